@@ -29,6 +29,35 @@ int deviceCalSweep(
     const double bw,
     const std::string &dir,
     const std::string &chans);
+int deviceRecord(
+    const std::string &argStr,
+    const std::string &path,
+    const double freq,
+    const double rate,
+    const double gain,
+    const double duration,
+    const std::string &chans);
+int devicePlay(
+    const std::string &argStr,
+    const std::string &path,
+    const std::string &fmtStr,
+    const double freq,
+    const double rate,
+    const double gain,
+    const unsigned repeat,
+    const double delay,
+    const std::string &chans);
+int deviceScan(
+    const std::string &argStr,
+    const double start,
+    const double stop,
+    const double step,
+    const double rate,
+    const double gain,
+    const unsigned ncoCount,
+    const unsigned dwell,
+    const bool pingPong,
+    const std::string &chans);
 
 /***********************************************************************
  * print help
@@ -60,6 +89,36 @@ static int printHelp(void)
     std::cout << "    --dir[=direction, default=BOTH]    \t Calibration direction, RX, TX, BOTH" << std::endl;
     std::cout << "    --chans[=channels, default=ALL]    \t Calibration channels, 0, 1, ALL" << std::endl;
     std::cout << std::endl;
+    std::cout << "  RX recording:" << std::endl;
+    std::cout << "    --record=\"path\"                   \t Record to path.sigmf-data/.sigmf-meta" << std::endl;
+    std::cout << "    --freq[=frequency]                 \t RX center frequency(Hz)" << std::endl;
+    std::cout << "    --rate[=sampleRate]                \t Sample rate(Hz)" << std::endl;
+    std::cout << "    --gain[=gain]                      \t RX gain(dB), default unchanged" << std::endl;
+    std::cout << "    --duration[=seconds, default=0]    \t Recording length, 0 until Ctrl+C" << std::endl;
+    std::cout << "    --chans[=channels, default=ALL]    \t Recorded channels, 0, 1, ALL" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  TX playback:" << std::endl;
+    std::cout << "    --play=\"filename\"                 \t Transmit IQ samples from file" << std::endl;
+    std::cout << "    --fmt[=format, default=int16]      \t File format, int16, int12, float32" << std::endl;
+    std::cout << "    --freq[=frequency]                 \t TX center frequency(Hz)" << std::endl;
+    std::cout << "    --rate[=sampleRate]                \t Sample rate(Hz)" << std::endl;
+    std::cout << "    --gain[=gain]                      \t TX gain(dB), default unchanged" << std::endl;
+    std::cout << "    --repeat[=count, default=1]        \t Times to play file, 0 until Ctrl+C" << std::endl;
+    std::cout << "    --delay[=seconds, default=0]       \t Start at hardware time, 0 immediately" << std::endl;
+    std::cout << "    --chans[=channels, default=ALL]    \t Transmit channels, 0, 1, ALL" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  RX power scan:" << std::endl;
+    std::cout << "    --scan[=\"module=foo,serial=bar\"] \t Scan RX power, optional device args..." << std::endl;
+    std::cout << "    --start[=freqStart]                \t First LO frequency(Hz)" << std::endl;
+    std::cout << "    --stop[=freqStop]                  \t Last LO frequency(Hz)" << std::endl;
+    std::cout << "    --step[=freqStep, default=1MHz]    \t LO step(Hz)" << std::endl;
+    std::cout << "    --rate[=sampleRate]                \t Sample rate(Hz)" << std::endl;
+    std::cout << "    --gain[=gain]                      \t RX gain(dB), default unchanged" << std::endl;
+    std::cout << "    --nco[=count, default=0]           \t NCO sub-bands per LO step, 0 - NCO not used" << std::endl;
+    std::cout << "    --dwell[=samples, default=4096]    \t Samples captured per step" << std::endl;
+    std::cout << "    --pingpong                         \t Alternate RX LO between SXR and SXT" << std::endl;
+    std::cout << "    --chans[=channel, default=0]       \t Scanned channel" << std::endl;
+    std::cout << std::endl;
     return EXIT_SUCCESS;
 }
 
@@ -337,11 +396,30 @@ int main(int argc, char *argv[])
         {"bw",      required_argument, 0, 'b'},
         {"dir",     required_argument, 0, 'd'},
         {"chans",   required_argument, 0, 'c'},
+        {"record",  required_argument, 0, 'R'},
+        {"freq",    required_argument, 0, 'q'},
+        {"rate",    required_argument, 0, 'S'},
+        {"gain",    required_argument, 0, 'G'},
+        {"duration", required_argument, 0, 'D'},
+        {"play",    required_argument, 0, 'P'},
+        {"fmt",     required_argument, 0, 'o'},
+        {"repeat",  required_argument, 0, 'n'},
+        {"delay",   required_argument, 0, 'y'},
+        {"scan",    optional_argument, 0, 'C'},
+        {"nco",     required_argument, 0, 'N'},
+        {"dwell",   required_argument, 0, 'W'},
+        {"pingpong",   no_argument, 0, 'x'},
         {0, 0, 0,  0}
     };
 
-    std::string argStr, dir("BOTH"), chans("ALL");
+    std::string argStr, dir("BOTH"), chans("ALL"), recordPath;
+    std::string playPath, fmt("int16");
+    unsigned repeat(1);
+    double delay(0.0);
+    unsigned ncoCount(0), dwell(4096);
+    bool scan(false), pingPong(false);
     double start(0.0), stop(0.0), step(1e6), bw(30e6);
+    double freq(0.0), rate(0.0), gain(-1.0), duration(0.0);
     bool testTiming(false), calSweep(false), update(false), force(false);
     int long_index = 0;
     int option = 0;
@@ -372,12 +450,31 @@ int main(int argc, char *argv[])
         case 'd': if (optarg != NULL) dir = optarg; break;
         case 'c': if (optarg != NULL) chans = optarg; break;
         case 'F': force = true; break;
+        case 'R': if (optarg != NULL) recordPath = optarg; break;
+        case 'q': if (optarg != NULL) freq = std::stod(optarg); break;
+        case 'S': if (optarg != NULL) rate = std::stod(optarg); break;
+        case 'G': if (optarg != NULL) gain = std::stod(optarg); break;
+        case 'D': if (optarg != NULL) duration = std::stod(optarg); break;
+        case 'P': if (optarg != NULL) playPath = optarg; break;
+        case 'o': if (optarg != NULL) fmt = optarg; break;
+        case 'n': if (optarg != NULL) repeat = std::stoul(optarg); break;
+        case 'y': if (optarg != NULL) delay = std::stod(optarg); break;
+        case 'C':
+            scan = true;
+            if (optarg != NULL) argStr = "none," + std::string(optarg);
+            break;
+        case 'N': if (optarg != NULL) ncoCount = std::stoul(optarg); break;
+        case 'W': if (optarg != NULL) dwell = std::stoul(optarg); break;
+        case 'x': pingPong = true; break;
         }
     }
 
     if (testTiming) return deviceTestTiming(argStr);
     if (calSweep) return deviceCalSweep(argStr, start, stop, step, bw, dir, chans);
     if (update) return programUpdate(force, argStr);
+    if (!recordPath.empty()) return deviceRecord(argStr, recordPath, freq, rate, gain, duration, chans);
+    if (!playPath.empty()) return devicePlay(argStr, playPath, fmt, freq, rate, gain, repeat, delay, chans);
+    if (scan) return deviceScan(argStr, start, stop, step, rate, gain, ncoCount, dwell, pingPong, chans);
 
     //unknown or unspecified options, do help...
     return printHelp();
@@ -0,0 +1,160 @@
+/**
+    @file LimeUtilPlay.cpp
+    @author Lime Microsystems
+    @brief Transmit IQ sample files
+*/
+
+#include <ConnectionRegistry.h>
+#include "lms7_device.h"
+#include "StreamPlayer.h"
+#include "Logger.h"
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace lime;
+
+static std::atomic<bool> stopPlaying(false);
+
+static void intHandler(int)
+{
+    stopPlaying.store(true);
+}
+
+int devicePlay(
+    const std::string &argStr,
+    const std::string &path,
+    const std::string &fmtStr,
+    const double freq,
+    const double rate,
+    const double gain,
+    const unsigned repeat,
+    const double delay,
+    const std::string &chansStr)
+{
+    if (rate <= 0.0 || freq <= 0.0)
+    {
+        std::cerr << "Unspecified --rate or --freq!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    StreamPlayer::Config playConfig;
+    playConfig.path = path;
+    if (fmtStr == "int16") playConfig.fileFormat = StreamConfig::FMT_INT16;
+    else if (fmtStr == "int12") playConfig.fileFormat = StreamConfig::FMT_INT12;
+    else if (fmtStr == "float32") playConfig.fileFormat = StreamConfig::FMT_FLOAT32;
+    else
+    {
+        std::cerr << "Unknown file format --fmt=" << fmtStr << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto handles = ConnectionRegistry::findConnections(ConnectionHandle(argStr));
+    if (handles.size() == 0)
+    {
+        std::cerr << "No available device!" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Connected to [" << handles[0].ToString() << "]" << std::endl;
+    LMS7_Device* device = LMS7_Device::CreateDevice(handles[0]);
+    if (device == nullptr || device->Init() != 0)
+    {
+        std::cerr << "Failed to initialize device: " << GetLastErrorMessage() << std::endl;
+        delete device;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<unsigned> chans;
+    if (chansStr == "ALL")
+        for (unsigned i = 0; i < device->GetNumChannels(true); ++i)
+            chans.push_back(i);
+    else
+        chans.push_back(std::stoi(chansStr));
+
+    int status = device->SetRate(rate, 0);
+    for (auto ch : chans)
+    {
+        if (status != 0)
+            break;
+        status = device->EnableChannel(true, ch, true);
+        if (status == 0)
+            status = device->SetFrequency(true, ch, freq);
+        if (status == 0 && gain >= 0)
+            status = device->SetGain(true, ch, gain);
+    }
+    if (status != 0)
+    {
+        std::cerr << "Failed to configure device: " << GetLastErrorMessage() << std::endl;
+        delete device;
+        return EXIT_FAILURE;
+    }
+
+    //write file samples unchanged when possible
+    std::vector<StreamChannel*> streams;
+    for (auto ch : chans)
+    {
+        StreamConfig config;
+        config.isTx = true;
+        config.channelID = ch;
+        config.align = false;
+        config.performanceLatency = 0.5;
+        config.bufferLength = 0;
+        config.format = playConfig.fileFormat;
+        config.linkFormat = StreamConfig::FMT_INT12;
+        streams.push_back(device->SetupStream(config));
+    }
+    for (auto s : streams)
+        s->Start();
+
+    playConfig.repeatCount = repeat;
+    playConfig.sampleRate = device->GetRate(true, chans[0]);
+    playConfig.timed = delay > 0;
+    playConfig.startTimestamp = delay > 0 ? uint64_t(delay * playConfig.sampleRate) : 0;
+
+    signal(SIGINT, intHandler);
+    std::vector<std::unique_ptr<StreamPlayer> > players;
+    for (auto s : streams)
+    {
+        players.emplace_back(new StreamPlayer());
+        if (players.back()->Start(s, playConfig) != 0)
+        {
+            std::cerr << "Failed to start playback: " << GetLastErrorMessage() << std::endl;
+            status = -1;
+            break;
+        }
+    }
+
+    if (status == 0)
+    {
+        std::cout << "Playing " << path << " on " << chans.size() << " channel(s) at "
+                  << playConfig.sampleRate / 1e6 << " MS/s, Ctrl+C to stop" << std::endl;
+        while (players[0]->IsRunning() && !stopPlaying.load())
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            auto stats = players[0]->GetStats();
+            auto info = streams[0]->GetInfo();
+            std::cout << "  " << stats.samplesSent / playConfig.sampleRate << " s, loops: " << stats.loopsCompleted
+                      << ", FIFO: " << 100.0 * info.fifoItemsCount / info.fifoSize << "%, underruns: " << info.underrun
+                      << ", late: " << info.droppedPackets << std::endl;
+        }
+    }
+    for (auto &p : players)
+        p->Stop();
+
+    //let FIFO drain before stopping stream
+    while (!stopPlaying.load() && status == 0 && streams[0]->GetInfo().fifoItemsCount > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    for (auto s : streams)
+    {
+        s->Stop();
+        device->DestroyStream(s);
+    }
+    delete device;
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,159 @@
+/**
+    @file LimeUtilRecord.cpp
+    @author Lime Microsystems
+    @brief Record RX samples to SigMF files
+*/
+
+#include <ConnectionRegistry.h>
+#include "lms7_device.h"
+#include "StreamRecorder.h"
+#include "Logger.h"
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+using namespace lime;
+
+static std::atomic<bool> stopRecording(false);
+
+static void intHandler(int)
+{
+    stopRecording.store(true);
+}
+
+int deviceRecord(
+    const std::string &argStr,
+    const std::string &path,
+    const double freq,
+    const double rate,
+    const double gain,
+    const double duration,
+    const std::string &chansStr)
+{
+    if (rate <= 0.0 || freq <= 0.0)
+    {
+        std::cerr << "Unspecified --rate or --freq!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto handles = ConnectionRegistry::findConnections(ConnectionHandle(argStr));
+    if (handles.size() == 0)
+    {
+        std::cerr << "No available device!" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Connected to [" << handles[0].ToString() << "]" << std::endl;
+    LMS7_Device* device = LMS7_Device::CreateDevice(handles[0]);
+    if (device == nullptr || device->Init() != 0)
+    {
+        std::cerr << "Failed to initialize device: " << GetLastErrorMessage() << std::endl;
+        delete device;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<unsigned> chans;
+    if (chansStr == "ALL")
+        for (unsigned i = 0; i < device->GetNumChannels(false); ++i)
+            chans.push_back(i);
+    else
+    {
+        char* end = nullptr;
+        const long ch = strtol(chansStr.c_str(), &end, 10);
+        if (chansStr.empty() || *end != '\0' || ch < 0 || ch >= long(device->GetNumChannels(false)))
+        {
+            std::cerr << "Invalid --chans " << chansStr << std::endl;
+            delete device;
+            return EXIT_FAILURE;
+        }
+        chans.push_back(ch);
+    }
+
+    int status = device->SetRate(rate, 0);
+    for (auto ch : chans)
+    {
+        if (status != 0)
+            break;
+        status = device->EnableChannel(false, ch, true);
+        if (status == 0)
+            status = device->SetFrequency(false, ch, freq);
+        if (status == 0 && gain >= 0)
+            status = device->SetGain(false, ch, gain);
+    }
+    if (status != 0)
+    {
+        std::cerr << "Failed to configure device: " << GetLastErrorMessage() << std::endl;
+        delete device;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<StreamChannel*> streams;
+    for (auto ch : chans)
+    {
+        StreamConfig config;
+        config.isTx = false;
+        config.channelID = ch;
+        config.align = false;
+        config.performanceLatency = 1.0; //favour throughput
+        config.bufferLength = 0;
+        config.format = StreamConfig::FMT_INT16;
+        config.linkFormat = StreamConfig::FMT_INT12;
+        StreamChannel* stream = device->SetupStream(config);
+        if (stream == nullptr)
+        {
+            std::cerr << "Failed to setup stream on channel " << ch << ": " << GetLastErrorMessage() << std::endl;
+            for (auto s : streams)
+                device->DestroyStream(s);
+            delete device;
+            return EXIT_FAILURE;
+        }
+        streams.push_back(stream);
+    }
+    for (auto s : streams)
+        s->Start();
+
+    StreamRecorder recorder;
+    StreamRecorder::Config recConfig;
+    recConfig.path = path;
+    recConfig.sampleRate = device->GetRate(false, chans[0]);
+    recConfig.frequency = freq;
+    recConfig.sampleCount = duration > 0 ? uint64_t(duration * recConfig.sampleRate) : 0;
+    recConfig.hardware = handles[0].ToString();
+
+    signal(SIGINT, intHandler);
+    if (recorder.Start(streams, recConfig) != 0)
+    {
+        std::cerr << "Failed to start recording: " << GetLastErrorMessage() << std::endl;
+        status = -1;
+    }
+    else
+    {
+        std::cout << "Recording " << chans.size() << " channel(s) at " << recConfig.sampleRate / 1e6
+                  << " MS/s to " << path << ".sigmf-data, Ctrl+C to stop" << std::endl;
+        while (recorder.IsRunning() && !stopRecording.load())
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            auto stats = recorder.GetStats();
+            std::cout << "  " << stats.samplesWritten / recConfig.sampleRate << " s, "
+                      << stats.throughput_Bps / 1e6 << " MB/s, gaps: " << stats.gaps
+                      << ", overruns link/disk: " << stats.linkOverruns << "/" << stats.diskOverruns
+                      << ", writer stalls: " << stats.writerStalls << std::endl;
+        }
+        status = recorder.Stop();
+        auto stats = recorder.GetStats();
+        std::cout << "Recorded " << stats.samplesWritten << " samples per channel ("
+                  << stats.bytesWritten / 1e6 << " MB, direct I/O " << (stats.directIO ? "on" : "off")
+                  << "), dropped " << stats.droppedSamples << " samples in " << stats.gaps << " gaps" << std::endl;
+    }
+
+    for (auto s : streams)
+    {
+        s->Stop();
+        device->DestroyStream(s);
+    }
+    delete device;
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,162 @@
+/**
+    @file LimeUtilScan.cpp
+    @author Lime Microsystems
+    @brief Scan RX power over frequency range with pipelined retuning
+*/
+
+#include <ConnectionRegistry.h>
+#include "lms7_device.h"
+#include "SweepEngine.h"
+#include "Logger.h"
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+
+using namespace lime;
+
+int deviceScan(
+    const std::string &argStr,
+    const double start,
+    const double stop,
+    const double step,
+    const double rate,
+    const double gain,
+    const unsigned ncoCount,
+    const unsigned dwell,
+    const bool pingPong,
+    const std::string &chansStr)
+{
+    if (start == 0.0 || stop == 0.0 || step == 0.0 || rate <= 0.0)
+    {
+        std::cerr << "Unspecified range --start, stop, step or --rate!" << std::endl;
+        return EXIT_FAILURE;
+    }
+    unsigned ch = 0;
+    if (chansStr != "ALL")
+    {
+        char* end = nullptr;
+        const long value = strtol(chansStr.c_str(), &end, 10);
+        if (chansStr.empty() || *end != '\0' || value < 0)
+        {
+            std::cerr << "Invalid --chans " << chansStr << ", expected channel index" << std::endl;
+            return EXIT_FAILURE;
+        }
+        ch = value;
+    }
+
+    auto handles = ConnectionRegistry::findConnections(ConnectionHandle(argStr));
+    if (handles.size() == 0)
+    {
+        std::cerr << "No available device!" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Connected to [" << handles[0].ToString() << "]" << std::endl;
+    LMS7_Device* device = LMS7_Device::CreateDevice(handles[0]);
+    if (device == nullptr || device->Init() != 0)
+    {
+        std::cerr << "Failed to initialize device: " << GetLastErrorMessage() << std::endl;
+        delete device;
+        return EXIT_FAILURE;
+    }
+
+    if (ch >= device->GetNumChannels(false))
+    {
+        std::cerr << "Invalid --chans " << ch << ", device has " << device->GetNumChannels(false) << " RX channels" << std::endl;
+        delete device;
+        return EXIT_FAILURE;
+    }
+
+    int status = device->SetRate(rate, 0);
+    if (status == 0)
+        status = device->EnableChannel(false, ch, true);
+    if (status == 0 && gain >= 0)
+        status = device->SetGain(false, ch, gain);
+    if (status != 0)
+    {
+        std::cerr << "Failed to configure device: " << GetLastErrorMessage() << std::endl;
+        delete device;
+        return EXIT_FAILURE;
+    }
+
+    SweepEngine::Config config;
+    config.sampleRate = device->GetRate(false, ch);
+    config.dwellSamples = dwell;
+    config.pingPong = pingPong;
+    //NCO offsets split every LO step in equal sub-bands
+    const double subBand = step / (ncoCount > 0 ? ncoCount : 1);
+    for (unsigned i = 0; i < ncoCount; ++i)
+        config.ncoOffsets.push_back((i + 0.5) * subBand - step / 2);
+    for (double freq = start; freq <= stop; freq += step)
+        config.frequencies.push_back(freq);
+
+    StreamConfig streamConfig;
+    streamConfig.isTx = false;
+    streamConfig.channelID = ch;
+    streamConfig.align = false;
+    streamConfig.performanceLatency = 0.0; //favour latency
+    streamConfig.bufferLength = 0;
+    streamConfig.format = StreamConfig::FMT_FLOAT32;
+    streamConfig.linkFormat = StreamConfig::FMT_INT12;
+    StreamChannel* stream = device->SetupStream(streamConfig);
+    if (stream == nullptr)
+    {
+        std::cerr << "Failed to setup stream: " << GetLastErrorMessage() << std::endl;
+        delete device;
+        return EXIT_FAILURE;
+    }
+
+    SweepEngine engine(device->GetLMS(ch / 2), stream);
+    std::cout << "Preparing " << config.frequencies.size() << " LO steps..." << std::endl;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    status = engine.Prepare(config);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::cout << "Prepared in " << std::chrono::duration<double>(t1 - t0).count() << " s" << std::endl;
+
+    stream->Start();
+    if (status == 0)
+    {
+        t0 = std::chrono::high_resolution_clock::now();
+        status = engine.Run([](const SweepEngine::Block &block, const void* samples, uint32_t count)
+        {
+            const float* iq = (const float*)samples;
+            double power = 0;
+            for (uint32_t i = 0; i < 2 * count; ++i)
+                power += iq[i] * iq[i];
+            std::cout << std::fixed << std::setprecision(3) << std::setw(10)
+                      << (block.loFrequency + block.ncoOffset) / 1e6 << " MHz " << std::setprecision(1)
+                      << std::setw(7) << 10 * std::log10(power / count + 1e-20) << " dBFS" << std::endl;
+            return true;
+        });
+        t1 = std::chrono::high_resolution_clock::now();
+    }
+    stream->Stop();
+    device->DestroyStream(stream);
+
+    if (status != 0)
+        std::cerr << "Scan failed: " << GetLastErrorMessage() << std::endl;
+    else
+    {
+        SweepEngine::StepTiming sum = {};
+        auto &timing = engine.GetTiming();
+        for (auto &t : timing)
+        {
+            sum.switchTime += t.switchTime;
+            sum.prepareTime += t.prepareTime;
+            sum.settleTime += t.settleTime;
+            sum.captureTime += t.captureTime;
+            sum.stepTime += t.stepTime;
+            sum.droppedSamples += t.droppedSamples;
+        }
+        const double n = timing.size();
+        const double duration = std::chrono::duration<double>(t1 - t0).count();
+        std::cout << std::setprecision(1) << "Average step (us): switch " << 1e6 * sum.switchTime / n
+                  << ", prepare " << 1e6 * sum.prepareTime / n << ", settle " << 1e6 * sum.settleTime / n
+                  << ", capture " << 1e6 * sum.captureTime / n << ", total " << 1e6 * sum.stepTime / n << std::endl;
+        std::cout << "Dropped samples per step: " << sum.droppedSamples / n << std::endl;
+        std::cout << std::setprecision(3) << "Scan: " << duration << " s, " << n / duration << " steps/s" << std::endl;
+    }
+    delete device;
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -8,7 +8,10 @@
 #include <ConnectionRegistry.h>
 #include <IConnection.h>
 #include <LMS7002M.h>
+#include "lms7_device.h"
+#include "Streamer.h"
 #include <iostream>
+#include <cstdio>
 #include <chrono>
 
 using namespace lime;
@@ -186,9 +189,123 @@ int deviceTestTiming(const std::string &argStr)
         std::cout << "  >>> RX corrections:\t\t" << (secsPerOp/1e-3) << " ms" << std::endl;
     }
 
-    std::cout << std::endl;
-    std::cout << "Done timing!" << std::endl;
     delete lms7;
     ConnectionRegistry::freeConnection(conn);
+
+    //time device initialization, found devices and their chips are initialized concurrently
+    {
+        std::cout << std::endl;
+        std::cout << "Timing device initialization:" << std::endl;
+        std::vector<LMS7_Device*> devices;
+        for (auto &handle : handles)
+        {
+            auto dev = LMS7_Device::CreateDevice(handle);
+            if (dev)
+                devices.push_back(dev);
+        }
+        auto t0 = std::chrono::high_resolution_clock::now();
+        const int status = devices.empty() ? -1 : LMS7_Device::InitDevices(devices);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        auto printPhases = [](LMS7_Device* dev)
+        {
+            for (auto &phase : dev->GetPhaseTiming())
+                std::cout << "  >>> " << (phase.chip < 0 ? std::string("device") : "chip " + std::to_string(phase.chip))
+                          << " " << phase.phase << ":\t" << (phase.duration/1e-3) << " ms" << std::endl;
+        };
+        if (status == 0)
+        {
+            printPhases(devices[0]);
+            std::cout << "  >>> Init total (" << devices.size() << " devices):\t" << (std::chrono::duration<double>(t1-t0).count()/1e-3) << " ms" << std::endl;
+        }
+        else
+            std::cout << "  >>> Init failed" << std::endl;
+        //only the first device is timed further
+        for (size_t i = 1; i < devices.size(); i++)
+            delete devices[i];
+        auto device = devices.empty() ? nullptr : devices[0];
+
+        //time calibration of all channels, chips are calibrated concurrently
+        if (status == 0)
+        {
+            std::cout << std::endl;
+            std::cout << "Timing channel calibration:" << std::endl;
+            std::vector<unsigned> chans;
+            for (unsigned ch = 0; ch < device->GetNumChannels(); ch++)
+                chans.push_back(ch);
+            auto t2 = std::chrono::high_resolution_clock::now();
+            const int calStatus = device->CalibrateChannels(false, chans, 10e6, 0);
+            auto t3 = std::chrono::high_resolution_clock::now();
+            printPhases(device);
+            std::cout << "  >>> Rx calibration total:\t" << (std::chrono::duration<double>(t3-t2).count()/1e-3) << " ms"
+                      << (calStatus == 0 ? "" : " (failed)") << std::endl;
+        }
+
+        //time radio profile switching, INI configuration against binary snapshot
+        if (status == 0)
+        {
+            std::cout << std::endl;
+            std::cout << "Timing profile load:" << std::endl;
+            const char* iniFile = "LimeUtilTiming.ini";
+            const char* snapshotFile = "LimeUtilTiming.snap";
+            const size_t numIters(10);
+            if (device->SaveConfig(iniFile) == 0 && device->SaveSnapshot(snapshotFile) == 0)
+            {
+                auto t2 = std::chrono::high_resolution_clock::now();
+                for (size_t i = 0; i < numIters; i++)
+                    device->LoadConfig(iniFile);
+                auto t3 = std::chrono::high_resolution_clock::now();
+                for (size_t i = 0; i < numIters; i++)
+                    device->LoadSnapshot(snapshotFile);
+                auto t4 = std::chrono::high_resolution_clock::now();
+                std::cout << "  >>> INI config load:\t\t" << (std::chrono::duration<double>(t3-t2).count()/numIters/1e-3) << " ms" << std::endl;
+                std::cout << "  >>> Snapshot load:\t\t" << (std::chrono::duration<double>(t4-t3).count()/numIters/1e-3) << " ms" << std::endl;
+            }
+            else
+                std::cout << "  >>> Profile save failed" << std::endl;
+            std::remove(iniFile);
+            std::remove(snapshotFile);
+        }
+
+        //time stream start and stop, armed start only sends one register transfer
+        StreamConfig config;
+        config.isTx = false;
+        config.channelID = 0;
+        config.align = false;
+        config.performanceLatency = 0.5;
+        config.bufferLength = 0;
+        config.format = StreamConfig::FMT_INT16;
+        config.linkFormat = StreamConfig::FMT_INT12;
+        StreamChannel* stream = status == 0 ? device->SetupStream(config) : nullptr;
+        if (stream)
+        {
+            std::cout << std::endl;
+            std::cout << "Timing stream start/stop:" << std::endl;
+            const size_t numIters(100);
+            for (int armed = 0; armed < 2; armed++)
+            {
+                double startTime = 0;
+                double stopTime = 0;
+                for (size_t i = 0; i < numIters; i++)
+                {
+                    if (armed && stream->Arm() != 0)
+                        break;
+                    auto t2 = std::chrono::high_resolution_clock::now();
+                    stream->Start();
+                    auto t3 = std::chrono::high_resolution_clock::now();
+                    stream->Stop();
+                    auto t4 = std::chrono::high_resolution_clock::now();
+                    startTime += std::chrono::duration<double>(t3-t2).count();
+                    stopTime += std::chrono::duration<double>(t4-t3).count();
+                }
+                std::cout << "  >>> " << (armed ? "Armed start:\t\t" : "Stream start:\t\t") << (startTime/numIters/1e-6) << " us" << std::endl;
+                std::cout << "  >>> " << (armed ? "Armed stop:\t\t" : "Stream stop:\t\t") << (stopTime/numIters/1e-6) << " us" << std::endl;
+            }
+            device->DestroyStream(stream);
+        }
+        delete device;
+    }
+
+    std::cout << std::endl;
+    std::cout << "Done timing!" << std::endl;
     return EXIT_SUCCESS;
 }
@@ -7,6 +7,7 @@
 #include "SoapyLMS7.h"
 #include "Logger.h"
 #include "lms7_device.h"
+#include "CommandQueue.h"
 #include <IConnection.h>
 #include <stdexcept>
 #include <iostream>
@@ -34,7 +35,10 @@ SoapyLMS7::SoapyLMS7(const ConnectionHandle &handle, const SoapySDR::Kwargs &arg
     _deviceArgs(args),
     _moduleName(handle.module),
     sampleRate{0.0, 0.0},
-    oversampling(0)   //auto
+    oversampling(0),  //auto
+    _commandTimeNs(0),
+    _recordingCommand(false),
+    _lastCommandTimeNs(0)
 {
     //connect
     SoapySDR::logf(SOAPY_SDR_INFO, "Make connection: '%s'", handle.ToString().c_str());
@@ -154,6 +158,8 @@ void SoapyLMS7::setAntenna(const int direction, const size_t channel, const std:
     std::unique_lock<std::recursive_mutex> lock(_accessMutex);
 
     SoapySDR::logf(SOAPY_SDR_DEBUG, "SoapyLMS7::setAntenna(%s, %d, %s)", dirName, int(channel), name.c_str());
+    if (deferCommand(channel, [=]{ this->setAntenna(direction, channel, name); }))
+        return;
 
     bool tx = direction == SOAPY_SDR_TX;
     std::vector<std::string> nameList = lms7Device->GetPathNames(tx);
@@ -282,6 +288,8 @@ void SoapyLMS7::setGain(const int direction, const size_t channel, const double
 {
     std::unique_lock<std::recursive_mutex> lock(_accessMutex);
     SoapySDR::logf(SOAPY_SDR_DEBUG, "SoapyLMS7::setGain(%s, %d, %g dB)", dirName, int(channel), value);
+    if (deferCommand(channel, [=]{ this->setGain(direction, channel, value); }))
+        return;
     lms7Device->SetGain(direction==SOAPY_SDR_TX,channel,value);
     SoapySDR::logf(SOAPY_SDR_DEBUG, "Actual %s[%d] gain %g dB", dirName, int(channel), this->getGain(direction, channel));
 }
@@ -296,6 +304,8 @@ void SoapyLMS7::setGain(const int direction, const size_t channel, const std::st
 {
     std::unique_lock<std::recursive_mutex> lock(_accessMutex);
     SoapySDR::logf(SOAPY_SDR_DEBUG, "SoapyLMS7::setGain(%s, %d, %s, %g dB)", dirName, int(channel), name.c_str(), value);
+    if (deferCommand(channel, [=]{ this->setGain(direction, channel, name, value); }))
+        return;
 
     lms7Device->SetGain(direction==SOAPY_SDR_TX, channel, value, name);
 
@@ -331,13 +341,16 @@ SoapySDR::ArgInfoList SoapyLMS7::getFrequencyArgsInfo(const int direction, const
 void SoapyLMS7::setFrequency(int direction, size_t channel, double frequency, const SoapySDR::Kwargs &args)
 {
     std::unique_lock<std::recursive_mutex> lock(_accessMutex);
+    if (deferCommand(channel, [=]{ this->setFrequency(direction, channel, frequency, args); }))
+        return;
     if (lms7Device->SetFrequency(direction == SOAPY_SDR_TX, channel, frequency)!=0)
     {
         SoapySDR::logf(SOAPY_SDR_ERROR, "setFrequency(%s, %d, %g MHz) Failed", dirName, int(channel), frequency/1e6);
         throw std::runtime_error("SoapyLMS7::setFrequency() failed");
     }
     mChannels[bool(direction)].at(channel).freq = frequency;
-    if (setBBLPF(direction, channel, mChannels[direction].at(channel).bw)!= 0)
+    //filter tuning runs MCU on the chip, timed change keeps current filter
+    if (!_recordingCommand && setBBLPF(direction, channel, mChannels[direction].at(channel).bw)!= 0)
         SoapySDR::logf(SOAPY_SDR_ERROR, "setBBLPF(%s, %d, RF, %g MHz) Failed", dirName, int(channel), mChannels[direction].at(channel).bw/1e6);
 }
 
@@ -345,6 +358,8 @@ void SoapyLMS7::setFrequency(const int direction, const size_t channel, const st
 {
     std::unique_lock<std::recursive_mutex> lock(_accessMutex);
     SoapySDR::logf(SOAPY_SDR_DEBUG, "SoapyLMS7::setFrequency(%s, %d, %s, %g MHz)", dirName, int(channel), name.c_str(), frequency/1e6);
+    if (deferCommand(channel, [=]{ this->setFrequency(direction, channel, name, frequency, args); }))
+        return;
     bool isTx = direction == SOAPY_SDR_TX;
     if (name == "RF")
     {
@@ -356,7 +371,7 @@ void SoapyLMS7::setFrequency(const int direction, const size_t channel, const st
         }
         mChannels[bool(direction)].at(channel).freq = frequency;
 
-        if (setBBLPF(direction, channel, mChannels[direction].at(channel).bw)!= 0)
+        if (!_recordingCommand && setBBLPF(direction, channel, mChannels[direction].at(channel).bw)!= 0)
             SoapySDR::logf(SOAPY_SDR_ERROR, "setBBLPF(%s, %d, RF, %g MHz) Failed", dirName, int(channel), mChannels[direction].at(channel).bw/1e6);
         _channelsToCal.emplace(direction, channel);
         return;
@@ -519,6 +534,21 @@ SoapySDR::RangeList SoapyLMS7::getSampleRateRange(const int direction, const siz
  * Bandwidth API
  ******************************************************************/
 
+/*!
+ * Calibrates channels of one direction, channels of different chips run concurrently
+ */
+void SoapyLMS7::calibrate(const int direction, const std::vector<unsigned> &channels, const double bw)
+{
+    SoapySDR::logf(SOAPY_SDR_INFO, "Calibrate %s %f", dirName, bw);
+    if (lms7Device->CalibrateChannels(direction == SOAPY_SDR_TX, channels, bw, 0)!=0)
+        throw std::runtime_error(lime::GetLastErrorMessage());
+    for (auto channel : channels)
+    {
+        _channelsToCal.erase(std::make_pair(direction, channel));
+        mChannels[direction].at(channel).cal_bw = bw;
+    }
+}
+
 int SoapyLMS7::setBBLPF(bool direction, size_t channel, double bw)
 {
     if (bw < 0)
@@ -637,6 +667,57 @@ void SoapyLMS7::setHardwareTime(const long long timeNs, const std::string &what)
     }
 }
 
+void SoapyLMS7::setCommandTime(const long long timeNs, const std::string &what)
+{
+    std::unique_lock<std::recursive_mutex> lock(_accessMutex);
+    if (!what.empty())
+        throw std::invalid_argument("SoapyLMS7::setCommandTime("+what+") unknown argument");
+    if (timeNs != 0 && sampleRate[SOAPY_SDR_RX] == 0)
+        throw std::runtime_error("SoapyLMS7::setCommandTime() sample rate unset");
+    _commandTimeNs = timeNs;
+}
+
+/*!
+ * When command time is set, runs the setter on the calling thread while
+ * recording chip register writes and queues only the recorded SPI batch,
+ * so the command thread neither takes the access lock nor reads the chip.
+ * Register cache and driver state reflect the setting right away.
+ * @return true when change was queued
+ */
+bool SoapyLMS7::deferCommand(const size_t channel, const std::function<void()> &command)
+{
+    if (_commandTimeNs == 0 || _recordingCommand)
+        return false;
+    const uint64_t ticks = SoapySDR::timeNsToTicks(_commandTimeNs, sampleRate[SOAPY_SDR_RX]);
+    lime::LMS7002M* lms = lms7Device->GetLMS(channel/2);
+    std::vector<uint32_t> spiWords;
+    lms->BeginWriteRecord();
+    _recordingCommand = true;
+    try
+    {
+        command();
+    }
+    catch (...)
+    {
+        _recordingCommand = false;
+        lms->EndWriteRecord(spiWords, true);
+        throw;
+    }
+    _recordingCommand = false;
+    if (lms->EndWriteRecord(spiWords) != 0)
+        throw std::runtime_error("SoapyLMS7::setCommandTime() setting needs chip response, it can not be timed");
+    const uint64_t id = lms7Device->ScheduleCommand(channel, ticks, [lms, spiWords]()
+    {
+        return lms->WriteRecorded(spiWords);
+    });
+    if (id == 0)
+        throw std::runtime_error("SoapyLMS7::setCommandTime() failed to queue command");
+    if (_timedCommands.size() >= CommandQueue::maxResults)
+        _timedCommands.erase(_timedCommands.begin());
+    _timedCommands.emplace_back(channel, id);
+    return true;
+}
+
 /*******************************************************************
  * Sensor API
  ******************************************************************/
@@ -832,20 +913,13 @@ void SoapyLMS7::writeSetting(const std::string &key, const std::string &value)
         }
     }
 
-    else if (key == "CALIBRATE_TX")
-    {
-        for (size_t channel = 0; channel < lms7Device->GetNumChannels(); channel++)
-        {
-            this->writeSetting(SOAPY_SDR_TX, channel, "CALIBRATE_TX", value);
-        }
-    }
-
-    else if (key == "CALIBRATE_RX")
+    else if (key == "CALIBRATE_TX" or key == "CALIBRATE_RX")
     {
+        std::unique_lock<std::recursive_mutex> lock(_accessMutex);
+        std::vector<unsigned> channels;
         for (size_t channel = 0; channel < lms7Device->GetNumChannels(); channel++)
-        {
-            this->writeSetting(SOAPY_SDR_RX, channel, "CALIBRATE_RX", value);
-        }
+            channels.push_back(channel);
+        calibrate(key == "CALIBRATE_TX" ? SOAPY_SDR_TX : SOAPY_SDR_RX, channels, std::stof(value));
     }
 
     else if (key == "ENABLE_RX_GFIR_LPF")
@@ -992,22 +1066,12 @@ void SoapyLMS7::writeSetting(const int direction, const size_t channel, const st
     }
     else if (key == "CALIBRATE_TX" or (isTx and key == "CALIBRATE"))
     {
-        double bw = std::stof(value);
-        SoapySDR::logf(SOAPY_SDR_INFO, "Calibrate Tx %f", bw);
-        if (lms7Device->Calibrate(true, channel, bw, 0)!=0)
-            throw std::runtime_error(lime::GetLastErrorMessage());
-        _channelsToCal.erase(std::make_pair(direction, channel));
-        mChannels[direction].at(channel).cal_bw = bw;
+        calibrate(SOAPY_SDR_TX, std::vector<unsigned>(1, channel), std::stof(value));
     }
 
     else if (key == "CALIBRATE_RX" or (not isTx and key == "CALIBRATE"))
     {
-        double bw = std::stof(value);
-        SoapySDR::logf(SOAPY_SDR_INFO, "CalibrateRx %f", bw);
-        if (lms7Device->Calibrate(false, channel, bw, 0)!=0)
-            throw std::runtime_error(lime::GetLastErrorMessage());
-        _channelsToCal.erase(std::make_pair(direction, channel));
-        mChannels[direction].at(channel).cal_bw = bw;
+        calibrate(SOAPY_SDR_RX, std::vector<unsigned>(1, channel), std::stof(value));
     }
 
     else if (key == "ENABLE_GFIR_LPF")
@@ -1061,6 +1125,31 @@ std::string SoapyLMS7::readSetting(const std::string &key) const
         return "";
     if (key == "OVERSAMPLING")
         return std::to_string(oversampling);
+    if (key == "COMMAND_TIME")
+    {
+        //achieved time of the latest executed timed command, 0 - none yet
+        std::unique_lock<std::recursive_mutex> lock(_accessMutex);
+        for (auto iter = _timedCommands.begin(); iter != _timedCommands.end();)
+        {
+            CommandQueue* queue = lms7Device->GetCommandQueueIfCreated(iter->first);
+            if (queue == nullptr)
+            {
+                //queue was destroyed with its streamer, results are gone
+                iter = _timedCommands.erase(iter);
+                continue;
+            }
+            CommandQueue::Result result;
+            if (queue->GetResult(iter->second, result) != 0)
+            {
+                ++iter;
+                continue;
+            }
+            if (result.status == 0)
+                _lastCommandTimeNs = SoapySDR::ticksToTimeNs(result.achieved, sampleRate[SOAPY_SDR_RX]);
+            iter = _timedCommands.erase(iter);
+        }
+        return std::to_string(_lastCommandTimeNs);
+    }
     return readSetting(SOAPY_SDR_TX, 0, key);
 }
 
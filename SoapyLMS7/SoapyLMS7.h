@@ -10,6 +10,8 @@
 #include <chrono>
 #include <map>
 #include <set>
+#include <vector>
+#include <functional>
 #include "Streamer.h"
 
 namespace lime
@@ -97,6 +99,21 @@ public:
         const long long timeNs = 0,
         const long timeoutUs = 100000);
 
+    size_t getNumDirectAccessBuffers(SoapySDR::Stream *stream);
+
+    int acquireWriteBuffer(
+        SoapySDR::Stream *stream,
+        size_t &handle,
+        void **buffs,
+        const long timeoutUs = 100000);
+
+    void releaseWriteBuffer(
+        SoapySDR::Stream *stream,
+        const size_t handle,
+        const size_t numElems,
+        int &flags,
+        const long long timeNs = 0);
+
     int readStreamStatus(
         SoapySDR::Stream *stream,
         size_t &chanMask,
@@ -215,6 +232,8 @@ public:
 
     void setHardwareTime(const long long timeNs, const std::string &what = "");
 
+    void setCommandTime(const long long timeNs, const std::string &what = "");
+
     /*******************************************************************
      * Sensor API
      ******************************************************************/
@@ -288,6 +307,8 @@ private:
     };
 
     int setBBLPF(bool direction, size_t channel, double bw);
+    void calibrate(const int direction, const std::vector<unsigned> &channels, const double bw);
+    bool deferCommand(const size_t channel, const std::function<void()> &command);
 
     const SoapySDR::Kwargs _deviceArgs; //!< stash of constructor arguments
     const std::string _moduleName;
@@ -298,4 +319,8 @@ private:
     mutable std::recursive_mutex _accessMutex;
     std::vector<Channel> mChannels[2]; //mChannels[direction]
     std::set<SoapySDR::Stream *> activeStreams;
+    long long _commandTimeNs; //!< 0 - commands run immediately
+    bool _recordingCommand; //!< setter runs to record register writes of timed command
+    mutable std::vector<std::pair<size_t, uint64_t>> _timedCommands; //!< channel, id
+    mutable long long _lastCommandTimeNs;
 };
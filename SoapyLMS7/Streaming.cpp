@@ -10,10 +10,15 @@
 #include <SoapySDR/Logger.hpp>
 #include <SoapySDR/Time.hpp>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <iostream>
 #include <algorithm> //min/max
+#include <map>
 #include "Logger.h"
 #include "Streamer.h"
+#include "Resampler.h"
+#include "threadHelper.h"
 
 using namespace lime;
 
@@ -27,12 +32,22 @@ struct IConnectionStream
     size_t elemSize;
     size_t elemMTU;
     bool skipCal;
+    //host resampled stream rate, timestamps count stream samples; 0 - device rate
+    double rate;
 
-    //rx cmd requests
+    //rx cmd requests, activation wakes readers waiting for one
+    std::mutex cmdLock;
+    std::condition_variable cmdCond;
     bool hasCmd;
     int flags;
     long long timeNs;
     size_t numElems;
+
+    //TX samples go into lent transfer buffers
+    bool directTx;
+    //acquired buffer is packet payload itself, otherwise staging is converted on release
+    bool zeroCopy;
+    std::vector<std::vector<char>> staging;
 };
 
 /*******************************************************************
@@ -106,6 +121,172 @@ SoapySDR::ArgInfoList SoapyLMS7::getStreamArgsInfo(const int direction, const si
         argInfos.push_back(info);
     }
 
+    //stream thread placement
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "";
+        info.key = "cpuAffinity";
+        info.name = "CPU Affinity";
+        info.description = "CPU cores for the stream thread, e.g. 2,4-5.";
+        info.type = SoapySDR::ArgInfo::STRING;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "threadPriority";
+        info.name = "Thread Priority";
+        info.description = "SCHED_FIFO priority 1-99 of the stream thread, 0 for default.";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "-1";
+        info.key = "numaNode";
+        info.name = "NUMA Node";
+        info.description = "NUMA node for stream buffers, -1 for node of the first affinity core.";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "hugePages";
+        info.name = "Huge Pages";
+        info.description = "Back stream buffers with huge pages when available.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0.25";
+        info.key = "bufferLatency";
+        info.name = "Buffer Latency";
+        info.description = "FIFO size in seconds of samples at sample rate, used when bufferLength is 0.";
+        info.units = "seconds";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "lockMemory";
+        info.name = "Lock Memory";
+        info.description = "Lock stream FIFO in RAM so it is never paged out.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "";
+        info.key = "usbCpuAffinity";
+        info.name = "USB CPU Affinity";
+        info.description = "CPU cores for the USB event thread.";
+        info.type = SoapySDR::ArgInfo::STRING;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "usbThreadPriority";
+        info.name = "USB Thread Priority";
+        info.description = "SCHED_FIFO priority 1-99 of the USB event thread, 0 for default.";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "dcIqTracking";
+        info.name = "DC/IQ Tracking";
+        info.description = "Track RX DC offset and IQ imbalance in background and update correctors while streaming.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+
+    //direct TX buffers
+    if (direction == SOAPY_SDR_TX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "directBuffers";
+        info.name = "Direct Buffers";
+        info.description = "Lend transfer buffers with acquireWriteBuffer(), single channel CS16 over CS16 link is written without copies.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+
+    //host side resampling
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "rate";
+        info.name = "Stream Rate";
+        info.description = "Resample stream on host to this rate, 0 for device rate. "
+            "Device rate is chosen for it when sample rate was not set.";
+        info.units = "Hz";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        argInfos.push_back(info);
+    }
+
+    //RX power trigger
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "";
+        info.key = "triggerLevel";
+        info.name = "Trigger Level";
+        info.description = "Deliver only windows around bursts reaching this average power, empty to deliver all samples.";
+        info.units = "dBFS";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        argInfos.push_back(info);
+    }
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "3";
+        info.key = "triggerHysteresis";
+        info.name = "Trigger Hysteresis";
+        info.description = "Window may end when power drops this much under trigger level.";
+        info.units = "dB";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        argInfos.push_back(info);
+    }
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "32";
+        info.key = "triggerAverage";
+        info.name = "Trigger Average";
+        info.description = "Samples in moving average of trigger power.";
+        info.units = "samples";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "1024";
+        info.key = "preTrigger";
+        info.name = "Pre-trigger";
+        info.description = "Samples delivered before trigger.";
+        info.units = "samples";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "1024";
+        info.key = "postTrigger";
+        info.name = "Post-trigger";
+        info.description = "Samples delivered after power dropped under trigger level.";
+        info.units = "samples";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+
     return argInfos;
 }
 
@@ -132,8 +313,77 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
     config.performanceLatency = 0.5;
     config.bufferLength = 0; //auto
 
+    //optional thread placement
+    if (args.count("cpuAffinity") != 0 and ParseCPUList(args.at("cpuAffinity"), config.cpuAffinity) != 0)
+        throw std::runtime_error("SoapyLMS7::setupStream(cpuAffinity="+args.at("cpuAffinity")+") invalid CPU list");
+    if (args.count("threadPriority") != 0)
+        config.threadPriority = std::stoi(args.at("threadPriority"));
+    if (args.count("numaNode") != 0)
+        config.numaNode = std::stoi(args.at("numaNode"));
+    config.hugePages = args.count("hugePages") != 0 and args.at("hugePages") == "true";
+    if (args.count("bufferLatency") != 0)
+        config.bufferLatency = std::stof(args.at("bufferLatency"));
+    config.lockMemory = args.count("lockMemory") != 0 and args.at("lockMemory") == "true";
+    if (args.count("usbCpuAffinity") != 0 and ParseCPUList(args.at("usbCpuAffinity"), config.usbCpuAffinity) != 0)
+        throw std::runtime_error("SoapyLMS7::setupStream(usbCpuAffinity="+args.at("usbCpuAffinity")+") invalid CPU list");
+    if (args.count("usbThreadPriority") != 0)
+        config.usbThreadPriority = std::stoi(args.at("usbThreadPriority"));
+    config.dcIqTracking = args.count("dcIqTracking") != 0 and args.at("dcIqTracking") == "true";
+    config.directBuffers = config.isTx and args.count("directBuffers") != 0 and args.at("directBuffers") == "true";
+    stream->directTx = config.directBuffers;
+    stream->zeroCopy = false;
+
+    //RX power trigger
+    if (args.count("triggerLevel") != 0 and not args.at("triggerLevel").empty())
+    {
+        config.powerTrigger = true;
+        config.triggerLevel = std::stof(args.at("triggerLevel"));
+        if (args.count("triggerHysteresis") != 0)
+            config.triggerHysteresis = std::stof(args.at("triggerHysteresis"));
+        if (args.count("triggerAverage") != 0)
+            config.triggerAverage = std::stoul(args.at("triggerAverage"));
+        if (args.count("preTrigger") != 0)
+            config.preTrigger = std::stoul(args.at("preTrigger"));
+        if (args.count("postTrigger") != 0)
+            config.postTrigger = std::stoul(args.at("postTrigger"));
+    }
+
+    //host side resampling from device rate to stream rate
+    stream->rate = 0;
+    const double rate = args.count("rate") != 0 ? std::stod(args.at("rate")) : 0;
+    if (rate > 0)
+    {
+        unsigned up = 1;
+        unsigned down = 1;
+        if (sampleRate[direction] <= 0)
+        {
+            const Resampler::Plan plan = Resampler::FindPlan(rate, lms7Device->GetClockFreq(LMS_CLOCK_REF));
+            if (plan.oversample == 0 || lms7Device->SetRate(plan.hardwareRate, int(plan.oversample)) != 0)
+                throw std::runtime_error("SoapyLMS7::setupStream(rate="+args.at("rate")+") cannot set device rate");
+            SoapySDR::logf(SOAPY_SDR_INFO, "Stream rate %g MHz: device rate %g MHz, resampling %u/%u, error %g Hz",
+                rate/1e6, plan.hardwareRate/1e6, plan.up, plan.down, plan.error);
+            sampleRate[SOAPY_SDR_RX] = sampleRate[SOAPY_SDR_TX] = plan.hardwareRate;
+            up = plan.up;
+            down = plan.down;
+        }
+        else if (Resampler::FindRatio(rate, sampleRate[direction], up, down) != 0)
+        {
+            const Resampler::Plan plan = Resampler::FindPlan(rate, lms7Device->GetClockFreq(LMS_CLOCK_REF));
+            throw std::runtime_error("SoapyLMS7::setupStream(rate="+args.at("rate")+") not a ratio of sample rate, try sample rate "
+                + std::to_string(plan.hardwareRate));
+        }
+        config.resampleUp = up;
+        config.resampleDown = down;
+        if (up != down)
+            stream->rate = rate;
+    }
+
     //default to channel 0, if none were specified
     const std::vector<size_t> &channelIDs = channels.empty() ? std::vector<size_t>{0} : channels;
+    //lent packets belong to one RF chip
+    if (config.directBuffers and (channelIDs.size() > 2 or channelIDs.front()/2 != channelIDs.back()/2))
+        throw std::runtime_error("SoapyLMS7::setupStream(directBuffers) channels have to be on the same RF chip");
+    stream->staging.resize(channelIDs.size());
     for(size_t i=0; i<channelIDs.size(); ++i)
     {
         config.channelID = channelIDs[i];
@@ -203,6 +453,9 @@ void SoapyLMS7::closeStream(SoapySDR::Stream *stream)
     for(auto i : streamID)
         i->Stop();
 
+    if (icstream->rate > 0 and not streamID.empty())
+        SoapySDR::logf(SOAPY_SDR_INFO, "Stream resampling cost %g ns/sample", streamID[0]->GetInfo().resampleCost);
+
     for(auto i : streamID)
         lms7Device->DestroyStream(i);
 }
@@ -230,21 +483,34 @@ int SoapyLMS7::activateStream(
     //this is for the set-it-and-forget-it style of use case
     //where boards are configured, the stream is setup,
     //and the configuration is maintained throughout the run
-    while (not _channelsToCal.empty() and not icstream->skipCal)
+    //channels with the same direction and bandwidth are calibrated together,
+    //so channels of different chips run concurrently
+    std::map<std::pair<int, double>, std::vector<unsigned>> calGroups;
+    for (const auto &toCal : _channelsToCal)
     {
-        bool dir  = _channelsToCal.begin()->first;
-        auto ch  = _channelsToCal.begin()->second;
+        if (icstream->skipCal)
+            break;
+        const int dir = toCal.first;
+        const auto ch = toCal.second;
         auto bw = mChannels[dir].at(ch).rf_bw > 0 ? mChannels[dir].at(ch).rf_bw : sampleRate[dir];
         bw = bw>2.5e6 ? bw : 2.5e6;
-        lms7Device->Calibrate(dir== SOAPY_SDR_TX, ch, bw, 0);
-        mChannels[dir].at(ch).cal_bw = bw;
-        _channelsToCal.erase(_channelsToCal.begin());
+        calGroups[std::make_pair(dir, bw)].push_back(ch);
+    }
+    for (const auto &group : calGroups)
+    {
+        const int dir = group.first.first;
+        const double bw = group.first.second;
+        lms7Device->CalibrateChannels(dir == SOAPY_SDR_TX, group.second, bw, 0);
+        for (auto ch : group.second)
+        {
+            mChannels[dir].at(ch).cal_bw = bw;
+            _channelsToCal.erase(std::make_pair(dir, ch));
+        }
     }
     //stream requests used with rx
     icstream->flags = flags;
     icstream->timeNs = timeNs;
     icstream->numElems = numElems;
-    icstream->hasCmd = true;
 
     for(auto i : streamID)
     {
@@ -252,6 +518,11 @@ int SoapyLMS7::activateStream(
         if(status != 0) return SOAPY_SDR_STREAM_ERROR;
     }
     activeStreams.insert(stream);
+    {
+        std::lock_guard<std::mutex> cmdLock(icstream->cmdLock);
+        icstream->hasCmd = true;
+    }
+    icstream->cmdCond.notify_all();
     return 0;
 }
 
@@ -263,7 +534,10 @@ int SoapyLMS7::deactivateStream(
     std::unique_lock<std::recursive_mutex> lock(_accessMutex);
     auto icstream = (IConnectionStream *)stream;
     const auto &streamID = icstream->streamID;
-    icstream->hasCmd = false;
+    {
+        std::lock_guard<std::mutex> cmdLock(icstream->cmdLock);
+        icstream->hasCmd = false;
+    }
 
     for(auto i : streamID)
     {
@@ -298,6 +572,7 @@ int SoapyLMS7::_readStreamAligned(
     const auto &streamID = stream->streamID;
     const size_t elemSize = stream->elemSize;
     std::vector<size_t> numWritten(streamID.size(), 0);
+    uint32_t configChanged = 0;
 
     for (size_t i = 0; i < streamID.size(); i += (numWritten[i]>=numElems)?1:0)
     {
@@ -308,6 +583,7 @@ int SoapyLMS7::_readStreamAligned(
         int status = streamID[i]->Read(buffs[i]+(elemSize*N), numElems-N,&md, timeoutMs);
         if (status == 0) return SOAPY_SDR_TIMEOUT;
         if (status < 0) return SOAPY_SDR_STREAM_ERROR;
+        configChanged |= md.flags & RingFIFO::CONFIG_CHANGED;
 
         //update accounting
         const size_t elemsRead = size_t(status);
@@ -351,6 +627,7 @@ int SoapyLMS7::_readStreamAligned(
     }
 
     md.timestamp = requestTime;
+    md.flags |= configChanged;
     return int(numElems);
 }
 
@@ -367,16 +644,11 @@ int SoapyLMS7::readStream(
 {
     auto icstream = (IConnectionStream *)stream;
 
-    const auto exitTime = std::chrono::high_resolution_clock::now() + std::chrono::microseconds(timeoutUs);
-
     //wait for a command from activate stream up to the timeout specified
-    if (not icstream->hasCmd)
     {
-        while (std::chrono::high_resolution_clock::now() < exitTime)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-        return SOAPY_SDR_TIMEOUT;
+        std::unique_lock<std::mutex> cmdLock(icstream->cmdLock);
+        if (not icstream->cmdCond.wait_for(cmdLock, std::chrono::microseconds(timeoutUs), [icstream]{ return icstream->hasCmd; }))
+            return SOAPY_SDR_TIMEOUT;
     }
 
     //handle the one packet flag by clipping
@@ -386,7 +658,8 @@ int SoapyLMS7::readStream(
     }
 
     StreamChannel::Metadata metadata;
-    const uint64_t cmdTicks = ((icstream->flags & SOAPY_SDR_HAS_TIME) != 0)?SoapySDR::timeNsToTicks(icstream->timeNs, sampleRate[SOAPY_SDR_RX]):0;
+    const double tickRate = icstream->rate > 0 ? icstream->rate : sampleRate[SOAPY_SDR_RX];
+    const uint64_t cmdTicks = ((icstream->flags & SOAPY_SDR_HAS_TIME) != 0)?SoapySDR::timeNsToTicks(icstream->timeNs, tickRate):0;
     int status = _readStreamAligned(icstream, (char * const *)buffs, numElems, cmdTicks, metadata, timeoutUs/1000);
     if (status < 0) return status;
 
@@ -433,7 +706,8 @@ int SoapyLMS7::readStream(
     flags = 0;
     if ((metadata.flags & RingFIFO::END_BURST) != 0) flags |= SOAPY_SDR_END_BURST;
     if ((metadata.flags & RingFIFO::SYNC_TIMESTAMP) != 0) flags |= SOAPY_SDR_HAS_TIME;
-    timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, sampleRate[SOAPY_SDR_RX]);
+    if ((metadata.flags & RingFIFO::CONFIG_CHANGED) != 0) flags |= SOAPY_SDR_USER_FLAG0;
+    timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, tickRate);
 
     //return num read or error code
     return (status >= 0) ? status : SOAPY_SDR_STREAM_ERROR;
@@ -454,7 +728,7 @@ int SoapyLMS7::writeStream(
 
     //input metadata
     StreamChannel::Metadata metadata;
-    metadata.timestamp = SoapySDR::timeNsToTicks(timeNs, sampleRate[SOAPY_SDR_RX]);
+    metadata.timestamp = SoapySDR::timeNsToTicks(timeNs, icstream->rate > 0 ? icstream->rate : sampleRate[SOAPY_SDR_RX]);
     metadata.flags = (flags & SOAPY_SDR_HAS_TIME) ? lime::RingFIFO::SYNC_TIMESTAMP : 0;
     metadata.flags |= (flags & SOAPY_SDR_END_BURST) ? lime::RingFIFO::END_BURST : 0;
 
@@ -480,6 +754,74 @@ int SoapyLMS7::writeStream(
     return status;
 }
 
+size_t SoapyLMS7::getNumDirectAccessBuffers(SoapySDR::Stream *stream)
+{
+    auto icstream = (IConnectionStream *)stream;
+    return icstream->directTx ? 1 : 0;
+}
+
+int SoapyLMS7::acquireWriteBuffer(
+    SoapySDR::Stream *stream,
+    size_t &handle,
+    void **buffs,
+    const long timeoutUs)
+{
+    auto icstream = (IConnectionStream *)stream;
+    const auto &streamID = icstream->streamID;
+    if (not icstream->directTx)
+        return SOAPY_SDR_NOT_SUPPORTED;
+
+    StreamChannel::TxPacket packet;
+    int status = streamID[0]->AcquireTxPacket(packet, timeoutUs/1000);
+    if (status == 0) return SOAPY_SDR_TIMEOUT;
+    if (status < 0) return SOAPY_SDR_STREAM_ERROR;
+
+    //payload is handed out only when it is the stream format, otherwise one conversion copy on release
+    icstream->zeroCopy = packet.channels == 1 and packet.linkFormat == StreamConfig::FMT_INT16
+        and streamID[0]->config.format == StreamConfig::FMT_INT16;
+    if (icstream->zeroCopy)
+        buffs[0] = packet.payload;
+    else for (size_t i = 0; i < streamID.size(); i++)
+    {
+        icstream->staging[i].resize(packet.capacity*icstream->elemSize);
+        buffs[i] = icstream->staging[i].data();
+    }
+    handle = 0;
+    return packet.capacity;
+}
+
+void SoapyLMS7::releaseWriteBuffer(
+    SoapySDR::Stream *stream,
+    const size_t handle,
+    const size_t numElems,
+    int &flags,
+    const long long timeNs)
+{
+    auto icstream = (IConnectionStream *)stream;
+    const auto &streamID = icstream->streamID;
+
+    StreamChannel::Metadata metadata;
+    metadata.timestamp = SoapySDR::timeNsToTicks(timeNs, sampleRate[SOAPY_SDR_RX]);
+    metadata.flags = (flags & SOAPY_SDR_HAS_TIME) ? lime::RingFIFO::SYNC_TIMESTAMP : 0;
+    metadata.flags |= (flags & SOAPY_SDR_END_BURST) ? lime::RingFIFO::END_BURST : 0;
+
+    int status;
+    if (icstream->zeroCopy)
+        status = streamID[0]->CommitTxPacket(numElems, &metadata);
+    else
+    {
+        //packet channel slots follow chip channel, unused slot is sent as silence
+        StreamChannel::TxPacket packet;
+        const void* samples[2] = {nullptr, nullptr};
+        streamID[0]->AcquireTxPacket(packet, 0);
+        for (size_t i = 0; i < streamID.size(); i++)
+            samples[packet.channels == 2 ? streamID[i]->config.channelID&1 : 0] = icstream->staging[i].data();
+        status = streamID[0]->CommitTxPacket(samples, numElems, &metadata);
+    }
+    if (status < 0)
+        SoapySDR::logf(SOAPY_SDR_ERROR, "releaseWriteBuffer() failed: %s", GetLastErrorMessage());
+}
+
 int SoapyLMS7::readStreamStatus(
     SoapySDR::Stream *stream,
     size_t &chanMask,
@@ -490,34 +832,54 @@ int SoapyLMS7::readStreamStatus(
     auto icstream = (IConnectionStream *)stream;
     const auto &streamID = icstream->streamID;
 
-    int ret = 0;
-    flags = 0;
-    lime::StreamChannel::Info metadata;
-    auto start = std::chrono::high_resolution_clock::now();
-    while (1)
-    {
-        for(auto i : streamID)
-        {
-            metadata = i->GetInfo();
+    //streams of the same RF chip share one event queue, wait on it with their channel mask
+    std::vector<uint8_t> chipMasks(streamID.size(), 0);
+    bool singleChip = true;
+    for (size_t i = 0; i < streamID.size(); i++)
+        for (size_t j = 0; j <= i; j++)
+            if (streamID[j]->mStreamer == streamID[i]->mStreamer)
+            {
+                chipMasks[j] |= 1 << (streamID[i]->config.channelID&1);
+                singleChip &= j == 0;
+                break;
+            }
 
-            if (metadata.droppedPackets) ret = SOAPY_SDR_TIME_ERROR;
-            else if (metadata.overrun) ret = SOAPY_SDR_OVERFLOW;
-            else if (metadata.underrun) ret = SOAPY_SDR_UNDERFLOW;
-        }
-        if (ret) break;
-        //check timeout
-        std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now()-start;
-        if (seconds.count()> (double)timeoutUs/1e6)
+    const auto exitTime = std::chrono::high_resolution_clock::now() + std::chrono::microseconds(timeoutUs);
+    StreamEvent event;
+    size_t chip = streamID.size();
+    while (chip == streamID.size())
+    {
+        const long remainingMs = std::max<long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(
+            exitTime - std::chrono::high_resolution_clock::now()).count());
+        //several chips are polled in turn
+        for (size_t i = 0; i < streamID.size() and chip == streamID.size(); i++)
+            if (chipMasks[i] and streamID[i]->WaitEvent(event, singleChip ? remainingMs : 0, chipMasks[i]))
+                chip = i;
+        if (chip != streamID.size())
+            break;
+        //single chip wait ends on timeout or stream stop
+        if (remainingMs == 0 or singleChip)
             return SOAPY_SDR_TIMEOUT;
-        //sleep to avoid high CPU load
-        if (timeoutUs >= 1000000)
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        else
-            std::this_thread::sleep_for(std::chrono::microseconds(timeoutUs));
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(remainingMs, 10L)));
     }
 
-    timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, sampleRate[SOAPY_SDR_RX]);
+    chanMask = 0;
+    for (size_t i = 0; i < streamID.size(); i++)
+        if (streamID[i]->mStreamer == streamID[chip]->mStreamer and (event.channels >> (streamID[i]->config.channelID&1)) & 1)
+            chanMask |= 1 << i;
+
+    timeNs = SoapySDR::ticksToTimeNs(event.timestamp, icstream->rate > 0 ? icstream->rate : sampleRate[SOAPY_SDR_RX]);
     //output metadata
-    flags |= SOAPY_SDR_HAS_TIME;
-    return ret;
+    flags = SOAPY_SDR_HAS_TIME;
+    switch (event.type)
+    {
+    case StreamEvent::EVENT_OVERFLOW: return SOAPY_SDR_OVERFLOW;
+    case StreamEvent::EVENT_UNDERFLOW: return SOAPY_SDR_UNDERFLOW;
+    case StreamEvent::EVENT_LATE_TX:
+    case StreamEvent::EVENT_DROPPED_PACKETS: return SOAPY_SDR_TIME_ERROR;
+    case StreamEvent::EVENT_BURST_ACK:
+        flags |= SOAPY_SDR_END_BURST;
+        return 0;
+    }
+    return 0;
 }
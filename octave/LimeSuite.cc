@@ -2,7 +2,13 @@
 #include <octave/Cell.h>
 #include <octave/ov-struct.h>
 #include <vector>
+#include <deque>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
 
 #include "LimeSuite.h"
 
@@ -11,7 +17,6 @@ using namespace std;
 void FreeResources();
 
 const int maxChCnt = 2;
-const float scaleFactor = 32768.0f;
 
 lms_device_t* lmsDev = NULL;
 lms_stream_t streamRx[maxChCnt];
@@ -24,13 +29,41 @@ struct complex16_t
 };
 
 bool WFMrunning = false;
-complex16_t* rxbuffers = NULL;
-complex16_t* txbuffers = NULL;
+
+/*
+ * Background RX capture, stream thread fills ring of every captured channel
+ * with timestamp aligned samples, LimeCapturePoll() copies the unread part.
+ */
+struct CaptureRing
+{
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> failed;   //stream thread stopped on receive error
+    std::mutex lock;
+    std::vector<int> channels;
+    std::vector<std::vector<FloatComplex> > data;
+    size_t size;
+    uint64_t written;   //samples per channel written since start
+    uint64_t readPos;   //samples per channel polled since start
+    uint64_t firstTimestamp;
+    std::deque<std::pair<uint64_t, uint64_t> > gaps; //[begin, end) of zero filled dropped samples
+    CaptureRing() : running(false), failed(false), size(0), written(0), readPos(0), firstTimestamp(0) {}
+} capture;
+
+void StopCapture()
+{
+    capture.running = false;
+    if (capture.thread.joinable())
+        capture.thread.join();
+    capture.data.clear();
+    capture.gaps.clear();
+}
 
 void StopStream()
 {
     if(lmsDev == NULL)
         return;
+    StopCapture();
     for (int i = 0; i < maxChCnt; i++)
     {
         LMS_StopStream(&streamRx[i]);
@@ -238,7 +271,7 @@ DEFUN_DLD (LimeStartStreaming, args, nargout,
         {
             streamRx[i].channel = i;
             streamRx[i].fifoSize = fifoSize;
-            streamRx[i].dataFmt = lms_stream_t::LMS_FMT_I16;
+            streamRx[i].dataFmt = lms_stream_t::LMS_FMT_F32;
             streamRx[i].isTx = false;
             streamRx[i].throughputVsLatency = 0.5;
             LMS_SetupStream(lmsDev, &streamRx[i]);
@@ -247,7 +280,7 @@ DEFUN_DLD (LimeStartStreaming, args, nargout,
         {
             streamTx[i].channel = i;
             streamTx[i].fifoSize = fifoSize;
-            streamTx[i].dataFmt = lms_stream_t::LMS_FMT_I16;
+            streamTx[i].dataFmt = lms_stream_t::LMS_FMT_F32;
             streamTx[i].isTx = true;
             streamTx[i].throughputVsLatency = 0.5;
             LMS_SetupStream(lmsDev, &streamTx[i]);
@@ -257,17 +290,9 @@ DEFUN_DLD (LimeStartStreaming, args, nargout,
     for (int i = 0; i < maxChCnt; i++)
     {
         if (rx[i])
-        {
-            if (!rxbuffers)
-                rxbuffers = new complex16_t[fifoSize/2];
             LMS_StartStream(&streamRx[i]);
-        }
         if (tx[i])
-        {
-            if (!txbuffers)
-                txbuffers = new complex16_t[fifoSize/2];
             LMS_StartStream(&streamTx[i]);
-        }
     }
 
     return octave_value_list();
@@ -286,82 +311,203 @@ DEFUN_DLD (LimeStopStreaming, args, nargout,
     return octave_value_list();
 }
 
-DEFUN_DLD (LimeReceiveSamples, args, ,
-"SIGNAL = LimeReceiveSamplesLarge( N, CH) - receive N samples from Rx channel CH.\n\
-CH parameter is optional, valid values are 0 and 1")
+/** @brief Receives samples of several RX channels, all starting at the same timestamp
+    @param channels RX channel indexes
+    @param dest destination of each channel, count samples each
+    @param timestamp receives timestamp of the first sample
+    @return samples received per channel, less than count on timeout or when
+        samples of some channel were dropped, (-1) on error
+*/
+static int ReceiveAligned(const std::vector<int> &channels, FloatComplex* const* dest, const int count, uint64_t &timestamp, const unsigned timeout_ms)
 {
-    if (!rxbuffers)
+    const size_t chCount = channels.size();
+    std::vector<int> filled(chCount, 0);
+    std::vector<uint64_t> start(chCount, 0);
+    //read channels in turns, so the other FIFOs do not overflow during large captures
+    int chunk = count;
+    for (auto ch : channels)
+        chunk = std::min<int>(chunk, std::max<int>(streamRx[ch].fifoSize/4, 4096));
+    int limit = count; //block ends early at timestamp discontinuity
+    bool aligned = chCount == 1;
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        for (size_t c = 0; c < chCount; ++c)
+        {
+            if (filled[c] >= limit)
+                continue;
+            lms_stream_meta_t meta;
+            const int toRead = std::min(count - filled[c], chunk);
+            const int samplesRead = LMS_RecvStream(&streamRx[channels[c]], dest[c] + filled[c], toRead, &meta, timeout_ms);
+            if (samplesRead < 0)
+                return -1;
+            if (samplesRead == 0)
+                continue;
+            if (filled[c] == 0)
+                start[c] = meta.timestamp;
+            else if (meta.timestamp != start[c] + filled[c])
+            {
+                //samples were dropped, return contiguous part only
+                limit = std::min(limit, filled[c]);
+                continue;
+            }
+            filled[c] += samplesRead;
+            progress = true;
+        }
+        if (aligned || *std::min_element(filled.begin(), filled.end()) == 0)
+            continue;
+        //drop leading samples of channels that started earlier
+        const uint64_t target = *std::max_element(start.begin(), start.end());
+        aligned = true;
+        for (size_t c = 0; c < chCount; ++c)
+        {
+            const uint64_t skip = target - start[c];
+            if (skip == 0)
+                continue;
+            if (skip >= uint64_t(filled[c]))
+            {
+                filled[c] = 0;
+                aligned = false;
+                continue;
+            }
+            memmove(dest[c], dest[c] + skip, (filled[c] - skip)*sizeof(FloatComplex));
+            filled[c] -= skip;
+            start[c] = target;
+        }
+        if (!aligned)
+            std::fill(filled.begin(), filled.end(), 0); //restart all from next samples
+    }
+    timestamp = start[0];
+    return std::min(limit, *std::min_element(filled.begin(), filled.end()));
+}
+
+/** @brief Reads RX channel list argument, scalar or vector of channel indexes
+    @return false if any channel is invalid or not streaming
+*/
+static bool GetRxChannels(const octave_value &arg, std::vector<int> &channels)
+{
+    channels.clear();
+    const Array<int> list = arg.int_vector_value();
+    for (octave_idx_type i = 0; i < list.numel(); ++i)
     {
-        octave_stdout << "Rx streaming not initialized" << endl;
-        return octave_value_list();;
+        const int ch = list(i);
+        if (ch < 0 || ch >= maxChCnt || streamRx[ch].handle == 0
+            || std::find(channels.begin(), channels.end(), ch) != channels.end())
+            return false;
+        channels.push_back(ch);
     }
+    return !channels.empty();
+}
+
+static int FirstRxChannel()
+{
+    for (int ch = 0; ch < maxChCnt; ch++)
+        if (streamRx[ch].handle != 0)
+            return ch;
+    return -1;
+}
 
+/** @brief Output array for samples of channels, row vector for one channel,
+    one column per channel otherwise, so every channel is contiguous
+*/
+static FloatComplexMatrix SamplesArray(int count, size_t chCount)
+{
+    return chCount == 1 ? FloatComplexMatrix(1, count) : FloatComplexMatrix(count, chCount);
+}
+
+DEFUN_DLD (LimeReceiveSamples, args, nargout,
+"[SIGNAL, TIMESTAMP] = LimeReceiveSamples( N, CH) - receive N samples from Rx channels CH.\n\
+CH parameter is optional, valid values are 0, 1 or [0 1] (default: first streaming channel)\n\
+SIGNAL is single precision, a row for one channel, one column per channel for several\n\
+channels, all starting at TIMESTAMP")
+{
     int nargin = args.length();
     if (nargin != 2 && nargin != 1)
     {
         print_usage ();
         return octave_value_list ();
     }
+    if (FirstRxChannel() < 0)
+    {
+        octave_stdout << "Rx streaming not initialized" << endl;
+        return octave_value_list();
+    }
+    if (capture.thread.joinable())
+    {
+        octave_stdout << "Background capture is running, stop it with LimeCaptureStop()" << endl;
+        return octave_value_list();
+    }
     const int samplesToReceive = args(0).int_value ();
+    if (samplesToReceive <= 0)
+    {
+        print_usage ();
+        return octave_value_list ();
+    }
 
-    unsigned chIndex;
+    std::vector<int> channels;
     if (nargin == 2)
     {
-        chIndex = args(1).int_value();
-        if (chIndex >= maxChCnt)
+        if (!GetRxChannels(args(1), channels))
         {
             octave_stdout << "Invalid channel number" << endl;
-            return octave_value_list();;
+            return octave_value_list();
         }
     }
     else
+        channels.push_back(FirstRxChannel());
+
+    //samples are converted by library straight into Octave array
+    FloatComplexMatrix iqdata = SamplesArray(samplesToReceive, channels.size());
+    FloatComplex* data = iqdata.fortran_vec();
+    std::vector<FloatComplex*> dest;
+    for (size_t c = 0; c < channels.size(); ++c)
+        dest.push_back(data + c*samplesToReceive);
+
+    const int timeout_ms = 1000;
+    uint64_t timestamp = 0;
+    const int samplesRead = ReceiveAligned(channels, dest.data(), samplesToReceive, timestamp, timeout_ms);
+    if (samplesRead < 0)
     {
-        for (chIndex = 0; chIndex < maxChCnt; chIndex++)
-            if (streamRx[chIndex].handle != 0)
-                break;
+        octave_stdout << "Error reading samples" << endl;
+        return octave_value(-1);
     }
+    if (samplesRead < samplesToReceive)
+        octave_stdout << "Timeout or dropped samples: received " << samplesRead << "/" << samplesToReceive << " samples" << endl;
 
-    Complex val=Complex(0.0,0.0);
-    ComplexRowVector iqdata( samplesToReceive, val ); // index 0 to N-1
+    octave_value_list retval;
+    retval(0) = iqdata;
+    if (nargout > 1)
+        retval(1) = octave_value(double(timestamp));
+    return retval;
+}
 
-    const int timeout_ms = 1000;
+/** @brief Sends whole signal, samples are converted by library from single precision
+    @return samples sent
+*/
+static int SendSamples(lms_stream_t &stream, const FloatComplexRowVector &iqdata, const unsigned timeout_ms)
+{
     lms_stream_meta_t meta;
-    int samplesCollected = 0;
-    int retries = 5;
-    while(samplesCollected < samplesToReceive && retries--)
-    {
-        int samplesToRead = 0;
-        if(samplesToReceive-samplesCollected > streamRx[chIndex].fifoSize/2)
-            samplesToRead = streamRx[chIndex].fifoSize/2;
-        else
-            samplesToRead = samplesToReceive-samplesCollected;
-        int samplesRead = LMS_RecvStream(&streamRx[chIndex], (void*)rxbuffers, samplesToRead, &meta, timeout_ms);
-        if (samplesRead < 0)
-        {
-            octave_stdout << "Error reading samples" << endl;
-            return octave_value(-1);
-        }
-        for(int i=0; i<samplesRead; ++i)
-        {
-            iqdata(samplesCollected+i)=Complex(rxbuffers[i].i/scaleFactor,rxbuffers[i].q/scaleFactor);
-        }
-        samplesCollected += samplesRead;
+    meta.waitForTimestamp = false;
+    meta.flushPartialPacket = false;
+    meta.timestamp = 0;
+    const int samplesCount = iqdata.numel();
+    int samplesSent = 0;
+    while (samplesSent < samplesCount)
+    {
+        const int ret = LMS_SendStream(&stream, iqdata.data() + samplesSent, samplesCount - samplesSent, &meta, timeout_ms);
+        if (ret <= 0)
+            break;
+        samplesSent += ret;
     }
-    return octave_value(iqdata);
+    return samplesSent;
 }
 
 DEFUN_DLD (LimeTransmitSamples, args, ,
 "LimeTransmitSamples( SIGNAL, CH) - sends normalized complex SIGNAL to Tx cahnnel CH\n\
 CH parameter is optional, valid values are 0 and 1")
 {
-    if (!txbuffers)
-    {
-        octave_stdout << "Tx streaming not initialized" << endl;
-        return octave_value(-1);
-    }
-
     int nargin = args.length();
-    int check=0;
     if (nargin != 2 && nargin != 1)
     {
         print_usage ();
@@ -372,7 +518,7 @@ CH parameter is optional, valid values are 0 and 1")
     if (nargin == 2)
     {
         chIndex = args(1).int_value ();
-        if (chIndex >= maxChCnt)
+        if (chIndex < 0 || chIndex >= maxChCnt)
         {
             octave_stdout << "Invalid channel number" << endl;
             return octave_value(-1);
@@ -384,29 +530,15 @@ CH parameter is optional, valid values are 0 and 1")
             if (streamTx[chIndex].handle != 0)
                 break;
     }
-
-    ComplexRowVector    iqdata=args(0).complex_row_vector_value();
-    dim_vector          iqdataSize=iqdata.dims();
-    int samplesCount = iqdataSize(0) > iqdataSize(1) ? iqdataSize(0) : iqdataSize(1);
-
-    for(int i=0; i < samplesCount; ++i)
+    if (chIndex >= maxChCnt || streamTx[chIndex].handle == 0)
     {
-        octave_value    iqdatum = scaleFactor*iqdata(i);
-        Complex iqdatum2 = iqdatum.complex_value();
-        short i_sample = iqdatum2.real(); //
-        short q_sample = iqdatum2.imag(); //
-        txbuffers[i].i = i_sample;
-        txbuffers[i].q = q_sample;
+        octave_stdout << "Tx streaming not initialized" << endl;
+        return octave_value(-1);
     }
 
+    const FloatComplexRowVector iqdata = args(0).float_complex_row_vector_value();
     const int timeout_ms = 1000;
-    lms_stream_meta_t meta;
-    meta.waitForTimestamp = false;
-    meta.timestamp = 0;
-    int samplesWrite = samplesCount;
-    samplesWrite = LMS_SendStream(&streamTx[chIndex], (const void*)txbuffers, samplesCount, &meta, timeout_ms);
-
-    return octave_value (samplesWrite);
+    return octave_value (SendSamples(streamTx[chIndex], iqdata, timeout_ms));
 }
 
 
@@ -415,17 +547,6 @@ DEFUN_DLD (LimeTransceiveSamples, args, ,
  RXOFFSET [optional] - number of samples to skip at the beginning of receive (default 0)\n\
  CH [optional] - channel to use for transmit and receive, valid values are 0 and 1 (default 0)")
 {
-    if (!rxbuffers)
-    {
-        octave_stdout << "Rx streaming not initialized" << endl;
-        return octave_value_list();
-    }
-    if (!txbuffers)
-    {
-        octave_stdout << "Tx streaming not initialized" << endl;
-        return octave_value_list();
-    }
-
     int nargin = args.length ();
     if (nargin == 0 || nargin > 3)
     {
@@ -435,34 +556,25 @@ DEFUN_DLD (LimeTransceiveSamples, args, ,
 
     unsigned chIndex = 0;
     if (nargin == 3)
-    {
         chIndex = args(2).int_value ();
-        if ((chIndex >= maxChCnt) || (streamRx[chIndex].handle == 0) || (streamTx[chIndex].handle == 0))
-        {
-            octave_stdout << "Invalid channel" << endl;
-            return octave_value_list();
-        }
+    if ((chIndex >= maxChCnt) || (streamRx[chIndex].handle == 0) || (streamTx[chIndex].handle == 0))
+    {
+        octave_stdout << "Invalid channel" << endl;
+        return octave_value_list();
+    }
+    if (capture.thread.joinable())
+    {
+        octave_stdout << "Background capture is running, stop it with LimeCaptureStop()" << endl;
+        return octave_value_list();
     }
 
     //transmit part
     const int timeout_ms = 1000;
-    lms_stream_meta_t meta = {0, false, false};
-    ComplexRowVector    iqdataTx=args(0).complex_row_vector_value();
-    dim_vector          iqdataSize=iqdataTx.dims();
-    const int samplesCount = iqdataSize(0) > iqdataSize(1) ? iqdataSize(0) : iqdataSize(1);
-
-    for(int i=0; i < samplesCount; ++i)
-    {
-        octave_value    iqdatum = scaleFactor*iqdataTx(i);
-        Complex iqdatum2 = iqdatum.complex_value();
-        short i_sample = iqdatum2.real(); //
-        short q_sample = iqdatum2.imag(); //
-        txbuffers[i].i = i_sample;
-        txbuffers[i].q = q_sample;
-    }
-    const int samplesWrite = LMS_SendStream(&streamTx[chIndex], (const void*)txbuffers, samplesCount, &meta, timeout_ms);
+    const FloatComplexRowVector iqdataTx = args(0).float_complex_row_vector_value();
+    const int samplesCount = iqdataTx.numel();
+    const int samplesWrite = SendSamples(streamTx[chIndex], iqdataTx, timeout_ms);
     if (samplesWrite != samplesCount)
-        octave_stdout << "Error transmitting samples: send " << samplesWrite +"/" +samplesCount << endl;
+        octave_stdout << "Error transmitting samples: send " << samplesWrite << "/" << samplesCount << endl;
 
     //Receive part
     int offset = nargin > 1 ? args(1).int_value() : 0;
@@ -471,36 +583,203 @@ DEFUN_DLD (LimeTransceiveSamples, args, ,
         octave_stdout << "Invalid RXOFFSET value" << endl;
         offset = 0;
     }
-    Complex val=Complex(0.0,0.0);
-    ComplexRowVector iqdataRx( samplesCount, val ); // index 0 to N-1
-
-    int samplesCollected = 0;
-    int retries = 5;
-    while(samplesCollected < samplesCount && retries--)
+    const std::vector<int> channels(1, chIndex);
+    uint64_t timestamp;
+    if (offset > 0)
     {
-        int samplesToRead = 0;
-        if(samplesCount-samplesCollected > streamRx[chIndex].fifoSize/2)
-            samplesToRead = streamRx[chIndex].fifoSize/2;
-        else
-            samplesToRead = samplesCount-samplesCollected;
-        int samplesRead = LMS_RecvStream(&streamRx[chIndex], (void*)rxbuffers, samplesToRead, &meta, timeout_ms);
-        if (samplesRead < 0)
+        std::vector<FloatComplex> skipped(offset);
+        FloatComplex* dest = skipped.data();
+        if (ReceiveAligned(channels, &dest, offset, timestamp, timeout_ms) < 0)
         {
             octave_stdout << "Error reading samples" << endl;
             return octave_value(-1);
         }
+    }
+    FloatComplexRowVector iqdataRx(samplesCount, FloatComplex(0.0f, 0.0f));
+    FloatComplex* dest = iqdataRx.fortran_vec();
+    if (ReceiveAligned(channels, &dest, samplesCount, timestamp, timeout_ms) < 0)
+    {
+        octave_stdout << "Error reading samples" << endl;
+        return octave_value(-1);
+    }
+    return octave_value(iqdataRx);
+}
+
+/** @brief Writes zeros for samples dropped by stream, keeps ring index equal to timestamp offset
+    @param count dropped samples per channel
+*/
+static void CaptureGap(uint64_t count)
+{
+    capture.gaps.push_back(std::make_pair(capture.written, capture.written + count));
+    const uint64_t zeroCount = std::min<uint64_t>(count, capture.size);
+    for (uint64_t i = capture.written + count - zeroCount; i < capture.written + count; ++i)
+        for (size_t c = 0; c < capture.channels.size(); ++c)
+            capture.data[c][i % capture.size] = FloatComplex(0.0f, 0.0f);
+    capture.written += count;
+}
 
-        if (offset >= samplesRead)
+static void CaptureLoop()
+{
+    const size_t chCount = capture.channels.size();
+    const int chunk = std::min<size_t>(capture.size/4, 64*1024);
+    std::vector<std::vector<FloatComplex> > block(chCount, std::vector<FloatComplex>(chunk));
+    std::vector<FloatComplex*> dest(chCount);
+    for (size_t c = 0; c < chCount; ++c)
+        dest[c] = block[c].data();
+    while (capture.running.load())
+    {
+        uint64_t timestamp;
+        const int samplesRead = ReceiveAligned(capture.channels, dest.data(), chunk, timestamp, 100);
+        if (samplesRead < 0)
         {
-            offset -= samplesRead;
-            continue;
+            capture.failed = true;
+            capture.running = false;
+            break;
+        }
+        if (samplesRead == 0)
+            continue; //timeout
+        std::lock_guard<std::mutex> lck(capture.lock);
+        if (capture.written == 0)
+            capture.firstTimestamp = timestamp;
+        const uint64_t expected = capture.firstTimestamp + capture.written;
+        if (timestamp > expected)
+            CaptureGap(timestamp - expected);
+        else if (timestamp < expected)
+            capture.firstTimestamp = timestamp - capture.written; //stream restarted
+        const size_t pos = capture.written % capture.size;
+        const size_t first = std::min<size_t>(samplesRead, capture.size - pos);
+        for (size_t c = 0; c < chCount; ++c)
+        {
+            memcpy(&capture.data[c][pos], block[c].data(), first*sizeof(FloatComplex));
+            memcpy(&capture.data[c][0], block[c].data() + first, (samplesRead - first)*sizeof(FloatComplex));
         }
+        capture.written += samplesRead;
+    }
+}
 
-        for(int i=offset; i<samplesRead; ++i)
-            iqdataRx(samplesCollected++)=Complex(rxbuffers[i].i/scaleFactor,rxbuffers[i].q/scaleFactor);
-        offset = 0;
+DEFUN_DLD (LimeCaptureStart, args, ,
+"LimeCaptureStart(RINGSIZE, CH) - start background receive into ring of RINGSIZE samples per channel\n\
+ CH [optional] - Rx channels, valid values are 0, 1 or [0 1] (default: first streaming channel)\n\
+ Samples are collected with LimeCapturePoll()")
+{
+    int nargin = args.length ();
+    if (nargin != 1 && nargin != 2)
+    {
+        print_usage ();
+        return octave_value(-1);
     }
-    return octave_value(iqdataRx);
+    if (FirstRxChannel() < 0)
+    {
+        octave_stdout << "Rx streaming not initialized" << endl;
+        return octave_value(-1);
+    }
+    const int ringSize = args(0).int_value();
+    std::vector<int> channels;
+    if (nargin == 2)
+    {
+        if (!GetRxChannels(args(1), channels))
+        {
+            octave_stdout << "Invalid channel number" << endl;
+            return octave_value(-1);
+        }
+    }
+    else
+        channels.push_back(FirstRxChannel());
+    if (ringSize < 4096)
+    {
+        octave_stdout << "RINGSIZE must be at least 4096 samples" << endl;
+        return octave_value(-1);
+    }
+
+    StopCapture();
+    capture.channels = channels;
+    capture.size = ringSize;
+    capture.data.assign(channels.size(), std::vector<FloatComplex>(ringSize));
+    capture.written = 0;
+    capture.readPos = 0;
+    capture.firstTimestamp = 0;
+    capture.failed = false;
+    capture.running = true;
+    capture.thread = std::thread(CaptureLoop);
+    return octave_value(0);
+}
+
+DEFUN_DLD (LimeCapturePoll, args, nargout,
+"[SIGNAL, TIMESTAMP, LOST] = LimeCapturePoll(N) - return up to N unread samples of background capture\n\
+ without waiting. N [optional] - default: all unread samples\n\
+ SIGNAL has same layout as in LimeReceiveSamples(), LOST is number of samples overwritten in ring\n\
+ before they were polled plus samples dropped by stream, which are returned as zeros")
+{
+    int nargin = args.length ();
+    if (nargin > 1)
+    {
+        print_usage ();
+        return octave_value_list();
+    }
+    if (capture.failed.load())
+    {
+        octave_stdout << "Capture stopped on receive error, restart it with LimeCaptureStart()" << endl;
+        return octave_value_list();
+    }
+    if (!capture.running.load())
+    {
+        octave_stdout << "Capture not started" << endl;
+        return octave_value_list();
+    }
+
+    std::lock_guard<std::mutex> lck(capture.lock);
+    uint64_t lost = 0;
+    if (capture.written - capture.readPos > capture.size)
+    {
+        lost = capture.written - capture.size - capture.readPos;
+        capture.readPos = capture.written - capture.size;
+    }
+    uint64_t count = capture.written - capture.readPos;
+    if (nargin == 1 && args(0).int_value() >= 0)
+        count = std::min<uint64_t>(count, args(0).int_value());
+    //dropped samples are counted once, when overwritten or when returned as zeros
+    const uint64_t end = capture.readPos + count;
+    while (!capture.gaps.empty() && capture.gaps.front().first < end)
+    {
+        std::pair<uint64_t, uint64_t> &gap = capture.gaps.front();
+        const uint64_t from = std::max(gap.first, capture.readPos);
+        if (gap.second > from)
+            lost += std::min(gap.second, end) - from;
+        if (gap.second > end)
+        {
+            gap.first = end;
+            break;
+        }
+        capture.gaps.pop_front();
+    }
+
+    const size_t chCount = capture.channels.size();
+    FloatComplexMatrix iqdata = SamplesArray(count, chCount);
+    FloatComplex* data = iqdata.fortran_vec();
+    const size_t pos = capture.readPos % capture.size;
+    const size_t first = std::min<size_t>(count, capture.size - pos);
+    for (size_t c = 0; c < chCount; ++c)
+    {
+        memcpy(data + c*count, &capture.data[c][pos], first*sizeof(FloatComplex));
+        memcpy(data + c*count + first, &capture.data[c][0], (count - first)*sizeof(FloatComplex));
+    }
+    const uint64_t timestamp = capture.firstTimestamp + capture.readPos;
+    capture.readPos += count;
+
+    octave_value_list retval;
+    retval(0) = iqdata;
+    if (nargout > 1)
+        retval(1) = octave_value(double(timestamp));
+    if (nargout > 2)
+        retval(2) = octave_value(double(lost));
+    return retval;
+}
+
+DEFUN_DLD (LimeCaptureStop, args, ,
+"LimeCaptureStop() - stop background receive")
+{
+    StopCapture();
+    return octave_value_list();
 }
 
 DEFUN_DLD (LimeLoopWFMStart, args, ,
@@ -610,16 +889,6 @@ void FreeResources()
         LMS_Close(lmsDev);
         lmsDev = NULL;
     }
-    if(rxbuffers)
-    {
-        delete rxbuffers;
-        rxbuffers = NULL;
-    }
-    if(txbuffers)
-    {
-        delete txbuffers;
-        txbuffers = NULL;
-    }
 }
 
 class ResourceDeallocator
@@ -10,4 +10,7 @@ autoload('LimeGetStreamStatus', which('LimeSuite.oct'))
 autoload('LimeLoopWFMStart', which('LimeSuite.oct'))
 autoload('LimeLoopWFMStop', which('LimeSuite.oct'))
 autoload('LimeGetDeviceList', which('LimeSuite.oct'))
-autoload('LimeTransceiveSamples', which('LimeSuite.oct'))
\ No newline at end of file
+autoload('LimeTransceiveSamples', which('LimeSuite.oct'))
+autoload('LimeCaptureStart', which('LimeSuite.oct'))
+autoload('LimeCapturePoll', which('LimeSuite.oct'))
+autoload('LimeCaptureStop', which('LimeSuite.oct'))
\ No newline at end of file
@@ -14,9 +14,19 @@ LimeStartStreaming(fifoSize,["rx0"; "rx1"]); % start RX from channels 0 and 1
 
 %receive samples, overwrite the same array
 for i=1:40
-    samplesCh0 = LimeReceiveSamples(readCnt,0); % read samples from RX channel 0
-    samplesCh1 = LimeReceiveSamples(readCnt,1); % read samples from RX channel 1
+    [samples, timestamp] = LimeReceiveSamples(readCnt,[0 1]); % one column per channel, time aligned
 end
+samplesCh0 = samples(:,1);
+samplesCh1 = samples(:,2);
+
+%background capture into 4 MSample ring, collect whatever has arrived
+LimeCaptureStart(4*1024*1024, [0 1]);
+for i=1:10
+    pause(0.1);
+    [captured, timestamp, lost] = LimeCapturePoll();
+    %do some processing on captured
+end
+LimeCaptureStop();
 LimeGetStreamStatus()     %must run at least 1s to get data rate (B/s)
 %stop streaming
 LimeStopStreaming();      % stop streaming
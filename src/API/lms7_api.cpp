@@ -9,6 +9,7 @@
 #include "Logger.h"
 #include "LMS64CProtocol.h"
 #include "Streamer.h"
+#include "threadHelper.h"
 #include "../limeRFE/RFE_Device.h"
 
 using namespace std;
@@ -486,20 +487,34 @@ API_EXPORT int CALL_CONV LMS_GetGaindB(lms_device_t *device, bool dir_tx, size_t
 
 API_EXPORT int CALL_CONV LMS_Calibrate(lms_device_t *device, bool dir_tx, size_t chan, double bw, unsigned flags)
 {
-    lime::LMS7_Device* lms = CheckDevice(device, chan);
+    return LMS_CalibrateChannels(device, dir_tx, &chan, 1, bw, flags);
+}
+
+API_EXPORT int CALL_CONV LMS_CalibrateChannels(lms_device_t *device, bool dir_tx, const size_t *chans, size_t count, double bw, unsigned flags)
+{
+    lime::LMS7_Device* lms = CheckDevice(device);
     if (!lms)
         return -1;
+    std::vector<unsigned> channels;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (CheckDevice(device, chans[i]) == nullptr)
+            return -1;
+        channels.push_back(chans[i]);
+    }
 
 #ifdef LIMERFE
     auto rfe = lms->GetLimeRFE();
     if (rfe)
-        rfe->OnCalibrate(chan, false);
+        for (auto chan : channels)
+            rfe->OnCalibrate(chan, false);
 #endif
-    int ret = lms->Calibrate(dir_tx, chan, bw, flags);
+    int ret = lms->CalibrateChannels(dir_tx, channels, bw, flags);
 
 #ifdef LIMERFE
     if (rfe)
-        rfe->OnCalibrate(chan, true);
+        for (auto chan : channels)
+            rfe->OnCalibrate(chan, true);
 #endif
     return ret;
 }
@@ -517,6 +532,18 @@ API_EXPORT int CALL_CONV LMS_SaveConfig(lms_device_t *device, const char *filena
     return lms ? lms->SaveConfig(filename) : -1;
 }
 
+API_EXPORT int CALL_CONV LMS_LoadSnapshot(lms_device_t *device, const char *filename)
+{
+    lime::LMS7_Device* lms = CheckDevice(device);
+    return lms ? lms->LoadSnapshot(filename) : -1;
+}
+
+API_EXPORT int CALL_CONV LMS_SaveSnapshot(lms_device_t *device, const char *filename)
+{
+    lime::LMS7_Device* lms = CheckDevice(device);
+    return lms ? lms->SaveSnapshot(filename) : -1;
+}
+
 API_EXPORT int CALL_CONV LMS_SetTestSignal(lms_device_t *device, bool dir_tx, size_t chan, lms_testsig_t sig, int16_t dc_i, int16_t dc_q)
 {
     lime::LMS7_Device* lms = CheckDevice(device, chan);
@@ -736,9 +763,10 @@ API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *str
 
     lime::StreamConfig config;
     config.bufferLength = stream->fifoSize;
-    config.channelID = stream->channel;
+    config.channelID = stream->channel & ~(LMS_ALIGN_CH_PHASE | LMS_DIRECT_TX_BUFFERS);
     config.performanceLatency = stream->throughputVsLatency;
     config.align = stream->channel & LMS_ALIGN_CH_PHASE;
+    config.directBuffers = stream->isTx && (stream->channel & LMS_DIRECT_TX_BUFFERS);
     switch(stream->dataFmt)
     {
         case lms_stream_t::LMS_FMT_F32:
@@ -800,6 +828,16 @@ API_EXPORT int CALL_CONV LMS_StartStream(lms_stream_t *stream)
     return reinterpret_cast<lime::StreamChannel*>(stream->handle)->Start();
 }
 
+API_EXPORT int CALL_CONV LMS_ArmStream(lms_stream_t *stream)
+{
+    if (stream==nullptr || stream->handle==0)
+    {
+        lime::error("Invalid stream handle");
+        return -1;
+    }
+    return reinterpret_cast<lime::StreamChannel*>(stream->handle)->Arm();
+}
+
 API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream)
 {
     if (stream==nullptr || stream->handle==0)
@@ -807,6 +845,34 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream)
     return reinterpret_cast<lime::StreamChannel*>(stream->handle)->Stop();
 }
 
+API_EXPORT int CALL_CONV LMS_SetStreamThreadParams(lms_stream_t *stream, const char *cpus, int priority, int numaNode, bool hugePages)
+{
+    if (stream==nullptr || stream->handle==0)
+    {
+        lime::error("Invalid stream handle");
+        return -1;
+    }
+    lime::StreamChannel* channel = reinterpret_cast<lime::StreamChannel*>(stream->handle);
+    std::vector<int> cpuList;
+    if (cpus != nullptr && lime::ParseCPUList(cpus, cpuList) != 0)
+        return -1;
+    return channel->SetThreadParams(cpuList, priority, numaNode, hugePages) == 0 ? 0 : -1;
+}
+
+API_EXPORT int CALL_CONV LMS_SetUSBThreadParams(lms_stream_t *stream, const char *cpus, int priority)
+{
+    if (stream==nullptr || stream->handle==0)
+    {
+        lime::error("Invalid stream handle");
+        return -1;
+    }
+    lime::StreamChannel* channel = reinterpret_cast<lime::StreamChannel*>(stream->handle);
+    std::vector<int> cpuList;
+    if (cpus != nullptr && lime::ParseCPUList(cpus, cpuList) != 0)
+        return -1;
+    return channel->SetUSBThreadParams(cpuList, priority) == 0 ? 0 : -1;
+}
+
 API_EXPORT int CALL_CONV LMS_RecvStream(lms_stream_t *stream, void *samples, size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms)
 {
     if (stream==nullptr || stream->handle==0)
@@ -845,6 +911,35 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream, const void *sample
     return channel->Write(samples, sample_count, &metadata, timeout_ms);
 }
 
+API_EXPORT int CALL_CONV LMS_AcquireTxBuffer(lms_stream_t *stream, void **payload, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || payload==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::TxPacket packet;
+    int ret = channel->AcquireTxPacket(packet, timeout_ms);
+    *payload = ret > 0 ? packet.payload : nullptr;
+    return ret;
+}
+
+API_EXPORT int CALL_CONV LMS_CommitTxBuffer(lms_stream_t *stream, size_t sample_count, const lms_stream_meta_t *meta)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    if (meta)
+    {
+        metadata.flags |= meta->waitForTimestamp * lime::RingFIFO::SYNC_TIMESTAMP;
+        metadata.flags |= meta->flushPartialPacket * lime::RingFIFO::END_BURST;
+        metadata.timestamp = meta->timestamp;
+    }
+    else metadata.timestamp = 0;
+
+    return channel->CommitTxPacket(sample_count, &metadata);
+}
+
 API_EXPORT int CALL_CONV LMS_UploadWFM(lms_device_t *device,
                                          const void **samples, uint8_t chCount,
                                          size_t sample_count, int format)
@@ -905,6 +1000,30 @@ API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_st
     return LMS_SUCCESS;
 }
 
+API_EXPORT int CALL_CONV LMS_GetHardwareTime(lms_device_t *device, uint64_t *ticks, double *error)
+{
+    lime::LMS7_Device* lms = CheckDevice(device);
+    if (!lms || ticks == nullptr)
+        return -1;
+    return lms->GetHardwareTime(*ticks, error);
+}
+
+API_EXPORT int CALL_CONV LMS_HostToHardwareTime(lms_device_t *device, int64_t host_ns, uint64_t *ticks)
+{
+    lime::LMS7_Device* lms = CheckDevice(device);
+    if (!lms || ticks == nullptr)
+        return -1;
+    return lms->HostToHardwareTime(host_ns, *ticks);
+}
+
+API_EXPORT int CALL_CONV LMS_HardwareToHostTime(lms_device_t *device, uint64_t ticks, int64_t *host_ns)
+{
+    lime::LMS7_Device* lms = CheckDevice(device);
+    if (!lms || host_ns == nullptr)
+        return -1;
+    return lms->HardwareToHostTime(ticks, *host_ns);
+}
+
 API_EXPORT const lms_dev_info_t* CALL_CONV LMS_GetDeviceInfo(lms_device_t *device)
 {
     lime::LMS7_Device* lms = CheckDevice(device);
@@ -966,6 +1085,16 @@ API_EXPORT void LMS_RegisterLogHandler(LMS_LogHandler handler)
         lime::registerLogHandler(nullptr);
 }
 
+API_EXPORT void LMS_SetLogAsync(bool enable)
+{
+    lime::setAsyncLogging(enable);
+}
+
+API_EXPORT void LMS_SetLogRateLimit(unsigned burst, double period)
+{
+    lime::setLogRateLimit(burst, period);
+}
+
 extern "C" API_EXPORT int CALL_CONV LMS_TransferLMS64C(lms_device_t *dev, int cmd, uint8_t* data, size_t *len)
 {
     auto conn = CheckConnection(dev);
@@ -14,7 +14,10 @@
 #include "LimeSDR_PCIE.h"
 #include "LimeSDR_Core.h"
 #include "FairwavesXTRX.h"
-#include "GFIR/lms_gfir.h"
+#include "GFIRCache.h"
+#include "DeviceSnapshot.h"
+#include "CommandQueue.h"
+#include "ClockModel.h"
 #include "IConnection.h"
 #include "dataTypes.h"
 #include "MCU_BD.h"
@@ -25,10 +28,31 @@
 #include "Logger.h"
 #include "device_constants.h"
 #include "LMSBoards.h"
+#include <thread>
+#include <functional>
 
 namespace lime
 {
 
+/** @brief Runs func(i) for every index on its own thread
+    @return first non-zero status in index order, 0 on success
+*/
+static int RunParallel(unsigned count, const std::function<int(unsigned)> &func)
+{
+    if (count == 1)
+        return func(0);
+    std::vector<int> status(count, 0);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < count; ++i)
+        threads.push_back(std::thread([&func, &status, i](){ status[i] = func(i); }));
+    for (auto &t : threads)
+        t.join();
+    for (auto s : status)
+        if (s != 0)
+            return s;
+    return 0;
+}
+
 std::vector<lime::ConnectionHandle> LMS7_Device::GetDeviceList()
 {
     return lime::ConnectionRegistry::findConnections();
@@ -125,9 +149,7 @@ lime::LMS7002M* LMS7_Device::SelectChannel(unsigned ch) const
 
 int LMS7_Device::ConfigureGFIR(bool tx, unsigned ch, bool enabled, double bandwidth)
 {
-    double w,w2;
-    int L;
-    int div = 1;
+    lime::GFIRCache::Key key;
 
     if (tx)
         tx_channels[ch].gfir_bw = enabled ? bandwidth : -1;
@@ -159,23 +181,10 @@ int LMS7_Device::ConfigureGFIR(bool tx, unsigned ch, bool enabled, double bandwi
             interface_MHz = lms->GetReferenceClk_TSP(lime::LMS7002M::Rx) / 1e6;
         }
 
-        if (ratio != 7)
-            div = (2<<(ratio));
-
-        w = (bandwidth/2)/(interface_MHz/div);
-
-        L = div > 8 ? 8 : div;
-        div -= 1;
-
-        w2 = w*1.1;
-        if (w2 > 0.495)
+        if (!lime::GFIRCache::MakeKey(bandwidth, interface_MHz, ratio, key))
         {
-            w2 = w*1.05;
-            if (w2 > 0.495)
-            {
-                lime::warning("GFIR LPF cannot be set to the requested bandwidth");
-                enabled = false; //Filter disabled
-            }
+            lime::warning("GFIR LPF cannot be set to the requested bandwidth");
+            enabled = false; //Filter disabled
         }
     }
 
@@ -205,49 +214,12 @@ int LMS7_Device::ConfigureGFIR(bool tx, unsigned ch, bool enabled, double bandwi
     if (!enabled)
         return 0;
 
-    double coef[120];
-    double coef2[40];
-    short gfir1[120];
-    short gfir2[40];
-
-    GenerateFilter(L*15, w, w2, 1.0, 0, coef);
-    GenerateFilter(L*5, w, w2, 1.0, 0, coef2);
-
-    int sample = 0;
-    for(int i=0; i<15; i++)
-    {
-	for(int j=0; j<8; j++)
-        {
-            if( (j < L) && (sample < L*15) )
-            {
-                gfir1[i*8+j] = (coef[sample]*32767.0);
-		sample++;
-            }
-            else
-            {
-		gfir1[i*8+j] = 0;
-            }
-	}
-    }
-
-    sample = 0;
-    for(int i=0; i<5; i++)
-    {
-	for(int j=0; j<8; j++)
-        {
-            if( (j < L) && (sample < L*5) )
-            {
-                gfir2[i*8+j] = (coef2[sample]*32767.0);
-		sample++;
-            }
-            else
-            {
-		gfir2[i*8+j] = 0;
-            }
-	}
-    }
-
-    L-=1;
+    //designs are memoized, bandwidth sweeps and repeated setups reuse them
+    const lime::GFIRCache::Entry coefs = lime::GFIRCache::Instance().Get(key);
+    const int16_t* gfir1 = coefs.gfir1;
+    const int16_t* gfir2 = coefs.gfir2;
+    const int L = key.taps/15 - 1;
+    const int div = key.ratio - 1;
 
     if (tx)
     {
@@ -324,9 +296,24 @@ int LMS7_Device::SetRate(double f_Hz, int oversample)
 
     oversample = 2<<decim;
 
+    lime::RateCache &cache = lime::RateCache::Instance();
     for (unsigned i = 0; i < lms_list.size(); i++)
     {
          lime::LMS7002M* lms = lms_list[i];
+         //previous switches to the same rate are written back without VCO and PLL tuning
+         const lime::RateCache::Key key = lime::RateCache::MakeKey(lms, GetRateCacheBoard(), i, f_Hz*4*oversample, decim);
+         lime::RateCache::Entry entry;
+         lms_chip_id = i;
+         if (cache.Find(key, entry))
+         {
+             if (ReplayRate(entry, decim) == 0)
+             {
+                 cache.Store(key, entry);
+                 continue;
+             }
+             lime::warning("Stored sample rate configuration failed, reconfiguring");
+             cache.Remove(key);
+         }
         if ((lms->SetFrequencyCGEN(f_Hz*4*oversample) != 0)
             || (lms->Modify_SPI_Reg_bits(LMS7param(EN_ADCCLKH_CLKGN), 0) != 0)
             || (lms->Modify_SPI_Reg_bits(LMS7param(CLKH_OV_CLKL_CGEN), 2) != 0)
@@ -337,8 +324,18 @@ int LMS7_Device::SetRate(double f_Hz, int oversample)
             || (lms->SetInterfaceFrequency(lms->GetFrequencyCGEN(), decim, decim) != 0))
             return -1;
          lms_chip_id = i;
-         if (SetFPGAInterfaceFreq(decim, decim)!=0)
+         if (fpga)
+             fpga->BeginRecording();
+         const int status = SetFPGAInterfaceFreq(decim, decim);
+         if (fpga && !fpga->EndRecording(entry.fpgaAddrs, entry.fpgaData))
+         {
+             entry.fpgaAddrs.clear();
+             entry.fpgaData.clear();
+         }
+         if (status != 0)
              return -1;
+         lime::RateCache::Capture(lms, entry);
+         cache.Store(key, entry);
     }
 
     for (unsigned i = 0; i < GetNumChannels();i++)
@@ -629,6 +626,41 @@ int LMS7_Device::SetRate(unsigned ch, double rxRate, double txRate, unsigned ove
     return SetRate(false, rxRate, oversample);
 }
 
+/** @brief Identifies board in rate cache keys, VCO tuning differs between boards
+*/
+const std::string& LMS7_Device::GetRateCacheBoard()
+{
+    if (rateCacheBoard.empty() && connection)
+    {
+        auto info = connection->GetDeviceInfo();
+        char serial[32];
+        snprintf(serial, sizeof(serial), "%llx", (unsigned long long)info.boardSerialNumber);
+        rateCacheBoard = info.deviceName + "_" + serial + "_" + info.gatewareVersion + "." + info.gatewareRevision;
+    }
+    return rateCacheBoard;
+}
+
+/** @brief Writes back stored rate change of active chip
+    @return 0-success, -1 stored configuration did not lock
+*/
+int LMS7_Device::ReplayRate(lime::RateCache::Entry &entry, int decim)
+{
+    auto lms = lms_list[lms_chip_id];
+    if (lime::RateCache::Apply(lms, entry) != 0)
+        return -1;
+    if (!fpga)
+        return 0;
+    //PLL configuration that needed status polling is redone
+    if (entry.fpgaAddrs.empty())
+        return SetFPGAInterfaceFreq(decim, decim);
+    if (fpga->WriteRegisters(entry.fpgaAddrs.data(), entry.fpgaData.data(), entry.fpgaAddrs.size()) != 0)
+        return -1;
+    //replayed writes do not wait for PLL, caller reconfigures if it fails
+    if (fpga->WaitPllDone(100) != 0)
+        return -1;
+    return lms->ResetLogicregisters();
+}
+
 int LMS7_Device::SetFPGAInterfaceFreq(int interp, int dec, double txPhase, double rxPhase)
 {
     if (!fpga)
@@ -1425,44 +1457,146 @@ int LMS7_Device::Init()
         {0x040B, 0x1020}, {0x040C, 0x00FB}
     };
 
-    for (unsigned i = 0; i < lms_list.size(); i++)
+    //whole register set goes in one batch, MAC=2 only needs channel B registers
+    std::vector<uint16_t> addrsA, valsA, addrsB, valsB;
+    for (auto i : initVals)
+    {
+        addrsA.push_back(i.adr);
+        valsA.push_back(i.val);
+        if (i.adr >= 0x100)
+        {
+            addrsB.push_back(i.adr);
+            valsB.push_back(i.val);
+        }
+    }
+
+    ResetPhaseTiming();
+    //chips are independent, chips sharing a connection interleave their transactions
+    auto initChip = [&](unsigned i)->int
     {
         lime::LMS7002M* lms = lms_list[i];
+        auto t = std::chrono::steady_clock::now();
         if (lms->ResetChip() != 0)
             return -1;
-       
         lms->Modify_SPI_Reg_bits(LMS7param(MAC), 1);
-        for (auto i : initVals)
-            lms->SPI_write(i.adr, i.val, true);
-        
+        lms->SPI_write_batch(addrsA.data(), valsA.data(), addrsA.size(), true);
+        AddPhaseTiming(i, "reset", t);
+
+        t = std::chrono::steady_clock::now();
         if(lms->CalibrateTxGain(0,nullptr) != 0)
             return -1;
+        AddPhaseTiming(i, "TxGain A", t);
 
+        t = std::chrono::steady_clock::now();
         EnableChannel(true, 2*i, false);
         lms->Modify_SPI_Reg_bits(LMS7param(MAC), 2);
-        for (auto i : initVals)
-            if (i.adr >= 0x100)
-                lms->SPI_write(i.adr, i.val, true);
-
+        lms->SPI_write_batch(addrsB.data(), valsB.data(), addrsB.size(), true);
         if(lms->CalibrateTxGain(0,nullptr) != 0)
             return -1;
+        AddPhaseTiming(i, "TxGain B", t);
 
         EnableChannel(false, 2*i+1, false);
         EnableChannel(true, 2*i+1, false);
 
         lms->Modify_SPI_Reg_bits(LMS7param(MAC), 1);
+        return 0;
+    };
 
+    if (RunParallel(lms_list.size(), initChip) != 0)
+        return -1;
+
+    //SetFrequency() can reach SetRate(), which configures every chip and
+    //selects active chip, so tuning runs after the parallel part
+    for (unsigned i = 0; i < lms_list.size(); i++)
+    {
+        auto t = std::chrono::steady_clock::now();
         if(SetFrequency(true,2*i,GetFrequency(true,2*i))!=0)
             return -1;
         if(SetFrequency(false,2*i,GetFrequency(false,2*i))!=0)
             return -1;
+        AddPhaseTiming(i, "tune SX", t);
     }
 
+    auto t = std::chrono::steady_clock::now();
     if (SetRate(10e6,2)!=0)
         return -1;
+    AddPhaseTiming(-1, "SetRate", t);
     return 0;
 }
 
+/** @brief Initializes several devices concurrently
+    @param devices devices to initialize, each on its own thread
+    @return 0 on success, -1 if any device failed
+*/
+int LMS7_Device::InitDevices(const std::vector<LMS7_Device*> &devices)
+{
+    auto start = std::chrono::steady_clock::now();
+    int status = RunParallel(devices.size(), [&devices](unsigned i){ return devices[i]->Init(); });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    lime::info("Initialized %d devices in %.3f s", int(devices.size()), elapsed.count());
+    return status;
+}
+
+/** @brief Calibrates several channels, channels of different chips run concurrently
+    @param dir_tx calibration direction
+    @param chans channels to calibrate, channels of the same chip run one after another
+    @param bw calibration bandwidth
+    @param flags calibration flags
+    @return 0 on success, -1 if any channel failed
+*/
+int LMS7_Device::CalibrateChannels(bool dir_tx, const std::vector<unsigned> &chans, double bw, unsigned flags)
+{
+    std::vector<std::vector<unsigned> > chipChannels(lms_list.size());
+    for (auto ch : chans)
+    {
+        if (ch/2 >= lms_list.size())
+            return ReportError(EINVAL, "Calibrate: invalid channel %d", ch);
+        chipChannels[ch/2].push_back(ch);
+    }
+
+    ResetPhaseTiming();
+    auto calibrateChip = [&](unsigned i)->int
+    {
+        int status = 0;
+        for (auto ch : chipChannels[i])
+        {
+            auto t = std::chrono::steady_clock::now();
+            if (Calibrate(dir_tx, ch, bw, flags) != 0)
+                status = -1;
+            AddPhaseTiming(i, ch%2 ? (dir_tx ? "Tx B" : "Rx B") : (dir_tx ? "Tx A" : "Rx A"), t);
+        }
+        return status;
+    };
+    return RunParallel(lms_list.size(), calibrateChip);
+}
+
+void LMS7_Device::ResetPhaseTiming()
+{
+    std::lock_guard<std::mutex> lock(mPhaseTimingLock);
+    mPhaseTiming.clear();
+    mPhaseTimingStart = std::chrono::steady_clock::now();
+}
+
+void LMS7_Device::AddPhaseTiming(int chip, const char* phase, std::chrono::steady_clock::time_point begin)
+{
+    PhaseTiming timing;
+    timing.chip = chip;
+    timing.phase = phase;
+    std::lock_guard<std::mutex> lock(mPhaseTimingLock);
+    timing.start = std::chrono::duration<double>(begin - mPhaseTimingStart).count();
+    timing.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    mPhaseTiming.push_back(timing);
+    lime::debug("chip %d %s: %.1f ms", chip, phase, timing.duration*1000);
+}
+
+/** @brief Returns step durations of the last Init() or multi channel Calibrate()
+*/
+std::vector<LMS7_Device::PhaseTiming> LMS7_Device::GetPhaseTiming() const
+{
+    std::lock_guard<std::mutex> lock(mPhaseTimingLock);
+    return mPhaseTiming;
+}
+
 int LMS7_Device::Reset()
 {
     for (unsigned i = 0; i < lms_list.size(); i++)
@@ -1506,6 +1640,9 @@ int LMS7_Device::Program(const std::string& mode, const char* data, size_t len,
 {
     if (connection == nullptr)
         return lime::ReportError(EINVAL, "Device not connected");
+    //programming resets FPGA or firmware, cached registers are stale afterwards
+    if (fpga)
+        fpga->ClearCache();
 
     if (mode == program_mode::autoUpdate)
         return this->connection->ProgramUpdate(true, true, callback);
@@ -1753,6 +1890,107 @@ int LMS7_Device::SaveConfig(const char *filename, int ind) const
     return lms_list.at(ind == -1 ? lms_chip_id : ind)->SaveConfig(filename);
 }
 
+/** @brief True if snapshot changes chip registers that define interface clocks
+*/
+static bool SnapshotChangesClocks(lime::LMS7002M* lms, const lime::DeviceSnapshot::ChipState &state)
+{
+    //register map may be outdated without values cache
+    if (!lms->IsValuesCacheEnabled())
+        return true;
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        const auto &addrs = state.addrs[ch];
+        for (size_t n = 0; n < addrs.size(); ++n)
+        {
+            bool clockReg = false;
+            if (ch == 0)
+                for (unsigned i = 0; i < lime::RateCache::globalRegCount; ++i)
+                    clockReg |= addrs[n] == lime::RateCache::globalRegs[i];
+            for (unsigned i = 0; i < lime::RateCache::channelRegCount; ++i)
+                clockReg |= addrs[n] == lime::RateCache::channelRegs[i];
+            if (clockReg && lms->SPI_read_cached(ch, addrs[n]) != state.values[ch][n])
+                return true;
+        }
+    }
+    return false;
+}
+
+int LMS7_Device::LoadSnapshot(const char *filename)
+{
+    lime::DeviceSnapshot snapshot;
+    if (snapshot.Load(filename) != 0)
+        return -1;
+    if (snapshot.chips.size() != lms_list.size())
+        return lime::ReportError(EINVAL, "LoadSnapshot: snapshot of %d chips, device has %d",
+                                 int(snapshot.chips.size()), int(lms_list.size()));
+
+    const unsigned chipId = lms_chip_id;
+    int status = 0;
+    for (unsigned i = 0; i < lms_list.size(); i++)
+    {
+        const bool clocksChanged = SnapshotChangesClocks(lms_list[i], snapshot.chips[i]);
+        if (lime::DeviceSnapshot::ApplyChip(lms_list[i], snapshot.chips[i]) != 0)
+            status = -1;
+        else if (clocksChanged)
+        {
+            lms_chip_id = i;
+            if (SetFPGAInterfaceFreq(-1, -1, -1000, -1000) != 0)
+                status = -1;
+        }
+    }
+    lms_chip_id = chipId;
+    if (fpga && !snapshot.fpgaAddrs.empty()
+        && fpga->WriteRegisters(snapshot.fpgaAddrs.data(), snapshot.fpgaData.data(), snapshot.fpgaAddrs.size()) != 0)
+        status = -1;
+
+    for (unsigned i = 0; i < rx_channels.size() && i < snapshot.rxChannels.size(); i++)
+    {
+        const auto &state = snapshot.rxChannels[i];
+        rx_channels[i].freq = state.freq;
+        rx_channels[i].sample_rate = state.sampleRate;
+        rx_channels[i].lpf_bw = state.lpfBw;
+        rx_channels[i].gfir_bw = state.gfirBw;
+        rx_channels[i].cF_offset_nco = state.ncoOffset;
+    }
+    for (unsigned i = 0; i < tx_channels.size() && i < snapshot.txChannels.size(); i++)
+    {
+        const auto &state = snapshot.txChannels[i];
+        tx_channels[i].freq = state.freq;
+        tx_channels[i].sample_rate = state.sampleRate;
+        tx_channels[i].lpf_bw = state.lpfBw;
+        tx_channels[i].gfir_bw = state.gfirBw;
+        tx_channels[i].cF_offset_nco = state.ncoOffset;
+    }
+    return status;
+}
+
+int LMS7_Device::SaveSnapshot(const char *filename) const
+{
+    lime::DeviceSnapshot snapshot;
+    snapshot.chips.resize(lms_list.size());
+    for (unsigned i = 0; i < lms_list.size(); i++)
+        if (lime::DeviceSnapshot::CaptureChip(lms_list[i], snapshot.chips[i]) != 0)
+            return -1;
+    if (fpga)
+    {
+        snapshot.fpgaAddrs.assign(lime::DeviceSnapshot::fpgaRegs, lime::DeviceSnapshot::fpgaRegs + lime::DeviceSnapshot::fpgaRegCount);
+        snapshot.fpgaData.resize(snapshot.fpgaAddrs.size());
+        if (fpga->ReadRegisters(snapshot.fpgaAddrs.data(), snapshot.fpgaData.data(), snapshot.fpgaAddrs.size()) != 0)
+            return -1;
+    }
+    for (auto &info : rx_channels)
+    {
+        lime::DeviceSnapshot::ChannelState state = {info.freq, info.sample_rate, info.lpf_bw, info.gfir_bw, info.cF_offset_nco};
+        snapshot.rxChannels.push_back(state);
+    }
+    for (auto &info : tx_channels)
+    {
+        lime::DeviceSnapshot::ChannelState state = {info.freq, info.sample_rate, info.lpf_bw, info.gfir_bw, info.cF_offset_nco};
+        snapshot.txChannels.push_back(state);
+    }
+    return snapshot.Save(filename);
+}
+
 int LMS7_Device::ReadLMSReg(uint16_t address, int ind) const
 {
     return lms_list.at(ind == -1 ? lms_chip_id : ind)->SPI_read(address & 0xFFFF);
@@ -1885,6 +2123,70 @@ void LMS7_Device::SetHardwareTimestamp(const uint64_t now)
     mStreamers[0]->SetHardwareTimestamp(now);
 }
 
+/** @brief Hardware timestamp estimated from host clock, unlike GetHardwareTimestamp()
+    it does not lag by the size of RX transfers
+    @param error receives error bound in samples, can be nullptr
+    @return 0 on success, -1 if RX stream has not run long enough
+*/
+int LMS7_Device::GetHardwareTime(uint64_t &ticks, double* error) const
+{
+    return HostToHardwareTime(lime::ClockModel::HostTimeNs(), ticks, error);
+}
+
+/** @brief Hardware timestamp at host steady clock time, see GetHardwareTime()
+*/
+int LMS7_Device::HostToHardwareTime(int64_t hostNs, uint64_t &ticks, double* error) const
+{
+    if (mStreamers[0]->GetClockModel().HostToTicks(hostNs, ticks, error) != 0)
+        return lime::ReportError(-1, "Hardware time is not known, RX stream must be running");
+    ticks += mStreamers[0]->mTimestampOffset;
+    return 0;
+}
+
+/** @brief Host steady clock time when hardware timestamp reaches given value
+*/
+int LMS7_Device::HardwareToHostTime(uint64_t ticks, int64_t &hostNs) const
+{
+    if (mStreamers[0]->GetClockModel().TicksToHost(ticks - mStreamers[0]->mTimestampOffset, hostNs) != 0)
+        return lime::ReportError(-1, "Hardware time is not known, RX stream must be running");
+    return 0;
+}
+
+lime::Channelizer* LMS7_Device::GetRxChannelizer(unsigned chan)
+{
+    if (chan >= GetNumChannels() || !connection)
+        return nullptr;
+    return mStreamers[chan/2]->GetRxChannelizer(chan&1);
+}
+
+lime::CommandQueue* LMS7_Device::GetCommandQueue(unsigned chan)
+{
+    if (chan >= GetNumChannels() || !connection)
+        return nullptr;
+    return mStreamers[chan/2]->GetCommandQueue();
+}
+
+lime::CommandQueue* LMS7_Device::GetCommandQueueIfCreated(unsigned chan) const
+{
+    if (chan >= GetNumChannels() || !connection)
+        return nullptr;
+    return mStreamers[chan/2]->GetCommandQueueIfCreated();
+}
+
+/** @brief Runs command when hardware timestamp of the channel's chip reaches given value
+    @return command id for CommandQueue::GetResult(), 0 - failure
+*/
+uint64_t LMS7_Device::ScheduleCommand(unsigned chan, uint64_t timestamp, const std::function<int()> &command)
+{
+    lime::CommandQueue* queue = GetCommandQueue(chan);
+    if (queue == nullptr)
+    {
+        lime::ReportError(EINVAL, "Invalid channel number.");
+        return 0;
+    }
+    return queue->Schedule(timestamp, command);
+}
+
 int LMS7_Device::MCU_AGCStart(uint32_t wantedRSSI)
 {
     lime::MCU_BD *mcu = lms_list.at(lms_chip_id)->GetMCUControls();
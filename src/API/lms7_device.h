@@ -11,8 +11,11 @@
 #include "lime/LimeSuite.h"
 #include <vector>
 #include <string>
+#include <mutex>
+#include <chrono>
 #include "Streamer.h"
 #include "IConnection.h"
+#include "RateCache.h"
 
 class RFE_Device;
 
@@ -21,6 +24,14 @@ namespace lime
 class LIME_API LMS7_Device
 {
 public:
+    //! Duration of one initialization or calibration step
+    struct PhaseTiming
+    {
+        int chip;           //!< LMS7002M index, -1 for device wide steps
+        std::string phase;
+        double start;       //!< seconds since start of Init() or Calibrate()
+        double duration;    //!< seconds
+    };
     struct Range {
         Range(double a = 0, double b = 0){ min = a, max = b; };
         double min;
@@ -65,6 +76,9 @@ public:
     int SetNCOPhase(bool tx, unsigned ch, int ind, double phase);
     double GetNCOPhase(bool tx, unsigned ch, int ind) const;
     virtual int Calibrate(bool dir_tx, unsigned chan, double bw, unsigned flags);
+    int CalibrateChannels(bool dir_tx, const std::vector<unsigned> &chans, double bw, unsigned flags);
+    std::vector<PhaseTiming> GetPhaseTiming() const;
+    static int InitDevices(const std::vector<LMS7_Device*> &devices);
     virtual std::vector<std::string> GetProgramModes() const;
     virtual int Program(const std::string& mode, const char* data, size_t len, lime::IConnection::ProgrammingCallback callback) const;
     double GetClockFreq(unsigned clk_id, int channel = -1) const;
@@ -76,6 +90,8 @@ public:
     double GetChipTemperature(int ind = -1) const;
     int LoadConfig(const char *filename, int ind = -1);
     int SaveConfig(const char *filename, int ind = -1) const;
+    int LoadSnapshot(const char *filename);
+    int SaveSnapshot(const char *filename) const;
     int ReadLMSReg(uint16_t address, int ind = -1) const;
     int WriteLMSReg(uint16_t address, uint16_t val, int ind = -1) const;
     int ReadFPGAReg(uint16_t address) const;
@@ -95,6 +111,13 @@ public:
     int DestroyStream(lime::StreamChannel* streamID);
     uint64_t GetHardwareTimestamp(void) const;
     void SetHardwareTimestamp(const uint64_t now);
+    int GetHardwareTime(uint64_t &ticks, double* error = nullptr) const;
+    int HostToHardwareTime(int64_t hostNs, uint64_t &ticks, double* error = nullptr) const;
+    int HardwareToHostTime(uint64_t ticks, int64_t &hostNs) const;
+    lime::Channelizer* GetRxChannelizer(unsigned chan);
+    lime::CommandQueue* GetCommandQueue(unsigned chan);
+    lime::CommandQueue* GetCommandQueueIfCreated(unsigned chan) const;
+    uint64_t ScheduleCommand(unsigned chan, uint64_t timestamp, const std::function<int()> &command);
 
     int MCU_AGCStart(uint32_t wantedRSSI);
     int MCU_AGCStop();
@@ -124,6 +147,16 @@ protected:
     std::vector<lime::Streamer*> mStreamers;
     lime::FPGA* fpga;
     RFE_Device* limeRFE;
+
+    const std::string& GetRateCacheBoard();
+    int ReplayRate(lime::RateCache::Entry &entry, int decim);
+    std::string rateCacheBoard;
+
+    void ResetPhaseTiming();
+    void AddPhaseTiming(int chip, const char* phase, std::chrono::steady_clock::time_point begin);
+    std::vector<PhaseTiming> mPhaseTiming;
+    std::chrono::steady_clock::time_point mPhaseTimingStart;
+    mutable std::mutex mPhaseTimingLock;
 };
 
 }
@@ -0,0 +1,554 @@
+/**
+    @file Channelizer.cpp
+    @author Lime Microsystems
+    @brief Host side polyphase channelizer and digital down converters of RX stream
+*/
+
+#include "Channelizer.h"
+#include "windowFunction.h"
+#include "kiss_fft.h"
+#include "Logger.h"
+#include <errno.h>
+#include <string.h>
+#include <cmath>
+#include <complex>
+#include <algorithm>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+using namespace lime;
+
+//! One filter bank or down converter, processed by a single worker
+struct Channelizer::Filter
+{
+    bool bank;
+    unsigned decimation;
+    //time reversed impulse response
+    std::vector<float> taps;
+    double frequency;
+    //NCO phase of next input sample, cycles
+    double phase;
+    //input history: samples before next output and unprocessed samples
+    std::vector<float> bufI;
+    std::vector<float> bufQ;
+    uint32_t len;
+    uint32_t next;
+    uint64_t bufTimestamp;
+    bool primed;
+    //filter bank branch sums and transform buffers
+    std::vector<float> accI;
+    std::vector<float> accQ;
+    std::vector<kiss_fft_cpx> fftIn;
+    std::vector<kiss_fft_cpx> fftOut;
+    kiss_fft_state* plan;
+    std::vector<SubChannel*> outputs;
+};
+
+struct Channelizer::Worker
+{
+    std::thread thread;
+    std::atomic<uint64_t> readIndex;
+    std::vector<Filter*> filters;
+};
+
+Channelizer::Config::Config() :
+    bankChannels(0),
+    bankTaps(8),
+    ddcTaps(8),
+    format(StreamConfig::FMT_INT16),
+    blockSamples(4096),
+    fifoSamples(1024*1024),
+    threads(0)
+{
+}
+
+Channelizer::SubChannel::SubChannel(const Channelizer* owner, double frequency, unsigned decimation) :
+    mOwner(owner),
+    mFrequency(frequency),
+    mDecimation(decimation),
+    mOverrun(0)
+{
+}
+
+int Channelizer::SubChannel::Read(void* samples, const uint32_t count, StreamChannel::Metadata* meta, const int32_t timeout_ms)
+{
+    complex16_t* ptr = (complex16_t*)samples;
+    const int popped = mFifo.pop_samples(ptr, count, meta ? &meta->timestamp : nullptr, timeout_ms);
+    if (mOwner->mConfig.format == StreamConfig::FMT_FLOAT32)
+    {
+        //in place conversion
+        const int16_t* samplesShort = (const int16_t*)samples;
+        float* samplesFloat = (float*)samples;
+        for (int i = 2*popped-1; i >= 0; --i)
+            samplesFloat[i] = (float)samplesShort[i]/32767.0f;
+    }
+    if (meta)
+        meta->flags |= RingFIFO::SYNC_TIMESTAMP;
+    return popped;
+}
+
+StreamChannel::Info Channelizer::SubChannel::GetInfo()
+{
+    StreamChannel::Info info;
+    memset(&info, 0, sizeof(info));
+    RingFIFO::BufferInfo stats = mFifo.GetInfo();
+    info.fifoSize = stats.size;
+    info.fifoItemsCount = stats.itemsFilled;
+    info.overrun = mOverrun.exchange(0);
+    info.underrun = stats.underflow;
+    info.active = mOwner->IsRunning();
+    info.droppedPackets = mOwner->GetDroppedSamples();
+    return info;
+}
+
+double Channelizer::SubChannel::GetFrequency() const
+{
+    return mFrequency;
+}
+
+unsigned Channelizer::SubChannel::GetDecimation() const
+{
+    return mDecimation;
+}
+
+Channelizer::Channelizer() :
+    mFill(0),
+    mWriteIndex(0),
+    mDropped(0),
+    mFeeding(0),
+    mRunning(false),
+    mTerminate(false)
+{
+}
+
+Channelizer::~Channelizer()
+{
+    Stop();
+    Release();
+}
+
+/** @brief Windowed sinc low pass filter with unity DC gain
+    @param cutoff -6 dB frequency normalized to sample rate
+    @return time reversed taps
+*/
+static std::vector<float> DesignLowPass(unsigned length, double cutoff)
+{
+    const double pi = std::acos(-1);
+    std::vector<float> window;
+    GenerateWindowCoefficients(1, length, window, 0);
+    std::vector<float> taps(length);
+    double sum = 0;
+    for (unsigned i = 0; i < length; ++i)
+    {
+        const double t = i - (length - 1) / 2.0;
+        const double sinc = t == 0 ? 2 * cutoff : std::sin(2 * pi * cutoff * t) / (pi * t);
+        taps[i] = sinc * window[i];
+        sum += taps[i];
+    }
+    for (auto &tap : taps)
+        tap /= sum;
+    std::reverse(taps.begin(), taps.end());
+    return taps;
+}
+
+void Channelizer::Release()
+{
+    for (auto filter : mFilters)
+    {
+        if (filter->plan)
+            kiss_fft_free(filter->plan);
+        delete filter;
+    }
+    mFilters.clear();
+    for (auto channel : mChannels)
+        delete channel;
+    mChannels.clear();
+}
+
+int Channelizer::Start(const Config &config)
+{
+    if (IsRunning())
+        return ReportError(EBUSY, "Channelizer: already running");
+    if (config.bankChannels == 1 || (config.bankChannels && config.bankTaps == 0))
+        return ReportError(EINVAL, "Channelizer: invalid filter bank size");
+    if (config.bankChannels == 0 && config.ddc.empty())
+        return ReportError(EINVAL, "Channelizer: no sub-channels configured");
+    if (config.blockSamples == 0)
+        return ReportError(EINVAL, "Channelizer: invalid block size");
+    if (config.format != StreamConfig::FMT_INT16 && config.format != StreamConfig::FMT_FLOAT32)
+        return ReportError(EINVAL, "Channelizer: unsupported sample format");
+    for (auto &ddc : config.ddc)
+        if (ddc.decimation == 0 || std::fabs(ddc.frequency) > 0.5)
+            return ReportError(EINVAL, "Channelizer: invalid down converter settings");
+
+    Release();
+    mConfig = config;
+    if (config.bankChannels)
+    {
+        const unsigned M = config.bankChannels;
+        Filter* filter = new Filter();
+        filter->bank = true;
+        filter->decimation = M;
+        filter->frequency = 0;
+        filter->taps = DesignLowPass(M * config.bankTaps, 0.5 / M);
+        filter->accI.resize(M);
+        filter->accQ.resize(M);
+        filter->fftIn.resize(M);
+        filter->fftOut.resize(M);
+        filter->plan = kiss_fft_alloc(M, 1, nullptr, nullptr);
+        //bin c is centered at c/M, upper half are negative frequencies
+        for (unsigned c = 0; c < M; ++c)
+            filter->outputs.push_back(new SubChannel(this, c < (M + 1) / 2 ? double(c) / M : double(c) / M - 1.0, M));
+        mFilters.push_back(filter);
+    }
+    for (auto &ddc : config.ddc)
+    {
+        Filter* filter = new Filter();
+        filter->bank = false;
+        filter->decimation = ddc.decimation;
+        filter->frequency = ddc.frequency;
+        //80% of output bandwidth is alias free
+        filter->taps = DesignLowPass(ddc.decimation * std::max(config.ddcTaps, 1u) + 1, 0.4 / ddc.decimation);
+        filter->plan = nullptr;
+        filter->outputs.push_back(new SubChannel(this, ddc.frequency, ddc.decimation));
+        mFilters.push_back(filter);
+    }
+
+    for (auto filter : mFilters)
+    {
+        const uint32_t history = filter->taps.size() - 1;
+        filter->bufI.resize(history + filter->decimation + config.blockSamples);
+        filter->bufQ.resize(filter->bufI.size());
+        filter->primed = false;
+        //every block is pushed as a separate FIFO packet to keep its timestamp exact
+        const uint32_t pktSize = config.blockSamples / filter->decimation + 1;
+        for (auto channel : filter->outputs)
+        {
+            mChannels.push_back(channel);
+            channel->mOutput.resize(pktSize);
+            if (channel->mFifo.Resize(pktSize, std::max(config.fifoSamples / pktSize, 2u)) != 0)
+                return -1;
+        }
+    }
+
+    mRing.resize(ringBlocks * config.blockSamples);
+    mFill = 0;
+    mWriteIndex.store(0);
+    mDropped.store(0);
+    mTerminate.store(false);
+
+    unsigned threads = config.threads;
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    threads = std::max(1u, std::min<unsigned>(threads, mFilters.size()));
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        Worker* worker = new Worker();
+        worker->readIndex.store(0);
+        for (size_t f = i; f < mFilters.size(); f += threads)
+            worker->filters.push_back(mFilters[f]);
+        mWorkers.push_back(worker);
+    }
+    for (auto worker : mWorkers)
+        worker->thread = std::thread(&Channelizer::WorkerLoop, this, worker);
+    mRunning.store(true);
+    return 0;
+}
+
+int Channelizer::Stop()
+{
+    mRunning.store(false);
+    //RX thread may be inside Feed()
+    while (mFeeding.load() != 0)
+        std::this_thread::yield();
+    {
+        std::lock_guard<std::mutex> lck(mLock);
+        mTerminate.store(true);
+    }
+    mCond.notify_all();
+    for (auto worker : mWorkers)
+    {
+        if (worker->thread.joinable())
+            worker->thread.join();
+        delete worker;
+    }
+    mWorkers.clear();
+    return 0;
+}
+
+bool Channelizer::IsRunning() const
+{
+    return mRunning.load();
+}
+
+unsigned Channelizer::GetChannelCount() const
+{
+    return mChannels.size();
+}
+
+Channelizer::SubChannel* Channelizer::GetChannel(unsigned index) const
+{
+    return index < mChannels.size() ? mChannels[index] : nullptr;
+}
+
+uint64_t Channelizer::GetDroppedSamples() const
+{
+    return mDropped.load(std::memory_order_relaxed);
+}
+
+unsigned Channelizer::GetQueuedBlocks() const
+{
+    return mWriteIndex.load(std::memory_order_acquire) - SlowestReader();
+}
+
+unsigned Channelizer::GetRingBlocks()
+{
+    return ringBlocks;
+}
+
+uint64_t Channelizer::SlowestReader() const
+{
+    uint64_t slowest = mWriteIndex.load(std::memory_order_relaxed);
+    for (auto worker : mWorkers)
+        slowest = std::min(slowest, worker->readIndex.load(std::memory_order_acquire));
+    return slowest;
+}
+
+void Channelizer::PublishBlock()
+{
+    const uint64_t index = mWriteIndex.load(std::memory_order_relaxed);
+    mBlockInfo[index % ringBlocks].count = mFill;
+    mFill = 0;
+    mWriteIndex.store(index + 1, std::memory_order_release);
+    //empty critical section orders wake up after worker predicate check
+    {
+        std::lock_guard<std::mutex> lck(mLock);
+    }
+    mCond.notify_all();
+}
+
+void Channelizer::Feed(const complex16_t* samples, uint32_t count, uint64_t timestamp, bool is16bit)
+{
+    ++mFeeding;
+    if (!mRunning.load())
+    {
+        --mFeeding;
+        return;
+    }
+    if (mFill > 0)
+    {
+        const BlockInfo &info = mBlockInfo[mWriteIndex.load(std::memory_order_relaxed) % ringBlocks];
+        if (timestamp != info.timestamp + mFill || is16bit != info.is16bit)
+            PublishBlock();
+    }
+    while (count > 0)
+    {
+        const uint64_t index = mWriteIndex.load(std::memory_order_relaxed);
+        BlockInfo &info = mBlockInfo[index % ringBlocks];
+        if (mFill == 0)
+        {
+            if (index - SlowestReader() >= ringBlocks)
+            {
+                mDropped.fetch_add(count, std::memory_order_relaxed);
+                break;
+            }
+            info.timestamp = timestamp;
+            info.is16bit = is16bit;
+        }
+        const uint32_t n = std::min(count, mConfig.blockSamples - mFill);
+        memcpy(&mRing[(index % ringBlocks) * mConfig.blockSamples + mFill], samples, n * sizeof(complex16_t));
+        mFill += n;
+        samples += n;
+        timestamp += n;
+        count -= n;
+        if (mFill == mConfig.blockSamples)
+            PublishBlock();
+    }
+    --mFeeding;
+}
+
+void Channelizer::WorkerLoop(Worker* worker)
+{
+    while (true)
+    {
+        const uint64_t index = worker->readIndex.load(std::memory_order_relaxed);
+        if (index == mWriteIndex.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lck(mLock);
+            mCond.wait(lck, [&]{ return mTerminate.load() || index != mWriteIndex.load(std::memory_order_acquire); });
+        }
+        if (mTerminate.load())
+            return;
+        const unsigned slot = index % ringBlocks;
+        for (auto filter : worker->filters)
+            ProcessBlock(*filter, &mRing[slot * mConfig.blockSamples], mBlockInfo[slot]);
+        worker->readIndex.store(index + 1, std::memory_order_release);
+    }
+}
+
+void Channelizer::ResetFilter(Filter &filter, uint64_t timestamp)
+{
+    //history starts zeroed, outputs are aligned to multiples of decimation
+    const uint32_t history = filter.taps.size() - 1;
+    const unsigned D = filter.decimation;
+    std::fill(filter.bufI.begin(), filter.bufI.begin() + history, 0.0f);
+    std::fill(filter.bufQ.begin(), filter.bufQ.begin() + history, 0.0f);
+    filter.len = history;
+    filter.next = history + (D - timestamp % D) % D;
+    filter.bufTimestamp = timestamp - history;
+    filter.phase = std::fmod(filter.frequency * double(timestamp), 1.0);
+    filter.primed = true;
+}
+
+/** @brief Dot product of time reversed taps with I and Q sample arrays
+*/
+static inline void DotIQ(const float* taps, const float* xi, const float* xq, unsigned n, float &yi, float &yq)
+{
+    unsigned i = 0;
+    float sumI = 0;
+    float sumQ = 0;
+#ifdef __SSE__
+    __m128 accI = _mm_setzero_ps();
+    __m128 accQ = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 h = _mm_loadu_ps(taps + i);
+        accI = _mm_add_ps(accI, _mm_mul_ps(h, _mm_loadu_ps(xi + i)));
+        accQ = _mm_add_ps(accQ, _mm_mul_ps(h, _mm_loadu_ps(xq + i)));
+    }
+    float partI[4];
+    float partQ[4];
+    _mm_storeu_ps(partI, accI);
+    _mm_storeu_ps(partQ, accQ);
+    sumI = partI[0] + partI[1] + partI[2] + partI[3];
+    sumQ = partQ[0] + partQ[1] + partQ[2] + partQ[3];
+#endif
+    for (; i < n; ++i)
+    {
+        sumI += taps[i] * xi[i];
+        sumQ += taps[i] * xq[i];
+    }
+    yi = sumI;
+    yq = sumQ;
+}
+
+/** @brief Adds products of taps and samples into branch accumulators, acc[m] += taps[m]*x[m]
+*/
+static inline void AccumulateIQ(const float* taps, const float* xi, const float* xq, unsigned n, float* accI, float* accQ)
+{
+    unsigned i = 0;
+#ifdef __SSE__
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 h = _mm_loadu_ps(taps + i);
+        _mm_storeu_ps(accI + i, _mm_add_ps(_mm_loadu_ps(accI + i), _mm_mul_ps(h, _mm_loadu_ps(xi + i))));
+        _mm_storeu_ps(accQ + i, _mm_add_ps(_mm_loadu_ps(accQ + i), _mm_mul_ps(h, _mm_loadu_ps(xq + i))));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        accI[i] += taps[i] * xi[i];
+        accQ[i] += taps[i] * xq[i];
+    }
+}
+
+static inline int16_t Saturate(float value)
+{
+    const long v = std::lrint(value);
+    return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+}
+
+void Channelizer::ProcessBlock(Filter &filter, const complex16_t* samples, const BlockInfo &info)
+{
+    if (!filter.primed || info.timestamp != filter.bufTimestamp + filter.len)
+        ResetFilter(filter, info.timestamp);
+
+    //convert to 16 bit scale float, down convert with NCO
+    const float scale = info.is16bit ? 1.0f : 16.0f;
+    float* xi = &filter.bufI[filter.len];
+    float* xq = &filter.bufQ[filter.len];
+    if (filter.bank)
+    {
+        for (uint32_t i = 0; i < info.count; ++i)
+        {
+            xi[i] = samples[i].i * scale;
+            xq[i] = samples[i].q * scale;
+        }
+    }
+    else
+    {
+        const double pi = std::acos(-1);
+        //rotator is recomputed from phase accumulator every chunk to limit float drift
+        const uint32_t chunk = 1024;
+        const std::complex<float> step = std::polar(1.0f, float(-2 * pi * filter.frequency));
+        for (uint32_t start = 0; start < info.count; start += chunk)
+        {
+            const uint32_t end = std::min(info.count, start + chunk);
+            std::complex<float> rot = std::polar(1.0f, float(-2 * pi * std::fmod(filter.phase + filter.frequency * start, 1.0)));
+            for (uint32_t i = start; i < end; ++i)
+            {
+                const std::complex<float> y = std::complex<float>(samples[i].i * scale, samples[i].q * scale) * rot;
+                xi[i] = y.real();
+                xq[i] = y.imag();
+                rot *= step;
+            }
+        }
+        filter.phase = std::fmod(filter.phase + filter.frequency * info.count, 1.0);
+    }
+    filter.len += info.count;
+
+    const unsigned D = filter.decimation;
+    const unsigned L = filter.taps.size();
+    const float* taps = filter.taps.data();
+    const uint64_t firstTimestamp = (filter.bufTimestamp + filter.next) / D;
+    uint32_t produced = 0;
+    for (; filter.next < filter.len; filter.next += D, ++produced)
+    {
+        const uint32_t base = filter.next + 1 - L;
+        if (!filter.bank)
+        {
+            float yi, yq;
+            DotIQ(taps, &filter.bufI[base], &filter.bufQ[base], L, yi, yq);
+            complex16_t &out = filter.outputs[0]->mOutput[produced];
+            out.i = Saturate(yi);
+            out.q = Saturate(yq);
+            continue;
+        }
+        //branch sums u[k] = sum h[k+pM] x[n-k-pM], taps are reversed so branch k sums into acc[M-1-k]
+        std::fill(filter.accI.begin(), filter.accI.end(), 0.0f);
+        std::fill(filter.accQ.begin(), filter.accQ.end(), 0.0f);
+        for (unsigned p = 0; p < L; p += D)
+            AccumulateIQ(taps + p, &filter.bufI[base + p], &filter.bufQ[base + p], D, filter.accI.data(), filter.accQ.data());
+        for (unsigned k = 0; k < D; ++k)
+        {
+            filter.fftIn[k].r = filter.accI[D - 1 - k];
+            filter.fftIn[k].i = filter.accQ[D - 1 - k];
+        }
+        //inverse transform modulates branch sums to every channel center
+        kiss_fft(filter.plan, filter.fftIn.data(), filter.fftOut.data());
+        for (unsigned c = 0; c < D; ++c)
+        {
+            complex16_t &out = filter.outputs[c]->mOutput[produced];
+            out.i = Saturate(filter.fftOut[c].r);
+            out.q = Saturate(filter.fftOut[c].i);
+        }
+    }
+
+    if (produced > 0)
+        for (auto channel : filter.outputs)
+        {
+            const uint32_t pushed = channel->mFifo.push_samples(channel->mOutput.data(), produced, firstTimestamp, 0, RingFIFO::END_BURST);
+            if (pushed < produced)
+                channel->mOverrun.fetch_add(produced - pushed, std::memory_order_relaxed);
+        }
+
+    //keep filter history and samples of the next output
+    const uint32_t drop = filter.next - (L - 1);
+    const uint32_t keep = filter.len - drop;
+    memmove(filter.bufI.data(), &filter.bufI[drop], keep * sizeof(float));
+    memmove(filter.bufQ.data(), &filter.bufQ[drop], keep * sizeof(float));
+    filter.len = keep;
+    filter.next -= drop;
+    filter.bufTimestamp += drop;
+}
@@ -0,0 +1,151 @@
+/**
+    @file Channelizer.h
+    @author Lime Microsystems
+    @brief Host side polyphase channelizer and digital down converters of RX stream
+*/
+
+#ifndef LIME_CHANNELIZER_H
+#define LIME_CHANNELIZER_H
+
+#include "LimeSuiteConfig.h"
+#include "Streamer.h"
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace lime
+{
+
+/*!
+ * Splits one RX channel into narrow sub-channels: a critically sampled
+ * polyphase filter bank of uniformly spaced channels and/or individual
+ * NCO + decimating FIR down converters. RX thread only copies packets
+ * into a ring of sample blocks, filtering is done by worker threads, each
+ * one owning a subset of filters and following the ring at its own pace.
+ * Every sub-channel is read through its own FIFO like a StreamChannel.
+ */
+class LIME_API Channelizer
+{
+public:
+    struct DDC
+    {
+        //! NCO offset normalized to input sample rate, -0.5 to 0.5
+        double frequency;
+        unsigned decimation;
+    };
+
+    struct Config
+    {
+        Config();
+        //! filter bank channels, spaced by input rate/bankChannels, 0 - no filter bank
+        unsigned bankChannels;
+        //! prototype filter taps per filter bank channel
+        unsigned bankTaps;
+        //! down converters, each one producing one sub-channel
+        std::vector<DDC> ddc;
+        //! low pass filter taps per unit of down converter decimation
+        unsigned ddcTaps;
+        //! sub-channel sample format, FMT_INT16 or FMT_FLOAT32
+        StreamConfig::StreamDataFormat format;
+        //! input samples per block handed to workers, trades latency for overhead
+        unsigned blockSamples;
+        //! FIFO size of every sub-channel in samples
+        unsigned fifoSamples;
+        //! worker threads, 0 - one per hardware thread, never more than filters
+        unsigned threads;
+    };
+
+    /*!
+     * Output of one filter bank channel or down converter. Timestamps count
+     * sub-channel samples: input timestamp of the newest sample under the
+     * filter divided by decimation, filter group delay is not removed.
+     */
+    class LIME_API SubChannel
+    {
+    public:
+        int Read(void* samples, const uint32_t count, StreamChannel::Metadata* meta, const int32_t timeout_ms = 100);
+        //! FIFO state, overrun counts samples dropped because FIFO was full
+        StreamChannel::Info GetInfo();
+        //! center frequency normalized to input sample rate
+        double GetFrequency() const;
+        unsigned GetDecimation() const;
+
+    private:
+        friend class Channelizer;
+        SubChannel(const Channelizer* owner, double frequency, unsigned decimation);
+        const Channelizer* mOwner;
+        double mFrequency;
+        unsigned mDecimation;
+        RingFIFO mFifo;
+        std::atomic<uint32_t> mOverrun;
+        std::vector<complex16_t> mOutput;
+    };
+
+    Channelizer();
+    ~Channelizer();
+
+    /** @brief Designs filters and starts workers
+        Sub-channel handles of previous run are released.
+    */
+    int Start(const Config &config);
+    //! Stops workers, sub-channels remain readable until next Start()
+    int Stop();
+    bool IsRunning() const;
+
+    /** @brief Queues received samples for filtering, never blocks
+        Called from RX thread, samples are dropped when workers fall behind.
+        @param timestamp hardware timestamp of the first sample
+        @param is16bit samples are 16 bit, otherwise 12 bit
+    */
+    void Feed(const complex16_t* samples, uint32_t count, uint64_t timestamp, bool is16bit);
+
+    //! Filter bank channels first (bin order), then down converters
+    unsigned GetChannelCount() const;
+    SubChannel* GetChannel(unsigned index) const;
+    //! Input samples dropped because workers were behind
+    uint64_t GetDroppedSamples() const;
+    //! Published input blocks not yet processed by every worker, at most GetRingBlocks()
+    unsigned GetQueuedBlocks() const;
+    static unsigned GetRingBlocks();
+
+private:
+    struct Filter;
+    struct Worker;
+    struct BlockInfo
+    {
+        uint64_t timestamp;
+        uint32_t count;
+        bool is16bit;
+    };
+    static const unsigned ringBlocks = 32;
+
+    void WorkerLoop(Worker* worker);
+    void ProcessBlock(Filter &filter, const complex16_t* samples, const BlockInfo &info);
+    void ResetFilter(Filter &filter, uint64_t timestamp);
+    void PublishBlock();
+    uint64_t SlowestReader() const;
+    void Release();
+
+    Config mConfig;
+    std::vector<Filter*> mFilters;
+    std::vector<Worker*> mWorkers;
+    std::vector<SubChannel*> mChannels;
+
+    //input ring written by RX thread only
+    std::vector<complex16_t> mRing;
+    BlockInfo mBlockInfo[ringBlocks];
+    uint32_t mFill;
+    std::atomic<uint64_t> mWriteIndex;
+    std::atomic<uint64_t> mDropped;
+    std::atomic<int> mFeeding;
+    std::atomic<bool> mRunning;
+    std::atomic<bool> mTerminate;
+    std::mutex mLock;
+    std::condition_variable mCond;
+};
+
+}
+#endif // LIME_CHANNELIZER_H
@@ -0,0 +1,221 @@
+/**
+    @file ClockModel.cpp
+    @author Lime Microsystems
+    @brief Correlation of host monotonic clock with hardware sample counter
+*/
+
+#include "ClockModel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace lime;
+
+//observations needed before estimates are given
+static const size_t minObservations = 8;
+//outlier rejection passes
+static const int maxIterations = 4;
+
+ClockModel::ClockModel(size_t window, int64_t interval_ns) :
+    mWindow(std::max(window, minObservations)),
+    mInterval(interval_ns)
+{
+    Reset();
+}
+
+int64_t ClockModel::HostTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ClockModel::Reset()
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    mObservations.clear();
+    mNext = 0;
+    mHasCandidate = false;
+    mIntervalStart = 0;
+    mValid = false;
+    mRefHost = 0;
+    mRefTicks = 0;
+    mOffset = 0;
+    mRate = 0;
+    mError = 0;
+}
+
+double ClockModel::Lateness(const Observation &obs) const
+{
+    if (!mValid)
+        return 0;
+    return mOffset + mRate * (obs.host - mRefHost) * 1e-9 - (double)int64_t(obs.ticks - mRefTicks);
+}
+
+void ClockModel::AddObservation(int64_t hostNs, uint64_t ticks)
+{
+    const Observation obs = {hostNs, ticks};
+    std::lock_guard<std::mutex> lck(mLock);
+    if (mHasCandidate && ticks < mCandidate.ticks)
+    {
+        //hardware counter was reset
+        mObservations.clear();
+        mNext = 0;
+        mHasCandidate = false;
+        mValid = false;
+    }
+    if (mHasCandidate && hostNs - mIntervalStart < mInterval)
+    {
+        if (Lateness(obs) < Lateness(mCandidate))
+            mCandidate = obs;
+        return;
+    }
+    if (mHasCandidate)
+    {
+        if (mObservations.size() < mWindow)
+            mObservations.push_back(mCandidate);
+        else
+            mObservations[mNext] = mCandidate;
+        mNext = (mNext + 1) % mWindow;
+        Fit();
+    }
+    mCandidate = obs;
+    mHasCandidate = true;
+    mIntervalStart = hostNs;
+}
+
+/** @brief Least squares line through observations marked in use
+    @return false if line cannot be fitted
+*/
+static bool FitLine(const std::vector<double> &x, const std::vector<double> &y, const std::vector<char> &use, double &a, double &b)
+{
+    double n = 0, sx = 0, sy = 0;
+    for (size_t i = 0; i < x.size(); ++i)
+        if (use[i])
+        {
+            n += 1;
+            sx += x[i];
+            sy += y[i];
+        }
+    if (n < 2)
+        return false;
+    const double mx = sx / n;
+    const double my = sy / n;
+    double sxx = 0, sxy = 0;
+    for (size_t i = 0; i < x.size(); ++i)
+        if (use[i])
+        {
+            sxx += (x[i] - mx) * (x[i] - mx);
+            sxy += (x[i] - mx) * (y[i] - my);
+        }
+    if (sxx <= 0)
+        return false;
+    b = sxy / sxx;
+    a = my - b * mx;
+    return true;
+}
+
+void ClockModel::Fit()
+{
+    const size_t n = mObservations.size();
+    if (n < minObservations)
+        return;
+    //relative to newest observation to keep precision
+    const Observation &ref = mObservations[(mNext + n - 1) % n];
+    std::vector<double> x(n), y(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        x[i] = (mObservations[i].host - ref.host) * 1e-9;
+        y[i] = (double)int64_t(mObservations[i].ticks - ref.ticks);
+    }
+    std::vector<char> use(n, 1);
+    double a, b;
+    if (!FitLine(x, y, use, a, b) || b <= 0)
+        return;
+
+    //reject outliers by median absolute deviation of residuals, repeated
+    //because outliers tilt the first fit and inflate deviation of the rest
+    std::vector<double> &residuals = mScratch;
+    for (int iteration = 0; iteration < maxIterations; ++iteration)
+    {
+        residuals.clear();
+        for (size_t i = 0; i < n; ++i)
+            if (use[i])
+                residuals.push_back(y[i] - (a + b * x[i]));
+        const size_t mid = residuals.size() / 2;
+        std::nth_element(residuals.begin(), residuals.begin() + mid, residuals.end());
+        const double median = residuals[mid];
+        for (auto &value : residuals)
+            value = std::fabs(value - median);
+        std::nth_element(residuals.begin(), residuals.begin() + mid, residuals.end());
+        const double threshold = std::max(3 * 1.4826 * residuals[mid], 1.0);
+        std::vector<char> inlier(n, 0);
+        size_t inliers = 0;
+        bool changed = false;
+        for (size_t i = 0; i < n; ++i)
+        {
+            inlier[i] = std::fabs(y[i] - (a + b * x[i]) - median) <= threshold;
+            inliers += inlier[i];
+            changed |= inlier[i] != use[i];
+        }
+        double ia, ib;
+        if (!changed || inliers < minObservations || !FitLine(x, y, inlier, ia, ib) || ib <= 0)
+            break;
+        use.swap(inlier);
+        a = ia;
+        b = ib;
+    }
+
+    //upper envelope of inliers, spread of their residuals is the error
+    double maxResidual = -INFINITY;
+    double minResidual = INFINITY;
+    for (size_t i = 0; i < n; ++i)
+        if (use[i])
+        {
+            const double r = y[i] - (a + b * x[i]);
+            maxResidual = std::max(maxResidual, r);
+            minResidual = std::min(minResidual, r);
+        }
+    mRefHost = ref.host;
+    mRefTicks = ref.ticks;
+    mOffset = a + maxResidual;
+    mRate = b;
+    mError = maxResidual - minResidual;
+    mValid = true;
+}
+
+bool ClockModel::IsValid() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mValid;
+}
+
+int ClockModel::HostToTicks(int64_t hostNs, uint64_t &ticks, double* error) const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    if (!mValid)
+        return -1;
+    const double delta = mOffset + mRate * (hostNs - mRefHost) * 1e-9;
+    ticks = delta < 0 && uint64_t(-delta) > mRefTicks ? 0 : mRefTicks + int64_t(std::floor(delta));
+    if (error)
+        *error = mError;
+    return 0;
+}
+
+int ClockModel::TicksToHost(uint64_t ticks, int64_t &hostNs) const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    if (!mValid)
+        return -1;
+    hostNs = mRefHost + int64_t(((double)int64_t(ticks - mRefTicks) - mOffset) / mRate * 1e9);
+    return 0;
+}
+
+int ClockModel::Now(uint64_t &ticks, double* error) const
+{
+    return HostToTicks(HostTimeNs(), ticks, error);
+}
+
+double ClockModel::GetRate() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mValid ? mRate : 0;
+}
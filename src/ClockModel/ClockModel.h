@@ -0,0 +1,90 @@
+/**
+    @file ClockModel.h
+    @author Lime Microsystems
+    @brief Correlation of host monotonic clock with hardware sample counter
+*/
+
+#ifndef LIME_CLOCK_MODEL_H
+#define LIME_CLOCK_MODEL_H
+
+#include "LimeSuiteConfig.h"
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+
+namespace lime
+{
+
+/*!
+ * Fits hardware sample counter against host monotonic clock from pairs of
+ * (host time when RX transfer completed, timestamp of its last sample).
+ * Observations are decimated, keeping the least delayed one per interval,
+ * and fitted with least squares over a sliding window, rejecting outliers
+ * further than 3 MADs from the median residual. The fitted line is moved
+ * to the upper envelope of inliers, so estimates give the newest sample
+ * that could have reached the host at given time. The spread of inlier
+ * residuals is the error bound, it measures transfer completion jitter.
+ * The constant minimum link latency is not observable and is not included.
+ */
+class LIME_API ClockModel
+{
+public:
+    /** @param window observations in fit
+        @param interval_ns decimation interval of observations
+    */
+    ClockModel(size_t window = 200, int64_t interval_ns = 5000000);
+
+    //! Host monotonic clock (steady_clock, CLOCK_MONOTONIC on Linux) in ns
+    static int64_t HostTimeNs();
+
+    //! Drops observations, used when hardware counter is reset
+    void Reset();
+    /** @brief Adds observation, cheap unless decimation interval has passed
+        @param hostNs host time when transfer completed
+        @param ticks timestamp of the last sample of transfer
+    */
+    void AddObservation(int64_t hostNs, uint64_t ticks);
+    //! True when enough observations were fitted
+    bool IsValid() const;
+    /** @brief Hardware time at host time
+        @param error receives error bound in ticks, can be nullptr
+        @return 0 on success, -1 if model is not fitted yet
+    */
+    int HostToTicks(int64_t hostNs, uint64_t &ticks, double* error = nullptr) const;
+    //! Host time when hardware counter reaches ticks, -1 if model is not fitted yet
+    int TicksToHost(uint64_t ticks, int64_t &hostNs) const;
+    //! Hardware time now, see HostToTicks()
+    int Now(uint64_t &ticks, double* error = nullptr) const;
+    //! Fitted counter rate in ticks per second of host clock, 0 if not fitted
+    double GetRate() const;
+
+private:
+    struct Observation
+    {
+        int64_t host;
+        uint64_t ticks;
+    };
+    void Fit();
+    //! Delay of observation against current fit, larger is later
+    double Lateness(const Observation &obs) const;
+
+    const size_t mWindow;
+    const int64_t mInterval;
+    mutable std::mutex mLock;
+    std::vector<Observation> mObservations; //ring of decimated observations
+    size_t mNext;
+    Observation mCandidate; //least delayed observation of current interval
+    bool mHasCandidate;
+    int64_t mIntervalStart;
+    //fit: ticks = mRefTicks + mOffset + mRate * (host - mRefHost)
+    bool mValid;
+    int64_t mRefHost;
+    uint64_t mRefTicks;
+    double mOffset;
+    double mRate;
+    double mError;
+    std::vector<double> mScratch;
+};
+
+}
+#endif // LIME_CLOCK_MODEL_H
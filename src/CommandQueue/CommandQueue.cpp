@@ -0,0 +1,193 @@
+/**
+    @file CommandQueue.cpp
+    @author Lime Microsystems
+    @brief Control operations executed at hardware timestamps
+*/
+
+#include "CommandQueue.h"
+#include "Streamer.h"
+#include "LMS7002M.h"
+#include "Logger.h"
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace lime;
+
+const size_t CommandQueue::maxResults;
+const size_t CommandQueue::maxChanges;
+
+CommandQueue::CommandQueue(Streamer* streamer, LMS7002M* chip) :
+    mStreamer(streamer),
+    mChip(chip),
+    mNextId(1),
+    mLatency(0),
+    mLeadSamples(0),
+    mRate(0),
+    mChangeIndex(0),
+    mChangeCount(0),
+    mTerminate(false)
+{
+    mThread = std::thread(&CommandQueue::ExecuteLoop, this);
+}
+
+CommandQueue::~CommandQueue()
+{
+    {
+        std::lock_guard<std::mutex> lck(mLock);
+        mTerminate = true;
+    }
+    mPendingCond.notify_all();
+    mThread.join();
+}
+
+uint64_t CommandQueue::Schedule(uint64_t timestamp, const Command &command)
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    Pending pending;
+    pending.id = mNextId++;
+    pending.command = command;
+    mPending.insert(std::make_pair(timestamp, pending));
+    mPendingCond.notify_all();
+    return pending.id;
+}
+
+int CommandQueue::GetResult(uint64_t id, Result &result, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lck(mLock);
+    const auto ready = [this, id]{ return mResults.count(id) > 0; };
+    if (!mDoneCond.wait_for(lck, std::chrono::milliseconds(timeout_ms), ready))
+        return -1;
+    auto iter = mResults.find(id);
+    result = iter->second;
+    mResults.erase(iter);
+    return 0;
+}
+
+void CommandQueue::Cancel()
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    for (auto &item : mPending)
+    {
+        Result &result = mResults[item.second.id];
+        result.status = -1;
+        result.timestamp = item.first;
+        result.start = 0;
+        result.achieved = 0;
+    }
+    mPending.clear();
+    while (mResults.size() > maxResults)
+        mResults.erase(mResults.begin());
+    mDoneCond.notify_all();
+}
+
+size_t CommandQueue::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mPending.size();
+}
+
+void CommandQueue::SetLatency(uint64_t samples)
+{
+    mLatency.store(samples, std::memory_order_relaxed);
+}
+
+bool CommandQueue::ChangedWithin(uint64_t first, uint64_t last) const
+{
+    if (mChangeCount.load(std::memory_order_acquire) == 0)
+        return false;
+    std::lock_guard<std::mutex> lck(mLock);
+    const size_t count = std::min(mChangeCount.load(std::memory_order_relaxed), maxChanges);
+    for (size_t i = 0; i < count; ++i)
+        if (mChanges[i].first <= last && mChanges[i].second >= first)
+            return true;
+    return false;
+}
+
+uint64_t CommandQueue::HardwareNow() const
+{
+    return mStreamer->rxLastTimestamp.load(std::memory_order_relaxed) + mStreamer->mTimestampOffset
+        + mLatency.load(std::memory_order_relaxed);
+}
+
+void CommandQueue::ExecuteLoop()
+{
+    typedef std::chrono::steady_clock clock;
+    auto rateTime = clock::now();
+    uint64_t rateTimestamp = HardwareNow();
+
+    std::unique_lock<std::mutex> lck(mLock);
+    while (!mTerminate)
+    {
+        if (mPending.empty())
+        {
+            mPendingCond.wait(lck);
+            continue;
+        }
+
+        //stream rate from timestamp progress, used to sleep until target
+        const auto now = clock::now();
+        const uint64_t hwNow = HardwareNow();
+        const double elapsed = std::chrono::duration<double>(now - rateTime).count();
+        if (hwNow < rateTimestamp)
+            rateTimestamp = hwNow; //hardware time was set
+        else if (elapsed > 0.05)
+        {
+            const double rate = (hwNow - rateTimestamp) / elapsed;
+            mRate = mRate == 0 ? rate : 0.75 * mRate + 0.25 * rate;
+            rateTime = now;
+            rateTimestamp = hwNow;
+        }
+
+        auto next = mPending.begin();
+        const uint64_t timestamp = next->first;
+        if (hwNow + uint64_t(mLeadSamples) < timestamp)
+        {
+            //wake before target, new earlier command wakes immediately
+            double wait = 1e-3;
+            if (mRate > 0)
+                wait = 0.5 * (timestamp - hwNow - mLeadSamples) / mRate;
+            wait = std::min(std::max(wait, 50e-6), 10e-3);
+            mPendingCond.wait_for(lck, std::chrono::microseconds(int(wait * 1e6)));
+            continue;
+        }
+
+        Pending pending = next->second;
+        mPending.erase(next);
+        lck.unlock();
+
+        Result result;
+        result.timestamp = timestamp;
+        const auto t0 = clock::now();
+        result.start = HardwareNow();
+        mChip->BeginWriteBatch();
+        try
+        {
+            result.status = pending.command();
+        }
+        catch (const std::exception &e)
+        {
+            result.status = ReportError("CommandQueue: %s", e.what());
+        }
+        const int batchStatus = mChip->EndWriteBatch();
+        if (result.status == 0)
+            result.status = batchStatus;
+        result.achieved = HardwareNow();
+        const double duration = std::chrono::duration<double>(clock::now() - t0).count();
+
+        lck.lock();
+        //release next commands earlier by average duration
+        if (mRate > 0)
+            mLeadSamples = 0.875 * mLeadSamples + 0.125 * duration * mRate;
+        const uint64_t offset = mStreamer->mTimestampOffset;
+        mChanges[mChangeIndex] = std::make_pair(result.start - offset, result.achieved - offset);
+        mChangeIndex = (mChangeIndex + 1) % maxChanges;
+        mChangeCount.fetch_add(1, std::memory_order_release);
+        if (result.status != 0)
+            lime::warning("CommandQueue: command at timestamp %llu failed", (unsigned long long)timestamp);
+        mResults[pending.id] = result;
+        while (mResults.size() > maxResults)
+            mResults.erase(mResults.begin());
+        mDoneCond.notify_all();
+    }
+}
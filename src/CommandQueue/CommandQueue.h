@@ -0,0 +1,112 @@
+/**
+    @file CommandQueue.h
+    @author Lime Microsystems
+    @brief Control operations executed at hardware timestamps
+*/
+
+#ifndef LIME_COMMAND_QUEUE_H
+#define LIME_COMMAND_QUEUE_H
+
+#include "LimeSuiteConfig.h"
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace lime
+{
+
+class Streamer;
+class LMS7002M;
+
+/*!
+ * Holds control operations (retune, gain, NCO, path changes) tagged with
+ * hardware timestamps and releases them from a dedicated thread when RX
+ * stream time approaches the target. Each command runs inside a chip
+ * write batch of the queue thread, so its register writes reach the chip
+ * in one transaction while writes from other threads are not held back,
+ * released early by the average duration of previous commands. Hardware
+ * time is estimated from the newest received RX timestamp, the queue only
+ * advances while RX stream of the chip is running.
+ */
+class LIME_API CommandQueue
+{
+public:
+    typedef std::function<int()> Command;
+
+    struct Result
+    {
+        //! value returned by command, -1 if canceled
+        int status;
+        //! requested hardware timestamp
+        uint64_t timestamp;
+        //! estimated hardware time when command started
+        uint64_t start;
+        //! estimated hardware time when its writes were completed
+        uint64_t achieved;
+    };
+
+    //! results not read by GetResult() are dropped above this count
+    static const size_t maxResults = 1024;
+
+    CommandQueue(Streamer* streamer, LMS7002M* chip);
+    ~CommandQueue();
+
+    /** @brief Queues command, commands with equal timestamps run in order
+        @param timestamp hardware timestamp, past timestamps run immediately
+        @return command id, used to get result
+    */
+    uint64_t Schedule(uint64_t timestamp, const Command &command);
+    /** @brief Gets result of executed command, result is kept until read
+        @param timeout_ms time to wait for command to execute
+        @return 0-result available, other-unknown id or not executed yet
+    */
+    int GetResult(uint64_t id, Result &result, int timeout_ms = 0);
+    //! Drops pending commands
+    void Cancel();
+    size_t GetPendingCount() const;
+    //! Samples produced by hardware but not yet received, added to hardware time estimate
+    void SetLatency(uint64_t samples);
+    /** @brief Checks if timed command was executing while samples were taken
+        @param first stream timestamp of first sample
+        @param last stream timestamp of last sample
+    */
+    bool ChangedWithin(uint64_t first, uint64_t last) const;
+
+private:
+    struct Pending
+    {
+        uint64_t id;
+        Command command;
+    };
+
+    void ExecuteLoop();
+    uint64_t HardwareNow() const;
+
+    static const size_t maxChanges = 64;
+
+    Streamer* mStreamer;
+    LMS7002M* mChip;
+    mutable std::mutex mLock;
+    std::condition_variable mPendingCond;
+    std::condition_variable mDoneCond;
+    std::multimap<uint64_t, Pending> mPending;
+    std::map<uint64_t, Result> mResults;
+    uint64_t mNextId;
+    std::atomic<uint64_t> mLatency;
+    //average command duration and stream rate estimate
+    double mLeadSamples;
+    double mRate;
+    //stream timestamp intervals of executed commands
+    std::pair<uint64_t, uint64_t> mChanges[maxChanges];
+    size_t mChangeIndex;
+    std::atomic<size_t> mChangeCount;
+    bool mTerminate;
+    std::thread mThread;
+};
+
+}
+#endif // LIME_COMMAND_QUEUE_H
@@ -14,6 +14,7 @@
 #include <FPGA_common.h>
 #include <ciso646>
 #include "Logger.h"
+#include "threadHelper.h"
 
 using namespace std;
 using namespace lime;
@@ -26,6 +27,7 @@ const int ConnectionFT601::ctrlRdEp = 0x82;
 ConnectionFT601::ConnectionFT601(void *arg)
 {
     isConnected = false;
+    mEventThread = nullptr;
 #ifndef __unix__
     mFTHandle = NULL;
 #else
@@ -40,6 +42,7 @@ ConnectionFT601::ConnectionFT601(void *arg)
 ConnectionFT601::ConnectionFT601(void *arg, const ConnectionHandle &handle)
 {
     isConnected = false;
+    mEventThread = nullptr;
     int pid = -1;
     int vid = -1;
     mSerial = std::strtoll(handle.serial.c_str(),nullptr,16);
@@ -703,6 +706,18 @@ void ConnectionFT601::AbortSending(int ep)
 #endif
 }
 
+/** @brief Pins libusb event thread, it completes transfers of all devices of this type
+*/
+int ConnectionFT601::SetEventThreadParams(const std::vector<int> &cpus, int priority)
+{
+    if (mEventThread == nullptr)
+        return 0;
+    int status = SetOSThreadAffinity(cpus, mEventThread);
+    if (priority > 0 && SetOSThreadRealtimePriority(priority, mEventThread) != 0)
+        status = -1;
+    return status;
+}
+
 int ConnectionFT601::ResetStreamBuffers()
 {
 #ifndef __unix__
@@ -99,6 +99,10 @@ protected:
     void AbortSending(int ep) override;
     
     int ResetStreamBuffers() override;
+    int SetEventThreadParams(const std::vector<int> &cpus, int priority) override;
+    friend class ConnectionFT601Entry;
+    //! libusb event thread of the registry entry, shared by all connections
+    std::thread* mEventThread;
 
     eConnectionType GetType(void) {return USB_PORT;}
     
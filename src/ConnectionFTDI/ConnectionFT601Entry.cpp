@@ -165,6 +165,8 @@ IConnection *ConnectionFT601Entry::make(const ConnectionHandle &handle)
 #ifndef __unix__
     return new ConnectionFT601(mFTHandle, handle);
 #else
-    return new ConnectionFT601(ctx, handle);
+    ConnectionFT601* conn = new ConnectionFT601(ctx, handle);
+    conn->mEventThread = &mUSBProcessingThread;
+    return conn;
 #endif
 }
@@ -10,6 +10,7 @@
 #include "FPGA_common.h"
 #include "LMS7002M.h"
 #include "Logger.h"
+#include "threadHelper.h"
 #include <ciso646>
 #include <fstream>
 #include <thread>
@@ -53,6 +54,7 @@ const std::set<uint8_t> ConnectionFX3::commandsToBulkCtrlHw2 =
 */
 ConnectionFX3::ConnectionFX3(void *arg, const std::string &vidpid, const std::string &serial, const unsigned index)
 {
+    mEventThread = nullptr;
     bulkCtrlAvailable = false;
     bulkCtrlInProgress = false;
     isConnected = false;
@@ -776,6 +778,18 @@ int ConnectionFX3::ProgramWrite(const char *buffer, const size_t length, const i
     return LMS64CProtocol::ProgramWrite(buffer,length,programmingMode,device,callback);
 }
 
+/** @brief Pins libusb event thread, it completes transfers of all devices of this type
+*/
+int ConnectionFX3::SetEventThreadParams(const std::vector<int> &cpus, int priority)
+{
+    if (mEventThread == nullptr)
+        return 0;
+    int status = SetOSThreadAffinity(cpus, mEventThread);
+    if (priority > 0 && SetOSThreadRealtimePriority(priority, mEventThread) != 0)
+        status = -1;
+    return status;
+}
+
 int ConnectionFX3::ResetStreamBuffers()
 {
     //USB FIFO reset
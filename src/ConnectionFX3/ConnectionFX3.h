@@ -115,6 +115,10 @@ protected:
     void AbortSending(int ep) override;
 
     int ResetStreamBuffers() override;
+    int SetEventThreadParams(const std::vector<int> &cpus, int priority) override;
+    friend class ConnectionFX3Entry;
+    //! libusb event thread of the registry entry, shared by all connections
+    std::thread* mEventThread;
     eConnectionType GetType(void) {return USB_PORT;}
     
     static const int USB_MAX_CONTEXTS = 16; //maximum number of contexts for asynchronous transfers
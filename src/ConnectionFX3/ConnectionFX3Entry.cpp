@@ -184,5 +184,9 @@ std::vector<ConnectionHandle> ConnectionFX3Entry::enumerate(const ConnectionHand
 
 IConnection *ConnectionFX3Entry::make(const ConnectionHandle &handle)
 {
-    return new ConnectionFX3(ctx, handle.addr, handle.serial, handle.index);
+    ConnectionFX3* conn = new ConnectionFX3(ctx, handle.addr, handle.serial, handle.index);
+#ifdef __unix__
+    conn->mEventThread = &mUSBProcessingThread;
+#endif
+    return conn;
 }
@@ -11,6 +11,7 @@
 #cmakedefine ENABLE_REMOTE
 #cmakedefine ENABLE_SPI
 #cmakedefine ENABLE_XTRX
+#cmakedefine ENABLE_SHARED
 
 void __loadConnectionEVB7COMEntry(void);
 void __loadConnectionFX3Entry(void);
@@ -21,6 +22,7 @@ void __loadConnectionXillybusEntry(void);
 void __loadConnectionRemoteEntry(void);
 void __loadConnectionSPIEntry(void);
 void __loadConnectionXTRXEntry(void);
+void __loadConnectionSharedEntry(void);
 
 void __loadAllConnections(void)
 {
@@ -55,4 +57,8 @@ void __loadAllConnections(void)
     #ifdef ENABLE_XTRX
     __loadConnectionXTRXEntry();
     #endif
+
+    #ifdef ENABLE_SHARED
+    __loadConnectionSharedEntry();
+    #endif
 }
@@ -111,6 +111,14 @@ int IConnection::FinishDataReading(char* buffer, uint32_t length, int contextHan
 {
     return 0;
 }
+int IConnection::AcquireReceivedData(const char** data, uint32_t length, int ep, unsigned int timeout_ms)
+{
+    return -1;
+}
+int IConnection::ReleaseReceivedData(uint32_t length, int ep)
+{
+    return 0;
+}
 
 /** @brief Sets callback function which gets called each time data is sent or received
 */
@@ -133,6 +141,11 @@ int IConnection::ResetStreamBuffers()
 {
     return 0;
 }
+
+int IConnection::SetEventThreadParams(const std::vector<int> &cpus, int priority)
+{
+    return 0;
+}
 /***********************************************************************
  * Programming API
  **********************************************************************/
@@ -183,6 +196,14 @@ int IConnection::GPIODirRead(uint8_t *buffer, const size_t bufLength)
     return -1;
 }
 
+int IConnection::GPIODirWriteSequence(const uint8_t *states, const size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        if (GPIODirWrite(&states[i], 1) != 0)
+            return -1;
+    return 0;
+}
+
 /***********************************************************************
  * Register API
  **********************************************************************/
@@ -176,6 +176,27 @@ public:
     virtual bool WaitForReading(int contextHandle, unsigned int timeout_ms);
     virtual int FinishDataReading(char* buffer, uint32_t length, int contextHandle);
     virtual void AbortReading(int ep){};
+
+    /**	@brief Gives access to received data kept by connection, without copying it
+    @param data         set to first received byte
+    @param length       maximum number of bytes to take, 0 only checks support
+    @param ep           endpoint identifier
+    @param timeout_ms   timeout in milliseconds
+    @return number of bytes available at data, -1 if connection does not support it
+    */
+    virtual int AcquireReceivedData(const char** data, uint32_t length, int ep, unsigned int timeout_ms);
+    /**	@brief Releases data taken with AcquireReceivedData()
+    @param length       number of bytes released
+    @param ep           endpoint identifier
+    @return number of released bytes that were overwritten while in use
+    */
+    virtual int ReleaseReceivedData(uint32_t length, int ep);
+
+    /**	@brief Pin thread completing asynchronous transfers, if connection has one
+    @param cpus         CPU cores allowed for the thread, empty for no restriction
+    @param priority     SCHED_FIFO priority 1-99, 0 to leave unchanged
+    */
+    virtual int SetEventThreadParams(const std::vector<int> &cpus, int priority);
     
     /***********************************************************************
      * Programming API
@@ -272,6 +293,17 @@ public:
     */
     virtual int GPIODirRead(uint8_t *buffer, const size_t bufLength);
 
+    /**	@brief Writes sequence of GPIO direction states in order, used for
+    bit-banged buses. Default writes each state in its own transfer, which
+    keeps every state on the pins for at least one transfer latency.
+    Overrides sending the sequence in one transfer must hold states long
+    enough for the bus clock rate.
+    @param states GPIO direction configuration of GPIO 0-7 for each step
+    @param count number of steps
+    @return the operation success state
+    */
+    virtual int GPIODirWriteSequence(const uint8_t *states, const size_t count);
+
     /***********************************************************************
      * Register API
      **********************************************************************/
@@ -0,0 +1,277 @@
+/**
+    @file ConnectionShared.cpp
+    @author Lime Microsystems
+    @brief Connection to a board that is shared by LimeShareDaemon.
+*/
+
+#include "ConnectionShared.h"
+#include "Logger.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <chrono>
+
+using namespace lime;
+
+const char* ConnectionShared::DEFAULT_SOCKET = "/tmp/limeshare.sock";
+
+ConnectionShared::ConnectionShared(const std::string &socketPath) :
+    mSocket(-1),
+    mEndpointCount(0)
+{
+    for (int i = 0; i < MAX_EP_CNT; ++i)
+        mReaders[i] = -1;
+    Open(socketPath);
+}
+
+ConnectionShared::~ConnectionShared(void)
+{
+    Close();
+}
+
+/** @brief Connects to daemon control socket and reads shared memory description
+    @param socketPath path of daemon UNIX socket
+    @return 0 on success, -1 on failure
+*/
+int ConnectionShared::Open(const std::string &socketPath)
+{
+    Close();
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path))
+        return ReportError(ENAMETOOLONG, "ConnectionShared: socket path too long");
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    mSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (mSocket < 0)
+        return ReportError(errno);
+    if (connect(mSocket, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        int err = errno;
+        Close();
+        return ReportError(err, "ConnectionShared: cannot connect to %s", socketPath.c_str());
+    }
+
+    Hello hello;
+    if (Read((unsigned char*)&hello, sizeof(hello), 1000) != sizeof(hello) || memcmp(hello.magic, "LSHR", 4) != 0)
+    {
+        Close();
+        return ReportError(EPROTO, "ConnectionShared: unexpected reply from daemon");
+    }
+    hello.shmName[sizeof(hello.shmName) - 1] = 0;
+    mShmName = hello.shmName;
+    mEndpointCount = hello.endpointCount < MAX_EP_CNT ? hello.endpointCount : MAX_EP_CNT;
+    return 0;
+}
+
+void ConnectionShared::Close()
+{
+    std::lock_guard<std::mutex> lock(mStreamLock);
+    for (int i = 0; i < MAX_EP_CNT; ++i)
+    {
+        mRings[i].RemoveReader(mReaders[i]);
+        mReaders[i] = -1;
+        mRings[i].Close();
+    }
+    if (mSocket >= 0)
+        close(mSocket);
+    mSocket = -1;
+}
+
+bool ConnectionShared::IsOpen()
+{
+    return mSocket >= 0;
+}
+
+/** @brief Sends control packet data to daemon.
+    @param buffer data buffer
+    @param length given buffer size
+    @param timeout_ms timeout limit for operation in milliseconds
+    @return number of bytes sent
+*/
+int ConnectionShared::Write(const unsigned char *buffer, int length, int timeout_ms)
+{
+    int totalBytesWritten = 0;
+    while (totalBytesWritten < length)
+    {
+        pollfd pfd = {mSocket, POLLOUT, 0};
+        if (poll(&pfd, 1, timeout_ms) <= 0)
+            break;
+        ssize_t bytesSent = send(mSocket, buffer + totalBytesWritten, length - totalBytesWritten, MSG_NOSIGNAL);
+        if (bytesSent < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            ReportError(errno);
+            break;
+        }
+        totalBytesWritten += bytesSent;
+    }
+    return totalBytesWritten;
+}
+
+/** @brief Reads control packet reply from daemon.
+    @param buffer destination buffer
+    @param length number of bytes to read
+    @param timeout_ms timeout limit for operation in milliseconds
+    @return number of bytes received
+*/
+int ConnectionShared::Read(unsigned char *buffer, int length, int timeout_ms)
+{
+    int totalBytesReaded = 0;
+    while (totalBytesReaded < length)
+    {
+        pollfd pfd = {mSocket, POLLIN, 0};
+        if (poll(&pfd, 1, timeout_ms) <= 0)
+            break;
+        ssize_t bytesReceived = recv(mSocket, buffer + totalBytesReaded, length - totalBytesReaded, 0);
+        if (bytesReceived < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            ReportError(errno);
+            break;
+        }
+        if (bytesReceived == 0)
+        {
+            ReportError(ECONNRESET, "ConnectionShared: daemon closed connection");
+            break;
+        }
+        totalBytesReaded += bytesReceived;
+    }
+    return totalBytesReaded;
+}
+
+int ConnectionShared::OpenReader(int ep)
+{
+    if (ep < 0 || ep >= mEndpointCount)
+        return ReportError(EINVAL, "ConnectionShared: invalid endpoint %d", ep);
+    std::lock_guard<std::mutex> lock(mStreamLock);
+    if (!mRings[ep].IsOpen() && mRings[ep].Attach(mShmName + std::to_string(ep)) != 0)
+        return -1;
+    if (mReaders[ep] < 0)
+        mReaders[ep] = mRings[ep].AddReader();
+    return mReaders[ep] < 0 ? -1 : 0;
+}
+
+int ConnectionShared::ResetStreamBuffers()
+{
+    std::lock_guard<std::mutex> lock(mStreamLock);
+    for (int i = 0; i < MAX_EP_CNT; ++i)
+        if (mReaders[i] >= 0)
+            mRings[i].SkipToHead(mReaders[i]);
+    return 0;
+}
+
+int ConnectionShared::GetBuffersCount() const
+{
+    return 1;
+}
+
+int ConnectionShared::CheckStreamSize(int size) const
+{
+    return size < 4 ? 4 : size;
+}
+
+/**
+    @brief Takes received packets from shared ring
+    @param buffer array where to store received data
+    @param length number of bytes to read
+    @param timeout_ms read timeout in milliseconds
+    @return number of bytes received
+*/
+int ConnectionShared::ReceiveData(char *buffer, int length, int epIndex, int timeout_ms)
+{
+    if (OpenReader(epIndex) != 0)
+        return -1;
+    int totalBytesReaded = 0;
+    auto t1 = std::chrono::steady_clock::now();
+    int remaining_ms = timeout_ms;
+    do
+    {
+        const uint32_t packets = (length - totalBytesReaded) / SharedRing::SLOT_SIZE;
+        if (packets == 0)
+            break;
+        const char* data = nullptr;
+        const uint32_t n = mRings[epIndex].Peek(mReaders[epIndex], &data, packets, remaining_ms);
+        if (n > 0)
+        {
+            memcpy(buffer + totalBytesReaded, data, n * SharedRing::SLOT_SIZE);
+            //packets overwritten while copying are dropped
+            const uint32_t lost = mRings[epIndex].Advance(mReaders[epIndex], n);
+            memmove(buffer + totalBytesReaded, buffer + totalBytesReaded + lost * SharedRing::SLOT_SIZE, (n - lost) * SharedRing::SLOT_SIZE);
+            totalBytesReaded += (n - lost) * SharedRing::SLOT_SIZE;
+        }
+        remaining_ms = timeout_ms - std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t1).count();
+    } while (remaining_ms > 0);
+    return totalBytesReaded;
+}
+
+/**
+    @brief Gives access to received packets in shared ring, stream converts them in place
+    @return number of bytes available at data
+*/
+int ConnectionShared::AcquireReceivedData(const char** data, uint32_t length, int epIndex, unsigned int timeout_ms)
+{
+    if (OpenReader(epIndex) != 0)
+        return -1;
+    const uint32_t packets = length / SharedRing::SLOT_SIZE;
+    if (packets == 0)
+        return 0;
+    return mRings[epIndex].Peek(mReaders[epIndex], data, packets, timeout_ms) * SharedRing::SLOT_SIZE;
+}
+
+int ConnectionShared::ReleaseReceivedData(uint32_t length, int epIndex)
+{
+    if (epIndex < 0 || epIndex >= mEndpointCount || mReaders[epIndex] < 0)
+        return 0;
+    return mRings[epIndex].Advance(mReaders[epIndex], length / SharedRing::SLOT_SIZE) * SharedRing::SLOT_SIZE;
+}
+
+int ConnectionShared::SendData(const char *buffer, int length, int epIndex, int timeout_ms)
+{
+    return ReportError(ENOTSUP, "ConnectionShared: transmitting is not supported");
+}
+
+void ConnectionShared::AbortReading(int epIndex)
+{
+    if (epIndex < 0 || epIndex >= MAX_EP_CNT)
+        return;
+    std::lock_guard<std::mutex> lock(mStreamLock);
+    mRings[epIndex].RemoveReader(mReaders[epIndex]);
+    mReaders[epIndex] = -1;
+}
+
+int ConnectionShared::BeginDataReading(char* buffer, uint32_t length, int ep)
+{
+    return ep;
+}
+
+bool ConnectionShared::WaitForReading(int contextHandle, unsigned int timeout_ms)
+{
+    return true;
+}
+
+int ConnectionShared::FinishDataReading(char* buffer, uint32_t length, int contextHandle)
+{
+    return ReceiveData(buffer, length, contextHandle, 1000);
+}
+
+int ConnectionShared::BeginDataSending(const char* buffer, uint32_t length, int ep)
+{
+    return SendData(buffer, length, ep, 1000);
+}
+
+bool ConnectionShared::WaitForSending(int contextHandle, uint32_t timeout_ms)
+{
+    return true;
+}
+
+int ConnectionShared::FinishDataSending(const char* buffer, uint32_t length, int contextHandle)
+{
+    return contextHandle;
+}
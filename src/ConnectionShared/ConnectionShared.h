@@ -0,0 +1,84 @@
+/**
+    @file ConnectionShared.h
+    @author Lime Microsystems
+    @brief Connection to a board that is shared by LimeShareDaemon.
+*/
+
+#pragma once
+#include <ConnectionRegistry.h>
+#include "LMS64CProtocol.h"
+#include "SharedRing.h"
+#include <vector>
+#include <string>
+#include <mutex>
+
+namespace lime{
+
+/*!
+ * Control packets are forwarded to the daemon over a UNIX socket, received
+ * stream data is converted in place in the daemon's shared memory rings.
+ */
+class LIME_API ConnectionShared : public LMS64CProtocol
+{
+public:
+    static const char* DEFAULT_SOCKET;
+    static const int MAX_EP_CNT = 3;
+
+    //! first message sent by daemon after accepting a client
+    struct Hello
+    {
+        char magic[4];
+        uint8_t endpointCount;
+        uint8_t reserved[3];
+        char shmName[56];
+    };
+
+    ConnectionShared(const std::string &socketPath);
+    ~ConnectionShared(void);
+
+    int Open(const std::string &socketPath);
+    void Close();
+    bool IsOpen();
+
+    int Write(const unsigned char *buffer, int length, int timeout_ms = 100) override;
+    int Read(unsigned char *buffer, int length, int timeout_ms = 100) override;
+protected:
+    int ResetStreamBuffers() override;
+    int GetBuffersCount() const override;
+    int CheckStreamSize(int size) const override;
+
+    int ReceiveData(char* buffer, int length, int epIndex, int timeout = 100) override;
+    int SendData(const char* buffer, int length, int epIndex, int timeout = 100) override;
+
+    int BeginDataReading(char* buffer, uint32_t length, int ep) override;
+    bool WaitForReading(int contextHandle, unsigned int timeout_ms) override;
+    int FinishDataReading(char* buffer, uint32_t length, int contextHandle) override;
+    void AbortReading(int epIndex) override;
+    int AcquireReceivedData(const char** data, uint32_t length, int ep, unsigned int timeout_ms) override;
+    int ReleaseReceivedData(uint32_t length, int ep) override;
+
+    int BeginDataSending(const char* buffer, uint32_t length, int ep) override;
+    bool WaitForSending(int contextHandle, uint32_t timeout_ms) override;
+    int FinishDataSending(const char* buffer, uint32_t length, int contextHandle) override;
+private:
+    eConnectionType GetType(void) {return COM_PORT;}
+    int OpenReader(int ep);
+
+    int mSocket;
+    int mEndpointCount;
+    std::string mShmName;
+    std::mutex mStreamLock;
+    SharedRing mRings[MAX_EP_CNT];
+    int mReaders[MAX_EP_CNT];
+};
+
+class ConnectionSharedEntry : public ConnectionRegistryEntry
+{
+public:
+    ConnectionSharedEntry(void);
+    ~ConnectionSharedEntry(void);
+    std::vector<ConnectionHandle> enumerate(const ConnectionHandle &hint);
+    IConnection *make(const ConnectionHandle &handle);
+};
+
+}
@@ -0,0 +1,43 @@
+/**
+    @file ConnectionSharedEntry.cpp
+    @author Lime Microsystems
+    @brief Registry entry for boards shared by LimeShareDaemon.
+*/
+
+#include "ConnectionShared.h"
+#include <sys/stat.h>
+using namespace lime;
+
+//! make a static-initialized entry in the registry
+void __loadConnectionSharedEntry(void) //TODO fixme replace with LoadLibrary/dlopen
+{
+    static ConnectionSharedEntry sharedEntry;
+}
+
+ConnectionSharedEntry::ConnectionSharedEntry(void):
+    ConnectionRegistryEntry("Shared")
+{
+}
+
+ConnectionSharedEntry::~ConnectionSharedEntry(void)
+{
+}
+
+std::vector<ConnectionHandle> ConnectionSharedEntry::enumerate(const ConnectionHandle &hint)
+{
+    std::vector<ConnectionHandle> handles;
+    ConnectionHandle handle;
+    handle.media = "Shared";
+    handle.name = "LimeShareDaemon";
+    handle.addr = hint.addr.empty() ? ConnectionShared::DEFAULT_SOCKET : hint.addr;
+
+    struct stat st;
+    if (stat(handle.addr.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        handles.push_back(handle);
+    return handles;
+}
+
+IConnection *ConnectionSharedEntry::make(const ConnectionHandle &handle)
+{
+    return new ConnectionShared(handle.addr.empty() ? ConnectionShared::DEFAULT_SOCKET : handle.addr);
+}
@@ -0,0 +1,343 @@
+/**
+    @file LimeShareDaemon.cpp
+    @author Lime Microsystems
+    @brief Owns a board connection and shares it between multiple processes.
+    Received packets are published once into POSIX shared memory rings,
+    control packets from clients are serialized onto the board.
+*/
+
+#include "ConnectionShared.h"
+#include "ConnectionRegistry.h"
+#include "LMS64CCommands.h"
+#include "dataTypes.h"
+#include "Logger.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <getopt.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <list>
+#include <memory>
+#include <iostream>
+
+using namespace lime;
+
+static std::atomic<bool> stopDaemon(false);
+static std::mutex controlLock;
+static std::atomic<int> clientCount(0);
+
+static void intHandler(int)
+{
+    stopDaemon.store(true);
+}
+
+struct ClientThread
+{
+    ClientThread() : done(false) {}
+    std::thread thread;
+    std::atomic<bool> done;
+};
+
+//! Readers of all rings, not counting readers of excludePid
+static uint32_t ActiveReaders(std::vector<SharedRing> &rings, int32_t excludePid)
+{
+    uint32_t active = 0;
+    for (auto &ring : rings)
+        active += ring.GetActiveReaders(excludePid);
+    return active;
+}
+
+//! Process id of socket peer, 0 if unknown
+static int32_t PeerPid(int fd)
+{
+#ifdef SO_PEERCRED
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0)
+        return cred.pid;
+#endif
+    return 0;
+}
+
+/*!
+ * While other clients stream, do not let a client stop the shared receiver
+ * or reset the hardware timestamp. Blocks are removed or patched in place.
+ * @return number of blocks left in packet
+ */
+static int FilterRegisterWrites(unsigned char* pkt, bool othersStreaming)
+{
+    const int RX_EN = 1;
+    int blockCount = pkt[2];
+    if (pkt[0] != CMD_BRDSPI_WR || !othersStreaming)
+        return blockCount;
+    int dst = 0;
+    for (int i = 0; i < blockCount && i < 14; ++i)
+    {
+        unsigned char* block = &pkt[8 + 4 * i];
+        const uint16_t addr = (block[0] << 8) | block[1];
+        if (addr == 0x0009)
+            continue;
+        if (addr == 0x000A)
+            block[3] |= RX_EN;
+        memmove(&pkt[8 + 4 * dst], block, 4);
+        ++dst;
+    }
+    pkt[2] = dst;
+    return dst;
+}
+
+static void PumpEndpoint(IConnection* port, SharedRing* ring, int ep)
+{
+    const int buffersCount = port->GetBuffersCount();
+    const int packetsToBatch = port->CheckStreamSize(16);
+    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
+    std::vector<int> handles(buffersCount, 0);
+    std::vector<char> buffers(buffersCount*bufferSize, 0);
+    bool reading = false;
+    bool listening = false;
+    int bi = 0;
+    auto t1 = std::chrono::steady_clock::now();
+
+    while (stopDaemon.load(std::memory_order_relaxed) == false)
+    {
+        auto t2 = std::chrono::steady_clock::now();
+        if (!reading || t2 - t1 >= std::chrono::milliseconds(100))
+        {
+            listening = ring->GetActiveReaders() != 0;
+            t1 = t2;
+        }
+        //keep endpoint idle while nobody is listening
+        if (!listening)
+        {
+            if (reading)
+                port->AbortReading(ep);
+            reading = false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        if (!reading)
+        {
+            for (int i = 0; i < buffersCount; ++i)
+                handles[i] = port->BeginDataReading(&buffers[i*bufferSize], bufferSize, ep);
+            bi = 0;
+            reading = true;
+        }
+        if (handles[bi] >= 0)
+        {
+            if (port->WaitForReading(handles[bi], 1000) == false)
+                continue;
+            int bytesReceived = port->FinishDataReading(&buffers[bi*bufferSize], bufferSize, handles[bi]);
+            if (bytesReceived > 0)
+                ring->Push(&buffers[bi*bufferSize], bytesReceived / sizeof(FPGA_DataPacket));
+        }
+        handles[bi] = port->BeginDataReading(&buffers[bi*bufferSize], bufferSize, ep);
+        bi = (bi + 1) & (buffersCount-1);
+    }
+    if (reading)
+        port->AbortReading(ep);
+}
+
+static void ServeClient(int fd, LMS64CProtocol* port, std::vector<SharedRing>* rings, const std::string &shmName, std::atomic<bool>* done)
+{
+    //own stream of the client does not block its stop and reset writes
+    const int32_t peerPid = PeerPid(fd);
+    ConnectionShared::Hello hello;
+    memset(&hello, 0, sizeof(hello));
+    memcpy(hello.magic, "LSHR", 4);
+    hello.endpointCount = rings->size();
+    strncpy(hello.shmName, shmName.c_str(), sizeof(hello.shmName) - 1);
+    send(fd, &hello, sizeof(hello), MSG_NOSIGNAL);
+
+    const int pktLength = LMS64CProtocol::ProtocolLMS64C::pktLength;
+    unsigned char request[pktLength];
+    unsigned char reply[pktLength];
+    while (stopDaemon.load(std::memory_order_relaxed) == false)
+    {
+        int received = 0;
+        while (received < pktLength && stopDaemon.load(std::memory_order_relaxed) == false)
+        {
+            pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 500) <= 0)
+                continue;
+            ssize_t ret = recv(fd, request + received, pktLength - received, 0);
+            if (ret <= 0)
+                break;
+            received += ret;
+        }
+        if (received < pktLength)
+            break;
+
+        {
+            std::lock_guard<std::mutex> lock(controlLock);
+            if (FilterRegisterWrites(request, ActiveReaders(*rings, peerPid) > 0) == 0 && request[0] == CMD_BRDSPI_WR)
+            {
+                memcpy(reply, request, pktLength);
+                reply[1] = STATUS_COMPLETED_CMD;
+            }
+            else if (port->Write(request, pktLength) != pktLength || port->Read(reply, pktLength) != pktLength)
+            {
+                memcpy(reply, request, pktLength);
+                reply[1] = STATUS_ERROR_CMD;
+            }
+        }
+        if (send(fd, reply, pktLength, MSG_NOSIGNAL) != pktLength)
+            break;
+    }
+    close(fd);
+    lime::info("Client disconnected (%d remaining)", --clientCount);
+    done->store(true);
+}
+
+static void PrintHelp(const char* name)
+{
+    std::cout << "Usage " << name << " [options]" << std::endl;
+    std::cout << "  --help\t\t\t Print this help message" << std::endl;
+    std::cout << "  --args [deviceArgs]\t\t Board to share (default first found)" << std::endl;
+    std::cout << "  --socket [path]\t\t Control socket path (default " << ConnectionShared::DEFAULT_SOCKET << ")" << std::endl;
+    std::cout << "\t\t\t\t Socket and rings are accessible to daemon user and group only" << std::endl;
+    std::cout << "  --shm [name]\t\t\t Shared memory name prefix (default /limeshare)" << std::endl;
+    std::cout << "  --endpoints [count]\t\t Number of stream endpoints (default 1)" << std::endl;
+    std::cout << "  --slots [count]\t\t Packets per ring (default 4096)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string argStr;
+    std::string socketPath = ConnectionShared::DEFAULT_SOCKET;
+    std::string shmName = "/limeshare";
+    int endpoints = 1;
+    int slots = 4096;
+
+    static struct option long_options[] = {
+        {"help", no_argument, 0, 'h'},
+        {"args", required_argument, 0, 'a'},
+        {"socket", required_argument, 0, 's'},
+        {"shm", required_argument, 0, 'm'},
+        {"endpoints", required_argument, 0, 'e'},
+        {"slots", required_argument, 0, 'n'},
+        {0, 0, 0,  0}
+    };
+
+    int option_index = 0;
+    int c;
+    while ((c = getopt_long_only(argc, argv, "", long_options, &option_index)) != -1)
+    {
+        switch (c)
+        {
+        case 'a': argStr = optarg; break;
+        case 's': socketPath = optarg; break;
+        case 'm': shmName = optarg; break;
+        case 'e': endpoints = std::stoi(optarg); break;
+        case 'n': slots = std::stoi(optarg); break;
+        case 'h':
+        default:
+            PrintHelp(argv[0]);
+            return EXIT_SUCCESS;
+        }
+    }
+    if (endpoints < 1 || endpoints > ConnectionShared::MAX_EP_CNT)
+    {
+        std::cerr << "Endpoint count must be 1.." << ConnectionShared::MAX_EP_CNT << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    //never share ourselves
+    ConnectionHandle handle;
+    bool found = false;
+    for (const auto &h : ConnectionRegistry::findConnections(ConnectionHandle(argStr)))
+        if (h.module != "Shared")
+        {
+            handle = h;
+            found = true;
+            break;
+        }
+    if (!found)
+    {
+        std::cerr << "No devices found" << std::endl;
+        return EXIT_FAILURE;
+    }
+    IConnection* conn = ConnectionRegistry::makeConnection(handle);
+    LMS64CProtocol* port = dynamic_cast<LMS64CProtocol*>(conn);
+    if (port == nullptr || !conn->IsOpen())
+    {
+        std::cerr << "Cannot share " << handle.serialize() << std::endl;
+        ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+    std::cout << "Sharing " << handle.serialize() << std::endl;
+
+    std::vector<SharedRing> rings(endpoints);
+    for (int i = 0; i < endpoints; ++i)
+        if (rings[i].Create(shmName + std::to_string(i), slots) != 0)
+        {
+            std::cerr << GetLastErrorMessage() << std::endl;
+            ConnectionRegistry::freeConnection(conn);
+            return EXIT_FAILURE;
+        }
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socketPath.c_str());
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    //only owner and group of daemon may send board commands
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0
+        || chmod(socketPath.c_str(), 0660) != 0 || listen(listenFd, 8) != 0)
+    {
+        std::cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << std::endl;
+        ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, intHandler);
+    signal(SIGTERM, intHandler);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::thread> pumps;
+    for (int i = 0; i < endpoints; ++i)
+        pumps.push_back(std::thread(PumpEndpoint, conn, &rings[i], i));
+
+    std::list<std::unique_ptr<ClientThread> > clients;
+    while (stopDaemon.load() == false)
+    {
+        //join threads of disconnected clients
+        for (auto it = clients.begin(); it != clients.end();)
+        {
+            if ((*it)->done.load())
+            {
+                (*it)->thread.join();
+                it = clients.erase(it);
+            }
+            else
+                ++it;
+        }
+        pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 500) <= 0)
+            continue;
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        lime::info("Client connected (%d total)", ++clientCount);
+        clients.emplace_back(new ClientThread());
+        clients.back()->thread = std::thread(ServeClient, fd, port, &rings, shmName, &clients.back()->done);
+    }
+
+    for (auto &client : clients)
+        client->thread.join();
+    for (auto &t : pumps)
+        t.join();
+    close(listenFd);
+    unlink(socketPath.c_str());
+    for (auto &ring : rings)
+        ring.Close();
+    ConnectionRegistry::freeConnection(conn);
+    return EXIT_SUCCESS;
+}
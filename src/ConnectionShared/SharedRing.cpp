@@ -0,0 +1,281 @@
+/**
+    @file SharedRing.cpp
+    @author Lime Microsystems
+    @brief POSIX shared memory ring of FPGA data packets with one writer and
+    multiple independent readers.
+*/
+
+#include "SharedRing.h"
+#include "dataTypes.h"
+#include "Logger.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <new>
+#include <thread>
+#include <chrono>
+
+using namespace lime;
+
+static const uint32_t RING_MAGIC = 0x4C534852; //"LSHR"
+static const uint32_t RING_VERSION = 1;
+
+static_assert(sizeof(FPGA_DataPacket) == SharedRing::SLOT_SIZE, "ring slot must hold one FPGA packet");
+
+SharedRing::SharedRing() :
+    mOwner(false),
+    mFd(-1),
+    mMapSize(0),
+    mSlotCount(0),
+    mHeader(nullptr),
+    mData(nullptr)
+{
+}
+
+SharedRing::~SharedRing()
+{
+    Close();
+}
+
+size_t SharedRing::DataOffset()
+{
+    //keep slots page aligned
+    return (sizeof(Header) + SLOT_SIZE - 1) / SLOT_SIZE * SLOT_SIZE;
+}
+
+/** @brief Creates new shared memory ring, replacing any stale one with the same name
+    @param name POSIX shared memory object name, must start with '/'
+    @param slotCount number of packets in ring, rounded up to power of 2
+    @return 0 on success, -1 on failure
+*/
+int SharedRing::Create(const std::string &name, uint32_t slotCount)
+{
+    Close();
+    uint32_t count = 1;
+    while (count < slotCount)
+        count <<= 1;
+
+    shm_unlink(name.c_str());
+    mFd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (mFd < 0)
+        return ReportError(errno, "SharedRing: shm_open(%s) failed", name.c_str());
+    fchmod(mFd, 0660); //clients must share owner or group, ignore umask
+
+    mMapSize = DataOffset() + size_t(count) * SLOT_SIZE;
+    if (ftruncate(mFd, mMapSize) != 0)
+    {
+        int err = errno;
+        Close();
+        shm_unlink(name.c_str());
+        return ReportError(err, "SharedRing: ftruncate failed");
+    }
+    void* ptr = mmap(nullptr, mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (ptr == MAP_FAILED)
+    {
+        int err = errno;
+        mHeader = nullptr;
+        Close();
+        shm_unlink(name.c_str());
+        return ReportError(err, "SharedRing: mmap failed");
+    }
+    mHeader = new (ptr) Header;
+    mHeader->slotSize = SLOT_SIZE;
+    mHeader->slotCount = count;
+    mSlotCount = count;
+    mHeader->writeStart.store(0, std::memory_order_relaxed);
+    mHeader->writeSeq.store(0, std::memory_order_relaxed);
+    for (auto &r : mHeader->readers)
+    {
+        r.pid.store(0, std::memory_order_relaxed);
+        r.cursor.store(0, std::memory_order_relaxed);
+        r.overruns.store(0, std::memory_order_relaxed);
+    }
+    mHeader->version = RING_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    mHeader->magic = RING_MAGIC;
+    mData = (char*)ptr + DataOffset();
+    mName = name;
+    mOwner = true;
+    return 0;
+}
+
+/** @brief Attaches to ring created by another process
+    @param name POSIX shared memory object name
+    @return 0 on success, -1 on failure
+*/
+int SharedRing::Attach(const std::string &name)
+{
+    Close();
+    mFd = shm_open(name.c_str(), O_RDWR, 0);
+    if (mFd < 0)
+        return ReportError(errno, "SharedRing: shm_open(%s) failed", name.c_str());
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || size_t(st.st_size) < DataOffset())
+    {
+        Close();
+        return ReportError(EINVAL, "SharedRing: %s is not a valid ring", name.c_str());
+    }
+    mMapSize = st.st_size;
+    void* ptr = mmap(nullptr, mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (ptr == MAP_FAILED)
+    {
+        int err = errno;
+        Close();
+        return ReportError(err, "SharedRing: mmap failed");
+    }
+    mHeader = (Header*)ptr;
+    const uint32_t slotCount = mHeader->slotCount;
+    if (mHeader->magic != RING_MAGIC || mHeader->version != RING_VERSION
+        || mHeader->slotSize != SLOT_SIZE || slotCount == 0 || (slotCount & (slotCount - 1)) != 0
+        || DataOffset() + size_t(slotCount) * SLOT_SIZE > mMapSize)
+    {
+        Close();
+        return ReportError(EINVAL, "SharedRing: %s version mismatch", name.c_str());
+    }
+    mSlotCount = slotCount;
+    mData = (char*)ptr + DataOffset();
+    mName = name;
+    mOwner = false;
+    return 0;
+}
+
+void SharedRing::Close()
+{
+    if (mHeader)
+        munmap(mHeader, mMapSize);
+    mHeader = nullptr;
+    mData = nullptr;
+    mSlotCount = 0;
+    if (mFd >= 0)
+        close(mFd);
+    mFd = -1;
+    if (mOwner)
+        shm_unlink(mName.c_str());
+    mOwner = false;
+}
+
+bool SharedRing::IsOpen() const
+{
+    return mHeader != nullptr;
+}
+
+void SharedRing::Push(const char* data, uint32_t packetCount)
+{
+    const uint32_t mask = mSlotCount - 1;
+    uint64_t seq = mHeader->writeSeq.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < packetCount; ++i, ++seq)
+    {
+        //announce slot reuse before touching it, readers validate against it
+        mHeader->writeStart.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(mData + (seq & mask) * SLOT_SIZE, data + i * SLOT_SIZE, SLOT_SIZE);
+        mHeader->writeSeq.store(seq + 1, std::memory_order_release);
+    }
+}
+
+int SharedRing::AddReader()
+{
+    const int32_t pid = getpid();
+    GetActiveReaders(); //reclaims slots of dead processes
+    for (uint32_t i = 0; i < MAX_READERS; ++i)
+    {
+        int32_t expected = 0;
+        Reader &r = mHeader->readers[i];
+        if (r.pid.compare_exchange_strong(expected, pid))
+        {
+            r.overruns.store(0, std::memory_order_relaxed);
+            r.cursor.store(mHeader->writeSeq.load(std::memory_order_acquire), std::memory_order_relaxed);
+            return i;
+        }
+    }
+    return ReportError(EBUSY, "SharedRing: too many readers");
+}
+
+void SharedRing::RemoveReader(int reader)
+{
+    if (mHeader && reader >= 0 && reader < int(MAX_READERS))
+        mHeader->readers[reader].pid.store(0, std::memory_order_release);
+}
+
+void SharedRing::SkipToHead(int reader)
+{
+    Reader &r = mHeader->readers[reader];
+    r.cursor.store(mHeader->writeSeq.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+uint32_t SharedRing::Peek(int reader, const char** data, uint32_t maxPackets, int timeout_ms)
+{
+    Reader &r = mHeader->readers[reader];
+    const uint32_t count = mSlotCount;
+    uint64_t cursor = r.cursor.load(std::memory_order_relaxed);
+    uint64_t head = mHeader->writeSeq.load(std::memory_order_acquire);
+
+    auto t1 = std::chrono::steady_clock::now();
+    while (head == cursor)
+    {
+        if (std::chrono::steady_clock::now() - t1 >= std::chrono::milliseconds(timeout_ms))
+            return 0;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        head = mHeader->writeSeq.load(std::memory_order_acquire);
+    }
+
+    //keep a quarter of the ring between writer and packets in use
+    const uint32_t window = count - count / 4;
+    if (head - cursor > window)
+    {
+        r.overruns.fetch_add(head - cursor - window, std::memory_order_relaxed);
+        cursor = head - window;
+        r.cursor.store(cursor, std::memory_order_relaxed);
+    }
+    const uint32_t index = cursor & (count - 1);
+    uint32_t n = head - cursor < maxPackets ? head - cursor : maxPackets;
+    if (n > count - index)
+        n = count - index;
+    *data = mData + index * SLOT_SIZE;
+    return n;
+}
+
+uint32_t SharedRing::Advance(int reader, uint32_t packets)
+{
+    Reader &r = mHeader->readers[reader];
+    const uint64_t cursor = r.cursor.load(std::memory_order_relaxed);
+    //slots claimed by writer while in use could be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t claimed = mHeader->writeStart.load(std::memory_order_relaxed);
+    uint32_t lost = 0;
+    if (cursor + mSlotCount < claimed)
+    {
+        lost = claimed - mSlotCount - cursor < packets ? claimed - mSlotCount - cursor : packets;
+        r.overruns.fetch_add(lost, std::memory_order_relaxed);
+    }
+    r.cursor.store(cursor + packets, std::memory_order_relaxed);
+    return lost;
+}
+
+uint64_t SharedRing::GetOverruns(int reader) const
+{
+    return mHeader->readers[reader].overruns.load(std::memory_order_relaxed);
+}
+
+uint32_t SharedRing::GetActiveReaders(int32_t excludePid)
+{
+    uint32_t active = 0;
+    for (auto &r : mHeader->readers)
+    {
+        int32_t pid = r.pid.load(std::memory_order_acquire);
+        if (pid <= 0)
+            continue;
+        if (kill(pid, 0) != 0 && errno == ESRCH)
+        {
+            r.pid.compare_exchange_strong(pid, 0);
+            continue;
+        }
+        if (pid != excludePid)
+            ++active;
+    }
+    return active;
+}
@@ -0,0 +1,96 @@
+/**
+    @file SharedRing.h
+    @author Lime Microsystems
+    @brief POSIX shared memory ring of FPGA data packets with one writer and
+    multiple independent readers.
+*/
+
+#ifndef LIME_SHARED_RING_H
+#define LIME_SHARED_RING_H
+
+#include "LimeSuiteConfig.h"
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+namespace lime
+{
+
+/*!
+ * The ring is created by the sharing daemon and attached by every client.
+ * The writer publishes whole packets and never waits for readers, each
+ * reader has its own cursor in the shared header and falls behind
+ * independently. Readers process packets in place in the shared memory,
+ * a reader that gets lapped by the writer drops the overwritten packets
+ * and counts them as overruns.
+ */
+class LIME_API SharedRing
+{
+public:
+    static const uint32_t MAX_READERS = 16;
+    static const uint32_t SLOT_SIZE = 4096; //sizeof(FPGA_DataPacket)
+
+    SharedRing();
+    ~SharedRing();
+
+    int Create(const std::string &name, uint32_t slotCount);
+    int Attach(const std::string &name);
+    void Close();
+    bool IsOpen() const;
+
+    //! Writer side: publish packetCount packets stored contiguously in data
+    void Push(const char* data, uint32_t packetCount);
+
+    //! Reader side: claim a reader slot, returns reader index or -1
+    int AddReader();
+    void RemoveReader(int reader);
+    //! Move reader cursor to the newest published packet
+    void SkipToHead(int reader);
+    /** @brief Gives access to packets at reader cursor without copying them
+        Readers close to being lapped skip ahead first, so the writer has to
+        publish a quarter of the ring before packets in use are overwritten.
+        @param data set to first packet, packets are contiguous up to ring end
+        @return number of packets available at data, 0 on timeout
+    */
+    uint32_t Peek(int reader, const char** data, uint32_t maxPackets, int timeout_ms);
+    /** @brief Moves reader cursor past packets taken with Peek()
+        @return number of those packets overwritten by writer while in use
+    */
+    uint32_t Advance(int reader, uint32_t packets);
+    uint64_t GetOverruns(int reader) const;
+
+    //! Number of readers currently attached to the ring, not counting readers of excludePid
+    uint32_t GetActiveReaders(int32_t excludePid = 0);
+
+private:
+    struct Reader
+    {
+        std::atomic<int32_t> pid;
+        std::atomic<uint64_t> cursor;
+        std::atomic<uint64_t> overruns;
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotSize;
+        uint32_t slotCount;
+        std::atomic<uint64_t> writeStart; //slots claimed by writer
+        std::atomic<uint64_t> writeSeq; //slots published by writer
+        Reader readers[MAX_READERS];
+    };
+
+    static size_t DataOffset();
+
+    std::string mName;
+    bool mOwner;
+    int mFd;
+    size_t mMapSize;
+    uint32_t mSlotCount; //private copy, header is writable by every client
+    Header* mHeader;
+    char* mData;
+};
+
+}
+#endif // LIME_SHARED_RING_H
@@ -0,0 +1,448 @@
+/**
+    @file DCIQTracker.cpp
+    @author Lime Microsystems
+    @brief Background RX DC offset and IQ imbalance tracking
+*/
+
+#include "DCIQTracker.h"
+#include "LMS7002M.h"
+#include "Logger.h"
+#include <errno.h>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lime;
+
+//IQ statistics are not meaningful below this signal variance, 12 bit LSB^2
+static const double minSignalPower = 1.0;
+//blocks discarded after corrector write, they may contain samples from before it
+static const unsigned settleBlockCount = 2;
+//statistics are restarted when this many samples are accumulated without update
+static const double maxAccumulatedSamples = 1 << 24;
+
+DCIQTracker::Config::Config() :
+    decimation(8),
+    blockSamples(8192),
+    updatePeriod(0.5),
+    loopGain(0.5),
+    trackIQ(true),
+    trackDC(true)
+{
+}
+
+void DCIQTracker::Loop::Reset(int value, int minValue, int maxValue)
+{
+    code = value;
+    minCode = minValue;
+    maxCode = maxValue;
+    lastCode = value;
+    lastErr = 0;
+    slope = 0;
+    hasLast = false;
+    slopeValid = false;
+}
+
+/** @brief Moves code towards zero error, slope and its sign are learned from previous steps
+    @param err error measured with current code
+    @param threshold error magnitude considered to be noise
+    @param gain fraction of estimated step to apply
+    @param maxStep largest code change per call
+    @return new code
+*/
+int DCIQTracker::Loop::Step(double err, double threshold, double gain, int maxStep)
+{
+    if (hasLast && code != lastCode && std::fabs(err - lastErr) > threshold)
+    {
+        const double s = (err - lastErr) / (code - lastCode);
+        //average only estimates of the same polarity
+        slope = (slopeValid && (s > 0) == (slope > 0)) ? 0.5 * (slope + s) : s;
+        slopeValid = true;
+    }
+    lastErr = err;
+    lastCode = code;
+    hasLast = true;
+    if (std::fabs(err) <= threshold)
+        return code;
+
+    int delta;
+    if (!slopeValid) //probe to measure slope
+        delta = (err > 0 ? -1 : 1) * (maxStep > 4 ? maxStep / 4 : 1);
+    else
+    {
+        double d = -gain * err / slope;
+        d = d > maxStep ? maxStep : (d < -maxStep ? -maxStep : d);
+        delta = std::lrint(d);
+        if (delta == 0)
+            delta = d < 0 ? -1 : 1;
+    }
+    code += delta;
+    code = code > maxCode ? maxCode : (code < minCode ? minCode : code);
+    return code;
+}
+
+DCIQTracker::DCIQTracker() :
+    mChip(nullptr),
+    mChannel(0),
+    mAnalogDC(false),
+    mFillIndex(0),
+    mFillCount(0),
+    mPacketCounter(0),
+    mReadyIndex(0),
+    mBlockReady(false),
+    mSettleBlocks(0),
+    mDropped(0),
+    mTerminate(false),
+    mRunning(false)
+{
+    mMoments = Moments();
+    mStats = Stats();
+}
+
+DCIQTracker::~DCIQTracker()
+{
+    Stop();
+}
+
+//analog DC registers hold sign bit 6 and magnitude inverted for negative values
+static uint16_t EncodeAnalogDC(int value)
+{
+    return value < 0 ? 0x40 | ((value + 0x3F) & 0x3F) : value & 0x3F;
+}
+
+int DCIQTracker::ReadAnalogDC(uint16_t address)
+{
+    std::lock_guard<std::recursive_mutex> lck(mChip->GetRegistersLock());
+    mChip->SPI_write(address, 0);
+    mChip->SPI_write(address, 0x4000);
+    uint16_t value = mChip->SPI_read(address, true);
+    mChip->SPI_write(address, value & ~0xC000);
+    return (value & 0x40) ? int(value & 0x3F) - 0x3F : int(value & 0x3F);
+}
+
+int DCIQTracker::Start(LMS7002M* chip, unsigned channel, const Config &config)
+{
+    if (mThread.joinable())
+        return ReportError(EBUSY, "DCIQTracker: already running");
+    if (chip == nullptr || channel > 1)
+        return ReportError(EINVAL, "DCIQTracker: invalid channel");
+
+    mConfig = config;
+    if (mConfig.decimation == 0)
+        mConfig.decimation = 1;
+    if (mConfig.blockSamples < 1024)
+        mConfig.blockSamples = 1024;
+    if (mConfig.blockSamples > maxBlockSamples)
+        mConfig.blockSamples = maxBlockSamples;
+    //allocated once, RX thread may still be inside Feed() of previous run
+    for (auto &block : mBlocks)
+        if (block.size() < maxBlockSamples)
+            block.resize(maxBlockSamples);
+    mChip = chip;
+    mChannel = channel;
+
+    //continue from correctors currently in use
+    const uint16_t bypass = chip->SPI_read_cached(channel, LMS7param(DC_BYP_RXTSP).address);
+    const int gcorrq = chip->SPI_read_cached(channel, LMS7param(GCORRQ_RXTSP).address) & 0x7FF;
+    const int gcorri = chip->SPI_read_cached(channel, LMS7param(GCORRI_RXTSP).address) & 0x7FF;
+    const int16_t iqcorr = chip->SPI_read_cached(channel, LMS7param(IQCORR_RXTSP).address) << 4;
+    int gain = 0;
+    if ((bypass & 0x2) == 0)
+        gain = gcorri < 2047 ? 2047 - gcorri : gcorrq - 2047;
+    mLoopGain.Reset(gain, -1023, 1023);
+    mLoopPhase.Reset((bypass & 0x1) ? 0 : iqcorr >> 4, -2047, 2047);
+
+    //RXTSP DC loop already removes DC, only bypassed loop leaves it to analog DC DAC
+    mAnalogDC = config.trackDC && (bypass & 0x4);
+    int dcI = 0;
+    int dcQ = 0;
+    if (mAnalogDC)
+    {
+        chip->Modify_SPI_Reg_bits(LMS7param(DCMODE), 1);
+        chip->Modify_SPI_Reg_bits(channel ? LMS7param(PD_DCDAC_RXB) : LMS7param(PD_DCDAC_RXA), 0);
+        dcI = ReadAnalogDC(LMS7param(DC_RXAI).address + 2 * channel);
+        dcQ = ReadAnalogDC(LMS7param(DC_RXAQ).address + 2 * channel);
+    }
+    mLoopDCI.Reset(dcI, -63, 63);
+    mLoopDCQ.Reset(dcQ, -63, 63);
+
+    if (mConfig.trackIQ && WriteCorrectors(true) != 0)
+        return -1;
+
+    mMoments = Moments();
+    mStats = Stats();
+    mDropped.store(0);
+    mSettleBlocks = 0;
+    mFillIndex = 0;
+    mFillCount = 0;
+    mPacketCounter = 0;
+    mBlockReady.store(false);
+    mTerminate.store(false);
+    mThread = std::thread(&DCIQTracker::WorkerLoop, this);
+    mRunning.store(true, std::memory_order_release);
+    return 0;
+}
+
+int DCIQTracker::Stop()
+{
+    mRunning.store(false);
+    mTerminate.store(true);
+    mCond.notify_one();
+    if (mThread.joinable())
+        mThread.join();
+    return 0;
+}
+
+bool DCIQTracker::IsRunning() const
+{
+    return mThread.joinable();
+}
+
+DCIQTracker::Stats DCIQTracker::GetStats()
+{
+    std::lock_guard<std::mutex> lck(mStatsLock);
+    Stats stats = mStats;
+    stats.blocksDropped = mDropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void DCIQTracker::Feed(const complex16_t* samples, uint32_t count, bool is16bit)
+{
+    if (!mRunning.load(std::memory_order_acquire))
+        return;
+    if (++mPacketCounter < mConfig.decimation)
+        return;
+    mPacketCounter = 0;
+
+    const uint32_t n = count < mConfig.blockSamples - mFillCount ? count : mConfig.blockSamples - mFillCount;
+    complex16_t* dst = mBlocks[mFillIndex].data() + mFillCount;
+    const int shift = is16bit ? 4 : 0;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        dst[i].i = samples[i].i >> shift;
+        dst[i].q = samples[i].q >> shift;
+    }
+    mFillCount += n;
+    if (mFillCount < mConfig.blockSamples)
+        return;
+    mFillCount = 0;
+    if (mBlockReady.load(std::memory_order_acquire)) //worker still busy, refill same block
+    {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    mReadyIndex = mFillIndex;
+    mBlockReady.store(true, std::memory_order_release);
+    mFillIndex ^= 1;
+    //notified without lock, a missed wakeup only delays block by wait timeout
+    mCond.notify_one();
+}
+
+void DCIQTracker::WorkerLoop()
+{
+    auto lastUpdate = std::chrono::steady_clock::now();
+    while (mTerminate.load(std::memory_order_relaxed) == false)
+    {
+        {
+            std::unique_lock<std::mutex> lck(mLock);
+            mCond.wait_for(lck, std::chrono::milliseconds(100), [this]{
+                return mBlockReady.load(std::memory_order_acquire) || mTerminate.load(std::memory_order_relaxed);
+            });
+        }
+        if (!mBlockReady.load(std::memory_order_acquire))
+            continue;
+        if (mSettleBlocks > 0)
+            --mSettleBlocks;
+        else
+            Accumulate(mBlocks[mReadyIndex].data(), mConfig.blockSamples);
+        mBlockReady.store(false, std::memory_order_release);
+
+        auto now = std::chrono::steady_clock::now();
+        if (mMoments.n > 0 && std::chrono::duration<double>(now - lastUpdate).count() >= mConfig.updatePeriod)
+        {
+            Update();
+            lastUpdate = now;
+        }
+    }
+}
+
+#ifdef __SSE2__
+static inline int64_t HorizontalSum(__m128i v)
+{
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, v);
+    return int64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+/** @brief Adds block sums of I, Q, I^2, Q^2 and I*Q to running moments
+    @param samples 12 bit IQ samples
+*/
+void DCIQTracker::Accumulate(const complex16_t* samples, uint32_t count)
+{
+    int64_t sumI = 0, sumQ = 0, sumSq = 0, sumDiff = 0, sumCross = 0;
+    uint32_t i = 0;
+#ifdef __SSE2__
+    //4 samples per vector, 32 bit lanes are flushed before 12 bit products can overflow
+    const __m128i selI = _mm_set_epi16(0, 1, 0, 1, 0, 1, 0, 1);
+    const __m128i selQ = _mm_set_epi16(1, 0, 1, 0, 1, 0, 1, 0);
+    const __m128i signs = _mm_set_epi16(-1, 1, -1, 1, -1, 1, -1, 1);
+    const uint32_t vecCount = count & ~3u;
+    while (i < vecCount)
+    {
+        __m128i accI = _mm_setzero_si128();
+        __m128i accQ = _mm_setzero_si128();
+        __m128i accSq = _mm_setzero_si128();
+        __m128i accDiff = _mm_setzero_si128();
+        __m128i accCross = _mm_setzero_si128();
+        const uint32_t end = vecCount - i < 4 * 128 ? vecCount : i + 4 * 128;
+        for (; i < end; i += 4)
+        {
+            const __m128i x = _mm_loadu_si128((const __m128i*)&samples[i]);
+            const __m128i swapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            accI = _mm_add_epi32(accI, _mm_madd_epi16(x, selI));
+            accQ = _mm_add_epi32(accQ, _mm_madd_epi16(x, selQ));
+            accSq = _mm_add_epi32(accSq, _mm_madd_epi16(x, x)); //I^2+Q^2
+            accDiff = _mm_add_epi32(accDiff, _mm_madd_epi16(x, _mm_mullo_epi16(x, signs))); //I^2-Q^2
+            accCross = _mm_add_epi32(accCross, _mm_madd_epi16(x, swapped)); //2*I*Q
+        }
+        sumI += HorizontalSum(accI);
+        sumQ += HorizontalSum(accQ);
+        sumSq += HorizontalSum(accSq);
+        sumDiff += HorizontalSum(accDiff);
+        sumCross += HorizontalSum(accCross);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const int32_t I = samples[i].i;
+        const int32_t Q = samples[i].q;
+        sumI += I;
+        sumQ += Q;
+        sumSq += I * I + Q * Q;
+        sumDiff += I * I - Q * Q;
+        sumCross += 2 * I * Q;
+    }
+    mMoments.n += count;
+    mMoments.sumI += sumI;
+    mMoments.sumQ += sumQ;
+    mMoments.sumII += 0.5 * (sumSq + sumDiff);
+    mMoments.sumQQ += 0.5 * (sumSq - sumDiff);
+    mMoments.sumIQ += 0.5 * sumCross;
+
+    std::lock_guard<std::mutex> lck(mStatsLock);
+    ++mStats.blocksProcessed;
+}
+
+void DCIQTracker::Update()
+{
+    const Moments &m = mMoments;
+    const double meanI = m.sumI / m.n;
+    const double meanQ = m.sumQ / m.n;
+    const double varI = m.sumII / m.n - meanI * meanI;
+    const double varQ = m.sumQQ / m.n - meanQ * meanQ;
+    const double covIQ = m.sumIQ / m.n - meanI * meanQ;
+    const double power = varI + varQ;
+
+    bool changed = false;
+    if (mConfig.trackIQ && power > minSignalPower && varI > 0 && varQ > 0)
+    {
+        //estimation noise of normalized metrics falls with sample count
+        const double threshold = std::max(3.0 / std::sqrt(m.n), 1e-3);
+        const int gain = mLoopGain.code;
+        const int phase = mLoopPhase.code;
+        mLoopGain.Step((varI - varQ) / power, threshold, mConfig.loopGain, 64);
+        mLoopPhase.Step(2 * covIQ / power, threshold, mConfig.loopGain, 64);
+        changed |= gain != mLoopGain.code || phase != mLoopPhase.code;
+    }
+    if (mAnalogDC)
+    {
+        const int dcI = mLoopDCI.code;
+        const int dcQ = mLoopDCQ.code;
+        mLoopDCI.Step(meanI, 0.5 + 3 * std::sqrt(varI / m.n), mConfig.loopGain, 8);
+        mLoopDCQ.Step(meanQ, 0.5 + 3 * std::sqrt(varQ / m.n), mConfig.loopGain, 8);
+        changed |= dcI != mLoopDCI.code || dcQ != mLoopDCQ.code;
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(mStatsLock);
+        mStats.dcI = meanI;
+        mStats.dcQ = meanQ;
+        mStats.gainImbalance = (varI > 0 && varQ > 0) ? 10 * std::log10(varI / varQ) : 0;
+        mStats.phaseImbalance = (varI > 0 && varQ > 0) ? std::asin(std::max(-1.0, std::min(1.0, covIQ / std::sqrt(varI * varQ)))) * 180 / M_PI : 0;
+        mStats.dcCorrI = mLoopDCI.code;
+        mStats.dcCorrQ = mLoopDCQ.code;
+        mStats.gainCorr = mLoopGain.code;
+        mStats.phaseCorr = mLoopPhase.code;
+        if (changed)
+            ++mStats.updates;
+    }
+
+    if (changed)
+    {
+        if (WriteCorrectors(false) != 0)
+            lime::warning("DCIQTracker: failed to write correctors");
+        mSettleBlocks = settleBlockCount;
+        mMoments = Moments();
+    }
+    else if (m.n >= maxAccumulatedSamples)
+        mMoments = Moments();
+}
+
+/** @brief Writes correctors of tracked channel in one SPI batch under chip register lock, MAC is restored at the end
+    @param enable also clear gain and phase corrector bypass
+*/
+int DCIQTracker::WriteCorrectors(bool enable)
+{
+    //MAC is read from cache, switched and restored without other threads in between
+    std::lock_guard<std::recursive_mutex> lck(mChip->GetRegistersLock());
+    uint16_t addrs[12];
+    uint16_t values[12];
+    int n = 0;
+    if (mConfig.trackIQ)
+    {
+        const uint16_t macAddr = LMS7param(MAC).address;
+        const uint16_t mac = mChip->SPI_read_cached(0, macAddr);
+        const int gain = mLoopGain.code;
+        const uint16_t gcorrqAddr = LMS7param(GCORRQ_RXTSP).address;
+        const uint16_t gcorriAddr = LMS7param(GCORRI_RXTSP).address;
+        const uint16_t iqcorrAddr = LMS7param(IQCORR_RXTSP).address;
+        const uint16_t bypassAddr = LMS7param(GC_BYP_RXTSP).address;
+        addrs[n] = macAddr;
+        values[n++] = (mac & ~0x3) | (mChannel + 1);
+        addrs[n] = gcorrqAddr;
+        values[n++] = (mChip->SPI_read_cached(mChannel, gcorrqAddr) & ~0x7FF) | (gain < 0 ? 2047 + gain : 2047);
+        addrs[n] = gcorriAddr;
+        values[n++] = (mChip->SPI_read_cached(mChannel, gcorriAddr) & ~0x7FF) | (gain > 0 ? 2047 - gain : 2047);
+        addrs[n] = iqcorrAddr;
+        values[n++] = (mChip->SPI_read_cached(mChannel, iqcorrAddr) & ~0xFFF) | (mLoopPhase.code & 0xFFF);
+        if (enable)
+        {
+            addrs[n] = bypassAddr;
+            values[n++] = mChip->SPI_read_cached(mChannel, bypassAddr) & ~0x3;
+        }
+        addrs[n] = macAddr;
+        values[n++] = mac;
+    }
+    if (mAnalogDC)
+    {
+        const uint16_t dcAddr = LMS7param(DC_RXAI).address + 2 * mChannel;
+        const uint16_t dcI = EncodeAnalogDC(mLoopDCI.code);
+        const uint16_t dcQ = EncodeAnalogDC(mLoopDCQ.code);
+        //value is latched on rising edge of write strobe bit 15
+        addrs[n] = dcAddr;
+        values[n++] = dcI;
+        addrs[n] = dcAddr;
+        values[n++] = dcI | 0x8000;
+        addrs[n] = dcAddr + 1;
+        values[n++] = dcQ;
+        addrs[n] = dcAddr + 1;
+        values[n++] = dcQ | 0x8000;
+    }
+    if (n == 0)
+        return 0;
+    return mChip->SPI_write_batch(addrs, values, n, true);
+}
@@ -0,0 +1,149 @@
+/**
+    @file DCIQTracker.h
+    @author Lime Microsystems
+    @brief Background RX DC offset and IQ imbalance tracking
+*/
+
+#ifndef LIME_DCIQ_TRACKER_H
+#define LIME_DCIQ_TRACKER_H
+
+#include "LimeSuiteConfig.h"
+#include "dataTypes.h"
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace lime
+{
+
+class LMS7002M;
+
+/*!
+ * Estimates DC offset and IQ gain/phase imbalance of one RX channel from
+ * decimated stream packets and periodically adjusts chip correctors.
+ * RX thread only copies every N-th packet into a preallocated block,
+ * statistics and register writes are done by a worker thread.
+ */
+class LIME_API DCIQTracker
+{
+public:
+    struct Config
+    {
+        Config();
+        //! take one of every N stream packets
+        unsigned decimation;
+        //! samples per statistics block, at most maxBlockSamples
+        unsigned blockSamples;
+        //! minimum seconds between corrector updates
+        double updatePeriod;
+        //! fraction of estimated correction applied per update
+        double loopGain;
+        //! adjust gain and phase correctors (GCORR/IQCORR)
+        bool trackIQ;
+        //! adjust analog RX DC offset when RXTSP DC loop is bypassed
+        bool trackDC;
+    };
+
+    struct Stats
+    {
+        uint64_t blocksProcessed;
+        uint64_t blocksDropped;
+        uint64_t updates;
+        //! residual DC offset, 12 bit LSB
+        float dcI;
+        float dcQ;
+        //! residual I/Q power ratio, dB
+        float gainImbalance;
+        //! residual quadrature error, degrees
+        float phaseImbalance;
+        //! corrector values currently written to chip
+        int dcCorrI;
+        int dcCorrQ;
+        int gainCorr;
+        int phaseCorr;
+    };
+
+    static const unsigned maxBlockSamples = 65536;
+
+    DCIQTracker();
+    ~DCIQTracker();
+
+    /** @brief Starts tracking
+        @param chip transceiver receiving the stream
+        @param channel 0 - channel A, 1 - channel B
+    */
+    int Start(LMS7002M* chip, unsigned channel, const Config &config);
+    int Stop();
+    bool IsRunning() const;
+    Stats GetStats();
+
+    /** @brief Called from RX thread for every received packet, never blocks
+        @param samples packet samples of tracked channel
+        @param count number of samples
+        @param is16bit samples are full scale 16 bit instead of 12 bit
+    */
+    void Feed(const complex16_t* samples, uint32_t count, bool is16bit);
+
+private:
+    struct Moments
+    {
+        double n;
+        double sumI, sumQ, sumII, sumQQ, sumIQ;
+    };
+
+    //! one dimensional secant search driving an error metric to zero
+    struct Loop
+    {
+        void Reset(int value, int minValue, int maxValue);
+        int Step(double err, double threshold, double gain, int maxStep);
+        int code;
+        int minCode;
+        int maxCode;
+        int lastCode;
+        double lastErr;
+        double slope;
+        bool hasLast;
+        bool slopeValid;
+    };
+
+    void WorkerLoop();
+    void Accumulate(const complex16_t* samples, uint32_t count);
+    void Update();
+    int WriteCorrectors(bool enable);
+    int ReadAnalogDC(uint16_t address);
+
+    Config mConfig;
+    LMS7002M* mChip;
+    unsigned mChannel;
+    bool mAnalogDC;
+
+    std::vector<complex16_t> mBlocks[2];
+    unsigned mFillIndex;
+    unsigned mFillCount;
+    unsigned mPacketCounter;
+    unsigned mReadyIndex;
+    std::atomic<bool> mBlockReady;
+
+    Moments mMoments;
+    unsigned mSettleBlocks;
+    Loop mLoopDCI;
+    Loop mLoopDCQ;
+    Loop mLoopGain;
+    Loop mLoopPhase;
+
+    std::mutex mStatsLock;
+    Stats mStats;
+    std::atomic<uint64_t> mDropped;
+
+    std::thread mThread;
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::atomic<bool> mTerminate;
+    std::atomic<bool> mRunning;
+};
+
+}
+#endif // LIME_DCIQ_TRACKER_H
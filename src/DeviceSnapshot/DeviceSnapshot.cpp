@@ -0,0 +1,450 @@
+/**
+    @file DeviceSnapshot.cpp
+    @author Lime Microsystems
+    @brief Binary snapshot of device state for fast radio profile switching
+*/
+
+#include "DeviceSnapshot.h"
+#include "LMS7002M.h"
+#include "Logger.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#ifdef __unix__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace lime;
+
+static const char fileMagic[8] = {'L', 'M', 'S', 'S', 'N', 'A', 'P', 0};
+static const size_t headerSize = 24;
+//sane limits of parsed contents
+static const unsigned maxChips = 16;
+static const unsigned maxChannels = 64;
+
+enum SectionType
+{
+    SECTION_CHIP_REGS = 1, //index: chip*2 + MIMO channel
+    SECTION_REF_CLOCKS = 2, //index: chip
+    SECTION_FPGA_REGS = 3,
+    SECTION_RX_CHANNEL = 4, //index: channel
+    SECTION_TX_CHANNEL = 5,
+};
+
+//board GPIO, RF switches and LED controls
+const uint32_t DeviceSnapshot::fpgaRegs[] = {0x0017};
+const unsigned DeviceSnapshot::fpgaRegCount = sizeof(fpgaRegs) / sizeof(fpgaRegs[0]);
+
+static std::vector<uint32_t> MakeCrcTable()
+{
+    //CRC-32, IEEE 802.3 polynomial
+    std::vector<uint32_t> table(256);
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}
+
+uint32_t DeviceSnapshot::Checksum(const uint8_t* data, size_t size)
+{
+    static const std::vector<uint32_t> table = MakeCrcTable();
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFF;
+}
+
+static void Put16(std::vector<uint8_t> &buf, uint16_t value)
+{
+    buf.push_back(value & 0xFF);
+    buf.push_back(value >> 8);
+}
+
+static void Put32(std::vector<uint8_t> &buf, uint32_t value)
+{
+    Put16(buf, value & 0xFFFF);
+    Put16(buf, value >> 16);
+}
+
+static void PutDouble(std::vector<uint8_t> &buf, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    Put32(buf, bits & 0xFFFFFFFF);
+    Put32(buf, bits >> 32);
+}
+
+static uint16_t Get16(const uint8_t* data)
+{
+    return data[0] | (uint16_t(data[1]) << 8);
+}
+
+static uint32_t Get32(const uint8_t* data)
+{
+    return Get16(data) | (uint32_t(Get16(data + 2)) << 16);
+}
+
+static double GetDouble(const uint8_t* data)
+{
+    const uint64_t bits = Get32(data) | (uint64_t(Get32(data + 4)) << 32);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void PutSectionHeader(std::vector<uint8_t> &buf, uint16_t type, uint16_t index, uint32_t length)
+{
+    Put16(buf, type);
+    Put16(buf, index);
+    Put32(buf, length);
+}
+
+static void PutChannels(std::vector<uint8_t> &buf, uint16_t type, const std::vector<DeviceSnapshot::ChannelState> &channels)
+{
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        PutSectionHeader(buf, type, i, 5 * sizeof(double));
+        PutDouble(buf, channels[i].freq);
+        PutDouble(buf, channels[i].sampleRate);
+        PutDouble(buf, channels[i].lpfBw);
+        PutDouble(buf, channels[i].gfirBw);
+        PutDouble(buf, channels[i].ncoOffset);
+    }
+}
+
+//registers accessed through MCU procedures, see LMS7002M::SPI_write
+static bool IsMCURegister(uint16_t addr)
+{
+    return addr == 0x0640 || addr == 0x0641;
+}
+
+int DeviceSnapshot::CaptureChip(LMS7002M* lms, ChipState &state)
+{
+    const LMS7002M::Channel ch = lms->GetActiveChannel();
+    for (int i = 0; i < 2; ++i)
+    {
+        const LMS7002M::Channel mimoCh = i == 0 ? LMS7002M::ChA : LMS7002M::ChB;
+        std::vector<uint16_t> &addrs = state.addrs[i];
+        std::vector<uint16_t> &values = state.values[i];
+        lms->GetConfigAddresses(mimoCh, addrs);
+        values.resize(addrs.size());
+        lms->SetActiveChannel(mimoCh);
+        if (i == 0)
+        {
+            //analog DC correction registers return DAC values after read-back request
+            lms->BeginWriteBatch();
+            for (uint16_t addr = 0x05C3; addr <= 0x05CA; ++addr)
+                lms->SPI_write(addr, 0x4000, true);
+            lms->EndWriteBatch();
+        }
+        std::vector<uint16_t> spiAddrs;
+        for (auto addr : addrs)
+            if (!IsMCURegister(addr))
+                spiAddrs.push_back(addr);
+        std::vector<uint16_t> spiValues(spiAddrs.size());
+        int status = lms->SPI_read_batch(spiAddrs.data(), spiValues.data(), spiAddrs.size());
+        for (size_t n = 0, k = 0; n < addrs.size() && status == 0; ++n)
+        {
+            if (IsMCURegister(addrs[n]))
+                values[n] = lms->SPI_read(addrs[n], true, &status);
+            else
+                values[n] = spiValues[k++];
+        }
+        if (status != 0)
+        {
+            lms->SetActiveChannel(ch);
+            return -1;
+        }
+        if (i != 0)
+            continue;
+        for (size_t n = 0; n < addrs.size(); ++n)
+        {
+            //same read-back conversions as LMS7002M::SaveConfig
+            if (addrs[n] >= 0x5C3 && addrs[n] <= 0x5C6 && (values[n] & 0x400))
+                values[n] = 0x400 | (~values[n] & 0x3FF);
+            else if (addrs[n] >= 0x5C7 && addrs[n] <= 0x5CA && (values[n] & 0x40))
+                values[n] = 0x40 | (~values[n] & 0x3F);
+            else if (addrs[n] == 0x5C2)
+                values[n] &= 0xFF00; //do not save calibration start triggers
+        }
+    }
+    lms->SetActiveChannel(ch);
+    state.refClkSXR = lms->GetReferenceClk_SX(LMS7002M::Rx);
+    state.refClkSXT = lms->GetReferenceClk_SX(LMS7002M::Tx);
+    return 0;
+}
+
+int DeviceSnapshot::ApplyChip(LMS7002M* lms, const ChipState &state)
+{
+    uint16_t reg20 = lms->SPI_read_cached(0, 0x0020);
+    std::vector<uint16_t> addrs;
+    std::vector<uint16_t> values;
+    std::vector<uint16_t> dcAddrs;
+    std::vector<uint16_t> dcValues;
+    std::vector<uint16_t> addrsB;
+    std::vector<uint16_t> valuesB;
+    for (size_t n = 0; n < state.addrs[1].size(); ++n)
+        if (!IsMCURegister(state.addrs[1][n]))
+        {
+            addrsB.push_back(state.addrs[1][n]);
+            valuesB.push_back(state.values[1][n]);
+        }
+    for (size_t n = 0; n < state.addrs[0].size(); ++n)
+    {
+        const uint16_t addr = state.addrs[0][n];
+        if (addr == 0x0020)
+            reg20 = state.values[0][n];
+        else if (IsMCURegister(addr))
+            continue;
+        else if (addr >= 0x5C3 && addr <= 0x5CA)
+        {
+            dcAddrs.push_back(addr);
+            dcValues.push_back(state.values[0][n]);
+        }
+        else
+        {
+            addrs.push_back(addr);
+            values.push_back(state.values[0][n]);
+        }
+    }
+    const uint16_t reg20A = (reg20 & ~0x3) | 0x1;
+
+    //unforced writes skip registers already holding snapshot values
+    lms->BeginWriteBatch();
+    lms->SPI_write(0x0020, reg20A, true);
+    lms->SPI_write_batch(addrs.data(), values.data(), addrs.size(), false);
+    for (size_t n = 0; n < dcAddrs.size(); ++n)
+    {
+        //enable analog DC correction
+        lms->SPI_write(dcAddrs[n], dcValues[n] & 0x3FFF, true);
+        lms->SPI_write(dcAddrs[n], dcValues[n] | 0x8000, true);
+    }
+    lms->SPI_write(0x0020, (reg20 & ~0x3) | 0x2, true);
+    lms->SPI_write_batch(addrsB.data(), valuesB.data(), addrsB.size(), false);
+    //reset logic registers, leave channel A selected
+    lms->SPI_write(0x0020, reg20A & 0x55FF, true);
+    lms->SPI_write(0x0020, reg20A | 0xFF00, true);
+    if (lms->EndWriteBatch() != 0)
+        return -1;
+    //MCU mediated registers can not be part of batch
+    for (int i = 0; i < 2; ++i)
+    {
+        lms->SetActiveChannel(i == 0 ? LMS7002M::ChA : LMS7002M::ChB);
+        for (size_t n = 0; n < state.addrs[i].size(); ++n)
+            if (IsMCURegister(state.addrs[i][n]) && lms->SPI_write(state.addrs[i][n], state.values[i][n]) != 0)
+            {
+                lms->SetActiveChannel(LMS7002M::ChA);
+                return -1;
+            }
+    }
+    lms->SetActiveChannel(LMS7002M::ChA);
+    lms->SetReferenceClk_SX(LMS7002M::Rx, state.refClkSXR);
+    lms->SetReferenceClk_SX(LMS7002M::Tx, state.refClkSXT);
+
+    //comparator settling time
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    int status = 0;
+    if (!lms->Get_SPI_Reg_bits(LMS7param(PD_VCO_CGEN)) && !lms->GetCGENLocked())
+    {
+        lime::debug("DeviceSnapshot: CGEN not locked with stored CSW, retuning");
+        status |= lms->TuneVCO(LMS7002M::VCO_CGEN);
+    }
+    for (int tx = 0; tx < 2; ++tx)
+    {
+        lms->SetActiveChannel(tx ? LMS7002M::ChSXT : LMS7002M::ChSXR);
+        if (!lms->Get_SPI_Reg_bits(LMS7param(PD_VCO)) && !lms->GetSXLocked(tx))
+        {
+            lime::debug("DeviceSnapshot: SX%s not locked with stored CSW, retuning", tx ? "T" : "R");
+            status |= lms->SetFrequencySX(tx, lms->GetFrequencySX(tx));
+        }
+    }
+    lms->SetActiveChannel(LMS7002M::ChA);
+    return status == 0 ? 0 : -1;
+}
+
+int DeviceSnapshot::Save(const std::string &filename) const
+{
+    std::vector<uint8_t> payload;
+    for (size_t chip = 0; chip < chips.size(); ++chip)
+    {
+        const ChipState &state = chips[chip];
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            PutSectionHeader(payload, SECTION_CHIP_REGS, chip * 2 + ch, state.addrs[ch].size() * 4);
+            for (size_t n = 0; n < state.addrs[ch].size(); ++n)
+            {
+                Put16(payload, state.addrs[ch][n]);
+                Put16(payload, state.values[ch][n]);
+            }
+        }
+        PutSectionHeader(payload, SECTION_REF_CLOCKS, chip, 2 * sizeof(double));
+        PutDouble(payload, state.refClkSXR);
+        PutDouble(payload, state.refClkSXT);
+    }
+    if (!fpgaAddrs.empty())
+    {
+        PutSectionHeader(payload, SECTION_FPGA_REGS, 0, fpgaAddrs.size() * 8);
+        for (size_t n = 0; n < fpgaAddrs.size(); ++n)
+        {
+            Put32(payload, fpgaAddrs[n]);
+            Put32(payload, fpgaData[n]);
+        }
+    }
+    PutChannels(payload, SECTION_RX_CHANNEL, rxChannels);
+    PutChannels(payload, SECTION_TX_CHANNEL, txChannels);
+
+    std::vector<uint8_t> header(fileMagic, fileMagic + sizeof(fileMagic));
+    Put32(header, version);
+    Put32(header, payload.size());
+    Put32(header, Checksum(payload.data(), payload.size()));
+    Put32(header, 0);
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+        return ReportError(errno, "DeviceSnapshot: cannot open %s", filename.c_str());
+    fwrite(header.data(), 1, header.size(), file);
+    fwrite(payload.data(), 1, payload.size(), file);
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed)
+        return ReportError(EIO, "DeviceSnapshot: failed to write %s", filename.c_str());
+    return 0;
+}
+
+int DeviceSnapshot::Load(const std::string &filename)
+{
+    DeviceSnapshot loaded;
+    int status;
+#ifdef __unix__
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return ReportError(errno, "DeviceSnapshot: cannot open %s", filename.c_str());
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)headerSize)
+    {
+        close(fd);
+        return ReportError(EINVAL, "DeviceSnapshot: %s is not a snapshot file", filename.c_str());
+    }
+    void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return ReportError(errno, "DeviceSnapshot: mmap failed");
+    status = loaded.Parse((const uint8_t*)ptr, st.st_size);
+    munmap(ptr, st.st_size);
+#else
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.good())
+        return ReportError(ENOENT, "DeviceSnapshot: cannot open %s", filename.c_str());
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    status = loaded.Parse((const uint8_t*)buffer.data(), buffer.size());
+#endif
+    if (status != 0)
+        return ReportError(EINVAL, "DeviceSnapshot: %s is not a valid snapshot file", filename.c_str());
+    *this = loaded;
+    return 0;
+}
+
+int DeviceSnapshot::Parse(const uint8_t* data, size_t size)
+{
+    if (size < headerSize || memcmp(data, fileMagic, sizeof(fileMagic)) != 0)
+        return -1;
+    if (Get32(data + 8) != version)
+    {
+        lime::error("DeviceSnapshot: unsupported version %u", Get32(data + 8));
+        return -1;
+    }
+    const uint32_t payloadSize = Get32(data + 12);
+    if (payloadSize != size - headerSize)
+        return -1;
+    const uint8_t* payload = data + headerSize;
+    if (Checksum(payload, payloadSize) != Get32(data + 16))
+    {
+        lime::error("DeviceSnapshot: checksum mismatch");
+        return -1;
+    }
+
+    size_t pos = 0;
+    while (pos + 8 <= payloadSize)
+    {
+        const uint16_t type = Get16(payload + pos);
+        const uint16_t index = Get16(payload + pos + 2);
+        const uint32_t length = Get32(payload + pos + 4);
+        pos += 8;
+        if (length > payloadSize - pos)
+            return -1;
+        const uint8_t* section = payload + pos;
+        pos += length;
+        switch (type)
+        {
+        case SECTION_CHIP_REGS:
+        {
+            if (index >= 2 * maxChips || length % 4 != 0)
+                return -1;
+            if (chips.size() <= index / 2u)
+                chips.resize(index / 2 + 1);
+            ChipState &state = chips[index / 2];
+            std::vector<uint16_t> &addrs = state.addrs[index % 2];
+            std::vector<uint16_t> &values = state.values[index % 2];
+            addrs.resize(length / 4);
+            values.resize(length / 4);
+            for (size_t n = 0; n < addrs.size(); ++n)
+            {
+                addrs[n] = Get16(section + 4 * n);
+                values[n] = Get16(section + 4 * n + 2);
+            }
+            break;
+        }
+        case SECTION_REF_CLOCKS:
+            if (index >= maxChips || length != 2 * sizeof(double))
+                return -1;
+            if (chips.size() <= index)
+                chips.resize(index + 1);
+            chips[index].refClkSXR = GetDouble(section);
+            chips[index].refClkSXT = GetDouble(section + 8);
+            break;
+        case SECTION_FPGA_REGS:
+            if (length % 8 != 0)
+                return -1;
+            for (size_t n = 0; n < length / 8; ++n)
+            {
+                fpgaAddrs.push_back(Get32(section + 8 * n));
+                fpgaData.push_back(Get32(section + 8 * n + 4));
+            }
+            break;
+        case SECTION_RX_CHANNEL:
+        case SECTION_TX_CHANNEL:
+        {
+            if (index >= maxChannels || length != 5 * sizeof(double))
+                return -1;
+            std::vector<ChannelState> &channels = type == SECTION_RX_CHANNEL ? rxChannels : txChannels;
+            if (channels.size() <= index)
+                channels.resize(index + 1);
+            ChannelState &channel = channels[index];
+            channel.freq = GetDouble(section);
+            channel.sampleRate = GetDouble(section + 8);
+            channel.lpfBw = GetDouble(section + 16);
+            channel.gfirBw = GetDouble(section + 24);
+            channel.ncoOffset = GetDouble(section + 32);
+            break;
+        }
+        default: //sections of newer writers are skipped
+            break;
+        }
+    }
+    if (pos != payloadSize || chips.empty())
+        return -1;
+    for (auto &state : chips)
+        if (state.addrs[0].empty() || !(state.refClkSXR > 0) || !(state.refClkSXT > 0))
+            return -1;
+    return 0;
+}
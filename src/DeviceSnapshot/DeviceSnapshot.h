@@ -0,0 +1,92 @@
+/**
+    @file DeviceSnapshot.h
+    @author Lime Microsystems
+    @brief Binary snapshot of device state for fast radio profile switching
+*/
+
+#ifndef LIME_DEVICE_SNAPSHOT_H
+#define LIME_DEVICE_SNAPSHOT_H
+
+#include "LimeSuiteConfig.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lime
+{
+
+class LMS7002M;
+
+/*!
+ * Complete device state in one versioned binary file: register maps of
+ * both chip channels (includes GFIR coefficients, TSP IQ/DC corrections
+ * and analog DC calibration values), reference clocks, FPGA control
+ * registers and host side channel settings. Files are mapped to memory
+ * and verified with CRC32 before anything is written to the device.
+ * Chip registers are applied as one batched SPI transfer, registers
+ * already holding snapshot values are skipped while values cache is on.
+ * INI configuration files remain the human readable import/export format.
+ *
+ * File layout, little endian:
+ *   header: "LMSSNAP\0", version, payload size, payload CRC32, reserved
+ *   payload: sections of {type, index, length, data}
+ */
+class LIME_API DeviceSnapshot
+{
+public:
+    static const uint32_t version = 1;
+
+    struct ChipState
+    {
+        //! register addresses and values of MIMO channels A and B
+        std::vector<uint16_t> addrs[2];
+        std::vector<uint16_t> values[2];
+        double refClkSXR;
+        double refClkSXT;
+    };
+
+    //! Host side settings of one stream channel, see LMS7_Device
+    struct ChannelState
+    {
+        double freq;
+        double sampleRate;
+        double lpfBw;
+        double gfirBw;
+        double ncoOffset;
+    };
+
+    std::vector<ChipState> chips;
+    std::vector<uint32_t> fpgaAddrs;
+    std::vector<uint32_t> fpgaData;
+    std::vector<ChannelState> rxChannels;
+    std::vector<ChannelState> txChannels;
+
+    //! FPGA registers stored in snapshots, board GPIO and RF switch controls
+    static const uint32_t fpgaRegs[];
+    static const unsigned fpgaRegCount;
+
+    /** @brief Reads configuration registers of both channels from chip
+        in two batched transfers, active channel is restored.
+        RSSI DC registers 0x0640-0x0641 are read through MCU
+        @return 0-success, other-failure
+    */
+    static int CaptureChip(LMS7002M* lms, ChipState &state);
+    /** @brief Writes chip state in one batched transfer and checks
+        PLL locks, VCOs are retuned only if stored settings do not lock.
+        RSSI DC registers 0x0640-0x0641 are written through MCU after the batch
+        @return 0-success, other-failure
+    */
+    static int ApplyChip(LMS7002M* lms, const ChipState &state);
+
+    int Save(const std::string &filename) const;
+    //! Replaces contents with file contents, nothing changes on error
+    int Load(const std::string &filename);
+
+    static uint32_t Checksum(const uint8_t* data, size_t size);
+
+private:
+    int Parse(const uint8_t* data, size_t size);
+};
+
+}
+#endif // LIME_DEVICE_SNAPSHOT_H
@@ -47,13 +47,9 @@ int FPGA_Q::SetInterfaceFreq(double txRate_Hz, double rxRate_Hz, double txPhase,
     return 0;
 }
 
-int FPGA_Q::WriteRegisters(const uint32_t *addrs, const uint32_t *data, unsigned cnt)
+void FPGA_Q::EnableValuesCache(bool enabled)
 {
-    return connection->WriteRegisters(addrs, data, cnt);
-}
-int FPGA_Q::ReadRegisters(const uint32_t *addrs, uint32_t *data, unsigned cnt)
-{
-    return connection->ReadRegisters(addrs, data, cnt);
+    FPGA::EnableValuesCache(false);
 }
 
 /** @brief Configures FPGA PLLs to LimeLight interface frequency
@@ -18,8 +18,8 @@ public:
     FPGA_Q();
     virtual ~FPGA_Q(){};
     int SetInterfaceFreq(double f_Tx_Hz, double f_Rx_Hz, double txPhase, double rxPhase, int ch = 0) override;
-    int WriteRegisters(const uint32_t *addrs, const uint32_t *data, unsigned cnt) override;
-    int ReadRegisters(const uint32_t *addrs, uint32_t *data, unsigned cnt) override;
+    //! values are not cached, bank select and write batches still apply
+    void EnableValuesCache(bool enabled) override;
     //int SetInterfaceFreq(double f_Tx_Hz, double f_Rx_Hz, int ch = 0)override;
 };
 
@@ -4,6 +4,7 @@
 #include <ciso646>
 #include <vector>
 #include <map>
+#include <bitset>
 #include <math.h>
 #include <assert.h>
 #include <thread>
@@ -31,16 +32,56 @@ const uint16_t PHCFG_MODE = 1 << 14;
 
 const uint16_t busyAddr = 0x0021;
 
-FPGA::FPGA()
+//! registers that are never written, writes are dropped when cache is enabled
+static const uint16_t readonly_regs[] = {
+    0x000, 0x001, 0x002, 0x003, 0x021, 0x022, 0x065, 0x067, 0x069, 0x06A,
+    0x06B, 0x06C, 0x06D, 0x06F, 0x070, 0x071, 0x072, 0x073, 0x074, 0x076,
+    0x077, 0x078, 0x07A, 0x07B, 0x07C, 0x0C2, 0x100, 0x101, 0x102, 0x103,
+    0x104, 0x105, 0x106, 0x107, 0x108, 0x109, 0x10A, 0x10B, 0x10C, 0x10D,
+    0x10E, 0x10F, 0x110, 0x111, 0x114};
+
+//! registers changed by FPGA, always read from device
+static const uint16_t volatile_regs[] = {
+    0x021, 0x022, 0x060, 0x065, 0x067, 0x069, 0x06A, 0x06B, 0x06C, 0x06D,
+    0x06F, 0x070, 0x071, 0x072, 0x073, 0x074, 0x076, 0x077, 0x078, 0x07A,
+    0x07B, 0x07C, 0x0C2, 0x100, 0x101, 0x102, 0x103, 0x104, 0x105, 0x106,
+    0x107, 0x108, 0x109, 0x10A, 0x10B, 0x10C, 0x10D, 0x10E, 0x10F, 0x110,
+    0x111, 0x114};
+
+template<size_t N, size_t M>
+static std::bitset<N> RegistersBitmap(const uint16_t (&regs)[M])
+{
+    std::bitset<N> bitmap;
+    for (size_t i = 0; i < M; ++i)
+        bitmap.set(regs[i]);
+    return bitmap;
+}
+
+FPGA::FPGA() :
+    regsCache(cacheBanks)
 {
     useCache = false;
+    writeBatchDepth = 0;
+    recording = false;
+    recordPolled = false;
+    connection = nullptr;
+    ClearCache();
+}
+
+void FPGA::ClearCache()
+{
+    std::lock_guard<std::recursive_mutex> lck(mLock);
+    bankSelect = ~0u;
+    for (auto &bank : regsCache)
+        bank.valid.reset();
 }
 
 void FPGA::EnableValuesCache(bool enabled)
 {
+    std::lock_guard<std::recursive_mutex> lck(mLock);
     useCache = enabled;
     if (!useCache)
-        regsCache.clear();
+        ClearCache();
 }
 
 int FPGA::WriteRegister(uint32_t addr, uint32_t val)
@@ -54,81 +95,170 @@ int FPGA::ReadRegister(uint32_t addr)
     return ReadRegisters(&addr, &val, 1) != 0 ? -1 : val;
 }
 
+//! Other threads wait until batch ends, their accesses would land in it
+void FPGA::BeginWriteBatch()
+{
+    mLock.lock();
+    ++writeBatchDepth;
+}
+
+int FPGA::EndWriteBatch()
+{
+    std::lock_guard<std::recursive_mutex> lck(mLock);
+    if (writeBatchDepth == 0)
+        return 0;
+    int status = 0;
+    if (--writeBatchDepth == 0)
+        status = FlushWriteBatch();
+    mLock.unlock(); //taken in BeginWriteBatch()
+    return status;
+}
+
+FPGA::WriteBatch::WriteBatch(FPGA* fpga) : fpga(fpga)
+{
+    fpga->BeginWriteBatch();
+}
+
+//! failed transfer clears register cache, following accesses reach device
+FPGA::WriteBatch::~WriteBatch()
+{
+    fpga->EndWriteBatch();
+}
+
+void FPGA::BeginRecording()
+{
+    std::lock_guard<std::recursive_mutex> lck(mLock);
+    recording = true;
+    recordPolled = false;
+    recordAddrs.clear();
+    recordData.clear();
+}
+
+bool FPGA::EndRecording(std::vector<uint32_t> &addrs, std::vector<uint32_t> &data)
+{
+    std::lock_guard<std::recursive_mutex> lck(mLock);
+    recording = false;
+    addrs.swap(recordAddrs);
+    data.swap(recordData);
+    recordAddrs.clear();
+    recordData.clear();
+    return !recordPolled;
+}
+
+//! Sends writes collected since BeginWriteBatch(), collection continues
+int FPGA::FlushWriteBatch()
+{
+    std::lock_guard<std::recursive_mutex> lck(mLock);
+    if (batchAddrs.empty())
+        return 0;
+    int status = connection->WriteRegisters(batchAddrs.data(), batchData.data(), batchAddrs.size());
+    batchAddrs.clear();
+    batchData.clear();
+    if (status != 0)
+        ClearCache(); //unknown which writes reached device
+    return status;
+}
+
 int FPGA::WriteRegisters(const uint32_t *addrs, const uint32_t *data, unsigned cnt)
 {
-    if (useCache)
+    static const std::bitset<cacheSize> readonly = RegistersBitmap<cacheSize>(readonly_regs);
+    static const std::bitset<cacheSize> volatiles = RegistersBitmap<cacheSize>(volatile_regs);
+    std::lock_guard<std::recursive_mutex> lck(mLock);
+    if (recording)
     {
-        const int readonly_regs[] = {
-            0x000, 0x001, 0x002, 0x003, 0x021, 0x022, 0x065, 0x067, 0x069, 0x06A,
-            0x06B, 0x06C, 0x06D, 0x06F, 0x070, 0x071, 0x072, 0x073, 0x074, 0x076,
-            0x077, 0x078, 0x07A, 0x07B, 0x07C, 0x0C2, 0x100, 0x101, 0x102, 0x103,
-            0x104, 0x105, 0x106, 0x107, 0x108, 0x109, 0x10A, 0x10B, 0x10C, 0x10D,
-            0x10E, 0x10F, 0x110, 0x111, 0x114};
-
-        std::vector<uint32_t> reg_addr;
-        std::vector<uint32_t> reg_val;
-        for (unsigned i = 0; i < cnt; i++)
+        recordAddrs.insert(recordAddrs.end(), addrs, addrs + cnt);
+        recordData.insert(recordData.end(), data, data + cnt);
+    }
+    for (unsigned i = 0; i < cnt; i++)
+    {
+        const uint32_t addr = addrs[i];
+        if (addr == bankSelectAddr)
         {
-            auto endptr = readonly_regs + sizeof(readonly_regs)/sizeof(*readonly_regs);
-            if (std::find(readonly_regs, endptr, addrs[i])!=endptr)
+            //select stays latched in FPGA, repeating it is redundant while
+            //cache is trusted to mirror device state
+            if (useCache && data[i] == bankSelect)
                 continue;
-
-            auto result = regsCache.find(addrs[i]);
-            if (result != regsCache.end() && result->second == data[i])
+            bankSelect = data[i];
+        }
+        else if (useCache && addr < cacheSize && bankSelect <= 0xFFFF && bankSelect != 0)
+        {
+            if (readonly.test(addr))
                 continue;
-            reg_addr.push_back(addrs[i]);
-            reg_val.push_back(data[i]);
-            regsCache[addrs[i]] = data[i];
+            //write reaches every selected bank, skip only if all of them hold the value
+            bool cached = !volatiles.test(addr);
+            for (unsigned b = 0; b < cacheBanks; ++b)
+                if ((bankSelect >> b) & 1)
+                    cached &= regsCache[b].valid.test(addr) && regsCache[b].values[addr] == uint16_t(data[i]);
+            if (cached)
+                continue;
+            for (unsigned b = 0; b < cacheBanks; ++b)
+                if ((bankSelect >> b) & 1)
+                {
+                    regsCache[b].values[addr] = data[i];
+                    regsCache[b].valid.set(addr);
+                }
         }
-        if (reg_val.size())
-            return connection->WriteRegisters(reg_addr.data(), reg_val.data(), reg_val.size());
-        return 0;
+        batchAddrs.push_back(addr);
+        batchData.push_back(data[i]);
     }
-    return connection->WriteRegisters(addrs, data, cnt);
+    if (writeBatchDepth > 0)
+        return 0;
+    return FlushWriteBatch();
 }
 
 int FPGA::ReadRegisters(const uint32_t *addrs, uint32_t *data, unsigned cnt)
 {
-    if (useCache)
+    static const std::bitset<cacheSize> volatiles = RegistersBitmap<cacheSize>(volatile_regs);
+    std::lock_guard<std::recursive_mutex> lck(mLock);
+    //reads must observe writes collected so far
+    if (FlushWriteBatch() != 0)
+        return -1;
+    if (recording && std::find(addrs, addrs + cnt, busyAddr) != addrs + cnt)
+        recordPolled = true;
+
+    //reads come from lowest selected chip
+    CacheBank* bank = nullptr;
+    if (useCache && bankSelect <= 0xFFFF)
+        for (unsigned b = 0; b < cacheBanks && !bank; ++b)
+            if ((bankSelect >> b) & 1)
+                bank = &regsCache[b];
+    if (!bank)
+        return connection->ReadRegisters(addrs, data, cnt);
+
+    std::vector<uint32_t> reg_addr;
+    for (unsigned i = 0; i < cnt; i++)
     {
-        const int volatile_regs[] = {
-            0x021, 0x022, 0x060, 0x065, 0x067, 0x069, 0x06A, 0x06B, 0x06C, 0x06D,
-            0x06F, 0x070, 0x071, 0x072, 0x073, 0x074, 0x076, 0x077, 0x078, 0x07A,
-            0x07B, 0x07C, 0x0C2, 0x100, 0x101, 0x102, 0x103, 0x104, 0x105, 0x106,
-            0x107, 0x108, 0x109, 0x10A, 0x10B, 0x10C, 0x10D, 0x10E, 0x10F, 0x110,
-            0x111, 0x114};
-
-        std::vector<uint32_t> reg_addr;
-        for (unsigned i = 0; i < cnt; i++)
-        {
-            auto endptr = volatile_regs + sizeof(volatile_regs)/sizeof(*volatile_regs);
-            if (std::find(volatile_regs, endptr, addrs[i])==endptr)
-            {
-                auto result = regsCache.find(addrs[i]);
-                if (result != regsCache.end())
-                    continue;
-            }
-            reg_addr.push_back(addrs[i]);
-        }
+        const uint32_t addr = addrs[i];
+        if (addr < cacheSize && !volatiles.test(addr) && bank->valid.test(addr))
+            data[i] = bank->values[addr];
+        else
+            reg_addr.push_back(addr);
+    }
+    if (reg_addr.empty())
+        return 0;
 
-        if (reg_addr.size())
+    std::vector<uint32_t> reg_val(reg_addr.size());
+    if (connection->ReadRegisters(reg_addr.data(), reg_val.data(), reg_addr.size()) < 0)
+        return -1;
+    for (unsigned i = 0, j = 0; i < cnt; i++)
+    {
+        const uint32_t addr = addrs[i];
+        if (addr < cacheSize && !volatiles.test(addr) && bank->valid.test(addr))
+            continue;
+        data[i] = reg_val[j++];
+        if (addr < cacheSize)
         {
-            std::vector<uint32_t> reg_val(reg_addr.size());
-            if (connection->ReadRegisters(reg_addr.data(), reg_val.data(), reg_addr.size()) <0)
-                return -1;
-            for (unsigned i = 0; i < reg_addr.size(); i++)
-                regsCache[reg_addr[i]] = reg_val[i];
+            bank->values[addr] = data[i];
+            bank->valid.set(addr);
         }
-        for (unsigned i = 0; i < cnt; i++)
-            data[i] = regsCache[addrs[i]];
-        return 0;
     }
-    return connection->ReadRegisters(addrs, data, cnt);
+    return 0;
 }
 
 void FPGA::SetConnection(IConnection* conn)
 {
     connection = conn;
+    ClearCache();
 }
 
 IConnection* FPGA::GetConnection() const
@@ -175,6 +305,29 @@ int FPGA::ResetTimestamp()
     return WriteRegister(0x0009, interface_ctrl_0009 & ~value);
 }
 
+/** @brief Polls PLL status after configuration was written without waiting, e.g. replayed
+    @param timeout_ms time to wait for done bit
+    @return 0-PLL configured, -1 error reported or still busy
+*/
+int FPGA::WaitPllDone(unsigned timeout_ms)
+{
+    const auto timeout = chrono::milliseconds(timeout_ms);
+    const auto t1 = chrono::high_resolution_clock::now();
+    while (true)
+    {
+        const int statusReg = ReadRegister(busyAddr);
+        if (statusReg < 0)
+            return -1;
+        if ((statusReg >> 7) & 0xFF)
+            return ReportError(EBUSY, "FPGA PLL error %i", (statusReg >> 7) & 0xFF);
+        if (statusReg & 0x1)
+            return 0;
+        if (chrono::high_resolution_clock::now() - t1 > timeout)
+            return ReportError(ENODEV, "FPGA PLL timeout, busy bit is still 1");
+        std::this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
 int FPGA::SetPllClock(int clockIndex, int nSteps, bool waitLock, uint16_t &reg23val)
 {
     const auto timeout = chrono::seconds(3);
@@ -10,7 +10,9 @@
 #include <stdint.h>
 #include "dataTypes.h"
 #include "Streamer.h"
-#include <map>
+#include <bitset>
+#include <vector>
+#include <mutex>
 
 namespace lime
 {
@@ -56,6 +58,30 @@ public:
     virtual int ReadRegisters(const uint32_t *addrs, uint32_t *data, unsigned cnt);
     int WriteRegister(uint32_t addr, uint32_t val);
     int ReadRegister(uint32_t addr);
+    /*!
+     * Collects register writes while in scope and sends them in one transfer
+     * when it ends. Reads send collected writes first. Register accesses of
+     * other threads wait until the scope ends.
+     */
+    class WriteBatch
+    {
+    public:
+        explicit WriteBatch(FPGA* fpga);
+        ~WriteBatch();
+    private:
+        WriteBatch(const WriteBatch&);
+        WriteBatch& operator=(const WriteBatch&);
+        FPGA* fpga;
+    };
+    //! Keeps copy of register writes until EndRecording()
+    void BeginRecording();
+    /** @brief Stops recording and returns recorded writes
+        @return false when FPGA status was polled, writes alone do not replay the sequence
+    */
+    bool EndRecording(std::vector<uint32_t> &addrs, std::vector<uint32_t> &data);
+    //! Invalidates cached values and bank select, needed after FPGA reset or reprogramming
+    void ClearCache();
+    int WaitPllDone(unsigned timeout_ms);
 protected:
     int SetPllFrequency(uint8_t pllIndex, double inputFreq, FPGA_PLL_clock* outputs, uint8_t clockCount);
     int SetDirectClocking(int clockIndex);
@@ -63,8 +89,32 @@ protected:
 private:
     virtual int ReadRawStreamData(char* buffer, unsigned length, int epIndex, int timeout_ms);
     int SetPllClock(int clockIndex, int nSteps, bool waitLock, uint16_t &reg23val);
+    void BeginWriteBatch();
+    int EndWriteBatch();
+    int FlushWriteBatch();
+
+    //! register 0xFFFF selects chip bank of following accesses, one bit per chip
+    static const uint32_t bankSelectAddr = 0xFFFF;
+    static const unsigned cacheBanks = 8;
+    static const unsigned cacheSize = 0x200;
+    struct CacheBank
+    {
+        uint16_t values[cacheSize];
+        std::bitset<cacheSize> valid;
+    };
     bool useCache;
-    std::map<uint16_t, uint16_t> regsCache;
+    //! last written bank select, outside 16 bits when unknown
+    uint32_t bankSelect;
+    std::vector<CacheBank> regsCache;
+    unsigned writeBatchDepth;
+    std::vector<uint32_t> batchAddrs;
+    std::vector<uint32_t> batchData;
+    bool recording;
+    bool recordPolled;
+    std::vector<uint32_t> recordAddrs;
+    std::vector<uint32_t> recordData;
+    //! guards cache, batch and recording, shared by streamers and API thread
+    std::recursive_mutex mLock;
 };
 
 }
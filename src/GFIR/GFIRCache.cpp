@@ -0,0 +1,215 @@
+/**
+    @file GFIRCache.cpp
+    @author Lime Microsystems
+    @brief Memoized GFIR coefficient design for ConfigureGFIR
+*/
+
+#include "GFIRCache.h"
+#include "lms_gfir.h"
+#include "Logger.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace lime;
+
+static const char* fileHeader = "# LimeSuite GFIR cache v1";
+
+bool GFIRCache::Key::operator<(const Key &other) const
+{
+    if (taps != other.taps)
+        return taps < other.taps;
+    if (ratio != other.ratio)
+        return ratio < other.ratio;
+    if (w1 != other.w1)
+        return w1 < other.w1;
+    return w2 < other.w2;
+}
+
+GFIRCache::GFIRCache() :
+    mHits(0),
+    mMisses(0)
+{
+}
+
+GFIRCache& GFIRCache::Instance()
+{
+    static GFIRCache cache;
+    return cache;
+}
+
+bool GFIRCache::MakeKey(double bandwidth_MHz, double interface_MHz, int hbRatio, Key &key)
+{
+    int div = 1;
+    if (hbRatio != 7)
+        div = (2<<(hbRatio));
+
+    const double w = (bandwidth_MHz/2)/(interface_MHz/div);
+    const int L = div > 8 ? 8 : div;
+
+    double w2 = w*1.1;
+    if (w2 > 0.495)
+    {
+        w2 = w*1.05;
+        if (w2 > 0.495)
+            return false;
+    }
+    key.taps = L*15;
+    key.w1 = w;
+    key.w2 = w2;
+    key.ratio = div;
+    return true;
+}
+
+/** @brief Designs filters and packs them in register order: 8 slots per
+    tap group of which first taps/15 are used
+*/
+void GFIRCache::Design(const Key &key, Entry &entry)
+{
+    const int L = key.taps/15;
+    double coef[120];
+    double coef2[40];
+    GenerateFilter(L*15, key.w1, key.w2, 1.0, 0, coef);
+    GenerateFilter(L*5, key.w1, key.w2, 1.0, 0, coef2);
+
+    int sample = 0;
+    for (int i = 0; i < 15; i++)
+        for (int j = 0; j < 8; j++)
+            entry.gfir1[i*8+j] = (j < L && sample < L*15) ? int16_t(coef[sample++]*32767.0) : 0;
+
+    sample = 0;
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < 8; j++)
+            entry.gfir2[i*8+j] = (j < L && sample < L*5) ? int16_t(coef2[sample++]*32767.0) : 0;
+}
+
+GFIRCache::Entry GFIRCache::Get(const Key &key)
+{
+    {
+        std::lock_guard<std::mutex> lck(mLock);
+        auto iter = mEntries.find(key);
+        if (iter != mEntries.end())
+        {
+            ++mHits;
+            return iter->second;
+        }
+        ++mMisses;
+    }
+    //design outside of lock, concurrent misses of same key produce same result
+    Entry entry;
+    Design(key, entry);
+    std::lock_guard<std::mutex> lck(mLock);
+    if (mEntries.size() >= maxEntries)
+        mEntries.clear();
+    mEntries[key] = entry;
+    return entry;
+}
+
+int GFIRCache::Prebuild(const std::vector<double> &interface_MHz, const std::vector<int> &hbRatios, const std::vector<double> &bandwidths_MHz)
+{
+    int added = 0;
+    for (auto clk : interface_MHz)
+        for (auto ratio : hbRatios)
+            for (auto bw : bandwidths_MHz)
+            {
+                Key key;
+                if (!MakeKey(bw, clk, ratio, key))
+                    continue;
+                const size_t before = Size();
+                Get(key);
+                if (Size() > before)
+                    ++added;
+            }
+    return added;
+}
+
+int GFIRCache::Save(const std::string &filename) const
+{
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == nullptr)
+        return ReportError(errno, "GFIRCache: cannot open %s", filename.c_str());
+    std::lock_guard<std::mutex> lck(mLock);
+    fprintf(file, "%s\n", fileHeader);
+    for (auto &item : mEntries)
+    {
+        //hexadecimal floats keep keys bit exact
+        fprintf(file, "%d %d %a %a", item.first.taps, item.first.ratio, item.first.w1, item.first.w2);
+        for (auto value : item.second.gfir1)
+            fprintf(file, " %d", value);
+        for (auto value : item.second.gfir2)
+            fprintf(file, " %d", value);
+        fprintf(file, "\n");
+    }
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed)
+        return ReportError(EIO, "GFIRCache: failed to write %s", filename.c_str());
+    return 0;
+}
+
+int GFIRCache::Load(const std::string &filename)
+{
+    FILE* file = fopen(filename.c_str(), "r");
+    if (file == nullptr)
+        return ReportError(errno, "GFIRCache: cannot open %s", filename.c_str());
+    char header[64] = {0};
+    if (fgets(header, sizeof(header), file) == nullptr || strncmp(header, fileHeader, strlen(fileHeader)) != 0)
+    {
+        fclose(file);
+        return ReportError(EINVAL, "GFIRCache: %s is not a GFIR cache file", filename.c_str());
+    }
+    std::map<Key, Entry> loaded;
+    Key key;
+    while (fscanf(file, "%d %d %lf %lf", &key.taps, &key.ratio, &key.w1, &key.w2) == 4)
+    {
+        Entry entry;
+        int value;
+        bool valid = key.taps > 0 && key.taps <= 120 && key.taps % 15 == 0;
+        for (int i = 0; i < 160 && valid; ++i)
+        {
+            valid = fscanf(file, "%d", &value) == 1;
+            if (i < 120)
+                entry.gfir1[i] = value;
+            else
+                entry.gfir2[i-120] = value;
+        }
+        if (!valid)
+        {
+            fclose(file);
+            return ReportError(EINVAL, "GFIRCache: corrupted entry in %s", filename.c_str());
+        }
+        loaded[key] = entry;
+    }
+    fclose(file);
+    std::lock_guard<std::mutex> lck(mLock);
+    for (auto &item : loaded)
+        if (mEntries.size() < maxEntries)
+            mEntries.insert(item);
+    return 0;
+}
+
+void GFIRCache::Clear()
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    mEntries.clear();
+    mHits = 0;
+    mMisses = 0;
+}
+
+size_t GFIRCache::Size() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mEntries.size();
+}
+
+uint64_t GFIRCache::GetHits() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mHits;
+}
+
+uint64_t GFIRCache::GetMisses() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mMisses;
+}
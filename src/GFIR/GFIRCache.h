@@ -0,0 +1,85 @@
+/**
+    @file GFIRCache.h
+    @author Lime Microsystems
+    @brief Memoized GFIR coefficient design for ConfigureGFIR
+*/
+
+#ifndef LIME_GFIR_CACHE_H
+#define LIME_GFIR_CACHE_H
+
+#include "LimeSuiteConfig.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace lime
+{
+
+/*!
+ * Keeps GFIR1 and GFIR2/3 register coefficients of every filter designed
+ * in this process, keyed by the exact design inputs. Entries can be
+ * prebuilt for sample rate and bandwidth grids and saved to a text file
+ * with exact (hexadecimal float) keys to be loaded by later sessions.
+ */
+class LIME_API GFIRCache
+{
+public:
+    struct Key
+    {
+        //! GFIR1 taps, GFIR2/3 use one third of them
+        int taps;
+        //! pass band and stop band edges normalized to filter rate
+        double w1;
+        double w2;
+        //! interpolation/decimation ratio of the filter
+        int ratio;
+        bool operator<(const Key &other) const;
+    };
+
+    struct Entry
+    {
+        int16_t gfir1[120];
+        int16_t gfir2[40];
+    };
+
+    static const size_t maxEntries = 4096;
+
+    //! Process wide cache used by LMS7_Device::ConfigureGFIR
+    static GFIRCache& Instance();
+
+    /** @brief Computes design inputs of a low pass filter like ConfigureGFIR
+        @param bandwidth_MHz RF bandwidth
+        @param interface_MHz TSP reference clock
+        @param hbRatio HBI_OVR_TXTSP/HBD_OVR_RXTSP value, 7 - bypass
+        @return false when band edges are too close to Nyquist
+    */
+    static bool MakeKey(double bandwidth_MHz, double interface_MHz, int hbRatio, Key &key);
+    //! Runs least squares design of both filters without caching
+    static void Design(const Key &key, Entry &entry);
+
+    //! Returns cached coefficients, designing and storing them on miss
+    Entry Get(const Key &key);
+    /** @brief Designs filters for every combination of rates and bandwidths
+        @return number of entries added
+    */
+    int Prebuild(const std::vector<double> &interface_MHz, const std::vector<int> &hbRatios, const std::vector<double> &bandwidths_MHz);
+    int Save(const std::string &filename) const;
+    //! Adds entries from file, existing entries are kept
+    int Load(const std::string &filename);
+    void Clear();
+    size_t Size() const;
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+
+private:
+    GFIRCache();
+    mutable std::mutex mLock;
+    std::map<Key, Entry> mEntries;
+    uint64_t mHits;
+    uint64_t mMisses;
+};
+
+}
+#endif // LIME_GFIR_CACHE_H
@@ -9,25 +9,23 @@
 
    AUTHOR:	Lime Microsystems
    DATE:	Feb 24, 2000
-   REVISION:
+   REVISION:	Normal equations built from Toeplitz-plus-Hankel moments
+		and solved by Cholesky factorization, original per element
+		formulation with LU decomposition is kept for results that
+		are too close to a rounding boundary.
    ************************************************************************ */
 #ifdef _MSC_VER
 #define _USE_MATH_DEFINES
 #endif 
 
 #include "lms.h"
-#include "recipes.h"
 #include "rounding.h"
+#include <float.h>
 
 /* Filter parity constants */
 #define EVEN    0
 #define ODD     1
 
-/* Declare functions from Numerical Recipes that are used here */
-double  *vector();
-int  *ivector();
-double  **matrix();
-    
 /* ************************************************************************ 
  *  Trigonometric functions for CASE1, CASE2, CASE3 and CASE4 filters
  *
@@ -58,6 +56,236 @@ double Case4F(double w, int i)
 	return( sin( 2.0*M_PI*w*((double)(i)-0.5)) );
 }
 
+/* ************************************************************************ 
+ *  Cholesky factorization and solution of symmetric positive definite
+ *  system A*x = b. A[n*n] is overwritten by the factor, b by solution.
+ *
+ *  RETURN VALUE:
+ *  0			- if everything is OK
+ *  -1			- if matrix is not positive definite
+ * ************************************************************************ */
+static int cholesky_solve(double *A, double *b, int n)
+{
+	int i, j, k;
+	double sum;
+
+	for(j=0; j<n; j++) {
+		sum = A[j*n+j];
+		for(k=0; k<j; k++) sum -= A[j*n+k]*A[j*n+k];
+		if(sum <= 0.0) return(-1);
+		A[j*n+j] = sqrt(sum);
+		for(i=j+1; i<n; i++) {
+			sum = A[i*n+j];
+			for(k=0; k<j; k++) sum -= A[i*n+k]*A[j*n+k];
+			A[i*n+j] = sum/A[j*n+j];
+		}
+	}
+	/* Forward substitution L*y = b */
+	for(i=0; i<n; i++) {
+		sum = b[i];
+		for(k=0; k<i; k++) sum -= A[i*n+k]*b[k];
+		b[i] = sum/A[i*n+i];
+	}
+	/* Back substitution L'*x = y */
+	for(i=n-1; i>=0; i--) {
+		sum = b[i];
+		for(k=i+1; k<n; k++) sum -= A[k*n+i]*b[k];
+		b[i] = sum/A[i*n+i];
+	}
+	return(0);
+}
+
+/* ************************************************************************ 
+ *  Estimates 2-norm condition number of A from its Cholesky factor F
+ *  (A = F*F') by power iterations on A and on inverse of A.
+ * ************************************************************************ */
+static double condition_estimate(const double *F, int n)
+{
+	int i, k, it;
+	double sum, norm, lmax, lmin;
+	double *v, *u;
+
+	v = (double *) calloc(n, sizeof(double));
+	u = (double *) calloc(n, sizeof(double));
+	if( (v == NULL) || (u == NULL) ) {
+		free(v); free(u);
+		return(1.0/DBL_EPSILON);
+	}
+	lmax = 0.0; lmin = 0.0;
+	for(i=0; i<n; i++) v[i] = 1.0;
+	for(it=0; it<16; it++) {
+		/* u = F'*v, v = F*u */
+		for(i=0; i<n; i++) {
+			sum = 0.0;
+			for(k=i; k<n; k++) sum += F[k*n+i]*v[k];
+			u[i] = sum;
+		}
+		norm = 0.0;
+		for(i=0; i<n; i++) {
+			sum = 0.0;
+			for(k=0; k<=i; k++) sum += F[i*n+k]*u[k];
+			v[i] = sum;
+			norm += sum*sum;
+		}
+		lmax = sqrt(norm);
+		for(i=0; i<n; i++) v[i] /= lmax;
+	}
+	for(i=0; i<n; i++) v[i] = 1.0;
+	for(it=0; it<16; it++) {
+		/* solve F*u = v, F'*v = u */
+		for(i=0; i<n; i++) {
+			sum = v[i];
+			for(k=0; k<i; k++) sum -= F[i*n+k]*u[k];
+			u[i] = sum/F[i*n+i];
+		}
+		norm = 0.0;
+		for(i=n-1; i>=0; i--) {
+			sum = u[i];
+			for(k=i+1; k<n; k++) sum -= F[k*n+i]*v[k];
+			v[i] = sum/F[i*n+i];
+			norm += v[i]*v[i];
+		}
+		norm = sqrt(norm);
+		lmin = 1.0/norm;
+		for(i=0; i<n; i++) v[i] /= norm;
+	}
+	free(v);
+	free(u);
+	return(lmax/lmin);
+}
+
+/* ************************************************************************ 
+ *  LU decomposition and back substitution from Numerical Recipes,
+ *  a[1:n][1:n], indx[1:n], b[1:n].
+ * ************************************************************************ */
+static void ludcmp(double **a, int n, int *indx)
+{
+	int i, imax, j, k;
+	double big, dum, sum, temp;
+	double *vv;
+
+	imax = 0;
+	vv = (double *) malloc((n+1)*sizeof(double));
+	for (i=1;i<=n;i++) {
+		big=0.0;
+		for (j=1;j<=n;j++)
+			if ((temp=fabs(a[i][j])) > big) big=temp;
+		vv[i]=1.0/big;
+	}
+	for (j=1;j<=n;j++) {
+		for (i=1;i<j;i++) {
+			sum=a[i][j];
+			for (k=1;k<i;k++) sum -= a[i][k]*a[k][j];
+			a[i][j]=sum;
+		}
+		big=0.0;
+		for (i=j;i<=n;i++) {
+			sum=a[i][j];
+			for (k=1;k<j;k++)
+				sum -= a[i][k]*a[k][j];
+			a[i][j]=sum;
+			if ((dum=vv[i]*fabs(sum))>=big) {
+				big=dum;
+				imax=i;
+			}
+		}
+		if (j!=imax) {
+			for (k=1;k<=n;k++) {
+				dum=a[imax][k];
+				a[imax][k]=a[j][k];
+				a[j][k]=dum;
+			}
+			vv[imax]=vv[j];
+		}
+		indx[j]=imax;
+		if(fpclassify(a[j][j]) == FP_ZERO) a[j][j]=1.0e-20;
+		if (j!=n) {
+			dum=1.0/(a[j][j]);
+			for (i=j+1;i<=n;i++) a[i][j] *= dum;
+		}
+	}
+	free(vv);
+}
+
+static void lubksb(double **a, int n, int *indx, double *b)
+{
+	int i, ii=0, ip, j;
+	double sum;
+
+	for (i=1;i<=n;i++) {
+		ip=indx[i];
+		sum=b[ip];
+		b[ip]=b[i];
+		if (ii) {
+			for (j=ii;j<=i-1;j++) sum -= a[i][j]*b[j];
+		} else if (sum) {
+			ii=i;
+		}
+		b[i]=sum;
+	}
+	for (i=n;i>=1;i--) {
+		sum=b[i];
+		for (j=i+1;j<=n;j++) sum -= a[i][j]*b[j];
+		b[i]=sum/a[i][i];
+	}
+}
+
+/* ************************************************************************ 
+ *  Original formulation: normal equations summed element by element and
+ *  solved by LU decomposition. Basis values are tabulated once per grid
+ *  point, sums keep the original order so results are bitwise equal.
+ *
+ *  OUTPUT:
+ *  double	x[L]	- Coefficients of Hr(w)
+ *
+ *  RETURN VALUE:
+ *  0			- if everything is OK
+ *  -1			- if memory allocation failed
+ * ************************************************************************ */
+static int lms_lu(double *x, int L, double (*f)(), double *w, double *des,
+	double *weight, int p)
+{
+	double **A, *a, *fw;
+	int *index;
+	int i, j, k;
+	double fwki, fwkj;
+
+	a = (double *) calloc(L+1, sizeof(double));
+	fw = (double *) calloc(L+1, sizeof(double));
+	index = (int *) calloc(L+1, sizeof(int));
+	A = (double **) calloc(L+1, sizeof(double *));
+	if( (a == NULL) || (fw == NULL) || (index == NULL) || (A == NULL) ) {
+		free(a); free(fw); free(index); free(A);
+		return(-1);
+	}
+	for(i=1; i <= L; i++) A[i] = (double *) calloc(L+1, sizeof(double));
+
+	for(k=0; k<p; k++) {
+		for(j=1; j <= L; j++) fw[j] = (f)(w[k], j);
+		for(j=1; j <= L; j++) {
+			fwkj = fw[j];
+			A[j][j] += weight[k]*fwkj*fwkj;
+			a[j] += weight[k]*des[k]*fwkj;
+			for(i=j+1; i <= L; i++) {
+				fwki = fw[i];
+				A[i][j] += weight[k]*fwki*fwkj;
+				A[j][i] += weight[k]*fwkj*fwki;
+			}
+		}
+	}
+
+	ludcmp(A, L, index);
+	lubksb(A, L, index, a);
+	for(i=0; i<L; i++) x[i] = a[i+1];
+
+	for(i=1; i <= L; i++) free(A[i]);
+	free(A);
+	free(a);
+	free(fw);
+	free(index);
+	return(0);
+}
+
 /* ************************************************************************ 
  *	OUTPUT:
  *	double 	hr[n]		- Filter impulse response
@@ -77,6 +305,15 @@ double Case4F(double w, int i)
  *	RETURN VALUE:
  *	0			- if everything is OK
  *	-1			- otherwise
+ *
+ *	All basis functions are cos or sin of 2*pi*w*(i+s), so products
+ *	of two of them only depend on i-j and i+j. Normal matrix is built
+ *	from 2L+1 weighted cosine moments (Toeplitz plus Hankel) instead of
+ *	L*L trigonometric sums, moments and right hand side use Chebyshev
+ *	recurrence, so only four trigonometric calls per grid point remain.
+ *	Both formulations carry rounding errors of order cond(A)*eps, when
+ *	a coefficient lands within that distance of a rounding boundary of
+ *	the integer result, it is recomputed with the original formulation.
  * ************************************************************************ */
 int lms(hr, hi, hcsd, n, w, des, weight, p, cprec, csdprec, symmetry,
 	bincode, csdcode, csdcoder)
@@ -91,20 +328,20 @@ int csdprec;
 int symmetry;
 int **bincode, **csdcode, **csdcoder;
 {
-
-	/* All this is for  solving a linear system */
-	/* of equations by LU decomposition */
-	double **A, d;
-	int *index;
+	double *A;		/* Normal matrix, later its Cholesky factor */
+	double *moment;		/* moment[m] = sum weight*cos(2*pi*w*m) */
 
 	/* Parameters of real function Hr(w) */
 	double *a; 		/* Coefficients */
 	int L;			/* Number of terms in Hr(w) sum */
 	double (*f)();		/* Trigonometric function in Hr(w) */
+	int shift;		/* Basis arguments sum: (i+shift)+(j+shift) */
+	double sign;		/* Sign of sum term: +1 for cos, -1 for sin */
 	
 	int parity;		/* Parity of the filter (ODD or EVEN) */
-	int i, j, k;		/* Loop counters */
-	double fwki, fwkj;	/* Used for equation formulation */
+	int i, j, k, m;		/* Loop counters */
+	double c0, c1, c2, twocos, wd, fk0, fk1, fk2;
+	double hmax, margin, scaled;	/* Rounding boundary check */
 
 	/* Check the correctness of inputs */
 	if( (hr == NULL) || (w == NULL) || 
@@ -123,58 +360,92 @@ int **bincode, **csdcode, **csdcoder;
 
 	/* Find which trigonometric function to use depending on filter type */
 	if( (symmetry == POSITIVE) && (parity == ODD) ) { 		/* Case 1 */
-		f = Case1F; 
+		f = Case1F; shift = -2; sign = 1.0;
 	} else if( (symmetry == POSITIVE) && (parity == EVEN) ) {	/* Case 2 */
-		f = Case2F;
-	} else if( (symmetry == NEGATIVE) && (parity == ODD) ) {	/* Case 2 */
-		f = Case3F;
-	} else if( (symmetry == NEGATIVE) && (parity == EVEN) ) {	/* Case 2 */
-		f = Case4F;
+		f = Case2F; shift = -1; sign = 1.0;
+	} else if( (symmetry == NEGATIVE) && (parity == ODD) ) {	/* Case 3 */
+		f = Case3F; shift = 0; sign = -1.0;
+	} else if( (symmetry == NEGATIVE) && (parity == EVEN) ) {	/* Case 4 */
+		f = Case4F; shift = -1; sign = -1.0;
 	} else {	/* This should never happen but ... */
 		return(-1);
 	}
 
-	/* Allocate memory for a[1:L], A[1:L][1:L] and index[1:L]. */
-	/* Functions from Numerical Recipes are used because I hate  */
-	/* FORTRAN like indexing (starting from 1, not 0). */
-	a = vector(1, L);
-	A = matrix(1, L, 1, L);
-	index = ivector(1, L);
-
-	/* Set A, a and index all to zeroes */
-	for(j=1; j <= L; j++) {
-		a[j] = 0.0;
-		index[j] = 0;
-		for(i=1; i <= L; i++) A[i][j] = 0.0;
+	/* a[0:L-1] holds right hand side, then solution */
+	a = (double *) calloc(L, sizeof(double));
+	A = (double *) calloc(L*L, sizeof(double));
+	moment = (double *) calloc(2*L+1, sizeof(double));
+	if( (a == NULL) || (A == NULL) || (moment == NULL) ) {
+		free(a); free(A); free(moment);
+		return(-1);
 	}
 
-	/* OK, ready to fill up the equations */
+	/* Accumulate moments and right hand side over the grid */
 	for(k=0; k<p; k++) {
-		for(j=1; j <= L; j++) {
-			fwkj = (f)(w[k], j);
-			A[j][j] += weight[k]*fwkj*fwkj;
-			a[j] += weight[k]*des[k]*fwkj;
-			for(i=j+1; i <= L; i++) {
-				fwki = (f)(w[k], i);
-				A[i][j] += weight[k]*fwki*fwkj;
-				A[j][i] += weight[k]*fwkj*fwki;
-			}
+		twocos = 2.0*cos(2.0*M_PI*w[k]);
+		/* cos(2*pi*w*m), m = 0..2L */
+		c0 = 1.0; c1 = 0.5*twocos;
+		moment[0] += weight[k];
+		if(2*L >= 1) moment[1] += weight[k]*c1;
+		for(m=2; m <= 2*L; m++) {
+			c2 = twocos*c1 - c0;
+			moment[m] += weight[k]*c2;
+			c0 = c1; c1 = c2;
+		}
+		/* Basis values f(w, j), j = 1..L, satisfy the same recurrence */
+		wd = weight[k]*des[k];
+		fk0 = (f)(w[k], 0);
+		fk1 = (f)(w[k], 1);
+		a[0] += wd*fk1;
+		for(j=1; j<L; j++) {
+			fk2 = twocos*fk1 - fk0;
+			a[j] += wd*fk2;
+			fk0 = fk1; fk1 = fk2;
 		}
 	}
 
-	/* Solve the equations */
-	ludcmp(A, L, index, &d); 
-	lubksb(A, L, index, a);
+	/* A[i][j] = (moment[|i-j|] +- moment[|i+j+2+shift|])/2, i, j = 0..L-1 */
+	for(i=0; i<L; i++) {
+		for(j=0; j<=i; j++) {
+			m = i+j+2+shift;
+			if(m < 0) m = -m;
+			A[i*L+j] = 0.5*(moment[i-j] + sign*moment[m]);
+			A[j*L+i] = A[i*L+j];
+		}
+	}
 
-	/* Calculate impulse response h[] from a[] */
-	for(i=0; i<n; i++) hr[i] = 0.0;
-	for(i=0; i<L; i++) hr[i] = 0.5*a[L-i];
+	/* Solve the equations, estimate error bound of coefficients */
+	margin = 1.0;
+	if( cholesky_solve(A, a, L) == 0 ) {
+		hmax = 0.0;
+		for(i=0; i<L; i++) if(fabs(a[i]) > hmax) hmax = fabs(a[i]);
+		margin = 4096.0*(condition_estimate(A, L) + p)*DBL_EPSILON*hmax*(1<<cprec);
+	}
+
+	for(j=0; j<2; j++) {
+		/* Calculate impulse response h[] from a[] */
+		for(i=0; i<n; i++) hr[i] = 0.0;
+		for(i=0; i<L; i++) hr[i] = 0.5*a[L-1-i];
+
+		/* Resolve CASE1 for i=L-1 */
+		if((symmetry == POSITIVE) && (parity == ODD)) hr[L-1] = a[0];
 
-	/* Resolve CASE1 for i=L-1 */
-	if((symmetry == POSITIVE) && (parity == ODD)) hr[L-1] = a[1];
+		/* Construct other half of hr[] using symmetry */
+		for(i=0; i<n/2; i++) hr[n-i-1] = symmetry * hr[i];
 
-	/* Construct other half of hr[] using symmetry */
-	for(i=0; i<n/2; i++) hr[n-i-1] = symmetry * hr[i];
+		if(margin == 0.0) break;
+		/* Is any coefficient too close to a rounding boundary? */
+		for(i=0; i<L; i++) {
+			scaled = fabs(hr[i])*(1<<cprec);
+			if( fabs(scaled - floor(scaled) - 0.5) < margin ) break;
+		}
+		if(i == L) break;
+		if( lms_lu(a, L, f, w, des, weight, p) != 0 ) {
+			free(a); free(A); free(moment);
+			return(-1);
+		}
+		margin = 0.0;
+	}
 
 	/* Round the filter coefficients to the nearest integer value */
 	round2int(hr, hi, n, cprec);
@@ -183,9 +454,9 @@ int **bincode, **csdcode, **csdcoder;
 	round2csd(hr, hcsd, n, cprec, csdprec, bincode, csdcode, csdcoder);
 
 	/* Free allocated memory */
-	free_vector(a, 1, L);
-	free_matrix(A, 1, L, 1, L);
-	free_ivector(index, 1, L);
+	free(a);
+	free(A);
+	free(moment);
 
 	/* That's all, let's go home */
 	return(0);
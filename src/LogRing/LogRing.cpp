@@ -0,0 +1,364 @@
+/**
+    @file LogRing.cpp
+    @author Lime Microsystems
+    @brief Lock-free multi-producer log message ring with deferred formatting
+*/
+
+#include "LogRing.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+using namespace lime;
+
+//longest conversion specification kept for deferred formatting
+static const int maxSpecLength = 24;
+
+/** @brief Skips flags, width and precision of conversion at f
+    @param stars receives '*' width and precision count
+*/
+static const char* SkipSpecPrefix(const char* f, int &stars)
+{
+    stars = 0;
+    while (*f && strchr("-+ #0'", *f))
+        ++f;
+    if (*f == '*')
+    {
+        ++stars;
+        ++f;
+    }
+    while (isdigit((unsigned char)*f))
+        ++f;
+    if (*f == '.')
+    {
+        ++f;
+        if (*f == '*')
+        {
+            ++stars;
+            ++f;
+        }
+        while (isdigit((unsigned char)*f))
+            ++f;
+    }
+    return f;
+}
+
+/** @brief Reads length modifier at f
+    @return 'H' - hh, 'q' - ll, modifier character or 0 if none
+*/
+static char ReadLength(const char* &f)
+{
+    if ((f[0] == 'h' || f[0] == 'l') && f[1] == f[0])
+    {
+        const char length = f[0] == 'h' ? 'H' : 'q';
+        f += 2;
+        return length;
+    }
+    if (*f && strchr("hljztL", *f))
+        return *f++;
+    return 0;
+}
+
+bool LogRecord::Capture(LogLevel lvl, const char* format, va_list argList)
+{
+    level = lvl;
+    suppressed = 0;
+    formatted = false;
+    argCount = 0;
+    va_list eager;
+    va_copy(eager, argList);
+
+    size_t used = strlen(format) + 1;
+    bool deferred = used <= textSize;
+    if (deferred)
+        memcpy(text, format, used);
+    for (const char* f = format; deferred && *f; ++f)
+    {
+        if (*f != '%')
+            continue;
+        if (*++f == '%')
+            continue;
+        const char* start = f;
+        int stars;
+        f = SkipSpecPrefix(f, stars);
+        const char length = ReadLength(f);
+        if (f - start > maxSpecLength || argCount + stars + 1 > int(maxArgs))
+        {
+            deferred = false;
+            break;
+        }
+        for (int i = 0; i < stars; ++i)
+        {
+            args[argCount].type = ARG_INT;
+            args[argCount++].i = va_arg(argList, int);
+        }
+        Arg &arg = args[argCount++];
+        switch (*f)
+        {
+        case 'd':
+        case 'i':
+            arg.type = ARG_INT;
+            switch (length)
+            {
+            case 'H': arg.i = (signed char)va_arg(argList, int); break;
+            case 'h': arg.i = (short)va_arg(argList, int); break;
+            case 'l': arg.i = va_arg(argList, long); break;
+            case 'q': arg.i = va_arg(argList, long long); break;
+            case 'j': arg.i = va_arg(argList, intmax_t); break;
+            case 'z':
+            case 't': arg.i = va_arg(argList, ptrdiff_t); break;
+            case 0: arg.i = va_arg(argList, int); break;
+            default: deferred = false; break;
+            }
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            arg.type = ARG_UINT;
+            switch (length)
+            {
+            case 'H': arg.u = (unsigned char)va_arg(argList, unsigned); break;
+            case 'h': arg.u = (unsigned short)va_arg(argList, unsigned); break;
+            case 'l': arg.u = va_arg(argList, unsigned long); break;
+            case 'q': arg.u = va_arg(argList, unsigned long long); break;
+            case 'j': arg.u = va_arg(argList, uintmax_t); break;
+            case 'z':
+            case 't': arg.u = va_arg(argList, size_t); break;
+            case 0: arg.u = va_arg(argList, unsigned); break;
+            default: deferred = false; break;
+            }
+            break;
+        case 'c':
+            arg.type = ARG_INT;
+            arg.i = va_arg(argList, int);
+            deferred = length == 0;
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (length == 'L')
+            {
+                arg.type = ARG_LONG_DOUBLE;
+                arg.ld = va_arg(argList, long double);
+            }
+            else
+            {
+                arg.type = ARG_DOUBLE;
+                arg.d = va_arg(argList, double);
+            }
+            break;
+        case 's':
+        {
+            if (length != 0)
+            {
+                deferred = false;
+                break;
+            }
+            const char* str = va_arg(argList, const char*);
+            if (str == nullptr)
+                str = "(null)";
+            const size_t len = strlen(str) + 1;
+            if (used + len > textSize)
+            {
+                deferred = false;
+                break;
+            }
+            memcpy(text + used, str, len);
+            arg.type = ARG_STRING;
+            arg.offset = used;
+            used += len;
+            break;
+        }
+        case 'p':
+            arg.type = ARG_POINTER;
+            arg.p = va_arg(argList, const void*);
+            break;
+        default: //%n, wide strings and malformed formats
+            deferred = false;
+            break;
+        }
+        if (*f == 0)
+            break;
+    }
+
+    bool fits = true;
+    if (!deferred)
+    {
+        formatted = true;
+        argCount = 0;
+        const int len = vsnprintf(text, textSize, format, eager);
+        fits = len >= 0 && len < int(textSize);
+        used = fits ? len + 1 : textSize;
+    }
+    textUsed = used;
+    va_end(eager);
+    return fits;
+}
+
+uint32_t LogRecord::Key() const
+{
+    //FNV-1a
+    uint32_t hash = 2166136261u;
+    for (unsigned i = 0; i < textUsed; ++i)
+        hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+    return hash;
+}
+
+template<typename T>
+static int PrintArg(char* buffer, size_t size, const char* spec, const int* stars, int starCount, T value)
+{
+    switch (starCount)
+    {
+    case 0: return snprintf(buffer, size, spec, value);
+    case 1: return snprintf(buffer, size, spec, stars[0], value);
+    default: return snprintf(buffer, size, spec, stars[0], stars[1], value);
+    }
+}
+
+int LogRecord::Format(char* buffer, size_t size) const
+{
+    if (formatted)
+        return snprintf(buffer, size, "%s", text);
+
+    size_t pos = 0;
+    unsigned argIndex = 0;
+    for (const char* f = text; *f; )
+    {
+        char* dst = pos < size ? buffer + pos : nullptr;
+        const size_t avail = pos < size ? size - pos : 0;
+        if (*f != '%' || f[1] == '%')
+        {
+            if (avail > 1)
+                *dst = *f;
+            f += *f == '%' ? 2 : 1;
+            ++pos;
+            continue;
+        }
+        //rebuild specification with length of stored argument
+        const char* start = f;
+        int starCount;
+        f = SkipSpecPrefix(f + 1, starCount);
+        char spec[maxSpecLength + 8];
+        size_t specLen = f - start;
+        memcpy(spec, start, specLen);
+        ReadLength(f);
+        const char conv = *f++;
+        int stars[2] = {0, 0};
+        for (int i = 0; i < starCount; ++i)
+            stars[i] = args[argIndex++].i;
+        const Arg &arg = args[argIndex++];
+        if ((arg.type == ARG_INT && conv != 'c') || arg.type == ARG_UINT)
+        {
+            spec[specLen++] = 'l';
+            spec[specLen++] = 'l';
+        }
+        else if (arg.type == ARG_LONG_DOUBLE)
+            spec[specLen++] = 'L';
+        spec[specLen++] = conv;
+        spec[specLen] = 0;
+
+        int len = 0;
+        switch (arg.type)
+        {
+        case ARG_INT:
+            len = conv == 'c' ? PrintArg(dst, avail, spec, stars, starCount, int(arg.i))
+                              : PrintArg(dst, avail, spec, stars, starCount, arg.i);
+            break;
+        case ARG_UINT: len = PrintArg(dst, avail, spec, stars, starCount, arg.u); break;
+        case ARG_DOUBLE: len = PrintArg(dst, avail, spec, stars, starCount, arg.d); break;
+        case ARG_LONG_DOUBLE: len = PrintArg(dst, avail, spec, stars, starCount, arg.ld); break;
+        case ARG_POINTER: len = PrintArg(dst, avail, spec, stars, starCount, arg.p); break;
+        case ARG_STRING: len = PrintArg(dst, avail, spec, stars, starCount, text + arg.offset); break;
+        }
+        if (len > 0)
+            pos += len;
+    }
+    if (size > 0)
+        buffer[pos < size ? pos : size - 1] = 0;
+    return pos;
+}
+
+void LogRecord::CopyTo(LogRecord &dest) const
+{
+    dest.level = level;
+    dest.suppressed = suppressed;
+    dest.formatted = formatted;
+    dest.argCount = argCount;
+    dest.textUsed = textUsed;
+    memcpy(dest.args, args, argCount * sizeof(Arg));
+    memcpy(dest.text, text, textUsed);
+}
+
+LogRing::LogRing(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    mSlots.reset(new Slot[size]);
+    mMask = size - 1;
+    for (size_t i = 0; i < size; ++i)
+        mSlots[i].seq.store(i, std::memory_order_relaxed);
+    mEnqueuePos.store(0, std::memory_order_relaxed);
+    mDequeuePos.store(0, std::memory_order_release);
+}
+
+LogRecord* LogRing::Reserve(size_t &ticket)
+{
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Slot &slot = mSlots[pos & mMask];
+        const size_t seq = slot.seq.load(std::memory_order_acquire);
+        const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+        if (diff == 0)
+        {
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                ticket = pos;
+                return &slot.record;
+            }
+        }
+        else if (diff < 0) //consumer has not released slot yet
+            return nullptr;
+        else
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+    }
+}
+
+void LogRing::Publish(size_t ticket)
+{
+    mSlots[ticket & mMask].seq.store(ticket + 1, std::memory_order_release);
+}
+
+const LogRecord* LogRing::Front()
+{
+    const size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    Slot &slot = mSlots[pos & mMask];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1)
+        return nullptr;
+    return &slot.record;
+}
+
+void LogRing::Pop()
+{
+    const size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    mSlots[pos & mMask].seq.store(pos + mMask + 1, std::memory_order_release);
+    mDequeuePos.store(pos + 1, std::memory_order_release);
+}
+
+size_t LogRing::Reserved() const
+{
+    return mEnqueuePos.load(std::memory_order_acquire);
+}
+
+size_t LogRing::Popped() const
+{
+    return mDequeuePos.load(std::memory_order_acquire);
+}
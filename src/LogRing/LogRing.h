@@ -0,0 +1,118 @@
+/**
+    @file LogRing.h
+    @author Lime Microsystems
+    @brief Lock-free multi-producer log message ring with deferred formatting
+*/
+
+#ifndef LIME_LOG_RING_H
+#define LIME_LOG_RING_H
+
+#include "Logger.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <cstdarg>
+#include <atomic>
+#include <memory>
+
+namespace lime
+{
+
+/*!
+ * Log message with its printf arguments captured, formatting is left to
+ * the thread that prints it. Format string and string arguments are
+ * copied, because callers pass transient buffers as formats. Messages
+ * with unsupported conversions, too many arguments or too much text are
+ * formatted when captured instead.
+ */
+struct LogRecord
+{
+    static const unsigned maxArgs = 8;
+    static const unsigned textSize = 480;
+
+    enum ArgType : uint8_t
+    {
+        ARG_INT,
+        ARG_UINT,
+        ARG_DOUBLE,
+        ARG_LONG_DOUBLE,
+        ARG_POINTER,
+        //! text offset of copied string
+        ARG_STRING,
+    };
+
+    struct Arg
+    {
+        union
+        {
+            long long i;
+            unsigned long long u;
+            double d;
+            long double ld;
+            const void* p;
+            uint16_t offset;
+        };
+        ArgType type;
+    };
+
+    LogLevel level;
+    //! messages of same key suppressed before this one
+    uint32_t suppressed;
+    //! false - text is format followed by string arguments
+    bool formatted;
+    uint8_t argCount;
+    uint16_t textUsed;
+    Arg args[maxArgs];
+    char text[textSize];
+
+    /** @brief Copies format and arguments, formats immediately if needed
+        @return false if message does not fit record, argList is consumed
+    */
+    bool Capture(LogLevel lvl, const char* format, va_list argList);
+    /** @brief Hash of format and string arguments, numbers are ignored, so
+        repeats of a message with changing values share rate limit
+    */
+    uint32_t Key() const;
+    /** @brief Writes message text to buffer
+        @return length of message, may exceed size like snprintf
+    */
+    int Format(char* buffer, size_t size) const;
+    //! Copies only used part of record
+    void CopyTo(LogRecord &dest) const;
+};
+
+/*!
+ * Bounded multi-producer single-consumer queue of log records (sequence
+ * numbered slots). Producers never block, full ring rejects messages.
+ */
+class LogRing
+{
+public:
+    //! capacity is rounded up to power of two
+    explicit LogRing(size_t capacity);
+
+    //! Reserves slot for producer, nullptr when ring is full
+    LogRecord* Reserve(size_t &ticket);
+    //! Makes reserved record visible to consumer
+    void Publish(size_t ticket);
+    //! Oldest published record, nullptr when empty, consumer only
+    const LogRecord* Front();
+    //! Releases record returned by Front()
+    void Pop();
+    //! Messages reserved so far, consumer is done when Popped() reaches it
+    size_t Reserved() const;
+    size_t Popped() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        LogRecord record;
+    };
+    std::unique_ptr<Slot[]> mSlots;
+    size_t mMask;
+    std::atomic<size_t> mEnqueuePos;
+    std::atomic<size_t> mDequeuePos;
+};
+
+}
+#endif // LIME_LOG_RING_H
@@ -5,8 +5,12 @@
 */
 
 #include "Logger.h"
+#include "LogRing.h"
 #include <cstdio>
 #include <cstring> //strerror
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 
 #ifdef _MSC_VER
@@ -67,18 +71,306 @@ static void defaultLogHandler(const lime::LogLevel level, const char *message)
     fprintf(stderr, "%s\n", message);
 }
 
-static lime::LogHandler logHandler(&defaultLogHandler);
+static std::atomic<lime::LogHandler> logHandler(&defaultLogHandler);
 
-void lime::log(const LogLevel level, const char *format, va_list argList)
+//messages waiting for drain thread
+static const size_t logRingSize = 1024;
+static std::atomic<bool> asyncEnabled(false);
+//set when drain thread is gone at exit, later messages are delivered synchronously
+static std::atomic<bool> asyncShutdown(false);
+static std::atomic<uint64_t> queuedCount(0);
+static std::atomic<uint64_t> droppedCount(0);
+static std::atomic<uint64_t> suppressedCount(0);
+
+static std::atomic<unsigned> rateLimitBurst(0);
+static std::atomic<int64_t> rateLimitPeriod(1000000); //us
+
+//rate limit state of message keys, key 0 marks free entry
+struct RateLimitEntry
+{
+    std::atomic<uint32_t> key;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> suppressed;
+    std::atomic<int64_t> windowStart;
+};
+static const unsigned rateLimitSlots = 256;
+//entries probed from key home slot before giving up
+static const unsigned rateLimitProbes = 4;
+static RateLimitEntry rateLimits[rateLimitSlots];
+
+//! Errors and warnings are never suppressed or dropped
+static bool IsDroppable(const lime::LogLevel level)
+{
+    return level > lime::LOG_LEVEL_WARNING;
+}
+
+/** @brief Finds entry of key among probed entries, new key claims free or expired one
+    Entries of keys still within their window are never taken over, so
+    colliding keys do not reset each other's counts.
+    @return entry of key, nullptr when all probed entries are in use
+*/
+static RateLimitEntry* FindRateLimitEntry(uint32_t key, const int64_t now, const int64_t period)
+{
+    if (key == 0)
+        key = 1;
+    const unsigned home = key ^ (key >> 8) ^ (key >> 16) ^ (key >> 24);
+    RateLimitEntry* oldest = nullptr;
+    for (unsigned i = 0; i < rateLimitProbes; ++i)
+    {
+        RateLimitEntry &entry = rateLimits[(home + i) % rateLimitSlots];
+        uint32_t owner = entry.key.load(std::memory_order_relaxed);
+        if (owner == 0)
+        {
+            entry.windowStart.store(now, std::memory_order_relaxed);
+            if (entry.key.compare_exchange_strong(owner, key, std::memory_order_relaxed))
+                return &entry;
+        }
+        if (owner == key)
+            return &entry;
+        if (oldest == nullptr || entry.windowStart.load(std::memory_order_relaxed) < oldest->windowStart.load(std::memory_order_relaxed))
+            oldest = &entry;
+    }
+    uint32_t owner = oldest->key.load(std::memory_order_relaxed);
+    if (now - oldest->windowStart.load(std::memory_order_relaxed) < period
+        || !oldest->key.compare_exchange_strong(owner, key, std::memory_order_relaxed))
+        return nullptr;
+    oldest->count.store(0, std::memory_order_relaxed);
+    oldest->suppressed.store(0, std::memory_order_relaxed);
+    oldest->windowStart.store(now, std::memory_order_relaxed);
+    return oldest;
+}
+
+/** @brief Counts message against limit of its key
+    @return -1 if message is suppressed, otherwise number of suppressed repeats before it
+*/
+static int CheckRateLimit(const lime::LogLevel level, uint32_t key)
 {
+    const unsigned burst = rateLimitBurst.load(std::memory_order_relaxed);
+    if (burst == 0 || !IsDroppable(level))
+        return 0;
+    const int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    RateLimitEntry* found = FindRateLimitEntry(key, now, rateLimitPeriod.load(std::memory_order_relaxed));
+    if (found == nullptr)
+        return 0;
+    RateLimitEntry &entry = *found;
+    int64_t start = entry.windowStart.load(std::memory_order_relaxed);
+    if (now - start >= rateLimitPeriod.load(std::memory_order_relaxed)
+        && entry.windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed))
+        entry.count.store(0, std::memory_order_relaxed);
+    if (entry.count.fetch_add(1, std::memory_order_relaxed) < burst)
+        return entry.suppressed.exchange(0, std::memory_order_relaxed);
+    entry.suppressed.fetch_add(1, std::memory_order_relaxed);
+    suppressedCount.fetch_add(1, std::memory_order_relaxed);
+    return -1;
+}
+
+static void Deliver(const lime::LogLevel level, char* message, size_t size, int len, uint32_t suppressed)
+{
+    if (suppressed > 0 && len >= 0 && size_t(len) < size)
+        snprintf(message + len, size - len, " (%u similar messages suppressed)", suppressed);
+    logHandler.load()(level, message);
+}
+
+/** @brief Formats message and calls handler on calling thread
+*/
+static void SyncLog(const lime::LogLevel level, const char *format, va_list argList)
+{
+    va_list args;
+    va_copy(args, argList);
+    lime::LogRecord record;
     char buff[4096];
-    int ret = vsnprintf(buff, sizeof(buff), format, argList);
-    if (ret > 0) logHandler(level, buff);
+    int len;
+    int suppressed = 0;
+    if (record.Capture(level, format, argList))
+    {
+        suppressed = CheckRateLimit(level, record.Key());
+        len = suppressed < 0 ? 0 : record.Format(buff, sizeof(buff));
+    }
+    else
+    {
+        len = vsnprintf(buff, sizeof(buff), format, args);
+        uint32_t key = 2166136261u;
+        for (const char* c = buff; *c; ++c)
+            key = (key ^ (uint8_t)*c) * 16777619u;
+        suppressed = CheckRateLimit(level, key);
+    }
+    va_end(args);
+    if (len > 0 && suppressed >= 0)
+        Deliver(level, buff, sizeof(buff), len, suppressed);
+}
+
+/*!
+ * Owns log ring and thread that formats queued messages and calls log
+ * handler. Created by first asynchronous message.
+ */
+class AsyncLog
+{
+public:
+    AsyncLog() : ring(logRingSize), terminate(false), reportedDrops(0)
+    {
+        thread = std::thread(&AsyncLog::DrainLoop, this);
+    }
+
+    ~AsyncLog()
+    {
+        asyncShutdown.store(true);
+        terminate.store(true);
+#ifdef _WIN32
+        //threads are already terminated when DLL static objects are destroyed
+        thread.detach();
+#else
+        thread.join();
+#endif
+        Drain();
+    }
+
+    bool IsDrainThread() const
+    {
+        return std::this_thread::get_id() == thread.get_id();
+    }
+
+    /** @brief Delivers all published messages
+        @return number of messages taken from ring
+    */
+    size_t Drain()
+    {
+        size_t count = 0;
+        const lime::LogRecord* record;
+        while ((record = ring.Front()) != nullptr)
+        {
+            char buff[4096];
+            const int len = record->Format(buff, sizeof(buff));
+            if (len > 0)
+                Deliver(record->level, buff, sizeof(buff), len, record->suppressed);
+            ring.Pop();
+            ++count;
+        }
+        const uint64_t drops = droppedCount.load(std::memory_order_relaxed);
+        if (drops != reportedDrops)
+        {
+            char buff[128];
+            const int len = snprintf(buff, sizeof(buff), "Log ring full, %llu messages dropped", (unsigned long long)(drops - reportedDrops));
+            reportedDrops = drops;
+            Deliver(lime::LOG_LEVEL_WARNING, buff, sizeof(buff), len, 0);
+        }
+        return count;
+    }
+
+    lime::LogRing ring;
+
+private:
+    void DrainLoop()
+    {
+        while (!terminate.load(std::memory_order_relaxed))
+            if (Drain() == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    std::thread thread;
+    std::atomic<bool> terminate;
+    uint64_t reportedDrops;
+};
+
+static std::atomic<AsyncLog*> asyncInstance(nullptr);
+
+static AsyncLog& GetAsyncLog()
+{
+    static AsyncLog async;
+    asyncInstance.store(&async, std::memory_order_release);
+    return async;
+}
+
+void lime::log(const LogLevel level, const char *format, va_list argList)
+{
+#ifdef NDEBUG
+    //dropped by default handler anyway
+    if (level == LOG_LEVEL_DEBUG && logHandler.load(std::memory_order_relaxed) == &defaultLogHandler)
+        return;
+#endif
+    if (level == LOG_LEVEL_CRITICAL || !asyncEnabled.load(std::memory_order_relaxed)
+        || asyncShutdown.load(std::memory_order_relaxed))
+        return SyncLog(level, format, argList);
+
+    AsyncLog &async = GetAsyncLog();
+    //handler logging from drain thread would wait for itself
+    if (async.IsDrainThread())
+        return SyncLog(level, format, argList);
+    va_list args;
+    va_copy(args, argList);
+    //staged on stack, suppressed messages do not take ring slots
+    LogRecord staged;
+    if (!staged.Capture(level, format, argList))
+    {
+        //long messages do not fit ring records
+        SyncLog(level, format, args);
+        va_end(args);
+        return;
+    }
+    va_end(args);
+    const int suppressed = CheckRateLimit(level, staged.Key());
+    if (suppressed < 0)
+        return;
+    staged.suppressed = suppressed;
+    size_t ticket;
+    LogRecord* record = async.ring.Reserve(ticket);
+    if (record == nullptr)
+    {
+        if (IsDroppable(level))
+        {
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        //ring full, errors and warnings are delivered on logging thread
+        char buff[4096];
+        const int len = staged.Format(buff, sizeof(buff));
+        if (len > 0)
+            Deliver(level, buff, sizeof(buff), len, suppressed);
+        return;
+    }
+    staged.CopyTo(*record);
+    async.ring.Publish(ticket);
+    queuedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void lime::flushLog()
+{
+    AsyncLog* async = asyncInstance.load(std::memory_order_acquire);
+    if (async == nullptr || asyncShutdown.load() || async->IsDrainThread())
+        return;
+    const size_t target = async->ring.Reserved();
+    //bounded wait, handler may be blocked by caller
+    for (int i = 0; i < 1000 && async->ring.Popped() < target; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void lime::setAsyncLogging(bool enable)
+{
+    if (!enable)
+        flushLog();
+    asyncEnabled.store(enable);
+}
+
+void lime::setLogRateLimit(unsigned burst, double period)
+{
+    rateLimitBurst.store(burst);
+    rateLimitPeriod.store(int64_t(period * 1e6));
+}
+
+lime::LogStats lime::getLogStats()
+{
+    LogStats stats;
+    stats.queued = queuedCount.load(std::memory_order_relaxed);
+    stats.dropped = droppedCount.load(std::memory_order_relaxed);
+    stats.suppressed = suppressedCount.load(std::memory_order_relaxed);
+    return stats;
 }
 
 void lime::registerLogHandler(const LogHandler handler)
 {
-    logHandler = handler ? handler : defaultLogHandler;
+    //queued messages go to handler that was registered when they were logged
+    flushLog();
+    logHandler.store(handler ? handler : defaultLogHandler);
 }
 
 const char *lime::logLevelToName(const LogLevel level)
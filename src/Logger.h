@@ -9,6 +9,7 @@
 
 #include "LimeSuiteConfig.h"
 #include <string>
+#include <stdint.h>
 #include <cstdarg>
 #include <cerrno>
 #include <stdexcept>
@@ -65,6 +66,40 @@ LIME_API void registerLogHandler(const LogHandler handler);
 //! Convert log level to a string name for printing
 LIME_API const char *logLevelToName(const LogLevel level);
 
+/*!
+ * Enable delivery of messages to log handler from a background thread
+ * (off by default). Logging threads only copy format and arguments to a
+ * lock-free ring, formatting and handler calls happen on the drain thread,
+ * so slow handlers do not stall streaming threads. The handler must then
+ * be thread-safe: critical messages, messages too long for the ring and
+ * errors or warnings that find the ring full are still delivered on the
+ * logging thread. Only info and debug messages are dropped when full.
+ */
+LIME_API void setAsyncLogging(bool enable);
+
+//! Wait until queued messages were passed to log handler
+LIME_API void flushLog();
+
+/*!
+ * Limit repeats of an info or debug message (same format and string
+ * arguments) to burst messages per period seconds. Number of suppressed
+ * repeats is appended to the next delivered repeat. Errors and warnings
+ * are never limited. Burst of 0 disables limiting (default).
+ */
+LIME_API void setLogRateLimit(unsigned burst, double period);
+
+//! Counters of logging backend since start
+struct LogStats
+{
+    //! messages passed to log ring
+    uint64_t queued;
+    //! info and debug messages lost because log ring was full
+    uint64_t dropped;
+    //! messages suppressed by rate limit
+    uint64_t suppressed;
+};
+LIME_API LogStats getLogStats();
+
 }
 
 static inline void lime::log(const LogLevel level, const char *format, ...)
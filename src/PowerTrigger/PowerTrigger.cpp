@@ -0,0 +1,250 @@
+/**
+    @file PowerTrigger.cpp
+    @author Lime Microsystems
+    @brief RX power trigger delivering only windows around bursts to stream FIFO
+*/
+
+#include "PowerTrigger.h"
+#include "fifo.h"
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lime;
+
+PowerTrigger::Config::Config() :
+    level(-30.0f),
+    hysteresis(3.0f),
+    average(32),
+    preTrigger(1024),
+    postTrigger(1024)
+{
+}
+
+PowerTrigger::PowerTrigger(const Config &config, float fullScale, uint32_t packetSize) :
+    mConfig(config),
+    mOut(packetSize),
+    mPacketSize(packetSize),
+    mWindows(0),
+    mDelivered(0),
+    mDropped(0)
+{
+    if (mConfig.average == 0)
+        mConfig.average = 1;
+    //thresholds of power sum, avoids division per sample
+    const double scale = double(fullScale) * fullScale * mConfig.average;
+    mOnSum = scale * std::pow(10.0, mConfig.level / 10.0);
+    mOffSum = scale * std::pow(10.0, (mConfig.level - mConfig.hysteresis) / 10.0);
+    mPowers.resize(mConfig.average);
+    mPre.resize(mConfig.preTrigger);
+    Reset();
+}
+
+void PowerTrigger::Reset()
+{
+    std::fill(mPowers.begin(), mPowers.end(), 0);
+    mPowerPos = 0;
+    mPowerSum = 0;
+    mPrePos = 0;
+    mPreCount = 0;
+    mOpen = false;
+    mHold = 0;
+    mExpected = ~uint64_t(0);
+    mOut.last = 0;
+}
+
+PowerTrigger::Stats PowerTrigger::GetStats() const
+{
+    Stats stats;
+    stats.windows = mWindows.load(std::memory_order_relaxed);
+    stats.samplesDelivered = mDelivered.load(std::memory_order_relaxed);
+    stats.samplesDropped = mDropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/** @brief I*I+Q*Q of every sample
+*/
+static void SamplePowers(const complex16_t* samples, uint32_t count, uint32_t* powers)
+{
+    uint32_t i = 0;
+#ifdef __SSE2__
+    //pairwise multiply-add of interleaved I/Q gives power of 4 samples at once
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(samples + i));
+        _mm_storeu_si128((__m128i*)(powers + i), _mm_madd_epi16(x, x));
+    }
+#endif
+    for (; i < count; ++i)
+        powers[i] = int32_t(samples[i].i) * samples[i].i + int32_t(samples[i].q) * samples[i].q;
+}
+
+/** @brief Adds samples to current output packet, full packet is pushed when more samples follow
+*/
+void PowerTrigger::Append(const complex16_t* samples, uint32_t count, uint64_t timestamp, RingFIFO* fifo)
+{
+    mDelivered.fetch_add(count, std::memory_order_relaxed);
+    while (count > 0)
+    {
+        if (mOut.last == mPacketSize)
+        {
+            mOut.flags = 0;
+            fifo->push_packet(mOut);
+            mOut.last = 0;
+        }
+        if (mOut.last == 0)
+            mOut.timestamp = timestamp;
+        const uint32_t cnt = std::min(count, mPacketSize - mOut.last);
+        memcpy(mOut.samples + mOut.last, samples, cnt * sizeof(complex16_t));
+        mOut.last += cnt;
+        samples += cnt;
+        timestamp += cnt;
+        count -= cnt;
+    }
+}
+
+void PowerTrigger::EndWindow(RingFIFO* fifo)
+{
+    mOpen = false;
+    mPreCount = 0;
+    if (mOut.last == 0)
+        return;
+    mOut.flags = RingFIFO::END_BURST;
+    fifo->push_packet(mOut);
+    mOut.last = 0;
+}
+
+/** @brief Keeps last preTrigger samples of idle stream
+*/
+void PowerTrigger::Remember(const complex16_t* samples, uint32_t count)
+{
+    const uint32_t size = mConfig.preTrigger;
+    if (size == 0 || count == 0)
+        return;
+    if (count >= size)
+    {
+        memcpy(mPre.data(), samples + count - size, size * sizeof(complex16_t));
+        mPrePos = 0;
+        mPreCount = size;
+        return;
+    }
+    const uint32_t first = std::min(count, size - mPrePos);
+    memcpy(&mPre[mPrePos], samples, first * sizeof(complex16_t));
+    memcpy(mPre.data(), samples + first, (count - first) * sizeof(complex16_t));
+    mPrePos = (mPrePos + count) % size;
+    mPreCount = std::min(size, mPreCount + count);
+}
+
+void PowerTrigger::Process(const SamplesPacket &packet, RingFIFO* fifo)
+{
+    const uint32_t count = packet.last;
+    const complex16_t* samples = packet.samples;
+    uint64_t dropped = 0;
+    //lost packets break pre-trigger history and open window
+    if (packet.timestamp != mExpected)
+    {
+        if (mOpen)
+            EndWindow(fifo);
+        std::fill(mPowers.begin(), mPowers.end(), 0);
+        mPowerSum = 0;
+        dropped += mPreCount;
+        mPreCount = 0;
+    }
+    mExpected = packet.timestamp + count;
+    if (mPacketPowers.size() < count)
+        mPacketPowers.resize(count);
+    const uint32_t* powers = mPacketPowers.data();
+    SamplePowers(samples, count, mPacketPowers.data());
+
+    const uint32_t average = mConfig.average;
+    uint32_t n = 0;
+    uint32_t idleFrom = 0;
+    while (n < count)
+    {
+        bool fired = false;
+        if (!mOpen)
+        {
+            for (; n < count; ++n)
+            {
+                mPowerSum += powers[n];
+                mPowerSum -= mPowers[mPowerPos];
+                mPowers[mPowerPos] = powers[n];
+                mPowerPos = mPowerPos + 1 == average ? 0 : mPowerPos + 1;
+                if (mPowerSum >= mOnSum)
+                    break;
+            }
+            if (n == count)
+                break;
+
+            //pre-trigger samples from history ring and this packet
+            const uint32_t size = mConfig.preTrigger;
+            const uint32_t fromPacket = std::min(n - idleFrom, size);
+            const uint32_t fromRing = std::min(size - fromPacket, mPreCount);
+            const uint64_t timestamp = packet.timestamp + n - fromPacket - fromRing;
+            if (fromRing > 0)
+            {
+                const uint32_t start = (mPrePos + size - fromRing) % size;
+                const uint32_t first = std::min(fromRing, size - start);
+                Append(&mPre[start], first, timestamp, fifo);
+                Append(mPre.data(), fromRing - first, timestamp + first, fifo);
+            }
+            Append(samples + n - fromPacket, fromPacket, packet.timestamp + n - fromPacket, fifo);
+            dropped += n - idleFrom - fromPacket + mPreCount - fromRing;
+            mPreCount = 0;
+            mOpen = true;
+            mHold = mConfig.postTrigger;
+            mWindows.fetch_add(1, std::memory_order_relaxed);
+            fired = true;
+        }
+
+        const uint32_t start = n;
+        bool closed = false;
+        for (; n < count; ++n)
+        {
+            //power of triggering sample is already in the average
+            if (n != start || !fired)
+            {
+                mPowerSum += powers[n];
+                mPowerSum -= mPowers[mPowerPos];
+                mPowers[mPowerPos] = powers[n];
+                mPowerPos = mPowerPos + 1 == average ? 0 : mPowerPos + 1;
+            }
+            if (mPowerSum >= mOffSum)
+                mHold = mConfig.postTrigger;
+            else if (mHold == 0)
+            {
+                closed = true;
+                ++n;
+                break;
+            }
+            else
+                --mHold;
+        }
+        Append(samples + start, n - start, packet.timestamp + start, fifo);
+        if (closed)
+        {
+            EndWindow(fifo);
+            idleFrom = n;
+        }
+    }
+
+    if (!mOpen)
+    {
+        //samples leaving history ring are never delivered
+        const uint32_t idle = count - idleFrom;
+        const uint64_t history = uint64_t(mPreCount) + idle;
+        dropped += history - std::min<uint64_t>(history, mConfig.preTrigger);
+        Remember(samples + idleFrom, idle);
+    }
+    else if (mOut.last == mPacketSize)
+    {
+        //window continues, do not hold full packet back
+        mOut.flags = 0;
+        fifo->push_packet(mOut);
+        mOut.last = 0;
+    }
+    mDropped.fetch_add(dropped, std::memory_order_relaxed);
+}
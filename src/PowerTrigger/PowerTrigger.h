@@ -0,0 +1,96 @@
+/**
+    @file PowerTrigger.h
+    @author Lime Microsystems
+    @brief RX power trigger delivering only windows around bursts to stream FIFO
+*/
+
+#ifndef LIME_POWER_TRIGGER_H
+#define LIME_POWER_TRIGGER_H
+
+#include "LimeSuiteConfig.h"
+#include "dataTypes.h"
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+
+namespace lime
+{
+
+class RingFIFO;
+
+/*!
+ * Runs in RX thread on every unpacked packet of one channel. Moving
+ * average power is compared with on/off thresholds (hysteresis), only
+ * windows from preTrigger samples before the on crossing until
+ * postTrigger samples after power stays under off level are pushed to
+ * stream FIFO with their hardware timestamps. Last packet of every window
+ * carries END_BURST, so reads stop at window end. Idle samples only pass
+ * the power average and a copy of the last preTrigger samples.
+ */
+class LIME_API PowerTrigger
+{
+public:
+    struct Config
+    {
+        Config();
+        //! window starts when average power reaches this level, dBFS
+        float level;
+        //! window may end when average power drops this much under level, dB
+        float hysteresis;
+        //! samples in moving average of power
+        uint32_t average;
+        //! samples delivered before the trigger
+        uint32_t preTrigger;
+        //! samples delivered after power dropped under off level
+        uint32_t postTrigger;
+    };
+
+    struct Stats
+    {
+        uint64_t windows;
+        uint64_t samplesDelivered;
+        uint64_t samplesDropped;
+    };
+
+    /** @param fullScale sample value of 0 dBFS
+        @param packetSize sample capacity of FIFO packets
+    */
+    PowerTrigger(const Config &config, float fullScale, uint32_t packetSize);
+
+    //! Forgets power history and open window, used when stream restarts
+    void Reset();
+    //! Evaluates packet and pushes triggered samples to fifo, RX thread only
+    void Process(const SamplesPacket &packet, RingFIFO* fifo);
+    Stats GetStats() const;
+
+private:
+    void Append(const complex16_t* samples, uint32_t count, uint64_t timestamp, RingFIFO* fifo);
+    void EndWindow(RingFIFO* fifo);
+    void Remember(const complex16_t* samples, uint32_t count);
+
+    Config mConfig;
+    //! threshold of power sum over average window
+    double mOnSum;
+    double mOffSum;
+    //! power of last average samples, ring
+    std::vector<uint32_t> mPowers;
+    uint32_t mPowerPos;
+    uint64_t mPowerSum;
+    //! scratch powers of current packet
+    std::vector<uint32_t> mPacketPowers;
+    //! last preTrigger samples before current packet, ring
+    std::vector<complex16_t> mPre;
+    uint32_t mPrePos;
+    uint32_t mPreCount;
+    bool mOpen;
+    uint32_t mHold;
+    uint64_t mExpected;
+    SamplesPacket mOut;
+    uint32_t mPacketSize;
+    std::atomic<uint64_t> mWindows;
+    std::atomic<uint64_t> mDelivered;
+    std::atomic<uint64_t> mDropped;
+};
+
+}
+#endif // LIME_POWER_TRIGGER_H
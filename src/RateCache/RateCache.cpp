@@ -0,0 +1,258 @@
+/**
+    @file RateCache.cpp
+    @author Lime Microsystems
+    @brief Replayable results of sample rate changes for LMS7_Device::SetRate
+*/
+
+#include "RateCache.h"
+#include "LMS7002M.h"
+#include "Logger.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
+
+using namespace lime;
+
+static const char* fileHeader = "# LimeSuite rate cache v1";
+
+//LML clock muxes and dividers, CGEN configuration and CSW
+const uint16_t RateCache::globalRegs[globalRegCount] = {0x002A, 0x002B, 0x002C, 0x0086, 0x0087, 0x0088, 0x0089, 0x008B};
+//HBI_OVR_TXTSP, HBD_OVR_RXTSP
+const uint16_t RateCache::channelRegs[channelRegCount] = {0x0203, 0x0403};
+
+bool RateCache::Key::operator<(const Key &other) const
+{
+    if (chip != other.chip)
+        return chip < other.chip;
+    if (decimation != other.decimation)
+        return decimation < other.decimation;
+    if (lmlConfig != other.lmlConfig)
+        return lmlConfig < other.lmlConfig;
+    if (cgenFrequency != other.cgenFrequency)
+        return cgenFrequency < other.cgenFrequency;
+    if (refClk != other.refClk)
+        return refClk < other.refClk;
+    return board < other.board;
+}
+
+RateCache::RateCache() :
+    mEnabled(true),
+    mHits(0),
+    mMisses(0)
+{
+}
+
+RateCache& RateCache::Instance()
+{
+    static RateCache cache;
+    return cache;
+}
+
+RateCache::Key RateCache::MakeKey(LMS7002M* lms, const std::string &board, int chip, double cgenFrequency, int decimation)
+{
+    Key key;
+    key.board = board;
+    //saved as single word
+    for (auto &c : key.board)
+        if (c == ' ' || c == '\t' || c == '\n')
+            c = '_';
+    key.chip = chip;
+    key.refClk = lms->GetReferenceClk_SX(LMS7002M::Rx);
+    key.cgenFrequency = cgenFrequency;
+    key.decimation = decimation;
+    //SISODDR modes, FIFO data sources and MCLK source selections
+    key.lmlConfig = (uint32_t(lms->SPI_read_cached(0, 0x0022) & 0x5000) << 16)
+                  | (lms->SPI_read_cached(0, 0x002A) & 0x0F00)
+                  | (lms->SPI_read_cached(0, 0x002B) & 0x0014);
+    return key;
+}
+
+void RateCache::Capture(LMS7002M* lms, Entry &entry)
+{
+    for (unsigned i = 0; i < globalRegCount; ++i)
+        entry.global[i] = lms->SPI_read_cached(0, globalRegs[i]);
+    for (unsigned ch = 0; ch < 2; ++ch)
+        for (unsigned i = 0; i < channelRegCount; ++i)
+            entry.channel[ch][i] = lms->SPI_read_cached(ch, channelRegs[i]);
+}
+
+int RateCache::Apply(LMS7002M* lms, Entry &entry)
+{
+    const uint16_t reg20 = lms->SPI_read(0x0020);
+    lms->BeginWriteBatch();
+    for (unsigned i = 0; i < globalRegCount; ++i)
+        lms->SPI_write(globalRegs[i], entry.global[i]);
+    for (unsigned ch = 0; ch < 2; ++ch)
+    {
+        lms->SPI_write(0x0020, (reg20 & ~0x3) | (ch + 1)); //MAC
+        for (unsigned i = 0; i < channelRegCount; ++i)
+            lms->SPI_write(channelRegs[i], entry.channel[ch][i]);
+    }
+    lms->SPI_write(0x0020, reg20); //restore active channel
+    if (lms->EndWriteBatch() != 0)
+        return -1;
+
+    //comparator settling time
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    if (lms->GetCGENLocked())
+        return 0;
+    lime::debug("RateCache: CGEN not locked with stored CSW, retuning");
+    if (lms->TuneCGENVCO() != 0)
+        return -1;
+    for (unsigned i = 0; i < globalRegCount; ++i)
+        if (globalRegs[i] == 0x008B)
+            entry.global[i] = lms->SPI_read_cached(0, 0x008B);
+    return 0;
+}
+
+bool RateCache::Find(const Key &key, Entry &entry)
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    if (!mEnabled)
+        return false;
+    auto iter = mEntries.find(key);
+    if (iter == mEntries.end())
+    {
+        ++mMisses;
+        return false;
+    }
+    ++mHits;
+    entry = iter->second;
+    return true;
+}
+
+void RateCache::Store(const Key &key, const Entry &entry)
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    if (!mEnabled)
+        return;
+    if (mEntries.size() >= maxEntries && mEntries.find(key) == mEntries.end())
+        mEntries.clear();
+    mEntries[key] = entry;
+}
+
+void RateCache::Remove(const Key &key)
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    mEntries.erase(key);
+}
+
+void RateCache::Enable(bool enabled)
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    mEnabled = enabled;
+}
+
+bool RateCache::IsEnabled() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mEnabled;
+}
+
+int RateCache::Save(const std::string &filename) const
+{
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == nullptr)
+        return ReportError(errno, "RateCache: cannot open %s", filename.c_str());
+    std::lock_guard<std::mutex> lck(mLock);
+    fprintf(file, "%s\n", fileHeader);
+    for (auto &item : mEntries)
+    {
+        const Key &key = item.first;
+        const Entry &entry = item.second;
+        //hexadecimal floats keep keys bit exact
+        fprintf(file, "%s %d %a %a %d %x", key.board.c_str(), key.chip, key.refClk, key.cgenFrequency, key.decimation, key.lmlConfig);
+        for (auto value : entry.global)
+            fprintf(file, " %x", value);
+        for (auto &channel : entry.channel)
+            for (auto value : channel)
+                fprintf(file, " %x", value);
+        fprintf(file, " %u", unsigned(entry.fpgaAddrs.size()));
+        for (size_t i = 0; i < entry.fpgaAddrs.size(); ++i)
+            fprintf(file, " %x %x", entry.fpgaAddrs[i], entry.fpgaData[i]);
+        fprintf(file, "\n");
+    }
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed)
+        return ReportError(EIO, "RateCache: failed to write %s", filename.c_str());
+    return 0;
+}
+
+int RateCache::Load(const std::string &filename)
+{
+    FILE* file = fopen(filename.c_str(), "r");
+    if (file == nullptr)
+        return ReportError(errno, "RateCache: cannot open %s", filename.c_str());
+    char header[64] = {0};
+    if (fgets(header, sizeof(header), file) == nullptr || strncmp(header, fileHeader, strlen(fileHeader)) != 0)
+    {
+        fclose(file);
+        return ReportError(EINVAL, "RateCache: %s is not a rate cache file", filename.c_str());
+    }
+    std::map<Key, Entry> loaded;
+    char board[256];
+    Key key;
+    while (fscanf(file, "%255s %d %lf %lf %d %x", board, &key.chip, &key.refClk, &key.cgenFrequency, &key.decimation, &key.lmlConfig) == 6)
+    {
+        key.board = board;
+        Entry entry;
+        unsigned value;
+        unsigned count = 0;
+        bool valid = true;
+        for (unsigned i = 0; i < globalRegCount && valid; ++i)
+            if ((valid = fscanf(file, "%x", &value) == 1))
+                entry.global[i] = value;
+        for (unsigned i = 0; i < 2 * channelRegCount && valid; ++i)
+            if ((valid = fscanf(file, "%x", &value) == 1))
+                entry.channel[i / channelRegCount][i % channelRegCount] = value;
+        valid = valid && fscanf(file, "%u", &count) == 1 && count <= 256;
+        for (unsigned i = 0; i < count && valid; ++i)
+        {
+            unsigned addr;
+            valid = fscanf(file, "%x %x", &addr, &value) == 2;
+            entry.fpgaAddrs.push_back(addr);
+            entry.fpgaData.push_back(value);
+        }
+        if (!valid)
+        {
+            fclose(file);
+            return ReportError(EINVAL, "RateCache: corrupted entry in %s", filename.c_str());
+        }
+        loaded[key] = entry;
+    }
+    fclose(file);
+    std::lock_guard<std::mutex> lck(mLock);
+    for (auto &item : loaded)
+        if (mEntries.size() < maxEntries)
+            mEntries.insert(item);
+    return 0;
+}
+
+void RateCache::Clear()
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    mEntries.clear();
+    mHits = 0;
+    mMisses = 0;
+}
+
+size_t RateCache::Size() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mEntries.size();
+}
+
+uint64_t RateCache::GetHits() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mHits;
+}
+
+uint64_t RateCache::GetMisses() const
+{
+    std::lock_guard<std::mutex> lck(mLock);
+    return mMisses;
+}
@@ -0,0 +1,108 @@
+/**
+    @file RateCache.h
+    @author Lime Microsystems
+    @brief Replayable results of sample rate changes for LMS7_Device::SetRate
+*/
+
+#ifndef LIME_RATE_CACHE_H
+#define LIME_RATE_CACHE_H
+
+#include "LimeSuiteConfig.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace lime
+{
+
+class LMS7002M;
+
+/*!
+ * Keeps chip registers written by a sample rate change (CGEN dividers
+ * and tuned CSW, HBD/HBI ratios, LML clock dividers) together with FPGA
+ * register writes that configured the interface PLLs. Later switches to
+ * the same rate write them back in one SPI and one FPGA transfer and
+ * only check that CGEN locked. FPGA sequences that had to poll FPGA
+ * status (phase search, busy waits) are not stored, those are rerun.
+ * Entries can be saved to a text file and loaded by later sessions.
+ */
+class LIME_API RateCache
+{
+public:
+    struct Key
+    {
+        //! device name, serial number and gateware version
+        std::string board;
+        //! chip index on board
+        int chip;
+        double refClk;
+        double cgenFrequency;
+        //! HBD/HBI ratio, 7 - bypass
+        int decimation;
+        //! LML mode bits the sequence depends on
+        uint32_t lmlConfig;
+        bool operator<(const Key &other) const;
+    };
+
+    static const unsigned globalRegCount = 8;
+    static const unsigned channelRegCount = 2;
+    //! chip registers of rate change, below 0x0100
+    static const uint16_t globalRegs[globalRegCount];
+    //! chip registers of rate change in both MIMO channels
+    static const uint16_t channelRegs[channelRegCount];
+
+    struct Entry
+    {
+        uint16_t global[globalRegCount];
+        uint16_t channel[2][channelRegCount];
+        //! FPGA writes of interface PLL configuration, empty when not replayable
+        std::vector<uint32_t> fpgaAddrs;
+        std::vector<uint32_t> fpgaData;
+    };
+
+    static const size_t maxEntries = 1024;
+
+    //! Process wide cache used by LMS7_Device::SetRate
+    static RateCache& Instance();
+
+    /** @brief Fills key inputs that are read from chip register map
+        @return key for rate change of chip to given CGEN frequency
+    */
+    static Key MakeKey(LMS7002M* lms, const std::string &board, int chip, double cgenFrequency, int decimation);
+    //! Copies rate change registers from chip register map
+    static void Capture(LMS7002M* lms, Entry &entry);
+    /** @brief Writes chip registers in one transfer and checks CGEN lock,
+        VCO is retuned and entry CSW updated if it did not lock
+        @return 0-success, -1 CGEN cannot lock
+    */
+    static int Apply(LMS7002M* lms, Entry &entry);
+
+    //! Copies entry of key, false if rate change was not stored
+    bool Find(const Key &key, Entry &entry);
+    void Store(const Key &key, const Entry &entry);
+    void Remove(const Key &key);
+
+    //! Disabled cache neither finds nor stores entries
+    void Enable(bool enabled);
+    bool IsEnabled() const;
+    int Save(const std::string &filename) const;
+    //! Adds entries from file, existing entries are kept
+    int Load(const std::string &filename);
+    void Clear();
+    size_t Size() const;
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+
+private:
+    RateCache();
+    mutable std::mutex mLock;
+    std::map<Key, Entry> mEntries;
+    bool mEnabled;
+    uint64_t mHits;
+    uint64_t mMisses;
+};
+
+}
+#endif // LIME_RATE_CACHE_H
@@ -0,0 +1,353 @@
+/**
+    @file Resampler.cpp
+    @author Lime Microsystems
+    @brief Host side polyphase rational resampler of stream samples
+*/
+
+#include "Resampler.h"
+#include "LMS7002M.h"
+#include "device_constants.h"
+#include "windowFunction.h"
+#include <string.h>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+using namespace lime;
+
+const unsigned Resampler::maxFactor;
+
+static unsigned GCD(unsigned a, unsigned b)
+{
+    while (b != 0)
+    {
+        const unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/** @brief Dot product of time reversed taps with I and Q sample arrays
+*/
+static inline void DotIQ(const float* taps, const float* xi, const float* xq, unsigned n, float &yi, float &yq)
+{
+    unsigned i = 0;
+    float sumI = 0;
+    float sumQ = 0;
+#ifdef __SSE__
+    __m128 accI = _mm_setzero_ps();
+    __m128 accQ = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 h = _mm_loadu_ps(taps + i);
+        accI = _mm_add_ps(accI, _mm_mul_ps(h, _mm_loadu_ps(xi + i)));
+        accQ = _mm_add_ps(accQ, _mm_mul_ps(h, _mm_loadu_ps(xq + i)));
+    }
+    float partI[4];
+    float partQ[4];
+    _mm_storeu_ps(partI, accI);
+    _mm_storeu_ps(partQ, accQ);
+    sumI = partI[0] + partI[1] + partI[2] + partI[3];
+    sumQ = partQ[0] + partQ[1] + partQ[2] + partQ[3];
+#endif
+    for (; i < n; ++i)
+    {
+        sumI += taps[i] * xi[i];
+        sumQ += taps[i] * xq[i];
+    }
+    yi = sumI;
+    yq = sumQ;
+}
+
+unsigned Resampler::PhaseTaps(unsigned up, unsigned down, unsigned taps)
+{
+    //decimation narrows the filter, keep transition band relative to output rate
+    unsigned n = taps * ((down + up - 1) / up);
+    return n + (n & 1);
+}
+
+Resampler::Resampler(unsigned up, unsigned down, unsigned taps) :
+    mBufLen(0),
+    mBufTimestamp(0),
+    mNext(0),
+    mPrimed(false),
+    mTimeNs(0),
+    mOutputCount(0)
+{
+    up = up > 0 ? up : 1;
+    down = down > 0 ? down : 1;
+    const unsigned gcd = GCD(up, down);
+    mUp = up / gcd;
+    mDown = down / gcd;
+    mTaps = PhaseTaps(mUp, mDown, taps > 0 ? taps : 2);
+
+    //windowed sinc at upsampled rate, centered at length/2 so delay is whole input samples
+    const unsigned length = mTaps * mUp;
+    const double cutoff = 0.45 / std::max(mUp, mDown);
+    const double pi = std::acos(-1);
+    std::vector<float> window;
+    GenerateWindowCoefficients(1, length + 1, window, 0);
+    std::vector<double> proto(length);
+    double sum = 0;
+    for (unsigned i = 0; i < length; ++i)
+    {
+        const double t = double(i) - length / 2;
+        const double sinc = t == 0 ? 2 * cutoff : std::sin(2 * pi * cutoff * t) / (pi * t);
+        proto[i] = sinc * window[i];
+        sum += proto[i];
+    }
+    mPhases.resize(length);
+    for (unsigned r = 0; r < mUp; ++r)
+        for (unsigned k = 0; k < mTaps; ++k)
+            mPhases[r * mTaps + mTaps - 1 - k] = proto[r + k * mUp] * mUp / sum;
+}
+
+unsigned Resampler::GetUp() const
+{
+    return mUp;
+}
+
+unsigned Resampler::GetDown() const
+{
+    return mDown;
+}
+
+unsigned Resampler::GetTapsPerOutput() const
+{
+    return mTaps;
+}
+
+uint32_t Resampler::MaxOutput(uint32_t count) const
+{
+    return (uint64_t(count) * mUp + mDown - 1) / mDown + 1;
+}
+
+void Resampler::Reset()
+{
+    mPrimed = false;
+    mBufLen = 0;
+}
+
+uint64_t Resampler::GetNextInputTimestamp() const
+{
+    return mPrimed ? mBufTimestamp + mBufLen : ~uint64_t(0);
+}
+
+uint64_t Resampler::ToInputTime(uint64_t outputTimestamp) const
+{
+    return (outputTimestamp * mDown + mUp - 1) / mUp;
+}
+
+uint64_t Resampler::ToOutputTime(uint64_t inputTimestamp) const
+{
+    return (inputTimestamp * mUp + mDown - 1) / mDown;
+}
+
+double Resampler::GetCostPerSample() const
+{
+    const uint64_t count = mOutputCount.load(std::memory_order_relaxed);
+    return count > 0 ? double(mTimeNs.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+/** @brief Starts filter at input timestamp with zero history
+*/
+void Resampler::Prime(uint64_t timestamp)
+{
+    const size_t history = mTaps;
+    if (mBufI.size() < history)
+    {
+        mBufI.resize(history);
+        mBufQ.resize(history);
+    }
+    std::fill(mBufI.begin(), mBufI.begin() + history, 0.0f);
+    std::fill(mBufQ.begin(), mBufQ.begin() + history, 0.0f);
+    mBufLen = history;
+    mBufTimestamp = timestamp - history; //may wrap, only differences are used
+    mNext = ToOutputTime(timestamp);
+    mPrimed = true;
+}
+
+/** @brief Computes every output whose filter span is buffered, drops used history
+*/
+uint32_t Resampler::Filter(float* out, uint64_t &outTimestamp)
+{
+    const uint64_t half = mTaps / 2;
+    outTimestamp = mNext;
+    uint32_t produced = 0;
+    while (true)
+    {
+        const uint64_t q = mNext * mDown;
+        //newest input under the filter, relative to buffer start
+        const uint64_t newest = q / mUp + half - mBufTimestamp;
+        if (newest >= mBufLen)
+            break;
+        const float* taps = &mPhases[(q % mUp) * mTaps];
+        const size_t first = newest + 1 - mTaps;
+        DotIQ(taps, &mBufI[first], &mBufQ[first], mTaps, out[2 * produced], out[2 * produced + 1]);
+        ++produced;
+        ++mNext;
+    }
+
+    //keep history of next output
+    const int64_t keepFrom = (mNext * mDown) / mUp + half + 1 - mTaps - mBufTimestamp;
+    if (keepFrom > 0)
+    {
+        const size_t drop = std::min<uint64_t>(keepFrom, mBufLen);
+        const size_t keep = mBufLen - drop;
+        memmove(mBufI.data(), mBufI.data() + drop, keep * sizeof(float));
+        memmove(mBufQ.data(), mBufQ.data() + drop, keep * sizeof(float));
+        mBufLen = keep;
+        mBufTimestamp += drop;
+    }
+    return produced;
+}
+
+uint32_t Resampler::Process(const float* in, uint32_t count, uint64_t timestamp, float* out, uint64_t &outTimestamp)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    if (!mPrimed || timestamp != GetNextInputTimestamp())
+        Prime(timestamp);
+    if (mBufI.size() < mBufLen + count)
+    {
+        mBufI.resize(mBufLen + count);
+        mBufQ.resize(mBufLen + count);
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mBufI[mBufLen + i] = in[2 * i];
+        mBufQ[mBufLen + i] = in[2 * i + 1];
+    }
+    mBufLen += count;
+    const uint32_t produced = Filter(out, outTimestamp);
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    mTimeNs.fetch_add(ns, std::memory_order_relaxed);
+    mOutputCount.fetch_add(produced, std::memory_order_relaxed);
+    return produced;
+}
+
+uint32_t Resampler::Process(const complex16_t* in, uint32_t count, uint64_t timestamp, float scale, float* out, uint64_t &outTimestamp)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    if (!mPrimed || timestamp != GetNextInputTimestamp())
+        Prime(timestamp);
+    if (mBufI.size() < mBufLen + count)
+    {
+        mBufI.resize(mBufLen + count);
+        mBufQ.resize(mBufLen + count);
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mBufI[mBufLen + i] = in[i].i * scale;
+        mBufQ[mBufLen + i] = in[i].q * scale;
+    }
+    mBufLen += count;
+    const uint32_t produced = Filter(out, outTimestamp);
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    mTimeNs.fetch_add(ns, std::memory_order_relaxed);
+    mOutputCount.fetch_add(produced, std::memory_order_relaxed);
+    return produced;
+}
+
+uint32_t Resampler::Flush(float* out, uint64_t &outTimestamp)
+{
+    outTimestamp = mNext;
+    if (!mPrimed)
+        return 0;
+    const std::vector<float> zeros(2 * (mTaps / 2), 0.0f);
+    const uint32_t produced = Process(zeros.data(), mTaps / 2, GetNextInputTimestamp(), out, outTimestamp);
+    Reset();
+    return produced;
+}
+
+/** @brief CGEN frequency produced by LMS7002M::SetFrequencyCGEN() for requested frequency
+    @return 0 if out of VCO range
+*/
+static double AchievableCGEN(double freq, double refClk)
+{
+    const double vcoLow = LMS7002M::gCGEN_VCO_frequencies[0];
+    const double vcoHigh = LMS7002M::gCGEN_VCO_frequencies[1];
+    const int divHigh = int(vcoHigh / 2 / freq) - 1;
+    const int divLow = int(vcoLow / 2 / freq);
+    const int div = std::min((divLow + divHigh) / 2, 255);
+    const double vco = 2 * (div + 1) * freq;
+    if (div < 0 || vco <= vcoLow || vco >= vcoHigh)
+        return 0;
+    const double mul = vco / refClk;
+    const uint32_t frac = uint32_t((mul - std::floor(mul)) * 1048576);
+    return refClk * (std::floor(mul) + frac / 1048576.0) / (2 * (div + 1));
+}
+
+Resampler::Plan Resampler::FindPlan(double rate, double refClk, double tolerance)
+{
+    const double maxError = std::max(tolerance, rate * 1e-12);
+    Plan best;
+    Plan closest;
+    memset(&best, 0, sizeof(best));
+    memset(&closest, 0, sizeof(closest));
+    bool found = false;
+
+    //device rate at or above stream rate, so resampling never removes signal bandwidth
+    for (unsigned down = 1; down <= maxFactor; ++down)
+        for (unsigned up = 1; up <= down; ++up)
+        {
+            if (GCD(up, down) != 1)
+                continue;
+            const unsigned cost = up == down ? 0 : PhaseTaps(up, down, 32);
+            if (found && cost > best.cost)
+                continue;
+            const double hwRate = rate * down / up;
+            //highest oversampling first, like LMS7_Device::SetRate()
+            for (int decim = 4; decim >= 0; --decim)
+            {
+                const unsigned ratio = 2 << decim;
+                const double cgen = hwRate * 4 * ratio;
+                if (cgen > cgenMax)
+                    continue;
+                const double achieved = AchievableCGEN(cgen, refClk);
+                if (achieved == 0)
+                    continue;
+                Plan plan;
+                plan.hardwareRate = hwRate;
+                plan.oversample = ratio;
+                plan.cgenFrequency = achieved;
+                plan.up = up;
+                plan.down = down;
+                plan.error = achieved / (4 * ratio) * up / down - rate;
+                plan.cost = cost;
+                if (up == down && (closest.oversample == 0 || std::fabs(plan.error) < std::fabs(closest.error)))
+                    closest = plan;
+                if (std::fabs(plan.error) > maxError)
+                    continue;
+                if (!found || cost < best.cost || hwRate < best.hardwareRate)
+                    best = plan;
+                found = true;
+                break;
+            }
+        }
+    //without exact combination report closest direct rate
+    return found ? best : closest;
+}
+
+int Resampler::FindRatio(double rate, double hardwareRate, unsigned &up, unsigned &down)
+{
+    if (rate <= 0 || hardwareRate <= 0)
+        return -1;
+    for (unsigned d = 1; d <= maxFactor; ++d)
+    {
+        const double u = std::floor(rate * d / hardwareRate + 0.5);
+        if (u < 1 || u > maxFactor)
+            continue;
+        if (std::fabs(hardwareRate * u / d - rate) <= rate * 1e-9)
+        {
+            const unsigned gcd = GCD(unsigned(u), d);
+            up = unsigned(u) / gcd;
+            down = d / gcd;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,125 @@
+/**
+    @file Resampler.h
+    @author Lime Microsystems
+    @brief Host side polyphase rational resampler of stream samples
+*/
+
+#ifndef LIME_RESAMPLER_H
+#define LIME_RESAMPLER_H
+
+#include "LimeSuiteConfig.h"
+#include "dataTypes.h"
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+
+namespace lime
+{
+
+/*!
+ * Changes sample rate of complex samples by up/down with a polyphase
+ * windowed sinc filter. Only the filter phase needed for every output
+ * sample is computed, so CPU cost is taps per phase per output sample.
+ * Output timestamps count output samples: output sample n is the filter
+ * response at input time n*down/up, filter group delay is compensated.
+ * A gap in input timestamps restarts the filter from zero history.
+ */
+class LIME_API Resampler
+{
+public:
+    //! Device rate and resampling ratio reaching requested stream rate
+    struct Plan
+    {
+        //! device sample rate for LMS7_Device::SetRate()
+        double hardwareRate;
+        //! oversampling for LMS7_Device::SetRate(), 2-32
+        unsigned oversample;
+        //! CGEN frequency after fractional-N quantization
+        double cgenFrequency;
+        unsigned up;
+        unsigned down;
+        //! achieved minus requested stream rate, Hz
+        double error;
+        //! filter taps per stream sample, 0 - no resampling needed
+        unsigned cost;
+    };
+
+    //! largest up and down factors considered by FindPlan() and FindRatio()
+    static const unsigned maxFactor = 64;
+
+    /** @param up interpolation factor
+        @param down decimation factor
+        @param taps filter taps per phase when down <= up, scaled by down/up above
+    */
+    Resampler(unsigned up, unsigned down, unsigned taps = 32);
+
+    unsigned GetUp() const;
+    unsigned GetDown() const;
+    //! Filter taps computed per output sample
+    unsigned GetTapsPerOutput() const;
+    //! Largest output count of Process() for count input samples
+    uint32_t MaxOutput(uint32_t count) const;
+
+    //! Drops filter history, next input restarts output timestamps
+    void Reset();
+    //! Timestamp of input sample that continues previous Process(), ~0 after Reset()
+    uint64_t GetNextInputTimestamp() const;
+
+    /** @brief Filters block of interleaved IQ samples
+        @param timestamp input timestamp of first sample
+        @param out interleaved IQ output, room for MaxOutput(count) samples
+        @param outTimestamp output timestamp of first produced sample
+        @return number of produced output samples
+    */
+    uint32_t Process(const float* in, uint32_t count, uint64_t timestamp, float* out, uint64_t &outTimestamp);
+    //! Same as above with integer input multiplied by scale
+    uint32_t Process(const complex16_t* in, uint32_t count, uint64_t timestamp, float scale, float* out, uint64_t &outTimestamp);
+    /** @brief Produces outputs up to the last input sample by feeding zeros and resets filter
+        @param out room for MaxOutput(GetTapsPerOutput()) samples
+    */
+    uint32_t Flush(float* out, uint64_t &outTimestamp);
+
+    //! Input timestamp that produces output timestamp, rounded up
+    uint64_t ToInputTime(uint64_t outputTimestamp) const;
+    //! Output timestamp of first output at or after input timestamp
+    uint64_t ToOutputTime(uint64_t inputTimestamp) const;
+
+    //! Measured host CPU time per output sample in ns, averaged since construction
+    double GetCostPerSample() const;
+
+    /** @brief Picks cheapest CGEN, oversampling and resampling ratio for stream rate
+        @param rate requested stream sample rate in Hz
+        @param refClk CGEN reference clock in Hz
+        @param tolerance allowed stream rate error in Hz, 0 - exact
+        @return plan, nonzero error when no combination reaches the rate within tolerance
+    */
+    static Plan FindPlan(double rate, double refClk, double tolerance = 0);
+    /** @brief Finds smallest up/down ratio converting device rate to stream rate
+        @return 0-success, -1 rate is not a ratio of factors up to maxFactor
+    */
+    static int FindRatio(double rate, double hardwareRate, unsigned &up, unsigned &down);
+
+private:
+    static unsigned PhaseTaps(unsigned up, unsigned down, unsigned taps);
+    void Prime(uint64_t timestamp);
+    uint32_t Filter(float* out, uint64_t &outTimestamp);
+
+    unsigned mUp;
+    unsigned mDown;
+    unsigned mTaps;
+    //! time reversed taps of every phase, mTaps each
+    std::vector<float> mPhases;
+    //! deinterleaved input, first element at input timestamp mBufTimestamp
+    std::vector<float> mBufI;
+    std::vector<float> mBufQ;
+    size_t mBufLen;
+    uint64_t mBufTimestamp;
+    //! next output timestamp
+    uint64_t mNext;
+    bool mPrimed;
+    std::atomic<uint64_t> mTimeNs;
+    std::atomic<uint64_t> mOutputCount;
+};
+
+}
+#endif // LIME_RESAMPLER_H
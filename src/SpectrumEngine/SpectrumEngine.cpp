@@ -0,0 +1,343 @@
+/**
+    @file SpectrumEngine.cpp
+    @author Lime Microsystems
+    @brief Multithreaded Welch power spectrum estimation of stream samples
+*/
+
+#include "SpectrumEngine.h"
+#include "Streamer.h"
+#include "windowFunction.h"
+#include "kiss_fft.h"
+#include "Logger.h"
+#include <errno.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+using namespace lime;
+
+SpectrumEngine::Config::Config() :
+    fftSize(1024),
+    windowFunction(0),
+    overlap(0),
+    maxHold(false),
+    threads(0)
+{
+}
+
+SpectrumEngine::SpectrumEngine() :
+    mChannels(0),
+    mHop(0),
+    mPlan(nullptr),
+    mNextJob(0),
+    mJobsDone(0),
+    mActiveWorkers(0),
+    mGeneration(0),
+    mJobsOpen(false),
+    mTerminate(false)
+{
+}
+
+SpectrumEngine::~SpectrumEngine()
+{
+    StopWorkers();
+    if (mPlan)
+        kiss_fft_free(mPlan);
+}
+
+int SpectrumEngine::Configure(const Config &config, unsigned channels)
+{
+    if (config.fftSize < 2 || channels == 0)
+        return ReportError(EINVAL, "SpectrumEngine: invalid FFT size or channel count");
+    StopWorkers();
+    if (mPlan == nullptr || config.fftSize != mConfig.fftSize)
+    {
+        if (mPlan)
+            kiss_fft_free(mPlan);
+        mPlan = kiss_fft_alloc(config.fftSize, 0, nullptr, nullptr);
+        if (mPlan == nullptr)
+            return ReportError(ENOMEM, "SpectrumEngine: failed to allocate FFT plan");
+    }
+    mConfig = config;
+    mChannels = channels;
+    const double overlap = config.overlap < 0 ? 0 : (config.overlap > 0.95 ? 0.95 : config.overlap);
+    mHop = config.fftSize - unsigned(std::lrint(overlap * config.fftSize));
+    if (mHop == 0)
+        mHop = 1;
+    GenerateWindowCoefficients(config.windowFunction, config.fftSize, mWindow, 1);
+
+    unsigned threads = config.threads;
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    mFFTIn.assign(threads, std::vector<float>(2 * config.fftSize));
+    mFFTOut.assign(threads, std::vector<float>(2 * config.fftSize));
+    mAccum.assign(threads, std::vector<float>(channels * config.fftSize, 0));
+    mFrames.assign(threads, std::vector<unsigned>(channels, 0));
+    mPending.assign(channels, std::vector<float>());
+    mPendingCount.assign(channels, 0);
+    mMaxHold.assign(channels * config.fftSize, 0);
+    mMaxHoldValid.assign(channels, false);
+    StartWorkers(threads - 1);
+    return 0;
+}
+
+int SpectrumEngine::SetWindowFunction(int windowFunction)
+{
+    if (mChannels == 0)
+        return ReportError(EINVAL, "SpectrumEngine: not configured");
+    mConfig.windowFunction = windowFunction;
+    GenerateWindowCoefficients(windowFunction, mConfig.fftSize, mWindow, 1);
+    ClearAccumulators();
+    return 0;
+}
+
+const SpectrumEngine::Config& SpectrumEngine::GetConfig() const
+{
+    return mConfig;
+}
+
+void SpectrumEngine::ClearAccumulators()
+{
+    for (auto &accum : mAccum)
+        std::fill(accum.begin(), accum.end(), 0.0f);
+    for (auto &frames : mFrames)
+        std::fill(frames.begin(), frames.end(), 0);
+    std::fill(mPendingCount.begin(), mPendingCount.end(), 0);
+}
+
+void SpectrumEngine::StartWorkers(unsigned count)
+{
+    mTerminate = false;
+    for (unsigned i = 0; i < count; ++i)
+        mWorkers.push_back(std::thread(&SpectrumEngine::WorkerLoop, this, i + 1, mGeneration));
+}
+
+void SpectrumEngine::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lck(mLock);
+        mTerminate = true;
+    }
+    mWorkReady.notify_all();
+    for (auto &worker : mWorkers)
+        worker.join();
+    mWorkers.clear();
+}
+
+void SpectrumEngine::WorkerLoop(unsigned slot, unsigned generation)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lck(mLock);
+            mWorkReady.wait(lck, [&]{ return mTerminate || (mJobsOpen && mGeneration != generation); });
+            if (mTerminate)
+                return;
+            generation = mGeneration;
+            ++mActiveWorkers;
+        }
+        RunJobs(slot);
+    }
+}
+
+/** @brief Transforms frames from shared job list until it is exhausted
+    @param slot index of buffers and accumulators owned by calling thread
+*/
+void SpectrumEngine::RunJobs(unsigned slot)
+{
+    const unsigned N = mConfig.fftSize;
+    const unsigned jobCount = mJobs.size();
+    const float* window = mWindow.data();
+    float* in = mFFTIn[slot].data();
+    float* out = mFFTOut[slot].data();
+    unsigned done = 0;
+    unsigned j;
+    while ((j = mNextJob.fetch_add(1)) < jobCount)
+    {
+        const Job &job = mJobs[j];
+        const float* src = &mPending[job.channel][2 * job.offset];
+        for (unsigned i = 0; i < N; ++i)
+        {
+            in[2*i] = src[2*i] * window[i];
+            in[2*i+1] = src[2*i+1] * window[i];
+        }
+        kiss_fft(mPlan, (const kiss_fft_cpx*)in, (kiss_fft_cpx*)out);
+        float* accum = &mAccum[slot][job.channel * N];
+        for (unsigned i = 0; i < N; ++i)
+            accum[i] += out[2*i] * out[2*i] + out[2*i+1] * out[2*i+1];
+        ++mFrames[slot][job.channel];
+        ++done;
+    }
+    std::lock_guard<std::mutex> lck(mLock);
+    mJobsDone += done;
+    if (slot != 0)
+        --mActiveWorkers;
+    mWorkDone.notify_all();
+}
+
+//transforms all complete frames and keeps the remainder for next call
+void SpectrumEngine::ProcessPending()
+{
+    const unsigned N = mConfig.fftSize;
+    mJobs.clear();
+    for (unsigned ch = 0; ch < mChannels; ++ch)
+        for (uint32_t offset = 0; offset + N <= mPendingCount[ch]; offset += mHop)
+            mJobs.push_back(Job{ch, offset});
+
+    if (!mJobs.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lck(mLock);
+            mNextJob.store(0);
+            mJobsDone = 0;
+            ++mGeneration;
+            mJobsOpen = true;
+        }
+        mWorkReady.notify_all();
+        RunJobs(0);
+        std::unique_lock<std::mutex> lck(mLock);
+        mWorkDone.wait(lck, [&]{ return mJobsDone == mJobs.size() && mActiveWorkers == 0; });
+        //late workers must not enter while job list is rebuilt
+        mJobsOpen = false;
+    }
+
+    for (unsigned ch = 0; ch < mChannels; ++ch)
+    {
+        uint32_t consumed = 0;
+        if (mPendingCount[ch] >= N)
+            consumed = ((mPendingCount[ch] - N) / mHop + 1) * mHop;
+        if (consumed > mPendingCount[ch])
+            consumed = mPendingCount[ch];
+        const uint32_t remaining = mPendingCount[ch] - consumed;
+        memmove(mPending[ch].data(), mPending[ch].data() + 2 * consumed, remaining * 2 * sizeof(float));
+        mPendingCount[ch] = remaining;
+    }
+}
+
+int SpectrumEngine::Process(const complex16_t* const* samples, uint32_t count)
+{
+    if (mChannels == 0)
+        return ReportError(EINVAL, "SpectrumEngine: not configured");
+    for (unsigned ch = 0; ch < mChannels; ++ch)
+    {
+        std::vector<float> &pending = mPending[ch];
+        if (pending.size() < 2 * (mPendingCount[ch] + count))
+            pending.resize(2 * (mPendingCount[ch] + count));
+        float* dst = &pending[2 * mPendingCount[ch]];
+        const int16_t* src = (const int16_t*)samples[ch];
+        for (uint32_t i = 0; i < 2 * count; ++i)
+            dst[i] = src[i];
+        mPendingCount[ch] += count;
+    }
+    ProcessPending();
+    return 0;
+}
+
+int SpectrumEngine::Process(const float* const* samples, uint32_t count)
+{
+    if (mChannels == 0)
+        return ReportError(EINVAL, "SpectrumEngine: not configured");
+    for (unsigned ch = 0; ch < mChannels; ++ch)
+    {
+        std::vector<float> &pending = mPending[ch];
+        if (pending.size() < 2 * (mPendingCount[ch] + count))
+            pending.resize(2 * (mPendingCount[ch] + count));
+        memcpy(&pending[2 * mPendingCount[ch]], samples[ch], 2 * count * sizeof(float));
+        mPendingCount[ch] += count;
+    }
+    ProcessPending();
+    return 0;
+}
+
+int SpectrumEngine::Read(StreamChannel* const* channels, uint32_t count, int timeout_ms)
+{
+    if (mChannels == 0)
+        return ReportError(EINVAL, "SpectrumEngine: not configured");
+    const bool isFloat = channels[0]->config.format == StreamConfig::FMT_FLOAT32;
+    if (isFloat)
+        mReadBufferFloat.resize(2 * count * mChannels);
+    else
+        mReadBuffer16.resize(count * mChannels);
+
+    //read same number of samples from every channel
+    uint32_t samplesRead = count;
+    std::vector<const void*> buffers(mChannels);
+    for (unsigned ch = 0; ch < mChannels; ++ch)
+    {
+        void* dst = isFloat ? (void*)&mReadBufferFloat[2 * count * ch] : (void*)&mReadBuffer16[count * ch];
+        StreamChannel::Metadata meta;
+        int ret = channels[ch]->Read(dst, count, &meta, timeout_ms);
+        if (ret < 0)
+            return -1;
+        if (uint32_t(ret) < samplesRead)
+            samplesRead = ret;
+        buffers[ch] = dst;
+    }
+    if (samplesRead == 0)
+        return 0;
+    if (isFloat)
+        Process((const float* const*)buffers.data(), samplesRead);
+    else
+        Process((const complex16_t* const*)buffers.data(), samplesRead);
+    return samplesRead;
+}
+
+unsigned SpectrumEngine::GetFrameCount(unsigned channel) const
+{
+    unsigned frames = 0;
+    for (const auto &slotFrames : mFrames)
+        frames += slotFrames[channel];
+    return frames;
+}
+
+unsigned SpectrumEngine::GetSpectrum(unsigned channel, float* bins, float* maxHold)
+{
+    if (channel >= mChannels)
+        return 0;
+    const unsigned N = mConfig.fftSize;
+    const unsigned frames = GetFrameCount(channel);
+    //sum worker accumulators in natural order into first slot
+    float* sum = &mAccum[0][channel * N];
+    for (size_t slot = 1; slot < mAccum.size(); ++slot)
+    {
+        float* accum = &mAccum[slot][channel * N];
+        for (unsigned i = 0; i < N; ++i)
+        {
+            sum[i] += accum[i];
+            accum[i] = 0;
+        }
+    }
+    for (auto &slotFrames : mFrames)
+        slotFrames[channel] = 0;
+
+    //reorder negative frequencies first
+    const float scale = frames ? 1.0f / (float(frames) * N * N) : 0.0f;
+    unsigned out = 0;
+    for (unsigned i = N / 2 + 1; i < N; ++i)
+        bins[out++] = sum[i] * scale;
+    for (unsigned i = 0; i < N / 2 + 1; ++i)
+        bins[out++] = sum[i] * scale;
+    std::fill(sum, sum + N, 0.0f);
+
+    float* hold = &mMaxHold[channel * N];
+    if (mConfig.maxHold && frames)
+    {
+        if (!mMaxHoldValid[channel])
+            memcpy(hold, bins, N * sizeof(float));
+        else
+            for (unsigned i = 0; i < N; ++i)
+                hold[i] = bins[i] > hold[i] ? bins[i] : hold[i];
+        mMaxHoldValid[channel] = true;
+    }
+    if (maxHold)
+        memcpy(maxHold, hold, N * sizeof(float));
+    return frames;
+}
+
+void SpectrumEngine::ResetMaxHold()
+{
+    std::fill(mMaxHold.begin(), mMaxHold.end(), 0.0f);
+    std::fill(mMaxHoldValid.begin(), mMaxHoldValid.end(), false);
+}
@@ -0,0 +1,132 @@
+/**
+    @file SpectrumEngine.h
+    @author Lime Microsystems
+    @brief Multithreaded Welch power spectrum estimation of stream samples
+*/
+
+#ifndef LIME_SPECTRUM_ENGINE_H
+#define LIME_SPECTRUM_ENGINE_H
+
+#include "LimeSuiteConfig.h"
+#include "dataTypes.h"
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+struct kiss_fft_state;
+
+namespace lime
+{
+
+class StreamChannel;
+
+/*!
+ * Accumulates windowed, overlapping FFT frames of one or more channels
+ * (Welch method). Frames of all channels are transformed in parallel by a
+ * worker pool sharing one FFT plan, every worker sums power into its own
+ * accumulators, so no locking is done per frame.
+ * Methods are not thread-safe, use one engine from one thread.
+ */
+class LIME_API SpectrumEngine
+{
+public:
+    struct Config
+    {
+        Config();
+        unsigned fftSize;
+        //! window function as in GenerateWindowCoefficients(): 0 - rectangular, 1 - Blackman-Harris, 2 - Hamming, 3 - Hanning
+        int windowFunction;
+        //! fraction of frame shared with previous frame, 0 to 0.95
+        double overlap;
+        //! keep maximum of every returned spectrum until ResetMaxHold()
+        bool maxHold;
+        //! worker threads, 0 - one per hardware thread
+        unsigned threads;
+    };
+
+    SpectrumEngine();
+    ~SpectrumEngine();
+
+    /** @brief Allocates plan and buffers, discards accumulated data
+        @param channels number of independent channels
+    */
+    int Configure(const Config &config, unsigned channels);
+    //! Changes window function keeping other settings, discards accumulated data
+    int SetWindowFunction(int windowFunction);
+    const Config& GetConfig() const;
+
+    /** @brief Splits samples into frames and adds their power spectrums
+        @param samples array of sample buffers, one per channel
+        @param count number of samples in every buffer
+    */
+    int Process(const complex16_t* const* samples, uint32_t count);
+    //! @copydoc Process(), samples are interleaved float IQ
+    int Process(const float* const* samples, uint32_t count);
+
+    /** @brief Reads samples from stream channels and processes them
+        @param channels one stream per engine channel
+        @param count samples to read from each stream
+        @return samples read from first stream, -1 on error
+    */
+    int Read(StreamChannel* const* channels, uint32_t count, int timeout_ms = 100);
+
+    /** @brief Returns averaged spectrum and restarts averaging of channel
+        @param bins fftSize power values, negative frequencies first, divided by frames*fftSize^2
+        @param maxHold optional output of maximum hold values
+        @return number of frames averaged
+    */
+    unsigned GetSpectrum(unsigned channel, float* bins, float* maxHold = nullptr);
+    //! Number of frames accumulated since last GetSpectrum()
+    unsigned GetFrameCount(unsigned channel) const;
+    void ResetMaxHold();
+
+private:
+    struct Job
+    {
+        unsigned channel;
+        uint32_t offset;
+    };
+
+    void StartWorkers(unsigned count);
+    void StopWorkers();
+    void WorkerLoop(unsigned slot, unsigned generation);
+    void RunJobs(unsigned slot);
+    void ProcessPending();
+    void ClearAccumulators();
+
+    Config mConfig;
+    unsigned mChannels;
+    uint32_t mHop;
+    kiss_fft_state* mPlan;
+    std::vector<float> mWindow;
+    //samples waiting for complete frame, interleaved float IQ per channel
+    std::vector<std::vector<float> > mPending;
+    std::vector<uint32_t> mPendingCount;
+    //per worker slot: FFT input/output as interleaved float IQ and per channel power sums
+    std::vector<std::vector<float> > mFFTIn;
+    std::vector<std::vector<float> > mFFTOut;
+    std::vector<std::vector<float> > mAccum;
+    std::vector<std::vector<unsigned> > mFrames;
+    std::vector<float> mMaxHold;
+    std::vector<bool> mMaxHoldValid;
+    std::vector<complex16_t> mReadBuffer16;
+    std::vector<float> mReadBufferFloat;
+
+    std::vector<Job> mJobs;
+    std::atomic<unsigned> mNextJob;
+    unsigned mJobsDone;
+    unsigned mActiveWorkers;
+    unsigned mGeneration;
+    bool mJobsOpen;
+    bool mTerminate;
+    std::mutex mLock;
+    std::condition_variable mWorkReady;
+    std::condition_variable mWorkDone;
+    std::vector<std::thread> mWorkers;
+};
+
+}
+#endif // LIME_SPECTRUM_ENGINE_H
@@ -0,0 +1,292 @@
+/**
+    @file StreamPlayer.cpp
+    @author Lime Microsystems
+    @brief Plays IQ sample files from disk into TX stream
+*/
+
+#include "StreamPlayer.h"
+#include "FPGA_common.h"
+#include "Logger.h"
+#include <errno.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#ifdef __unix__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace lime;
+
+//samples converted and written per StreamChannel::Write() call
+static const uint32_t chunkSize = 16*samples12InPkt;
+//bytes of file requested ahead of playback position
+static const size_t readAheadSize = 8*1024*1024;
+
+StreamPlayer::Config::Config() :
+    fileFormat(StreamConfig::FMT_INT16),
+    repeatCount(1),
+    timed(false),
+    startTimestamp(0),
+    sampleRate(0),
+    maxLead(0.1)
+{
+}
+
+StreamPlayer::StreamPlayer() :
+    mChannel(nullptr),
+    mFileSampleSize(4),
+    mChannelSampleSize(4),
+    mPassThrough(true),
+    mSampleCount(0),
+    mData(nullptr),
+    mMapSize(0),
+    mTerminate(false),
+    mDone(false),
+    mSamplesSent(0),
+    mLoopsCompleted(0)
+{
+}
+
+StreamPlayer::~StreamPlayer()
+{
+    Stop();
+}
+
+int StreamPlayer::Start(StreamChannel* channel, const Config &config)
+{
+    if (mThread.joinable())
+        return ReportError(EBUSY, "StreamPlayer: already playing");
+    if (channel == nullptr || !channel->config.isTx)
+        return ReportError(EINVAL, "StreamPlayer: TX stream required");
+
+    mConfig = config;
+    mChannel = channel;
+    switch (config.fileFormat)
+    {
+    case StreamConfig::FMT_FLOAT32: mFileSampleSize = 2*sizeof(float); break;
+    case StreamConfig::FMT_INT12: mFileSampleSize = 3; break;
+    default: mFileSampleSize = 2*sizeof(int16_t); break;
+    }
+    mChannelSampleSize = channel->config.format == StreamConfig::FMT_FLOAT32 ? 2*sizeof(float) : 2*sizeof(int16_t);
+
+#ifdef __unix__
+    int fd = open(config.path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return ReportError(errno, "StreamPlayer: cannot open %s", config.path.c_str());
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)mFileSampleSize)
+    {
+        close(fd);
+        return ReportError(EINVAL, "StreamPlayer: %s is empty", config.path.c_str());
+    }
+    mMapSize = st.st_size;
+    void* ptr = mmap(nullptr, mMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return ReportError(errno, "StreamPlayer: mmap failed");
+    mData = (const char*)ptr;
+    madvise(ptr, mMapSize, MADV_SEQUENTIAL);
+    madvise(ptr, mMapSize < readAheadSize ? mMapSize : readAheadSize, MADV_WILLNEED);
+#else
+    std::ifstream file(config.path.c_str(), std::ios::in | std::ios::binary);
+    if (!file.good())
+        return ReportError(ENOENT, "StreamPlayer: cannot open %s", config.path.c_str());
+    file.seekg(0, std::ios::end);
+    mFileBuffer.resize(file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(mFileBuffer.data(), mFileBuffer.size());
+    mData = mFileBuffer.data();
+    mMapSize = mFileBuffer.size();
+#endif
+    mSampleCount = mMapSize / mFileSampleSize;
+
+    //packed 12 bit files are always unpacked, channel INT12 format is int16 IQ
+    mPassThrough = config.fileFormat == channel->config.format && config.fileFormat != StreamConfig::FMT_INT12;
+    if (!mPassThrough)
+        mConvertBuffer.resize(chunkSize * mChannelSampleSize);
+    mSamplesSent.store(0);
+    mLoopsCompleted.store(0);
+    mTerminate.store(false);
+    mDone.store(false);
+    mThread = std::thread(&StreamPlayer::PlayLoop, this);
+    return 0;
+}
+
+int StreamPlayer::Stop()
+{
+    mTerminate.store(true);
+    if (mThread.joinable())
+        mThread.join();
+    Unmap();
+    return 0;
+}
+
+void StreamPlayer::Unmap()
+{
+#ifdef __unix__
+    if (mData)
+        munmap((void*)mData, mMapSize);
+#endif
+    mFileBuffer.clear();
+    mData = nullptr;
+    mMapSize = 0;
+}
+
+bool StreamPlayer::IsRunning() const
+{
+    return mThread.joinable() && !mDone.load();
+}
+
+StreamPlayer::Stats StreamPlayer::GetStats() const
+{
+    Stats stats;
+    stats.samplesSent = mSamplesSent.load();
+    stats.loopsCompleted = mLoopsCompleted.load();
+    stats.running = IsRunning();
+    return stats;
+}
+
+/** @brief Returns samples in channel format, converting them if file layout differs
+    @param offset index of first sample in file
+    @param count number of samples, not more than chunkSize
+*/
+const char* StreamPlayer::Convert(uint64_t offset, uint32_t count)
+{
+    const char* src = mData + offset * mFileSampleSize;
+    const StreamConfig::StreamDataFormat dstFormat = mChannel->config.format;
+    if (mPassThrough)
+        return src;
+
+    int16_t* dst16 = (int16_t*)mConvertBuffer.data();
+    float* dstFloat = (float*)mConvertBuffer.data();
+    if (mConfig.fileFormat == StreamConfig::FMT_FLOAT32)
+    {
+        const float* srcFloat = (const float*)src;
+        const float scale = dstFormat == StreamConfig::FMT_INT12 ? 2047.0f : 32767.0f;
+        for (uint32_t i = 0; i < 2*count; ++i)
+            dst16[i] = srcFloat[i] * scale;
+        return mConvertBuffer.data();
+    }
+
+    const int16_t* src16 = (const int16_t*)src;
+    if (mConfig.fileFormat == StreamConfig::FMT_INT12)
+    {
+        //unpack to 12 bit values first
+        complex16_t* dst = (complex16_t*)mConvertBuffer.data();
+        FPGA::FPGAPacketPayload2Samples((const uint8_t*)src, count * 3, false, true, &dst);
+        src16 = dst16;
+    }
+    const bool src12 = mConfig.fileFormat == StreamConfig::FMT_INT12;
+    if (dstFormat == StreamConfig::FMT_FLOAT32)
+    {
+        const float scale = src12 ? 1.0f/2047.0f : 1.0f/32767.0f;
+        //back to front, unpacked 12 bit samples share the buffer
+        for (int i = 2*count-1; i >= 0; --i)
+            dstFloat[i] = src16[i] * scale;
+    }
+    else if (dstFormat == StreamConfig::FMT_INT16 && src12)
+        for (uint32_t i = 0; i < 2*count; ++i)
+            dst16[i] = src16[i] << 4;
+    else if (dstFormat == StreamConfig::FMT_INT12 && !src12)
+        for (uint32_t i = 0; i < 2*count; ++i)
+            dst16[i] = src16[i] >> 4;
+    return mConvertBuffer.data();
+}
+
+/** @brief Blocks while samples are too far ahead of hardware
+    @param timestamp timestamp of next samples to be sent
+*/
+void StreamPlayer::Pace(uint64_t timestamp)
+{
+    if (mConfig.sampleRate <= 0)
+        return;
+    const double maxLead = mConfig.maxLead * mConfig.sampleRate;
+    Streamer* streamer = mChannel->mStreamer;
+    while (mTerminate.load(std::memory_order_relaxed) == false)
+    {
+        double lead;
+        const uint64_t rxTimestamp = streamer->rxLastTimestamp.load(std::memory_order_relaxed);
+        if (mConfig.timed && rxTimestamp != 0) //hardware time known from RX stream
+            lead = double(timestamp) - double(rxTimestamp + streamer->mTimestampOffset);
+        else
+        {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - mStartTime;
+            lead = mSamplesSent.load(std::memory_order_relaxed) - elapsed.count() * mConfig.sampleRate;
+        }
+        if (lead <= maxLead)
+            return;
+        const double wait = (lead - maxLead) / mConfig.sampleRate;
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait < 0.01 ? wait : 0.01));
+    }
+}
+
+void StreamPlayer::PlayLoop()
+{
+    uint64_t timestamp = mConfig.startTimestamp;
+    unsigned loop = 0;
+    size_t requested = readAheadSize;
+    mStartTime = std::chrono::steady_clock::now();
+    while (mTerminate.load(std::memory_order_relaxed) == false)
+    {
+        uint64_t pos = 0;
+        bool wrapRequested = false;
+        const bool lastLoop = mConfig.repeatCount != 0 && loop + 1 >= mConfig.repeatCount;
+        while (pos < mSampleCount && mTerminate.load(std::memory_order_relaxed) == false)
+        {
+            const uint32_t count = mSampleCount - pos < chunkSize ? mSampleCount - pos : chunkSize;
+#ifdef __unix__
+            //keep kernel reading ahead of playback, wrap around when looping
+            const size_t bytePos = (pos + count) * mFileSampleSize;
+            if (bytePos + readAheadSize / 2 > requested)
+            {
+                if (requested < mMapSize)
+                {
+                    const size_t page = sysconf(_SC_PAGESIZE);
+                    const size_t start = requested / page * page;
+                    const size_t len = mMapSize - start < readAheadSize ? mMapSize - start : readAheadSize;
+                    madvise((void*)(mData + start), len, MADV_WILLNEED);
+                    requested = start + len;
+                }
+                else if (!lastLoop && !wrapRequested)
+                {
+                    madvise((void*)mData, mMapSize < readAheadSize ? mMapSize : readAheadSize, MADV_WILLNEED);
+                    wrapRequested = true;
+                }
+            }
+#endif
+            const char* src = Convert(pos, count);
+            StreamChannel::Metadata meta;
+            meta.flags = mConfig.timed ? RingFIFO::SYNC_TIMESTAMP : 0;
+            if (lastLoop && pos + count == mSampleCount)
+                meta.flags |= RingFIFO::END_BURST;
+
+            Pace(timestamp);
+            uint32_t written = 0;
+            while (written < count && mTerminate.load(std::memory_order_relaxed) == false)
+            {
+                meta.timestamp = timestamp + written;
+                int ret = mChannel->Write(src + written * mChannelSampleSize, count - written, &meta, 250);
+                if (ret < 0)
+                {
+                    lime::error("StreamPlayer: write failed");
+                    mTerminate.store(true);
+                    break;
+                }
+                written += ret;
+            }
+            pos += written;
+            timestamp += written;
+            mSamplesSent.fetch_add(written, std::memory_order_relaxed);
+        }
+        if (pos < mSampleCount)
+            break;
+        requested = readAheadSize;
+        mLoopsCompleted.store(++loop);
+        if (lastLoop)
+            break;
+    }
+    mDone.store(true);
+}
@@ -0,0 +1,91 @@
+/**
+    @file StreamPlayer.h
+    @author Lime Microsystems
+    @brief Plays IQ sample files from disk into TX stream
+*/
+
+#ifndef LIME_STREAM_PLAYER_H
+#define LIME_STREAM_PLAYER_H
+
+#include "LimeSuiteConfig.h"
+#include "Streamer.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+namespace lime
+{
+
+/*!
+ * Memory maps IQ file and feeds it to TX StreamChannel from a worker thread.
+ * Samples already in the channel format are written straight from the
+ * mapping, other formats are converted through one preallocated buffer.
+ */
+class LIME_API StreamPlayer
+{
+public:
+    struct Config
+    {
+        Config();
+        std::string path;
+        /*!
+         * File sample format: FMT_INT16 - interleaved int16 IQ,
+         * FMT_INT12 - packed 12 bit IQ (3 bytes per sample),
+         * FMT_FLOAT32 - interleaved float IQ in range [-1, 1]
+         */
+        StreamConfig::StreamDataFormat fileFormat;
+        //! number of times to play file, 0 - loop until Stop()
+        unsigned repeatCount;
+        //! send samples with timestamps starting at startTimestamp
+        bool timed;
+        uint64_t startTimestamp;
+        //! if >0 keep at most maxLead seconds of samples ahead of hardware
+        double sampleRate;
+        double maxLead;
+    };
+
+    struct Stats
+    {
+        uint64_t samplesSent;
+        unsigned loopsCompleted;
+        bool running;
+    };
+
+    StreamPlayer();
+    ~StreamPlayer();
+
+    //! Opens file and starts playback, channel must be set up and started by the caller
+    int Start(StreamChannel* channel, const Config &config);
+    int Stop();
+    bool IsRunning() const;
+    Stats GetStats() const;
+
+private:
+    void PlayLoop();
+    void Pace(uint64_t timestamp);
+    const char* Convert(uint64_t offset, uint32_t count);
+    void Unmap();
+
+    Config mConfig;
+    StreamChannel* mChannel;
+    size_t mFileSampleSize;
+    size_t mChannelSampleSize;
+    bool mPassThrough; //file samples are sent straight from mapping
+    uint64_t mSampleCount;
+    const char* mData;
+    size_t mMapSize;
+    std::vector<char> mFileBuffer; //used where mmap is not available
+    std::vector<char> mConvertBuffer;
+    std::chrono::steady_clock::time_point mStartTime;
+    std::thread mThread;
+    std::atomic<bool> mTerminate;
+    std::atomic<bool> mDone;
+    std::atomic<uint64_t> mSamplesSent;
+    std::atomic<unsigned> mLoopsCompleted;
+};
+
+}
+#endif // LIME_STREAM_PLAYER_H
@@ -0,0 +1,509 @@
+/**
+    @file StreamRecorder.cpp
+    @author Lime Microsystems
+    @brief Records RX streams to disk in SigMF format
+*/
+
+#include "StreamRecorder.h"
+#include "Streamer.h"
+#include "Logger.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#define ftruncate _chsize_s
+#else
+#include <unistd.h>
+#endif
+
+using namespace lime;
+
+//direct I/O requires buffers, lengths and file offsets aligned to this
+static const size_t IO_ALIGNMENT = 4096;
+
+static char* AllocAligned(size_t bytes)
+{
+#ifdef _WIN32
+    return (char*)_aligned_malloc(bytes, IO_ALIGNMENT);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, IO_ALIGNMENT, bytes) != 0)
+        return nullptr;
+    return (char*)ptr;
+#endif
+}
+
+static void FreeAligned(char* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static std::string JsonEscape(const std::string &str)
+{
+    std::string out;
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char)c >= 0x20)
+            out += c;
+    }
+    return out;
+}
+
+StreamRecorder::Config::Config() :
+    sampleRate(0),
+    frequency(0),
+    sampleCount(0),
+    blockSize(4*1024*1024),
+    directIO(true)
+{
+}
+
+StreamRecorder::StreamRecorder() :
+    mSampleSize(4),
+    mFirstTimestamp(0),
+    mCaptureBlock(0),
+    mFd(-1),
+    mTerminate(false),
+    mCaptureDone(false),
+    mStalled(false)
+{
+    memset(&mStats, 0, sizeof(mStats));
+    for (auto &b : mBlocks)
+    {
+        b.data = nullptr;
+        b.bytes = 0;
+        b.full = false;
+    }
+}
+
+StreamRecorder::~StreamRecorder()
+{
+    Stop();
+}
+
+int StreamRecorder::Start(const std::vector<StreamChannel*> &channels, const Config &config)
+{
+    if (mCaptureThread.joinable())
+        return ReportError(EBUSY, "StreamRecorder: already recording");
+    if (channels.empty())
+        return ReportError(EINVAL, "StreamRecorder: no channels to record");
+    for (auto ch : channels)
+        if (ch == nullptr || ch->config.isTx || ch->config.format != channels[0]->config.format)
+            return ReportError(EINVAL, "StreamRecorder: channels must be RX streams of the same format");
+
+    mChannels = channels;
+    mConfig = config;
+    mConfig.blockSize = (config.blockSize + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+    if (mConfig.blockSize < 16 * IO_ALIGNMENT)
+        mConfig.blockSize = 16 * IO_ALIGNMENT;
+    if (channels[0]->config.format == StreamConfig::FMT_FLOAT32)
+    {
+        mSampleSize = 2 * sizeof(float);
+        mDatatype = "cf32_le";
+    }
+    else
+    {
+        mSampleSize = 2 * sizeof(int16_t);
+        mDatatype = "ci16_le";
+    }
+
+    for (auto &b : mBlocks)
+    {
+        b.data = AllocAligned(mConfig.blockSize);
+        b.bytes = 0;
+        b.full = false;
+        if (b.data == nullptr)
+        {
+            Stop();
+            return ReportError(ENOMEM, "StreamRecorder: failed to allocate buffers");
+        }
+    }
+
+    const std::string dataPath = mConfig.path + ".sigmf-data";
+    bool direct = false;
+    mFd = -1;
+#ifdef O_DIRECT
+    if (mConfig.directIO)
+    {
+        mFd = open(dataPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        direct = mFd >= 0;
+        if (!direct)
+            lime::warning("StreamRecorder: direct I/O not supported, using page cache");
+    }
+#endif
+    if (mFd < 0)
+        mFd = open(dataPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (mFd < 0)
+    {
+        int err = errno;
+        Stop();
+        return ReportError(err, "StreamRecorder: cannot open %s", dataPath.c_str());
+    }
+
+    char datetime[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    mDatetime = datetime;
+
+    memset(&mStats, 0, sizeof(mStats));
+    mStats.directIO = direct;
+    mStats.running = true;
+    mAnnotations.clear();
+    mFirstTimestamp = 0;
+    mCaptureBlock = 0;
+    mStalled = false;
+    mTerminate.store(false);
+    mCaptureDone.store(false);
+    mWriterThread = std::thread(&StreamRecorder::WriteLoop, this);
+    mCaptureThread = std::thread(&StreamRecorder::CaptureLoop, this);
+    return 0;
+}
+
+int StreamRecorder::Stop()
+{
+    mTerminate.store(true);
+    if (mCaptureThread.joinable())
+        mCaptureThread.join();
+    if (mWriterThread.joinable())
+        mWriterThread.join();
+
+    int status = 0;
+    if (mFd >= 0)
+    {
+        //direct I/O pads last block, cut file to recorded length
+        if (ftruncate(mFd, mStats.bytesWritten) != 0)
+            status = ReportError(errno, "StreamRecorder: failed to truncate data file");
+        close(mFd);
+        mFd = -1;
+        if (WriteMeta() != 0)
+            status = -1;
+    }
+    for (auto &b : mBlocks)
+    {
+        if (b.data)
+            FreeAligned(b.data);
+        b.data = nullptr;
+    }
+    mStats.running = false;
+    return status;
+}
+
+bool StreamRecorder::IsRunning() const
+{
+    return mCaptureThread.joinable() && !mCaptureDone.load();
+}
+
+StreamRecorder::Stats StreamRecorder::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    return mStats;
+}
+
+void StreamRecorder::CaptureLoop()
+{
+    struct ChannelData
+    {
+        std::vector<char> samples;
+        uint32_t first;      //index of first pending sample
+        uint32_t count;      //pending samples
+        uint64_t timestamp;  //timestamp of first pending sample
+    };
+
+    const size_t chCount = mChannels.size();
+    const size_t frameSize = chCount * mSampleSize;
+    const uint32_t chunk = mChannels[0]->GetStreamSize();
+    std::vector<ChannelData> chData(chCount);
+    for (auto &d : chData)
+    {
+        d.samples.resize(chunk * mSampleSize);
+        d.first = 0;
+        d.count = 0;
+        d.timestamp = 0;
+    }
+    std::vector<char> interleaved(chCount > 1 ? chunk * frameSize : 0);
+
+    uint64_t samplesCaptured = 0;
+    uint64_t expectedTs = 0;
+    bool first = true;
+    auto t1 = std::chrono::steady_clock::now();
+
+    while (mTerminate.load(std::memory_order_relaxed) == false)
+    {
+        if (mConfig.sampleCount && samplesCaptured >= mConfig.sampleCount)
+            break;
+
+        //refill drained channels, each read carries timestamp of its first sample
+        bool ready = true;
+        for (size_t ch = 0; ch < chCount && ready; ++ch)
+        {
+            ChannelData &d = chData[ch];
+            if (d.count > 0)
+                continue;
+            StreamChannel::Metadata meta;
+            meta.flags = 0;
+            meta.timestamp = 0;
+            int ret = mChannels[ch]->Read(d.samples.data(), chunk, &meta, 100);
+            if (ret <= 0)
+                ready = false;
+            else
+            {
+                d.first = 0;
+                d.count = ret;
+                d.timestamp = meta.timestamp;
+            }
+        }
+        if (!ready)
+            continue;
+
+        //samples lost on some channels only: discard others up to latest timestamp
+        uint64_t frameTs = chData[0].timestamp;
+        for (auto &d : chData)
+            frameTs = std::max(frameTs, d.timestamp);
+        for (auto &d : chData)
+        {
+            const uint64_t skip = std::min<uint64_t>(frameTs - d.timestamp, d.count);
+            d.first += skip;
+            d.count -= skip;
+            d.timestamp += skip;
+            if (d.count == 0)
+                ready = false;
+        }
+        if (!ready)
+            continue;
+
+        uint32_t n = chData[0].count;
+        for (auto &d : chData)
+            n = std::min(n, d.count);
+        if (mConfig.sampleCount && mConfig.sampleCount - samplesCaptured < n)
+            n = mConfig.sampleCount - samplesCaptured;
+
+        if (first)
+        {
+            mFirstTimestamp = frameTs;
+            first = false;
+        }
+        else if (frameTs != expectedTs)
+        {
+            Annotation gap;
+            gap.sampleStart = samplesCaptured;
+            gap.timestamp = frameTs;
+            gap.dropped = frameTs > expectedTs ? frameTs - expectedTs : 0;
+            gap.disk = mStalled;
+            std::lock_guard<std::mutex> lock(mStatsLock);
+            mAnnotations.push_back(gap);
+            mStats.gaps++;
+            mStats.droppedSamples += gap.dropped;
+        }
+        expectedTs = frameTs + n;
+
+        if (chCount == 1)
+            Append(&chData[0].samples[chData[0].first * mSampleSize], n * frameSize);
+        else
+        {
+            for (uint32_t i = 0; i < n; ++i)
+                for (size_t ch = 0; ch < chCount; ++ch)
+                    memcpy(&interleaved[i * frameSize + ch * mSampleSize], &chData[ch].samples[(chData[ch].first + i) * mSampleSize], mSampleSize);
+            Append(interleaved.data(), n * frameSize);
+        }
+        for (auto &d : chData)
+        {
+            d.first += n;
+            d.count -= n;
+            d.timestamp += n;
+        }
+        samplesCaptured += n;
+
+        auto t2 = std::chrono::steady_clock::now();
+        if (t2 - t1 >= std::chrono::milliseconds(100))
+        {
+            CheckOverruns();
+            t1 = t2;
+        }
+    }
+    CheckOverruns();
+    if (mBlocks[mCaptureBlock].bytes > 0)
+        SubmitBlock();
+    std::lock_guard<std::mutex> lock(mBlockLock);
+    mCaptureDone.store(true);
+    mBlockCond.notify_all();
+}
+
+void StreamRecorder::Append(const char* data, size_t bytes)
+{
+    while (bytes > 0)
+    {
+        Block &b = mBlocks[mCaptureBlock];
+        size_t n = mConfig.blockSize - b.bytes;
+        if (n > bytes)
+            n = bytes;
+        memcpy(b.data + b.bytes, data, n);
+        b.bytes += n;
+        data += n;
+        bytes -= n;
+        if (b.bytes == mConfig.blockSize)
+            SubmitBlock();
+    }
+}
+
+void StreamRecorder::SubmitBlock()
+{
+    std::unique_lock<std::mutex> lck(mBlockLock);
+    mBlocks[mCaptureBlock].full = true;
+    mBlockCond.notify_all();
+    mCaptureBlock ^= 1;
+    if (mBlocks[mCaptureBlock].full)
+    {
+        //writer did not finish previous block, samples pile up in stream FIFO
+        mStalled = true;
+        {
+            std::lock_guard<std::mutex> lock(mStatsLock);
+            mStats.writerStalls++;
+        }
+        mBlockCond.wait(lck, [this]{ return !mBlocks[mCaptureBlock].full; });
+    }
+}
+
+void StreamRecorder::CheckOverruns()
+{
+    uint32_t dropped = 0;
+    uint32_t overflow = 0;
+    for (auto ch : mChannels)
+    {
+        StreamChannel::Info info = ch->GetInfo();
+        dropped += info.droppedPackets;
+        overflow += info.overrun;
+    }
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    mStats.linkOverruns += dropped;
+    if (mStalled)
+        mStats.diskOverruns += overflow;
+    else
+        mStats.linkOverruns += overflow;
+    mStalled = false;
+}
+
+void StreamRecorder::WriteLoop()
+{
+    const size_t frameSize = mChannels.size() * mSampleSize;
+    int wb = 0;
+    bool failed = false;
+    uint64_t periodBytes = 0;
+    auto t1 = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        std::unique_lock<std::mutex> lck(mBlockLock);
+        mBlockCond.wait(lck, [this, wb]{ return mBlocks[wb].full || mCaptureDone.load(); });
+        if (!mBlocks[wb].full)
+            break;
+        lck.unlock();
+
+        Block &b = mBlocks[wb];
+        const size_t length = b.bytes;
+        const size_t aligned = (length + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+        if (aligned > length)
+            memset(b.data + length, 0, aligned - length);
+        size_t written = 0;
+        while (!failed && written < aligned)
+        {
+            auto ret = write(mFd, b.data + written, aligned - written);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                ReportError(errno, "StreamRecorder: write failed");
+                failed = true;
+                mTerminate.store(true); //keep draining blocks so capture does not block
+                break;
+            }
+            written += ret;
+        }
+
+        periodBytes += length;
+        auto t2 = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mStatsLock);
+            if (!failed)
+            {
+                mStats.bytesWritten += length;
+                mStats.samplesWritten = mStats.bytesWritten / frameSize;
+            }
+            auto period = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            if (period >= 1000)
+            {
+                mStats.throughput_Bps = 1000.0 * periodBytes / period;
+                periodBytes = 0;
+                t1 = t2;
+            }
+        }
+
+        lck.lock();
+        b.bytes = 0;
+        b.full = false;
+        mBlockCond.notify_all();
+        wb ^= 1;
+    }
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    mStats.running = false;
+}
+
+int StreamRecorder::WriteMeta()
+{
+    const std::string metaPath = mConfig.path + ".sigmf-meta";
+    std::ofstream meta(metaPath.c_str());
+    if (!meta.good())
+        return ReportError(errno, "StreamRecorder: cannot write %s", metaPath.c_str());
+
+    meta << std::setprecision(15);
+    meta << "{\n  \"global\": {\n";
+    meta << "    \"core:datatype\": \"" << mDatatype << "\",\n";
+    meta << "    \"core:sample_rate\": " << mConfig.sampleRate << ",\n";
+    meta << "    \"core:version\": \"1.0.0\",\n";
+    meta << "    \"core:num_channels\": " << mChannels.size() << ",\n";
+    meta << "    \"core:recorder\": \"LimeSuite\",\n";
+    meta << "    \"core:extensions\": [{\"name\": \"lime\", \"version\": \"1.0.0\", \"optional\": true}],\n";
+    if (!mConfig.hardware.empty())
+        meta << "    \"core:hw\": \"" << JsonEscape(mConfig.hardware) << "\",\n";
+    if (!mConfig.description.empty())
+        meta << "    \"core:description\": \"" << JsonEscape(mConfig.description) << "\",\n";
+    meta << "    \"lime:disk_overruns\": " << mStats.diskOverruns << ",\n";
+    meta << "    \"lime:link_overruns\": " << mStats.linkOverruns << "\n";
+    meta << "  },\n";
+
+    //every discontinuity starts a new capture segment with its own timestamp
+    meta << "  \"captures\": [\n";
+    meta << "    {\"core:sample_start\": 0, \"core:frequency\": " << mConfig.frequency
+         << ", \"core:datetime\": \"" << mDatetime << "\", \"lime:timestamp\": " << mFirstTimestamp << "}";
+    for (const auto &a : mAnnotations)
+        meta << ",\n    {\"core:sample_start\": " << a.sampleStart << ", \"core:frequency\": " << mConfig.frequency
+             << ", \"lime:timestamp\": " << a.timestamp << "}";
+    meta << "\n  ],\n";
+
+    meta << "  \"annotations\": [";
+    for (size_t i = 0; i < mAnnotations.size(); ++i)
+    {
+        const auto &a = mAnnotations[i];
+        const char* cause = a.disk ? "disk" : "link";
+        meta << (i ? ",\n" : "\n") << "    {\"core:sample_start\": " << a.sampleStart
+             << ", \"core:comment\": \"" << a.dropped << " samples dropped (" << cause << ")\""
+             << ", \"lime:dropped_samples\": " << a.dropped << ", \"lime:cause\": \"" << cause << "\"}";
+    }
+    meta << (mAnnotations.empty() ? "]\n" : "\n  ]\n");
+    meta << "}\n";
+    return meta.good() ? 0 : ReportError(EIO, "StreamRecorder: failed to write meta file");
+}
@@ -0,0 +1,127 @@
+/**
+    @file StreamRecorder.h
+    @author Lime Microsystems
+    @brief Records RX streams to disk in SigMF format
+*/
+
+#ifndef LIME_STREAM_RECORDER_H
+#define LIME_STREAM_RECORDER_H
+
+#include "LimeSuiteConfig.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace lime
+{
+
+class StreamChannel;
+
+/*!
+ * Captures one or more RX stream channels into a SigMF recording.
+ * A capture thread fills one of two aligned blocks while a writer thread
+ * stores the other one using direct I/O, bypassing the page cache.
+ * Channels are aligned by hardware timestamp and interleaved sample by
+ * sample in the data file. Samples lost on any channel are dropped on all
+ * of them, timestamp discontinuities are stored as annotations in the meta file.
+ */
+class LIME_API StreamRecorder
+{
+public:
+    struct Config
+    {
+        Config();
+        //! output path without extension, .sigmf-data and .sigmf-meta are appended
+        std::string path;
+        double sampleRate;
+        double frequency;
+        //! samples per channel to record, 0 - record until Stop()
+        uint64_t sampleCount;
+        //! size of each of the two capture blocks in bytes
+        size_t blockSize;
+        //! use O_DIRECT when the file system supports it
+        bool directIO;
+        std::string description;
+        std::string hardware;
+    };
+
+    struct Stats
+    {
+        uint64_t samplesWritten; //per channel
+        uint64_t bytesWritten;
+        double throughput_Bps; //disk write rate over last second
+        uint32_t gaps;
+        uint64_t droppedSamples;
+        uint32_t linkOverruns; //packets lost on the link or FIFO overflows while writer kept up
+        uint32_t diskOverruns; //FIFO overflows while capture waited for the writer
+        uint32_t writerStalls; //times capture had to wait for a free block
+        bool directIO;
+        bool running;
+    };
+
+    StreamRecorder();
+    ~StreamRecorder();
+
+    /*!
+     * Starts recording, channels must be set up and started by the caller.
+     * All channels must use the same sample format.
+     * @return 0 on success, -1 on failure
+     */
+    int Start(const std::vector<StreamChannel*> &channels, const Config &config);
+    //! Stops recording and writes SigMF meta file
+    int Stop();
+    bool IsRunning() const;
+    Stats GetStats();
+
+private:
+    struct Block
+    {
+        char* data;
+        size_t bytes;
+        bool full;
+    };
+
+    struct Annotation
+    {
+        uint64_t sampleStart;
+        uint64_t timestamp;
+        uint64_t dropped;
+        bool disk;
+    };
+
+    void CaptureLoop();
+    void WriteLoop();
+    void Append(const char* data, size_t bytes);
+    void SubmitBlock();
+    void CheckOverruns();
+    int WriteMeta();
+
+    Config mConfig;
+    std::vector<StreamChannel*> mChannels;
+    size_t mSampleSize;
+    std::string mDatatype;
+    std::string mDatetime;
+    uint64_t mFirstTimestamp;
+
+    Block mBlocks[2];
+    int mCaptureBlock;
+    int mFd;
+    std::mutex mBlockLock;
+    std::condition_variable mBlockCond;
+    std::thread mCaptureThread;
+    std::thread mWriterThread;
+    std::atomic<bool> mTerminate;
+    std::atomic<bool> mCaptureDone;
+    bool mStalled;
+
+    std::mutex mStatsLock;
+    Stats mStats;
+    std::vector<Annotation> mAnnotations;
+};
+
+}
+#endif // LIME_STREAM_RECORDER_H
@@ -0,0 +1,264 @@
+/**
+    @file SweepEngine.cpp
+    @author Lime Microsystems
+    @brief Pipelined RX frequency sweep overlapping LO preparation with capture
+*/
+
+#include "SweepEngine.h"
+#include "LMS7002M.h"
+#include "Logger.h"
+#include <errno.h>
+#include <string.h>
+#include <cmath>
+#include <chrono>
+
+using namespace lime;
+
+static const uint16_t sxAddress = 0x011C;
+static const int sxRegisters = 6;
+
+static uint16_t SetBits(uint16_t value, const LMS7Parameter &param, uint16_t bits)
+{
+    const uint16_t mask = ((1 << (param.msb - param.lsb + 1)) - 1) << param.lsb;
+    return (value & ~mask) | ((bits << param.lsb) & mask);
+}
+
+static double Elapsed(std::chrono::high_resolution_clock::time_point from, std::chrono::high_resolution_clock::time_point to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+SweepEngine::Config::Config() :
+    pingPong(false),
+    sampleRate(0),
+    dwellSamples(4096),
+    settleTime(100e-6),
+    switchSettleTime(10e-6),
+    ncoSettleTime(5e-6),
+    latency(1e-3)
+{
+}
+
+SweepEngine::SweepEngine(LMS7002M* chip, StreamChannel* stream) :
+    mChip(chip),
+    mStream(stream),
+    mPrepared(false)
+{
+}
+
+uint64_t SweepEngine::ToSamples(double time) const
+{
+    return uint64_t(std::ceil(time * mConfig.sampleRate));
+}
+
+int SweepEngine::Prepare(const Config &config)
+{
+    mPrepared = false;
+    if (mChip == nullptr || mStream == nullptr || mStream->config.isTx)
+        return ReportError(EINVAL, "SweepEngine: RX stream and its chip are required");
+    if (config.frequencies.empty() || config.dwellSamples == 0 || config.sampleRate <= 0)
+        return ReportError(EINVAL, "SweepEngine: empty frequency plan, dwell or sample rate");
+    if (config.ncoOffsets.size() > 16)
+        return ReportError(EINVAL, "SweepEngine: NCO has only 16 frequency registers");
+    mConfig = config;
+
+    //full VCO tuning of every LO, registers are replayed by Run()
+    mLO.clear();
+    for (size_t i = 0; i < config.frequencies.size(); ++i)
+    {
+        LOImage lo;
+        lo.frequency = config.frequencies[i];
+        lo.sxt = config.pingPong && (i & 1);
+        if (mChip->SetFrequencySX(lo.sxt, lo.frequency) != 0)
+            return -1;
+        for (int r = 0; r < sxRegisters; ++r)
+            lo.regs[r] = mChip->SPI_read_cached(lo.sxt ? 1 : 0, sxAddress + r);
+        mLO.push_back(lo);
+    }
+
+    if (!config.ncoOffsets.empty())
+    {
+        const LMS7002M::Channel ch = mChip->GetActiveChannel(false);
+        mChip->SetActiveChannel(mStream->config.channelID ? LMS7002M::ChB : LMS7002M::ChA);
+        int status = 0;
+        status |= mChip->Modify_SPI_Reg_bits(LMS7param(CMIX_BYP_RXTSP), 0);
+        status |= mChip->Modify_SPI_Reg_bits(LMS7param(CMIX_GAIN_RXTSP), 1);
+        status |= mChip->Modify_SPI_Reg_bits(LMS7param(MODE_RX), 0);
+        for (size_t i = 0; i < config.ncoOffsets.size(); ++i)
+            status |= mChip->SetNCOFrequency(false, i, std::fabs(config.ncoOffsets[i]));
+        mChip->SetActiveChannel(ch);
+        if (status != 0)
+            return -1;
+    }
+    mPrepared = true;
+    return 0;
+}
+
+/** @brief Adds synthesizer registers of LO to batch
+    @param active RX LO is switched to this synthesizer, otherwise it is only
+    programmed: idle SXT locks with its LO buffer to RX disabled, idle SXR
+    stays powered down because SXT drives RX LO
+*/
+void SweepEngine::AddLO(std::vector<uint16_t> &addr, std::vector<uint16_t> &data, const LOImage &lo, bool active) const
+{
+    const uint16_t mac = mChip->SPI_read_cached(0, LMS7param(MAC).address);
+    addr.push_back(LMS7param(MAC).address);
+    data.push_back(SetBits(mac, LMS7param(MAC), lo.sxt ? LMS7002M::ChSXT : LMS7002M::ChSXR));
+    for (int r = 0; r < sxRegisters; ++r)
+    {
+        uint16_t value = lo.regs[r];
+        if (r == 0 && lo.sxt)
+            value = SetBits(value, LMS7param(PD_LOCH_T2RBUF), active ? 0 : 1);
+        else if (r == 0)
+            value = SetBits(value, LMS7param(PD_VCO), active ? 0 : 1);
+        addr.push_back(sxAddress + r);
+        data.push_back(value);
+    }
+    if (!active)
+        return;
+
+    //other synthesizer stops driving RX LO
+    addr.push_back(LMS7param(MAC).address);
+    data.push_back(SetBits(mac, LMS7param(MAC), lo.sxt ? LMS7002M::ChSXR : LMS7002M::ChSXT));
+    const uint16_t other = mChip->SPI_read_cached(lo.sxt ? 0 : 1, sxAddress);
+    addr.push_back(sxAddress);
+    if (lo.sxt)
+        data.push_back(SetBits(other, LMS7param(PD_VCO), 1));
+    else
+        data.push_back(SetBits(other, LMS7param(PD_LOCH_T2RBUF), 1));
+}
+
+void SweepEngine::AddNCO(std::vector<uint16_t> &addr, std::vector<uint16_t> &data, unsigned index) const
+{
+    const unsigned ch = mStream->config.channelID ? 1 : 0;
+    const uint16_t mac = mChip->SPI_read_cached(0, LMS7param(MAC).address);
+    const double offset = mConfig.ncoOffsets[index];
+    //same spectrum control as LMS7_Device::SetNCOFreq()
+    bool down = offset < 0;
+    if ((mChip->SPI_read_cached(0, LMS7param(MASK).address) & 0x3F) == 0)
+        down = !down;
+
+    addr.push_back(LMS7param(MAC).address);
+    data.push_back(SetBits(mac, LMS7param(MAC), ch ? LMS7002M::ChB : LMS7002M::ChA));
+    addr.push_back(LMS7param(CMIX_SC_RXTSP).address);
+    data.push_back(SetBits(mChip->SPI_read_cached(ch, LMS7param(CMIX_SC_RXTSP).address), LMS7param(CMIX_SC_RXTSP), down));
+    addr.push_back(LMS7param(SEL_RX).address);
+    data.push_back(SetBits(mChip->SPI_read_cached(ch, LMS7param(SEL_RX).address), LMS7param(SEL_RX), index));
+}
+
+//! Writes batch with restored MAC, registers matching cache are skipped
+int SweepEngine::WriteBatch(std::vector<uint16_t> &addr, std::vector<uint16_t> &data)
+{
+    addr.push_back(LMS7param(MAC).address);
+    data.push_back(mChip->SPI_read_cached(0, LMS7param(MAC).address));
+    const int status = mChip->SPI_write_batch(addr.data(), data.data(), addr.size());
+    addr.clear();
+    data.clear();
+    return status;
+}
+
+int SweepEngine::Run(const Callback &callback)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    if (!mPrepared)
+        return ReportError(EINVAL, "SweepEngine: Prepare() was not called");
+
+    const unsigned subSteps = mConfig.ncoOffsets.empty() ? 1 : mConfig.ncoOffsets.size();
+    const size_t sampleSize = mStream->config.format == StreamConfig::FMT_FLOAT32 ? 2 * sizeof(float) : 2 * sizeof(int16_t);
+    const uint32_t dwell = mConfig.dwellSamples;
+    std::vector<char> buffer(dwell * sampleSize);
+    std::vector<uint16_t> addr;
+    std::vector<uint16_t> data;
+    mTiming.clear();
+
+    for (unsigned step = 0; step < mLO.size(); ++step)
+    {
+        const LOImage &lo = mLO[step];
+        for (unsigned sub = 0; sub < subSteps; ++sub)
+        {
+            StepTiming timing;
+            memset(&timing, 0, sizeof(timing));
+            const auto t0 = clock::now();
+
+            double settle = mConfig.ncoSettleTime;
+            if (sub == 0)
+            {
+                AddLO(addr, data, lo, true);
+                settle = lo.sxt ? mConfig.switchSettleTime : mConfig.settleTime;
+            }
+            if (!mConfig.ncoOffsets.empty())
+                AddNCO(addr, data, sub);
+            if (WriteBatch(addr, data) != 0)
+                return -1;
+            //samples newer than received ones may still be in flight with old LO
+            const uint64_t switchTimestamp = mStream->mStreamer->rxLastTimestamp.load(std::memory_order_relaxed) + ToSamples(mConfig.latency);
+            const uint64_t threshold = switchTimestamp + ToSamples(settle);
+            const auto t1 = clock::now();
+
+            //idle synthesizer gets next LO while this step settles and captures
+            if (mConfig.pingPong && sub == 0 && step + 1 < mLO.size())
+            {
+                AddLO(addr, data, mLO[step + 1], false);
+                if (WriteBatch(addr, data) != 0)
+                    return -1;
+            }
+            const auto t2 = clock::now();
+
+            uint32_t collected = 0;
+            uint64_t firstTimestamp = 0;
+            auto t3 = t2;
+            while (collected < dwell)
+            {
+                StreamChannel::Metadata meta;
+                char* dest = buffer.data() + collected * sampleSize;
+                const int count = mStream->Read(dest, dwell - collected, &meta, 1000);
+                if (count <= 0)
+                    return ReportError(ETIMEDOUT, "SweepEngine: no RX samples at step %u", step);
+                uint32_t skip = 0;
+                if (meta.timestamp < threshold)
+                    skip = std::min<uint64_t>(threshold - meta.timestamp, count);
+                if (collected > 0 && meta.timestamp != firstTimestamp + collected)
+                {
+                    //samples were lost, block restarts after the gap
+                    timing.droppedSamples += collected;
+                    collected = 0;
+                }
+                timing.droppedSamples += skip;
+                if (skip == uint32_t(count))
+                    continue;
+                if (collected == 0)
+                {
+                    firstTimestamp = meta.timestamp + skip;
+                    t3 = clock::now();
+                }
+                memmove(buffer.data() + collected * sampleSize, dest + skip * sampleSize, (count - skip) * sampleSize);
+                collected += count - skip;
+            }
+            const auto t4 = clock::now();
+
+            timing.switchTime = Elapsed(t0, t1);
+            timing.prepareTime = Elapsed(t1, t2);
+            timing.settleTime = Elapsed(t1, t3);
+            timing.captureTime = Elapsed(t3, t4);
+            timing.stepTime = Elapsed(t0, t4);
+            mTiming.push_back(timing);
+
+            Block block;
+            block.step = step;
+            block.subStep = sub;
+            block.loFrequency = lo.frequency;
+            block.ncoOffset = mConfig.ncoOffsets.empty() ? 0 : mConfig.ncoOffsets[sub];
+            block.sxt = lo.sxt;
+            block.timestamp = firstTimestamp;
+            block.switchTimestamp = switchTimestamp;
+            if (!callback(block, buffer.data(), dwell))
+                return 0;
+        }
+    }
+    return 0;
+}
+
+const std::vector<SweepEngine::StepTiming>& SweepEngine::GetTiming() const
+{
+    return mTiming;
+}
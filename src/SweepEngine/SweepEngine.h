@@ -0,0 +1,136 @@
+/**
+    @file SweepEngine.h
+    @author Lime Microsystems
+    @brief Pipelined RX frequency sweep overlapping LO preparation with capture
+*/
+
+#ifndef LIME_SWEEP_ENGINE_H
+#define LIME_SWEEP_ENGINE_H
+
+#include "LimeSuiteConfig.h"
+#include "Streamer.h"
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+namespace lime
+{
+
+class LMS7002M;
+
+/*!
+ * Steps RX LO over a frequency plan while the RX stream keeps running.
+ * Every LO is tuned once in Prepare() and its synthesizer registers are
+ * kept, so a retune is a single batched SPI write without VCO tuning.
+ * Each LO step can be split further into sub-steps by TSP NCO offsets
+ * that are loaded to the NCO frequency table once and selected by one
+ * register write. With ping-pong enabled RX LO alternates between SXR
+ * and SXT (TDD LO buffer): idle SXT is programmed and locks while
+ * current step is captured, so switching to it only changes LO buffers.
+ * Samples received before a switch took effect and during settling are
+ * dropped by timestamp, delivered blocks carry LO/NCO state of the step.
+ * Steps on SXR disable TDD LO sharing, RX LO is left at the last step.
+ */
+class LIME_API SweepEngine
+{
+public:
+    struct Config
+    {
+        Config();
+        //! RX LO frequencies in Hz, in sweep order
+        std::vector<double> frequencies;
+        //! NCO offsets in Hz (up to 16) captured at every LO, empty - NCO not used
+        std::vector<double> ncoOffsets;
+        //! alternate RX LO between SXR and SXT, TX LO is owned by sweep in this mode
+        bool pingPong;
+        //! RX sample rate of stream in Hz, used to convert times to samples
+        double sampleRate;
+        //! samples delivered per step
+        uint32_t dwellSamples;
+        //! dropped time after retuning synthesizer driving RX LO
+        double settleTime;
+        //! dropped time after switching RX LO to already locked SXT
+        double switchSettleTime;
+        //! dropped time after NCO change, covers TSP filter delay
+        double ncoSettleTime;
+        //! worst case age of newest received sample, time from sampling to host
+        double latency;
+    };
+
+    //! LO/NCO state of delivered samples
+    struct Block
+    {
+        unsigned step;
+        unsigned subStep;
+        double loFrequency;
+        //! NCO offset, same sign convention as LMS_SetNCOFrequency()
+        double ncoOffset;
+        //! true when RX LO was driven by SXT
+        bool sxt;
+        //! timestamp of first delivered sample
+        uint64_t timestamp;
+        //! first timestamp that could be affected by the switch
+        uint64_t switchTimestamp;
+    };
+
+    //! Host time of one sub-step, seconds
+    struct StepTiming
+    {
+        //! batched switch write
+        double switchTime;
+        //! programming of idle synthesizer for next step
+        double prepareTime;
+        //! from end of switch write until first kept sample was read
+        double settleTime;
+        //! reading of dwell samples
+        double captureTime;
+        double stepTime;
+        uint64_t droppedSamples;
+    };
+
+    /** @brief Receives samples of every sub-step in stream format
+        @return false to stop sweep
+    */
+    typedef std::function<bool(const Block &block, const void* samples, uint32_t count)> Callback;
+
+    /** @param chip transceiver providing RX LO
+        @param stream started RX stream of the chip
+    */
+    SweepEngine(LMS7002M* chip, StreamChannel* stream);
+
+    /** @brief Tunes every LO of the plan, stores synthesizer registers and
+        loads NCO offsets. Slow, done once per plan.
+        @return 0-success, other-failure
+    */
+    int Prepare(const Config &config);
+    /** @brief Runs one pass over prepared plan
+        @return 0-success or stopped by callback, other-failure
+    */
+    int Run(const Callback &callback);
+    //! Timing of sub-steps of last Run()
+    const std::vector<StepTiming>& GetTiming() const;
+
+private:
+    //! synthesizer registers 0x011C-0x0121 of one LO
+    struct LOImage
+    {
+        double frequency;
+        bool sxt;
+        uint16_t regs[6];
+    };
+
+    void AddLO(std::vector<uint16_t> &addr, std::vector<uint16_t> &data, const LOImage &lo, bool active) const;
+    void AddNCO(std::vector<uint16_t> &addr, std::vector<uint16_t> &data, unsigned index) const;
+    int WriteBatch(std::vector<uint16_t> &addr, std::vector<uint16_t> &data);
+    uint64_t ToSamples(double time) const;
+
+    LMS7002M* mChip;
+    StreamChannel* mStream;
+    Config mConfig;
+    std::vector<LOImage> mLO;
+    std::vector<StepTiming> mTiming;
+    bool mPrepared;
+};
+
+}
+#endif // LIME_SWEEP_ENGINE_H
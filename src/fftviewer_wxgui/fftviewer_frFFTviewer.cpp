@@ -3,11 +3,10 @@
 #include <vector>
 #include "OpenGLGraph.h"
 #include <LMSBoards.h>
-#include "kiss_fft.h"
+#include "SpectrumEngine.h"
 #include "IConnection.h"
 #include "dataTypes.h"
 #include "LMS7002M.h"
-#include "windowFunction.h"
 #include <fstream>
 #include "lms7suiteEvents.h"
 #include "lms7_device.h"
@@ -359,8 +358,11 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
         if (pthis->cmbChannelVisibility->GetSelection() == 1)
             ch_offset = 1;
     }
-    vector<float> wndCoef;
-    GenerateWindowCoefficients(wndFunction, fftSize, wndCoef, 1);
+    SpectrumEngine spectrum;
+    SpectrumEngine::Config spectrumConfig;
+    spectrumConfig.fftSize = fftSize;
+    spectrumConfig.windowFunction = wndFunction;
+    spectrum.Configure(spectrumConfig, channelsCount);
 
     lime::complex16_t** buffers;
 
@@ -413,10 +415,6 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
             LMS_SetupStream(pthis->lmsControl, &pthis->txStreams[i]);
     }
 
-    kiss_fft_cfg m_fftCalcPlan = kiss_fft_alloc(fftSize, 0, 0, 0);
-    kiss_fft_cpx* m_fftCalcIn = new kiss_fft_cpx[fftSize];
-    kiss_fft_cpx* m_fftCalcOut = new kiss_fft_cpx[fftSize];
-
     for(int i=0; i<channelsCount; ++i)
     {
         LMS_StartStream(&pthis->rxStreams[i]);
@@ -470,61 +468,23 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
                 }
             }
 
+            //take only first buffer for time domain display
             for (int ch = 0; ch < channelsCount; ++ch)
-            {
-                //take only first buffer for time domain display
-                //reset fftBins for accumulation
                 for (unsigned i = 0; fftCounter==0 && i < fftSize; ++i)
                 {
-                    if (fftEnabled)
-                        localDataResults.fftBins[ch][i] = 0;
                     localDataResults.samplesI[ch][i] = buffers[ch][i].i;
                     localDataResults.samplesQ[ch][i] = buffers[ch][i].q;
                 }
-                if (fftEnabled)
-                {
-                    if (wndFunction == 0)
-                    {
-                        for (unsigned i = 0; i < fftSize; ++i)
-                        {
-                            m_fftCalcIn[i].r = buffers[ch][i].i;
-                            m_fftCalcIn[i].i = buffers[ch][i].q;
-                        }
-                    }
-                    else
-                    {
-                        for (unsigned i = 0; i < fftSize; ++i)
-                        {
-                            m_fftCalcIn[i].r = buffers[ch][i].i * wndCoef[i];
-                            m_fftCalcIn[i].i = buffers[ch][i].q * wndCoef[i];
-                        }
-                    }
-
-                    kiss_fft(m_fftCalcPlan, m_fftCalcIn, m_fftCalcOut);
-
-                    int output_index = 0;
-                    for (unsigned i = fftSize / 2 + 1; i < fftSize; ++i)
-                        localDataResults.fftBins[ch][output_index++] += m_fftCalcOut[i].r * m_fftCalcOut[i].r + m_fftCalcOut[i].i * m_fftCalcOut[i].i;
-                    for (unsigned i = 0; i < fftSize / 2 + 1; ++i)
-                        localDataResults.fftBins[ch][output_index++] += m_fftCalcOut[i].r * m_fftCalcOut[i].r + m_fftCalcOut[i].i * m_fftCalcOut[i].i;
-                }
-            }
+            //channels are transformed in parallel and averaged by engine
+            if (fftEnabled)
+                spectrum.Process(buffers, fftSize);
         } while (++fftCounter < avgCount && pthis->stopProcessing.load() == false);
 
         if (fftCounter >= avgCount && pthis->updateGUI.load() == true)
         {
-            //shift fft
             if (fftEnabled)
-            {
                 for(int ch=0; ch<channelsCount; ++ch)
-                {
-                    for (unsigned s = 0; s < fftSize; ++s)
-                    {
-                        const float div = (float)fftCounter*fftSize*fftSize;
-                        localDataResults.fftBins[ch][s] /= div;
-                    }
-                }
-            }
+                    spectrum.GetSpectrum(ch, localDataResults.fftBins[ch].data());
             if(pthis->stopProcessing.load() == false)
             {
                 pthis->streamData = localDataResults;
@@ -540,7 +500,7 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
             if(wndFunctionSelection != wndFunction)
             {
                 wndFunction = wndFunctionSelection;
-                GenerateWindowCoefficients(wndFunction, fftSize, wndCoef, 1);
+                spectrum.SetWindowFunction(wndFunction);
             }
         }
     }
@@ -585,7 +545,6 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
         fout.close();
     }
 
-    kiss_fft_free(m_fftCalcPlan);
     pthis->stopProcessing.store(true);
     pthis->mStreamRunning.store(false);
     for(int i=0; i<channelsCount; ++i)
@@ -603,8 +562,6 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
     for (int i = 0; i < channelsCount; ++i)
         delete [] buffers[i];
     delete [] buffers;
-    delete [] m_fftCalcIn;
-    delete [] m_fftCalcOut;
 }
 
 wxString fftviewer_frFFTviewer::printDataRate(float dataRate)
@@ -512,6 +512,25 @@ API_EXPORT int CALL_CONV LMS_SetGFIRLPF(lms_device_t *device, bool dir_tx,
 API_EXPORT int CALL_CONV LMS_Calibrate(lms_device_t *device, bool dir_tx,
                                         size_t chan, double bw, unsigned flags);
 
+/**
+ * Perform the automatic calibration of several RX/TX channels. Channels of
+ * different RF chips are calibrated concurrently, channels of the same chip
+ * one after another.
+ *
+ * @pre Device should be configured
+ *
+ * @param   device      Device handle previously obtained by LMS_Open().
+ * @param   dir_tx      Select RX or TX
+ * @param   chans       channel indexes
+ * @param   count       number of channels in chans
+ * @param   bw          bandwidth
+ * @param   flags       additional calibration flags (normally should be 0)
+ *
+ * @return  0 on success, (-1) on failure of any channel
+ */
+API_EXPORT int CALL_CONV LMS_CalibrateChannels(lms_device_t *device, bool dir_tx,
+                                const size_t *chans, size_t count, double bw, unsigned flags);
+
 /**
  * Load LMS chip configuration from a file
  *
@@ -536,6 +555,32 @@ API_EXPORT int CALL_CONV LMS_LoadConfig(lms_device_t *device, const char *filena
  */
 API_EXPORT int CALL_CONV LMS_SaveConfig(lms_device_t *device, const char *filename);
 
+/**
+ * Load complete device state from a binary snapshot file
+ *
+ * Snapshot contains LMS chip registers of all chips (including calibration
+ * corrections and GFIR coefficients), reference clocks, FPGA control
+ * registers and channel settings. Only registers that differ from current
+ * state are written when register cache is enabled. PLLs are retuned only if
+ * they do not lock with stored settings.
+ *
+ * @param   device      Device handle
+ * @param   filename    path to snapshot file
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_LoadSnapshot(lms_device_t *device, const char *filename);
+
+/**
+ * Save complete device state to a binary snapshot file
+ *
+ * @param   device      Device handle
+ * @param   filename    path to snapshot file
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SaveSnapshot(lms_device_t *device, const char *filename);
+
 /**
  * Apply the specified test signal
  *
@@ -1066,6 +1111,9 @@ typedef struct
  */
 ///Attempt to align channel phases in MIMO mode (supported only for Rx channels)
 #define LMS_ALIGN_CH_PHASE (1<<16)
+///TX samples are written into transfer buffers with LMS_AcquireTxBuffer()
+///and LMS_CommitTxBuffer() instead of LMS_SendStream()
+#define LMS_DIRECT_TX_BUFFERS (1<<17)
 /** @} (End STREAM_CH_FLAGS) */
 
 /**Stream structure*/
@@ -1084,7 +1132,7 @@ typedef struct
      * Can be combined with additional flags  (\ref STREAM_CH_FLAGS)*/
     uint32_t channel;
 
-    //! FIFO size (in samples) used by stream.
+    //! FIFO size (in samples) used by stream, 0 - sized for 0.25 s at sample rate
     uint32_t fifoSize;
 
     /** @brief
@@ -1167,6 +1215,18 @@ API_EXPORT int CALL_CONV LMS_DestroyStream(lms_device_t *dev, lms_stream_t *stre
  */
 API_EXPORT int CALL_CONV LMS_StartStream(lms_stream_t *stream);
 
+/**
+ * Prepare start of streams set up on the same RF chip. FPGA configuration,
+ * buffer reset and stream threads are done here, so the following
+ * LMS_StartStream() only sends one register transfer. Needs to be repeated
+ * after every stop, setting up or destroying a stream cancels it.
+ *
+ * @param stream Stream structure previously initialized with LMS_SetupStream().
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_ArmStream(lms_stream_t *stream);
+
 /**
  * Stop stream
  *
@@ -1176,6 +1236,35 @@ API_EXPORT int CALL_CONV LMS_StartStream(lms_stream_t *stream);
  */
 API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream);
 
+/**
+ * Set CPU affinity, SCHED_FIFO priority and buffer placement of the thread
+ * serving the stream. RX and TX threads are shared by both channels of the
+ * same direction. Settings are applied when the thread is started by
+ * LMS_StartStream() and are refused while any stream of the chip is running.
+ *
+ * @param stream    Stream structure previously initialized with LMS_SetupStream().
+ * @param cpus      CPU list, e.g. "2,4-5", NULL or empty for no restriction
+ * @param priority  SCHED_FIFO priority 1-99, 0 for library default
+ * @param numaNode  NUMA node for stream buffers, -1 for node of the first CPU
+ * @param hugePages Back stream buffers with huge pages when available
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamThreadParams(lms_stream_t *stream, const char *cpus, int priority, int numaNode, bool hugePages);
+
+/**
+ * Set CPU affinity and SCHED_FIFO priority of the USB event thread completing
+ * stream transfers. The thread is shared by all devices of the same type.
+ * Settings are refused while any stream of the chip is running.
+ *
+ * @param stream    Stream structure previously initialized with LMS_SetupStream().
+ * @param cpus      CPU list, e.g. "1", NULL or empty for no restriction
+ * @param priority  SCHED_FIFO priority 1-99, 0 for library default
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetUSBThreadParams(lms_stream_t *stream, const char *cpus, int priority);
+
 /**
  * Read samples from the FIFO of the specified stream.
  * Sample buffer must be big enough to hold requested number of samples.
@@ -1201,6 +1290,44 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream);
  */
 API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_status_t* status);
 
+/**
+ * Get current hardware timestamp estimated from host monotonic clock.
+ * Unlike lms_stream_status_t::timestamp it does not lag by the size of RX
+ * transfers. The estimate is fitted while RX stream is running, the constant
+ * USB/PCIe latency is not observable and is not included.
+ *
+ * @param device    Device handle previously obtained by LMS_Open().
+ * @param ticks     Hardware timestamp (samples).
+ * @param error     Estimate error bound in samples, can be NULL.
+ *
+ * @return  0 on success, (-1) on failure or if RX stream has not run long enough
+ */
+API_EXPORT int CALL_CONV LMS_GetHardwareTime(lms_device_t *device, uint64_t *ticks, double *error);
+
+/**
+ * Convert host monotonic clock time (C++ steady_clock, CLOCK_MONOTONIC on
+ * Linux) to hardware timestamp. See LMS_GetHardwareTime().
+ *
+ * @param device    Device handle previously obtained by LMS_Open().
+ * @param host_ns   Host time in nanoseconds.
+ * @param ticks     Hardware timestamp (samples).
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_HostToHardwareTime(lms_device_t *device, int64_t host_ns, uint64_t *ticks);
+
+/**
+ * Convert hardware timestamp to host monotonic clock time, e.g. to find when
+ * timed transmission starts. See LMS_HostToHardwareTime().
+ *
+ * @param device    Device handle previously obtained by LMS_Open().
+ * @param ticks     Hardware timestamp (samples).
+ * @param host_ns   Host time in nanoseconds.
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_HardwareToHostTime(lms_device_t *device, uint64_t ticks, int64_t *host_ns);
+
 /**
  * Write samples to the FIFO of the specified stream.
  *
@@ -1216,6 +1343,37 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream,
                             const void *samples,size_t sample_count,
                             const lms_stream_meta_t *meta, unsigned timeout_ms);
 
+/**
+ * Get payload of the next TX packet of stream set up with
+ * LMS_DIRECT_TX_BUFFERS. Samples are written in link format: I and Q
+ * int16 for LMS_LINK_FMT_I16, 12-bit I and Q packed in 3 bytes for
+ * LMS_LINK_FMT_I12. When both channels of the RF chip are streaming,
+ * packet holds samples of both channels interleaved (A0 B0 A1 B1...).
+ * Calling again before LMS_CommitTxBuffer() returns the same packet.
+ *
+ * @param stream        TX stream previously initialized with LMS_SetupStream().
+ * @param payload       Receives packet payload address.
+ * @param timeout_ms    how long to wait for free buffer.
+ *
+ * @return samples per channel that fit packet, 0 on timeout, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_AcquireTxBuffer(lms_stream_t *stream, void **payload,
+                            unsigned timeout_ms);
+
+/**
+ * Queue packet obtained with LMS_AcquireTxBuffer() for sending. Packet with
+ * fewer samples than it fits, or meta::flushPartialPacket set, sends
+ * buffered packets immediately.
+ *
+ * @param stream        TX stream previously initialized with LMS_SetupStream().
+ * @param sample_count  Number of samples per channel written to packet.
+ * @param meta          Metadata. See the ::lms_stream_meta_t description.
+ *
+ * @return number of samples committed on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_CommitTxBuffer(lms_stream_t *stream, size_t sample_count,
+                            const lms_stream_meta_t *meta);
+
 /**
  * Uploads waveform to on board memory for later use
  * @param device        Device handle previously obtained by LMS_Open().
@@ -1349,12 +1507,36 @@ API_EXPORT const char * CALL_CONV LMS_GetLastErrorMessage(void);
 
 /*!
  * Register a new system log handler. Should be called to replace the default
- * stdio handler.
+ * stdio handler. The handler is called on the thread that logged the
+ * message unless LMS_SetLogAsync() is enabled.
  *
  * @param handler   function for handling API messages
  */
 API_EXPORT void LMS_RegisterLogHandler(LMS_LogHandler handler);
 
+/*!
+ * Deliver messages to log handler from a library thread instead of the
+ * thread that logged them. Slow handlers then do not stall streaming
+ * threads, but the handler is called from the library thread and, for
+ * critical messages or errors and warnings that find the log queue full,
+ * from the logging thread, so it must be thread-safe. Info and debug
+ * messages are dropped while the queue is full. Disabled by default,
+ * disabling waits until queued messages are delivered.
+ *
+ * @param enable    true to deliver messages asynchronously
+ */
+API_EXPORT void LMS_SetLogAsync(bool enable);
+
+/*!
+ * Limit repeats of the same info or debug message to burst messages per
+ * period. Number of suppressed repeats is appended to the next delivered
+ * message. Errors and warnings are never limited. Disabled by default.
+ *
+ * @param burst     messages allowed per period, 0 disables limiting
+ * @param period    period length in seconds
+ */
+API_EXPORT void LMS_SetLogRateLimit(unsigned burst, double period);
+
 /** @} (End FN_VERSION) */
 
 #ifdef __cplusplus
@@ -0,0 +1,148 @@
+/*
+ * File:   RFE_I2CBus.cpp
+ * I2C master bit-banged over SDR GPIO for limeRFE control
+ */
+
+#include "RFE_I2CBus.h"
+#include "IConnection.h"
+
+//reads waiting for slave to release SCL (clock stretching)
+static const int maxStretchReads = 100;
+
+RFE_I2CBus::RFE_I2CBus(lime::IConnection* conn, uint8_t address, int sclBit, int sdaBit) :
+    mConn(conn),
+    mAddress(address),
+    mScl(sclBit),
+    mSda(sdaBit),
+    mHoldWrites(1),
+    mDir(0)
+{
+}
+
+void RFE_I2CBus::SetHoldWrites(int count)
+{
+    mHoldWrites = count > 0 ? count : 1;
+}
+
+/** @brief Reads GPIO state once and clears SCL and SDA output values,
+    so that only direction changes are needed to drive the lines
+*/
+int RFE_I2CBus::Begin()
+{
+    mQueue.clear();
+    uint8_t levels = 0;
+    if (mConn == nullptr || mConn->GPIODirRead(&mDir, 1) != 0 || mConn->GPIORead(&levels, 1) != 0)
+        return -1;
+    //output pins keep their levels, as writes of bit-banged I2C always did
+    const uint8_t values = levels & ~((1 << mScl) | (1 << mSda));
+    if (mConn->GPIOWrite(&values, 1) != 0)
+        return -1;
+    SetLine(mSda, true);
+    SetLine(mScl, true);
+    return 0;
+}
+
+void RFE_I2CBus::SetLine(int bit, bool high)
+{
+    //direction: 1-output driving 0, 0-input released to pull-up
+    const uint8_t dir = high ? mDir & ~(1 << bit) : mDir | (1 << bit);
+    if (dir == mDir)
+        return;
+    mDir = dir;
+    mQueue.insert(mQueue.end(), mHoldWrites, dir);
+}
+
+int RFE_I2CBus::Flush()
+{
+    if (mQueue.empty())
+        return 0;
+    const int ret = mConn->GPIODirWriteSequence(mQueue.data(), mQueue.size());
+    mQueue.clear();
+    return ret;
+}
+
+int RFE_I2CBus::Sample(uint8_t &levels)
+{
+    if (Flush() != 0)
+        return -1;
+    return mConn->GPIORead(&levels, 1);
+}
+
+void RFE_I2CBus::Start()
+{
+    SetLine(mSda, true);
+    SetLine(mScl, true);
+    SetLine(mSda, false);
+    SetLine(mScl, false);
+}
+
+void RFE_I2CBus::Stop()
+{
+    SetLine(mSda, false);
+    SetLine(mScl, true);
+    SetLine(mSda, true);
+}
+
+void RFE_I2CBus::TxByte(uint8_t byte)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        SetLine(mSda, byte & 0x80);
+        SetLine(mScl, true);
+        SetLine(mScl, false);
+        byte <<= 1;
+    }
+    //ACK clock, acknowledge is not checked
+    SetLine(mSda, true);
+    SetLine(mScl, true);
+    SetLine(mScl, false);
+}
+
+int RFE_I2CBus::RxByte(bool ack, unsigned char &byte)
+{
+    byte = 0;
+    SetLine(mSda, true);
+    for (int i = 0; i < 8; ++i)
+    {
+        SetLine(mScl, true);
+        uint8_t levels;
+        int attempt = 0;
+        do
+        {
+            if (++attempt > maxStretchReads || Sample(levels) != 0)
+                return -1;
+        } while ((levels & (1 << mScl)) == 0);
+        byte = (byte << 1) | ((levels >> mSda) & 1);
+        SetLine(mScl, false);
+    }
+    SetLine(mSda, !ack);
+    SetLine(mScl, true);
+    SetLine(mScl, false);
+    SetLine(mSda, true);
+    return 0;
+}
+
+int RFE_I2CBus::Write(const unsigned char* data, int size)
+{
+    if (Begin() != 0)
+        return -1;
+    Start();
+    TxByte(mAddress << 1);
+    for (int i = 0; i < size; ++i)
+        TxByte(data[i]);
+    Stop();
+    return Flush();
+}
+
+int RFE_I2CBus::Read(unsigned char* data, int size)
+{
+    if (Begin() != 0)
+        return -1;
+    Start();
+    TxByte((mAddress << 1) | 1);
+    for (int i = 0; i < size; ++i)
+        if (RxByte(i != size - 1, data[i]) != 0)
+            return -1;
+    Stop();
+    return Flush() == 0 ? size : -1;
+}
@@ -0,0 +1,62 @@
+/*
+ * File:   RFE_I2CBus.h
+ * I2C master bit-banged over SDR GPIO for limeRFE control
+ */
+
+#ifndef RFE_I2CBUS_H
+#define RFE_I2CBUS_H
+
+#include "LimeSuiteConfig.h"
+#include <stdint.h>
+#include <vector>
+
+namespace lime
+{
+class IConnection;
+}
+
+/*!
+ * SCL and SDA are open drain: their GPIO values are kept 0 and lines are
+ * driven low by making the pin an output and released by making it an
+ * input. Only the direction register changes during a transaction, so
+ * GPIO state is read once per transaction and shadowed on the host. Line
+ * changes are queued and sent with IConnection::GPIODirWriteSequence(),
+ * the queue is flushed only when a line has to be sampled. Writes need
+ * no samples (ACK bits are not checked, as before), reads sample once
+ * per received bit.
+ */
+class LIME_API RFE_I2CBus
+{
+public:
+    RFE_I2CBus(lime::IConnection* conn, uint8_t address, int sclBit, int sdaBit);
+    //! @return 0 on success, -1 on GPIO failure
+    int Write(const unsigned char* data, int size);
+    //! @return bytes read, -1 on GPIO failure or SCL held low
+    int Read(unsigned char* data, int size);
+    /** @brief Each line state is written this many times, slows bus
+        down for connections that apply queued writes too fast. Every
+        state must last at least 1/(2*RFE_I2C_FSCL), GPIO connections
+        without batched sequence writes need no extra hold.
+    */
+    void SetHoldWrites(int count);
+
+private:
+    int Begin();
+    void SetLine(int bit, bool high);
+    int Flush();
+    int Sample(uint8_t &levels);
+    void Start();
+    void Stop();
+    void TxByte(uint8_t byte);
+    int RxByte(bool ack, unsigned char &byte);
+
+    lime::IConnection* mConn;
+    const uint8_t mAddress;
+    const uint8_t mScl;
+    const uint8_t mSda;
+    int mHoldWrites;
+    uint8_t mDir; //shadow of GPIO direction register
+    std::vector<uint8_t> mQueue;
+};
+
+#endif /* RFE_I2CBUS_H */
@@ -1,4 +1,6 @@
 #include "limeRFE_constants.h"
+#include "RFE_I2CBus.h"
+#include "API/lms7_device.h"
 #include "INI.h"
 #include <chrono>
 
@@ -617,161 +619,20 @@ void mySleep(double sleepms)
 #endif
 }
 
-void i2c_dly(void)
+/** @brief I2C engine on GPIO of SDR connection */
+static RFE_I2CBus GetI2C(lms_device_t* lms)
 {
-	double sleepms = 0.5 * 1 / RFE_I2C_FSCL * 1000; //for example 0.5 * period - Check this!!!
-	mySleep(sleepms);
-}
-
-int i2c_setVal(lms_device_t* lms, int bitGPIO, int value) {
-	uint8_t gpio_dir = 0;
-	int direction;
-	if (LMS_GPIODirRead(lms, &gpio_dir, 1) != 0)
-		return -1;
-	// Direction: 1-output, 0-input
-	// If writting 0, then output => direction = 1
-	// If writting 1, then input (high Z, and pull-up will do the trick) => direction = 0
-	(value == 1) ? direction = 0 : direction = 1;
-
-	(direction == 1) ? gpio_dir |= (1 << (bitGPIO)) : gpio_dir &= ~(1 << (bitGPIO));
-
-	if (LMS_GPIODirWrite(lms, &gpio_dir, 1) != 0)
-		return -1;
-
-	uint8_t gpio_val = 0;
-	if (LMS_GPIORead(lms, &gpio_val, 1) != 0)
-		return -1;
-
-	(value == 1) ? gpio_val |= (1 << (bitGPIO)) : gpio_val &= ~(1 << (bitGPIO));
-
-	if (LMS_GPIOWrite(lms, &gpio_val, 1) != 0)
-		return -1;
-
-	i2c_dly();
-
-	return 0;
-}
-
-int i2c_getVal(lms_device_t* lms, int bitGPIO) {
-	uint8_t gpio_val = 0;
-	if (LMS_GPIORead(lms, &gpio_val, 1) != 0)
-		return -1;
-
-	int result = 0;
-
-	result = gpio_val & (1 << (bitGPIO));
-
-	return result;
-}
-
-int i2c_start(lms_device_t* lms)
-{
-	if(i2c_setVal(lms, GPIO_SDA, 1) != 0)
-		return -1;
-	i2c_setVal(lms, GPIO_SCL, 1);
-	i2c_setVal(lms, GPIO_SDA, 0);
-	i2c_setVal(lms, GPIO_SCL, 0);
-	return 0;
-}
-
-int i2c_stop(lms_device_t* lms)
-{
-	if(i2c_setVal(lms, GPIO_SDA, 0) != 0)
-		return -1;
-	i2c_setVal(lms, GPIO_SCL, 1);
-	i2c_setVal(lms, GPIO_SDA, 1);
-	return 0;
-}
-
-int i2c_rx(lms_device_t* lms, char ack, unsigned char* d)
-{
-	char x = 0;
-
-	i2c_setVal(lms, GPIO_SDA, 1);
-	for (x = 0; x<8; x++) {
-		(*d) <<= 1;
-
-		int attempt = 0;
-		do {
-			i2c_setVal(lms, GPIO_SCL, 1);
-			attempt++;
-			if (attempt > 100) { // Is this limit OK?
-				return RFE_ERROR_COMM;
-			}
-		} while (i2c_getVal(lms, GPIO_SCL) == 0);    // wait for any SCL clock stretching
-		i2c_dly();
-		if (i2c_getVal(lms, GPIO_SDA)) (*d) |= 1;
-		i2c_setVal(lms, GPIO_SCL, 0);
-	}
-	if (ack) i2c_setVal(lms, GPIO_SDA, 0);
-	else i2c_setVal(lms, GPIO_SDA, 1);
-	i2c_setVal(lms, GPIO_SCL, 1);
-	i2c_dly();             // send (N)ACK bit
-	i2c_setVal(lms, GPIO_SCL, 0);
-	i2c_setVal(lms, GPIO_SDA, 1);
-//	return d;
-	return RFE_SUCCESS;
-}
-
-int i2c_tx(lms_device_t* lms, unsigned char d)
-{
-	char x;
-	int b;
-
-	for (x = 8; x; x--) {
-		if (d & 0x80)
-			i2c_setVal(lms, GPIO_SDA, 1);
-		else
-			i2c_setVal(lms, GPIO_SDA, 0);
-		i2c_setVal(lms, GPIO_SCL, 1);
-		d <<= 1;
-		i2c_setVal(lms, GPIO_SCL, 0);
-	}
-	i2c_setVal(lms, GPIO_SDA, 1);
-	i2c_setVal(lms, GPIO_SCL, 1);
-	i2c_dly();
-	b = i2c_getVal(lms, GPIO_SDA);          // possible ACK bit
-	i2c_setVal(lms, GPIO_SCL, 0);
-	return b;
+	lime::IConnection* conn = lms ? ((lime::LMS7_Device*)lms)->GetConnection() : nullptr;
+	return RFE_I2CBus(conn, RFE_I2C_ADDRESS, GPIO_SCL, GPIO_SDA);
 }
 
 int i2c_write_buffer(lms_device_t* lms, unsigned char* c, int size) {
-	unsigned char addressI2C = RFE_I2C_ADDRESS;
-	unsigned char addressByte = addressI2C << 1;
-	unsigned char addressByteW = addressByte & ~1;
-
-	if(i2c_start(lms) != 0) // send start sequence
-		return -1;
-	i2c_tx(lms, addressByteW);	// I2C address with R/W bit clear
-
-	for (int i = 0; i < size; i++) {
-		i2c_tx(lms, c[i]);
-	}
-
-	i2c_stop(lms);	// send stop sequence
-
-	return 0;
+	return GetI2C(lms).Write(c, size);
 }
 
 int i2c_read_buffer(lms_device_t* lms, unsigned char* c, int size) {
-	unsigned char addressI2C = RFE_I2C_ADDRESS;
-	unsigned char addressByte = addressI2C << 1;
-	unsigned char addressByteR = addressByte | 1;
-
-	i2c_start(lms);	// send a restart sequence
-	i2c_tx(lms, addressByteR);	// I2C address with R/W bit set
-
-	int i;
-	for (i = 0; i < size; i++) {
-		char ack = 1;
-		if (i == (size - 1))
-			ack = 0;
-		int res = i2c_rx(lms, ack, &(c[i]));
-		if (res != RFE_SUCCESS)
-			return RFE_ERROR_COMM;
-	}
-	i2c_stop(lms);	// send stop sequence
-	return i;
+	const int ret = GetI2C(lms).Read(c, size);
+	return ret < 0 ? RFE_ERROR_COMM : ret;
 }
 
 int Cmd_Fan(lms_device_t *dev, RFE_COM com, int enable) {
@@ -196,13 +196,6 @@ extern "C" {
 * I2C Functions
 *************************************************************************/
 	void mySleep(double sleepms);
-	void i2c_dly(void);
-	int i2c_setVal(lms_device_t* lms, int bitGPIO, int value);
-	int i2c_getVal(lms_device_t* lms, int bitGPIO);
-	int i2c_start(lms_device_t* lms);
-	int i2c_stop(lms_device_t* lms);
-	int i2c_rx(lms_device_t* lms, char ack, unsigned char* d);
-	int i2c_tx(lms_device_t* lms, unsigned char d);
 	int i2c_write_buffer(lms_device_t* lms, unsigned char* c, int size);
 	int i2c_read_buffer(lms_device_t* lms, unsigned char* c, int size);
 
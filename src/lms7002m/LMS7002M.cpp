@@ -22,6 +22,7 @@
 #include <assert.h>
 #include <chrono>
 #include <thread>
+#include <mutex>
 #include "Logger.h"
 #include "mcu_programs.h"
 
@@ -42,6 +43,42 @@ extern std::vector<const LMS7Parameter*> LMS7parameterList;
 const uint16_t LMS7002M::readOnlyRegisters[] =      { 0x002F, 0x008C, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x0123, 0x0209, 0x020A, 0x020B, 0x040E, 0x040F };
 const uint16_t LMS7002M::readOnlyRegistersMasks[] = { 0x0000, 0x0FFF, 0x007F, 0x0000, 0x0000, 0x0000, 0x0000, 0x003F, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 };
 
+namespace
+{
+//! SPI writes collected between BeginWriteBatch() and EndWriteBatch()
+struct WriteBatch
+{
+    const LMS7002M* chip;
+    int depth;
+    std::vector<uint32_t> data;
+    bool recording; //!< writes are kept for WriteRecorded() instead of sending
+    bool failed; //!< recording needed chip response
+    LMS7002M_RegistersMap* backup; //!< cache before recording
+    WriteBatch* next;
+};
+}
+//batches belong to calling thread, writes of other threads are not captured
+static thread_local WriteBatch* writeBatches = nullptr;
+
+static WriteBatch* FindWriteBatch(const LMS7002M* chip)
+{
+    for (WriteBatch* batch = writeBatches; batch; batch = batch->next)
+        if (batch->chip == chip)
+            return batch;
+    return nullptr;
+}
+
+//registers containing read only registers, which values can change
+static const uint16_t volatileRegisters[] = { 0, 1, 2, 3, 4, 5, 6, 0x002F, 0x008C, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x0123, 0x0209, 0x020A, 0x020B, 0x040E, 0x040F, 0x05C3, 0x05C4, 0x05C5, 0x05C6, 0x05C7, 0x05C8, 0x05C9, 0x05CA};
+
+static bool IsVolatileRegister(uint16_t address)
+{
+    for (unsigned i = 0; i < sizeof(volatileRegisters) / sizeof(uint16_t); ++i)
+        if (address == volatileRegisters[i])
+            return true;
+    return false;
+}
+
 /** @brief Simple logging function to print status messages
     @param text message to print
     @param type message type for filtering specific information
@@ -708,9 +745,7 @@ int LMS7002M::SaveConfig(const char* filename)
     Channel ch = this->GetActiveChannel();
 
     vector<uint16_t> addrToRead;
-    for (uint8_t i = 0; i < MEMORY_SECTIONS_COUNT; ++i)
-        for (uint16_t addr = MemorySectionAddresses[i][0]; addr <= MemorySectionAddresses[i][1]; ++addr)
-            addrToRead.push_back(addr);
+    GetConfigAddresses(ChA, addrToRead);
     vector<uint16_t> dataReceived;
     dataReceived.resize(addrToRead.size(), 0);
 
@@ -735,12 +770,7 @@ int LMS7002M::SaveConfig(const char* filename)
     }
 
     fout << "[lms7002_registers_b]" << endl;
-    addrToRead.clear(); //add only B channel addresses
-    for (uint8_t i = 0; i < MEMORY_SECTIONS_COUNT; ++i)
-        if (i != RSSI_DC_CALIBRATION)
-            for (uint16_t addr = MemorySectionAddresses[i][0]; addr <= MemorySectionAddresses[i][1]; ++addr)
-                if (addr >= 0x0100)
-                    addrToRead.push_back(addr);
+    GetConfigAddresses(ChB, addrToRead); //add only B channel addresses
 
     this->SetActiveChannel(ChB);
     for (uint16_t i = 0; i < addrToRead.size(); ++i)
@@ -760,6 +790,19 @@ int LMS7002M::SaveConfig(const char* filename)
     return 0;
 }
 
+void LMS7002M::GetConfigAddresses(Channel ch, std::vector<uint16_t> &addrs) const
+{
+    addrs.clear();
+    for (uint8_t i = 0; i < MEMORY_SECTIONS_COUNT; ++i)
+    {
+        if (ch == ChB && i == RSSI_DC_CALIBRATION)
+            continue;
+        for (uint16_t addr = MemorySectionAddresses[i][0]; addr <= MemorySectionAddresses[i][1]; ++addr)
+            if (ch != ChB || addr >= 0x0100)
+                addrs.push_back(addr);
+    }
+}
+
 int LMS7002M::SetRBBPGA_dB(const float_type value)
 {
     int g_pga_rbb = (int)(value + 12.5);
@@ -1431,6 +1474,7 @@ int LMS7002M::Modify_SPI_Reg_bits(const LMS7Parameter &param, const uint16_t val
 */
 int LMS7002M::Modify_SPI_Reg_bits(const uint16_t address, const uint8_t msb, const uint8_t lsb, const uint16_t value, bool fromChip)
 {
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
     uint16_t spiDataReg = SPI_read(address, fromChip); //read current SPI reg data
     uint16_t spiMask = (~(~0u << (msb - lsb + 1))) << (lsb); // creates bit mask
     spiDataReg = (spiDataReg & (~spiMask)) | ((value << lsb) & spiMask);//clear bits
@@ -1486,6 +1530,7 @@ int LMS7002M::SetFrequencySX(bool tx, float_type freq_Hz, SX_details* output)
 {
     static map<float_type, int8_t> tuning_cache_sel_vco;
     static map<float_type, int16_t> tuning_cache_csw_value;
+    static std::mutex tuning_cache_mutex; //chips can be tuned from several threads
 
     const char* vcoNames[] = {"VCOL", "VCOM", "VCOH"};
     const uint8_t sxVCO_N = 2; //number of entries in VCO frequencies
@@ -1550,16 +1595,44 @@ int LMS7002M::SetFrequencySX(bool tx, float_type freq_Hz, SX_details* output)
     Modify_SPI_Reg_bits(LMS7param(PD_VCO_COMP), 0);
 
     // try setting tuning values from the cache, if it fails perform full tuning
-    if  (useCache && tuning_cache_sel_vco.count(freq_Hz) > 0)
+    std::unique_lock<std::mutex> cacheLock(tuning_cache_mutex);
+    const bool cached = tuning_cache_sel_vco.count(freq_Hz) > 0;
+    if (cached)
     {
         sel_vco = tuning_cache_sel_vco[freq_Hz];
         csw_value = tuning_cache_csw_value[freq_Hz];
+    }
+    cacheLock.unlock();
+    WriteBatch* batch = FindWriteBatch(this);
+    if (batch && batch->recording)
+    {
+        //comparators can not be checked before recorded writes reach the chip
+        if (!cached)
+        {
+            batch->failed = true;
+            this->SetActiveChannel(ch);
+            return ReportError(EBUSY, "SetFrequencySX%s(%g MHz) - VCO was never tuned to this frequency, it can not be recorded",
+                                tx?"T":"R", freq_Hz / 1e6);
+        }
+        Modify_SPI_Reg_bits(LMS7param(SEL_VCO), sel_vco);
+        Modify_SPI_Reg_bits(LMS7param(CSW_VCO).address, LMS7param(CSW_VCO).msb, LMS7param(CSW_VCO).lsb, csw_value);
+        this->SetActiveChannel(ch);
+        if (output)
+        {
+            output->success = true;
+            output->sel_vco = sel_vco;
+            output->csw = csw_value;
+        }
+        return 0;
+    }
+    if (cached && useCache)
+    {
         Modify_SPI_Reg_bits(LMS7param(SEL_VCO), sel_vco);
         Modify_SPI_Reg_bits(LMS7param(CSW_VCO).address, LMS7param(CSW_VCO).msb, LMS7param(CSW_VCO).lsb, csw_value);
         this_thread::sleep_for(chrono::microseconds(50)); // probably no need for this as the interface is already very slow..
         auto cmphl = (uint8_t)Get_SPI_Reg_bits(LMS7param(VCO_CMPHO).address, 13, 12, true);
         if(cmphl == 2) {
-            lime::info("Fast Tune success; vco=%d value=%d", tuning_cache_sel_vco[freq_Hz], tuning_cache_csw_value[freq_Hz]);
+            lime::info("Fast Tune success; vco=%d value=%d", sel_vco, csw_value);
             this->SetActiveChannel(ch); //restore used channel
             if (output)
             {
@@ -1623,8 +1696,9 @@ int LMS7002M::SetFrequencySX(bool tx, float_type freq_Hz, SX_details* output)
     Modify_SPI_Reg_bits(LMS7param(SEL_VCO), sel_vco);
     Modify_SPI_Reg_bits(LMS7param(CSW_VCO), csw_value);
 
-    // save successful tuning results in cache
-    if (useCache && canDeliverFrequency) {
+    // save successful tuning results in cache, recorded changes use them even without register cache
+    if (canDeliverFrequency) {
+        std::lock_guard<std::mutex> lock(tuning_cache_mutex);
         tuning_cache_sel_vco[freq_Hz] = sel_vco;
         tuning_cache_csw_value[freq_Hz] = csw_value;
     }
@@ -1905,14 +1979,20 @@ int LMS7002M::GetGFIRCoefficients(bool tx, uint8_t GFIR_index, int16_t *coef, ui
 */
 int LMS7002M::SPI_write(uint16_t address, uint16_t data, bool toChip)
 {
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
     if(address == 0x0640 || address == 0x0641)
     {
+        //MCU accesses chip directly, batched writes must reach it first
+        if (FlushWriteBatch() != 0)
+            return -1;
         MCU_BD* mcu = GetMCUControls();
         mcu->RunProcedure(MCU_FUNCTION_GET_PROGRAM_ID);
         if(mcu->WaitForMCU(100) != MCU_ID_CALIBRATIONS_SINGLE_IMAGE)
             mcu->Program_MCU(mcu_program_lms7_dc_iq_calibration_bin, IConnection::MCU_PROG_MODE::SRAM);
         SPI_write(0x002D, address);
         SPI_write(0x020C, data);
+        if (FlushWriteBatch() != 0)
+            return -1;
         mcu->RunProcedure(7);
         mcu->WaitForMCU(50);
         return SPI_read(0x040B) == data ? 0 : -1;
@@ -1921,6 +2001,15 @@ int LMS7002M::SPI_write(uint16_t address, uint16_t data, bool toChip)
         return this->SPI_write_batch(&address, &data, 1, toChip);
 }
 
+/** @brief Returns register value from cache without changing active channel
+    @param channel register space, 0 - channel A, 1 - channel B
+    @param address SPI address
+*/
+uint16_t LMS7002M::SPI_read_cached(uint8_t channel, uint16_t address) const
+{
+    return mRegistersMap->GetValue(address < 0x0100 ? 0 : channel, address);
+}
+
 /** @brief Reads whole register value from given address
     @param address SPI address
     @param status operation status(optional)
@@ -1929,15 +2018,9 @@ int LMS7002M::SPI_write(uint16_t address, uint16_t data, bool toChip)
 */
 uint16_t LMS7002M::SPI_read(uint16_t address, bool fromChip, int *status)
 {
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
     fromChip |= !useCache;
-    //registers containing read only registers, which values can change
-    const uint16_t readOnlyRegs[] = { 0, 1, 2, 3, 4, 5, 6, 0x002F, 0x008C, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x0123, 0x0209, 0x020A, 0x020B, 0x040E, 0x040F, 0x05C3, 0x05C4, 0x05C5, 0x05C6, 0x05C7, 0x05C8, 0x05C9, 0x05CA};
-    for (unsigned i = 0; i < sizeof(readOnlyRegs) / sizeof(uint16_t); ++i)
-        if (address == readOnlyRegs[i])
-        {
-            fromChip = true;
-            break;
-        }
+    fromChip |= IsVolatileRegister(address);
     if (!controlPort || fromChip == false)
     {
         if (status && !controlPort)
@@ -1953,11 +2036,17 @@ uint16_t LMS7002M::SPI_read(uint16_t address, bool fromChip, int *status)
         int st;
         if(address == 0x0640 || address == 0x0641)
         {
+            if (FlushWriteBatch() != 0)
+            {
+                if (status) *status = -1;
+                return 0;
+            }
             MCU_BD* mcu = GetMCUControls();
             mcu->RunProcedure(MCU_FUNCTION_GET_PROGRAM_ID);
             if(mcu->WaitForMCU(100) != MCU_ID_CALIBRATIONS_SINGLE_IMAGE)
                 mcu->Program_MCU(mcu_program_lms7_dc_iq_calibration_bin, IConnection::MCU_PROG_MODE::SRAM);
             SPI_write(0x002D, address);
+            FlushWriteBatch();
             mcu->RunProcedure(8);
             mcu->WaitForMCU(50);
             uint16_t rdVal = SPI_read(0x040B, true, status);
@@ -1980,6 +2069,7 @@ uint16_t LMS7002M::SPI_read(uint16_t address, bool fromChip, int *status)
 */
 int LMS7002M::SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData, uint16_t cnt, bool toChip)
 {
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
     toChip |= !useCache;
     int mac = mRegistersMap->GetValue(0, LMS7param(MAC).address) & 0x0003;
     std::vector<uint32_t> data;
@@ -2015,9 +2105,119 @@ int LMS7002M::SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData,
         lime::error("No device connected");
         return -1;
     }
+    WriteBatch* batch = FindWriteBatch(this);
+    if (batch)
+    {
+        batch->data.insert(batch->data.end(), data.begin(), data.end());
+        return 0;
+    }
     return controlPort->WriteLMS7002MSPI(data.data(), data.size(), mdevIndex);
 }
 
+void LMS7002M::BeginWriteBatch()
+{
+    WriteBatch* batch = FindWriteBatch(this);
+    if (batch == nullptr)
+    {
+        batch = new WriteBatch();
+        batch->chip = this;
+        batch->depth = 0;
+        batch->recording = false;
+        batch->failed = false;
+        batch->backup = nullptr;
+        batch->next = writeBatches;
+        writeBatches = batch;
+    }
+    ++batch->depth;
+}
+
+int LMS7002M::EndWriteBatch()
+{
+    WriteBatch* batch = FindWriteBatch(this);
+    if (batch == nullptr || --batch->depth > 0)
+        return 0;
+    const int status = FlushWriteBatch();
+    WriteBatch** link = &writeBatches;
+    while (*link != batch)
+        link = &(*link)->next;
+    *link = batch->next;
+    delete batch;
+    return status;
+}
+
+void LMS7002M::BeginWriteRecord()
+{
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
+    FlushWriteBatch();
+    BeginWriteBatch();
+    WriteBatch* batch = FindWriteBatch(this);
+    batch->backup = new LMS7002M_RegistersMap(*mRegistersMap);
+    batch->recording = true;
+    batch->failed = false;
+}
+
+int LMS7002M::EndWriteRecord(std::vector<uint32_t> &spiWords, bool discard)
+{
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
+    WriteBatch* batch = FindWriteBatch(this);
+    if (batch == nullptr || !batch->recording)
+        return ReportError(EINVAL, "EndWriteRecord() - recording was not started");
+    int status = 0;
+    if (batch->failed || discard)
+    {
+        //restoring writes are recorded too, so chip is left untouched
+        RestoreRegisterMap(batch->backup);
+        batch->data.clear();
+        status = -1;
+    }
+    else
+        delete batch->backup;
+    batch->backup = nullptr;
+    batch->recording = false;
+    spiWords.swap(batch->data);
+    batch->data.clear();
+    EndWriteBatch();
+    return status;
+}
+
+/** @brief Sends writes returned by EndWriteRecord() in one transaction
+    @param spiWords recorded SPI words, register cache already holds their values
+    @return 0-success, other-failure
+*/
+int LMS7002M::WriteRecorded(const std::vector<uint32_t> &spiWords)
+{
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
+    if (spiWords.empty())
+        return 0;
+    if (!controlPort)
+        return ReportError(ENODEV, "WriteRecorded() - chip not connected");
+    WriteBatch* batch = FindWriteBatch(this);
+    if (batch && !batch->recording)
+    {
+        batch->data.insert(batch->data.end(), spiWords.begin(), spiWords.end());
+        return 0;
+    }
+    return controlPort->WriteLMS7002MSPI(spiWords.data(), spiWords.size(), mdevIndex);
+}
+
+//! Sends writes collected by calling thread since BeginWriteBatch(), collection continues
+int LMS7002M::FlushWriteBatch()
+{
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
+    WriteBatch* batch = FindWriteBatch(this);
+    if (batch && batch->recording)
+    {
+        //caller is about to access chip directly
+        batch->failed = true;
+        return ReportError(EBUSY, "Chip access needs response, it can not be recorded");
+    }
+    if (batch == nullptr || batch->data.empty())
+        return 0;
+    int status = controlPort->WriteLMS7002MSPI(batch->data.data(), batch->data.size(), mdevIndex);
+    batch->data.clear();
+    return status;
+}
+
 /** @brief Batches multiple register reads into least amount of transactions
     @param spiAddr SPI addresses to read
     @param spiData array for read data
@@ -2026,11 +2226,31 @@ int LMS7002M::SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData,
 */
 int LMS7002M::SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_t cnt)
 {
+    std::lock_guard<std::recursive_mutex> lck(mRegistersLock);
     if (!controlPort)
     {
         lime::error("No device connected");
         return -1;
     }
+    WriteBatch* batch = FindWriteBatch(this);
+    if (batch && batch->recording)
+    {
+        //chip has not received recorded writes, cache holds recorded state
+        int mac = mRegistersMap->GetValue(0, LMS7param(MAC).address) & 0x0003;
+        for (size_t i = 0; i < cnt; ++i)
+        {
+            if (IsVolatileRegister(spiAddr[i]))
+            {
+                batch->failed = true;
+                return ReportError(EBUSY, "SPI read of 0x%04X needs chip response, it can not be recorded", spiAddr[i]);
+            }
+            const int regNo = (mac == 2 && spiAddr[i] >= 0x0100) ? 1 : 0;
+            spiData[i] = mRegistersMap->GetValue(regNo, spiAddr[i]);
+        }
+        return 0;
+    }
+    if (FlushWriteBatch() != 0)
+        return -1;
 
     std::vector<uint32_t> dataWr(cnt);
     std::vector<uint32_t> dataRd(cnt);
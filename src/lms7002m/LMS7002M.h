@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <functional>
 #include <vector>
+#include <mutex>
 
 namespace lime{
 class IConnection;
@@ -145,6 +146,8 @@ public:
 
 	int LoadConfig(const char* filename);
 	int SaveConfig(const char* filename);
+    //! Registers kept in configuration files, B channel only has MAC mapped ones
+    void GetConfigAddresses(Channel ch, std::vector<uint16_t> &addrs) const;
     ///@}
 
     ///@name Registers writing and reading
@@ -153,7 +156,33 @@ public:
     int Modify_SPI_Reg_bits(const LMS7Parameter &param, const uint16_t value, bool fromChip = false);
     int Modify_SPI_Reg_bits(uint16_t address, uint8_t msb, uint8_t lsb, uint16_t value, bool fromChip = false);
     int SPI_write(uint16_t address, uint16_t data, bool toChip = false);
+    int SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData, uint16_t cnt, bool toChip = false);
     uint16_t SPI_read(uint16_t address, bool fromChip = false, int *status = 0);
+    uint16_t SPI_read_cached(uint8_t channel, uint16_t address) const;
+    /** @brief Held during every register access, threads writing registers in
+        the background hold it to make several accesses atomic
+    */
+    std::recursive_mutex &GetRegistersLock() { return mRegistersLock; }
+    int SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_t cnt);
+    /*!
+     * Collects SPI writes until matching EndWriteBatch() and sends them in
+     * one transaction. Reads from chip send collected writes first.
+     * Batches are per calling thread, writes of other threads go directly.
+     */
+    void BeginWriteBatch();
+    int EndWriteBatch();
+    /*!
+     * Records SPI writes of calling thread until EndWriteRecord() without
+     * sending them, register cache holds the recorded state meanwhile.
+     * Accesses that need chip response fail the recording.
+     */
+    void BeginWriteRecord();
+    /*!
+     * Stops recording and returns recorded SPI words for WriteRecorded().
+     * Failed or discarded recording restores register cache and returns -1.
+     */
+    int EndWriteRecord(std::vector<uint32_t> &spiWords, bool discard = false);
+    int WriteRecorded(const std::vector<uint32_t> &spiWords);
     int RegistersTest(const char* fileName = "registersTest.txt");
     static const LMS7Parameter* GetParam(const std::string &name);
     ///@}
@@ -474,8 +503,7 @@ protected:
     int TuneTxFilterSetup(const float_type tx_lpf_IF);
 
     int RegistersTestInterval(uint16_t startAddr, uint16_t endAddr, uint16_t pattern, std::stringstream &ss);
-    int SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData, uint16_t cnt, bool toChip = false);
-    int SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_t cnt);
+    int FlushWriteBatch();
     int Modify_SPI_Reg_mask(const uint16_t *addr, const uint16_t *masks, const uint16_t *values, uint8_t start, uint8_t stop);
     ///@}
 
@@ -496,6 +524,7 @@ protected:
     IConnection* controlPort;
     unsigned mdevIndex;
     size_t mSelfCalDepth;
+    std::recursive_mutex mRegistersLock;
     int opt_gain_tbb[2];
     double _cachedRefClockRate;
     int LoadConfigLegacyFile(const char* filename);
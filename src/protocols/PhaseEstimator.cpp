@@ -0,0 +1,68 @@
+/**
+    @file PhaseEstimator.cpp
+    @author Lime Microsystems
+    @brief Goertzel phase difference estimation of MIMO sample captures
+*/
+
+#include "PhaseEstimator.h"
+#include <cmath>
+
+using namespace lime;
+
+//bins evaluated in one pass without heap allocation
+static const size_t maxBins = 8;
+
+PhaseEstimator::PhaseEstimator(int length, const std::vector<int> &bins) :
+    mLength(length)
+{
+    const double pi = std::acos(-1);
+    for (size_t i = 0; i < bins.size() && i < maxBins; ++i)
+    {
+        const double w = 2.0 * pi * bins[i] / length;
+        mCoef.push_back(2.0 * std::cos(w));
+        mTwiddle.push_back(std::polar(1.0, -w));
+    }
+}
+
+int PhaseEstimator::GetLength() const
+{
+    return mLength;
+}
+
+size_t PhaseEstimator::GetBinCount() const
+{
+    return mCoef.size();
+}
+
+void PhaseEstimator::Estimate(const int16_t* samples, double* phaseDiff, double* magnitude) const
+{
+    const size_t binCount = mCoef.size();
+    //Goertzel state s[n-1], s[n-2] for AI, AQ, BI, BQ of every bin
+    double s1[maxBins][4] = {{0}};
+    double s2[maxBins][4] = {{0}};
+    for (int n = 0; n < mLength; ++n)
+    {
+        const int16_t* x = &samples[4*n];
+        for (size_t b = 0; b < binCount; ++b)
+            for (int c = 0; c < 4; ++c)
+            {
+                const double s0 = x[c] + mCoef[b] * s1[b][c] - s2[b][c];
+                s2[b][c] = s1[b][c];
+                s1[b][c] = s0;
+            }
+    }
+
+    const double pi = std::acos(-1);
+    for (size_t b = 0; b < binCount; ++b)
+    {
+        //common e^(-jw(N-1)) factor of both channels cancels in difference
+        const std::complex<double> xA = std::complex<double>(s1[b][0], s1[b][1]) - mTwiddle[b] * std::complex<double>(s2[b][0], s2[b][1]);
+        const std::complex<double> xB = std::complex<double>(s1[b][2], s1[b][3]) - mTwiddle[b] * std::complex<double>(s2[b][2], s2[b][3]);
+        double diff = std::arg(xB * std::conj(xA)) * 180.0 / pi;
+        if (diff <= -180.0)
+            diff += 360.0;
+        phaseDiff[b] = diff;
+        if (magnitude)
+            magnitude[b] = std::abs(xA);
+    }
+}
@@ -0,0 +1,49 @@
+/**
+    @file PhaseEstimator.h
+    @author Lime Microsystems
+    @brief Goertzel phase difference estimation of MIMO sample captures
+*/
+
+#ifndef LIME_PHASE_ESTIMATOR_H
+#define LIME_PHASE_ESTIMATOR_H
+
+#include "LimeSuiteConfig.h"
+#include <stdint.h>
+#include <vector>
+#include <complex>
+
+namespace lime
+{
+
+/*!
+ * Evaluates selected DFT bins of both channels of interleaved 16 bit
+ * MIMO samples (AI, AQ, BI, BQ) with Goertzel recurrences in one pass,
+ * coefficients are computed once at construction.
+ */
+class LIME_API PhaseEstimator
+{
+public:
+    /** @brief Prepares coefficients
+        @param length number of samples per channel used for estimation
+        @param bins DFT bins of interest
+    */
+    PhaseEstimator(int length, const std::vector<int> &bins);
+
+    /** @brief Estimates phase of channel B relative to channel A
+        @param samples interleaved AI, AQ, BI, BQ samples, at least length per channel
+        @param phaseDiff output phase difference in degrees (-180, 180] for each bin
+        @param magnitude optional output channel A bin magnitude for each bin
+    */
+    void Estimate(const int16_t* samples, double* phaseDiff, double* magnitude = nullptr) const;
+
+    int GetLength() const;
+    size_t GetBinCount() const;
+
+private:
+    int mLength;
+    std::vector<double> mCoef;
+    std::vector<std::complex<double> > mTwiddle;
+};
+
+}
+#endif // LIME_PHASE_ESTIMATOR_H
@@ -6,18 +6,92 @@
 #include "Streamer.h"
 #include "IConnection.h"
 #include <complex>
+#include <cmath>
+#include <algorithm>
 #include "LMSBoards.h"
 #include "threadHelper.h"
+#include "DCIQTracker.h"
+#include "Channelizer.h"
+#include "CommandQueue.h"
+#include "PhaseEstimator.h"
+#include "Resampler.h"
+#include "PowerTrigger.h"
 
 namespace lime
 {
 
+StreamEventQueue::StreamEventQueue() : interrupts(0)
+{
+}
+
+void StreamEventQueue::Post(StreamEvent::Type type, uint8_t channels, uint64_t timestamp, uint32_t count)
+{
+    {
+        std::lock_guard<std::mutex> lck(lock);
+        if (!events.empty() && events.back().type == type && events.back().channels == channels)
+            events.back().count += count;
+        else
+        {
+            if (events.size() >= maxEvents)
+                events.pop_front();
+            StreamEvent event;
+            event.type = type;
+            event.channels = channels;
+            event.timestamp = timestamp;
+            event.count = count;
+            events.push_back(event);
+        }
+    }
+    cond.notify_all();
+}
+
+bool StreamEventQueue::Wait(StreamEvent &event, uint8_t channels, int32_t timeout_ms)
+{
+    std::unique_lock<std::mutex> lck(lock);
+    const unsigned interrupted = interrupts;
+    std::deque<StreamEvent>::iterator it;
+    auto ready = [&]{
+        it = events.begin();
+        while (it != events.end() && (it->channels & channels) == 0)
+            ++it;
+        return it != events.end() || interrupts != interrupted;
+    };
+    if (!cond.wait_for(lck, std::chrono::milliseconds(timeout_ms), ready) || it == events.end())
+        return false;
+    event = *it;
+    event.channels &= channels;
+    it->channels &= ~channels;
+    if (it->channels == 0)
+        events.erase(it);
+    return true;
+}
+
+void StreamEventQueue::Interrupt()
+{
+    {
+        std::lock_guard<std::mutex> lck(lock);
+        ++interrupts;
+    }
+    cond.notify_all();
+}
+
+void StreamEventQueue::Clear()
+{
+    std::lock_guard<std::mutex> lck(lock);
+    events.clear();
+}
+
 StreamChannel::StreamChannel(Streamer* streamer) :
     mStreamer(streamer),
     pktLost(0),
     mActive(false),
     used(false),
-    fifo(nullptr)
+    fifo(nullptr),
+    resampler(nullptr),
+    trigger(nullptr),
+    resampleOutPos(0),
+    resampleOutLen(0),
+    resampleOutTimestamp(0)
 {
 }
 
@@ -25,59 +99,299 @@ StreamChannel::~StreamChannel()
 {
     if (fifo)
         delete fifo;
+    delete resampler;
+    delete trigger;
 }
 
-void StreamChannel::Setup(StreamConfig conf)
+int StreamChannel::Setup(StreamConfig conf)
 {
-    used = true;
     config = conf;
     pktLost = 0;
-    int bufferLength = config.bufferLength == 0 ? 1024*4*1024 : config.bufferLength;
     int pktSize = config.linkFormat != StreamConfig::FMT_INT12 ? samples16InPkt : samples12InPkt;
-    if (bufferLength < 4*pktSize)  //set FIFO to at least 4 packets
-        bufferLength = 4*pktSize;
     if (!fifo)
         fifo = new RingFIFO();
-    fifo->Resize(pktSize, bufferLength/pktSize);
+    if (fifo->Resize(pktSize, FifoLength(pktSize)/pktSize) != 0)
+    {
+        used = false;
+        return -1;
+    }
+    used = true;
+    PlaceBuffers();
+
+    delete resampler;
+    resampler = nullptr;
+    resampleOutPos = resampleOutLen = 0;
+    if (config.resampleUp > 0 && config.resampleDown > 0 && config.resampleUp != config.resampleDown)
+    {
+        if (config.isTx) //stream rate to device rate
+        {
+            resampler = new Resampler(config.resampleDown, config.resampleUp);
+            //scratch buffers of one converted chunk and filter flush
+            const uint32_t maxOut = resampler->MaxOutput(samples12InPkt) + resampler->MaxOutput(resampler->GetTapsPerOutput());
+            resampleOut.resize(2*maxOut);
+            resampleIn.resize(maxOut);
+        }
+        else
+            resampler = new Resampler(config.resampleUp, config.resampleDown);
+    }
+
+    delete trigger;
+    trigger = nullptr;
+    if (config.powerTrigger && !config.isTx)
+    {
+        PowerTrigger::Config triggerConfig;
+        triggerConfig.level = config.triggerLevel;
+        triggerConfig.hysteresis = config.triggerHysteresis;
+        triggerConfig.average = config.triggerAverage;
+        triggerConfig.preTrigger = config.preTrigger;
+        triggerConfig.postTrigger = config.postTrigger;
+        const float fullScale = config.linkFormat == StreamConfig::FMT_INT12 ? 2047.0f : 32767.0f;
+        trigger = new PowerTrigger(triggerConfig, fullScale, pktSize);
+    }
+    return 0;
+}
+
+size_t StreamChannel::FifoLength(int pktSize)
+{
+    //largest automatic FIFO, former fixed default
+    const size_t maxAutoLength = 4*1024*1024;
+    size_t length = config.bufferLength;
+    if (length == 0)
+    {
+        const double rate = mStreamer->GetSampleRate(config.isTx);
+        if (rate > 0 && config.bufferLatency > 0)
+            length = std::min<size_t>(rate*config.bufferLatency, maxAutoLength);
+        else
+            length = maxAutoLength;
+        length = std::max<size_t>(length, 16*pktSize);
+    }
+    if (length < size_t(4*pktSize))  //set FIFO to at least 4 packets
+        length = 4*pktSize;
+    return length;
+}
+
+static int GetStreamNumaNode(const StreamConfig &config)
+{
+    if (config.numaNode >= 0 || config.cpuAffinity.empty())
+        return config.numaNode;
+    return GetCPUNumaNode(config.cpuAffinity[0]);
+}
+
+/** @brief Moves FIFO memory to the NUMA node and page size requested in stream config
+*/
+void StreamChannel::PlaceBuffers()
+{
+    if (fifo == nullptr)
+        return;
+    fifo->LockMemory(config.lockMemory);
+    const int node = GetStreamNumaNode(config);
+    if (node < 0 && !config.hugePages)
+        return;
+    fifo->ForEachBuffer([&](void* ptr, size_t size){ BindMemoryToNode(ptr, size, node, config.hugePages); });
+}
+
+/** @brief Sets stream thread parameters and moves FIFO memory accordingly
+    Stream threads read the configs of every stream on the chip when they
+    start, so changes are refused while any stream of the chip runs.
+*/
+int StreamChannel::SetThreadParams(const std::vector<int> &cpus, int priority, int numaNode, bool hugePages)
+{
+    if (mActive || mStreamer->IsStreaming())
+        return ReportError(EBUSY, "Stream thread parameters cannot be changed while streaming");
+    config.cpuAffinity = cpus;
+    config.threadPriority = priority;
+    config.numaNode = numaNode;
+    config.hugePages = hugePages;
+    PlaceBuffers();
+    return 0;
+}
+
+int StreamChannel::SetUSBThreadParams(const std::vector<int> &cpus, int priority)
+{
+    if (mActive || mStreamer->IsStreaming())
+        return ReportError(EBUSY, "USB thread parameters cannot be changed while streaming");
+    config.usbCpuAffinity = cpus;
+    config.usbThreadPriority = priority;
+    return 0;
 }
 
 void StreamChannel::Close()
 {
     if (mActive)
         Stop();
+    mStreamer->GetEvents(config.isTx).Interrupt();
+    mStreamer->Disarm();
     if (fifo)
         delete fifo;
     fifo = nullptr;
+    delete resampler;
+    resampler = nullptr;
+    delete trigger;
+    trigger = nullptr;
     used = false;
 }
 
-int StreamChannel::Write(const void* samples, const uint32_t count, const Metadata *meta, const int32_t timeout_ms)
+/** @brief Multiplier from link sample values to stream format values
+*/
+float StreamChannel::LinkToStreamScale() const
 {
-    int pushed = 0;
-    if(config.format == StreamConfig::FMT_FLOAT32 && config.isTx)
+    if (config.format == StreamConfig::FMT_FLOAT32)
+        return config.linkFormat == StreamConfig::FMT_INT12 ? 1.0f/2047.0f : 1.0f/32767.0f;
+    if (config.format == StreamConfig::FMT_INT16 && config.linkFormat == StreamConfig::FMT_INT12)
+        return 16.0f;
+    if (config.format == StreamConfig::FMT_INT12 && config.linkFormat != StreamConfig::FMT_INT12)
+        return 1.0f/16.0f;
+    return 1.0f;
+}
+
+static inline int16_t Saturate(float value)
+{
+    const long v = std::lrint(value);
+    return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+}
+
+/** @brief Resamples samples from device rate FIFO to stream rate.
+    Resampled samples that were pending when a gap in FIFO timestamps
+    occurred are dropped, so every read stays contiguous in time.
+*/
+int StreamChannel::ReadResampled(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
+{
+    const float scale = LinkToStreamScale();
+    while (resampleOutLen - resampleOutPos < count)
     {
-        const float* samplesFloat = (const float*)samples;
-        int16_t* samplesShort = new int16_t[2*count];
-        const float maxValue = config.linkFormat == StreamConfig::FMT_INT12 ? 2047.0f : 32767.0f;
-        for(size_t i=0; i<2*count; ++i)
-            samplesShort[i] = samplesFloat[i]*maxValue;
-        const complex16_t* ptr = (const complex16_t*)samplesShort ;
-        pushed = fifo->push_samples(ptr, count, meta ? meta->timestamp : 0, timeout_ms, meta ? meta->flags : 0);
-        delete[] samplesShort;
+        const size_t pending = resampleOutLen - resampleOutPos;
+        const uint32_t inCount = std::max<uint32_t>(resampler->ToInputTime(count - pending) + 1, samples12InPkt);
+        if (resampleIn.size() < inCount)
+            resampleIn.resize(inCount);
+        uint64_t timestamp = 0;
+        const uint32_t popped = fifo->pop_samples(resampleIn.data(), inCount, &timestamp, timeout_ms);
+        if (popped == 0)
+            break;
+        if (timestamp != resampler->GetNextInputTimestamp())
+            resampleOutPos = resampleOutLen;
+
+        const size_t kept = resampleOutLen - resampleOutPos;
+        memmove(resampleOut.data(), resampleOut.data() + 2*resampleOutPos, 2*kept*sizeof(float));
+        resampleOutPos = 0;
+        resampleOutLen = kept;
+        const size_t needed = 2*(kept + resampler->MaxOutput(popped));
+        if (resampleOut.size() < needed)
+            resampleOut.resize(needed);
+        uint64_t outTimestamp = 0;
+        const uint32_t produced = resampler->Process(resampleIn.data(), popped, timestamp, scale, &resampleOut[2*kept], outTimestamp);
+        if (kept == 0)
+            resampleOutTimestamp = outTimestamp;
+        resampleOutLen += produced;
+        if (popped < inCount)
+            break;
     }
-    else if(config.format != config.linkFormat)
+
+    const uint32_t available = resampleOutLen - resampleOutPos;
+    const uint32_t cnt = count < available ? count : available;
+    const float* src = resampleOut.data() + 2*resampleOutPos;
+    if (config.format == StreamConfig::FMT_FLOAT32)
+        memcpy(samples, src, 2*cnt*sizeof(float));
+    else
     {
-        int16_t* samplesShort = (int16_t*)samples;
-        int16_t* samplesConverted = new int16_t[2*count];
-        if(config.format == StreamConfig::FMT_INT16)
-            for(size_t i=0; i<2*count; ++i)
-                samplesConverted[i] = samplesShort[i] >> 4;
+        int16_t* dst = (int16_t*)samples;
+        for (size_t i = 0; i < 2*cnt; ++i)
+            dst[i] = Saturate(src[i]);
+    }
+    if (meta)
+        meta->timestamp = resampleOutTimestamp;
+    resampleOutPos += cnt;
+    resampleOutTimestamp += cnt;
+    return cnt;
+}
+
+/** @brief Resamples stream rate samples to device rate and pushes them to FIFO.
+    End of burst flushes filter, so burst ends at its last stream sample.
+    Resampled samples that do not fit into FIFO within timeout are dropped.
+*/
+int StreamChannel::WriteResampled(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms)
+{
+    const float scale = 1.0f/LinkToStreamScale();
+    const uint32_t flags = meta ? meta->flags : 0;
+    const uint64_t next = resampler->GetNextInputTimestamp();
+    uint64_t timestamp = next != ~uint64_t(0) ? next : 0;
+    if (flags & RingFIFO::SYNC_TIMESTAMP)
+        timestamp = meta->timestamp;
+
+    const uint32_t chunkSize = samples12InPkt;
+    float* out = resampleOut.data();
+    uint32_t consumed = 0;
+    while (consumed < count)
+    {
+        const uint32_t cnt = count - consumed < chunkSize ? count - consumed : chunkSize;
+        uint64_t outTimestamp = 0;
+        uint32_t produced;
+        if (config.format == StreamConfig::FMT_FLOAT32)
+            produced = resampler->Process((const float*)samples + 2*consumed, cnt, timestamp + consumed, out, outTimestamp);
         else
-            for(size_t i=0; i<2*count; ++i)
-                samplesConverted[i] = samplesShort[i] << 4;
-        const complex16_t* ptr = (const complex16_t*)samplesConverted;
-        pushed = fifo->push_samples(ptr, count, meta ? meta->timestamp : 0, timeout_ms, meta ? meta->flags : 0);
-        delete[] samplesConverted;
+            produced = resampler->Process((const complex16_t*)samples + consumed, cnt, timestamp + consumed, 1.0f, out, outTimestamp);
+        consumed += cnt;
+
+        uint32_t chunkFlags = flags & ~RingFIFO::END_BURST;
+        if (consumed == count && (flags & RingFIFO::END_BURST))
+        {
+            uint64_t flushTimestamp;
+            produced += resampler->Flush(out + 2*produced, flushTimestamp);
+            chunkFlags = flags;
+        }
+        if (produced == 0)
+            continue;
+
+        int16_t* converted = (int16_t*)resampleIn.data();
+        for (size_t i = 0; i < 2*produced; ++i)
+            converted[i] = Saturate(out[i]*scale);
+        if (fifo->push_samples(resampleIn.data(), produced, outTimestamp, timeout_ms, chunkFlags) != produced)
+            break;
+    }
+    return consumed;
+}
+
+int StreamChannel::Write(const void* samples, const uint32_t count, const Metadata *meta, const int32_t timeout_ms)
+{
+    if (config.directBuffers)
+        return ReportError(-1, "Write: stream uses direct TX buffers, use AcquireTxPacket()");
+    if (resampler)
+        return WriteResampled(samples, count, meta, timeout_ms);
+    int pushed = 0;
+    if((config.format == StreamConfig::FMT_FLOAT32 && config.isTx) || config.format != config.linkFormat)
+    {
+        //convert in fixed size chunks to avoid heap allocation per call
+        const uint32_t chunkSize = samples12InPkt;
+        complex16_t converted[chunkSize];
+        int16_t* samplesConverted = (int16_t*)converted;
+        const uint64_t timestamp = meta ? meta->timestamp : 0;
+        const uint32_t flags = meta ? meta->flags : 0;
+        while (uint32_t(pushed) < count)
+        {
+            const uint32_t cnt = count - pushed < chunkSize ? count - pushed : chunkSize;
+            if(config.format == StreamConfig::FMT_FLOAT32)
+            {
+                const float* samplesFloat = (const float*)samples + 2*pushed;
+                const float maxValue = config.linkFormat == StreamConfig::FMT_INT12 ? 2047.0f : 32767.0f;
+                for(size_t i=0; i<2*cnt; ++i)
+                    samplesConverted[i] = samplesFloat[i]*maxValue;
+            }
+            else
+            {
+                const int16_t* samplesShort = (const int16_t*)samples + 2*pushed;
+                if(config.format == StreamConfig::FMT_INT16)
+                    for(size_t i=0; i<2*cnt; ++i)
+                        samplesConverted[i] = samplesShort[i] >> 4;
+                else
+                    for(size_t i=0; i<2*cnt; ++i)
+                        samplesConverted[i] = samplesShort[i] << 4;
+            }
+            //end of burst applies only to the last chunk
+            const uint32_t chunkFlags = pushed + cnt < count ? flags & ~RingFIFO::END_BURST : flags;
+            const uint32_t ret = fifo->push_samples(converted, cnt, timestamp + pushed, timeout_ms, chunkFlags);
+            pushed += ret;
+            if (ret != cnt)
+                break;
+        }
     }
     else
     {
@@ -87,17 +401,76 @@ int StreamChannel::Write(const void* samples, const uint32_t count, const Metada
     return pushed;
 }
 
+int StreamChannel::AcquireTxPacket(TxPacket &packet, const int32_t timeout_ms)
+{
+    if (!config.isTx || !config.directBuffers)
+        return ReportError(-1, "AcquireTxPacket: stream is not set up for direct TX buffers");
+    return mStreamer->AcquireTxPacket(packet, timeout_ms);
+}
+
+int StreamChannel::CommitTxPacket(const uint32_t count, const Metadata* meta)
+{
+    if (!config.isTx || !config.directBuffers)
+        return ReportError(-1, "CommitTxPacket: stream is not set up for direct TX buffers");
+    return mStreamer->CommitTxPacket(count, meta);
+}
+
+int StreamChannel::CommitTxPacket(const void* const* samples, const uint32_t count, const Metadata* meta)
+{
+    TxPacket packet;
+    //packet is already lent, this only returns its layout
+    if (AcquireTxPacket(packet, 0) <= 0)
+        return -1;
+    if (count > packet.capacity)
+        return ReportError(-1, "CommitTxPacket: %u samples do not fit packet", count);
+    const bool packed = packet.linkFormat == StreamConfig::FMT_INT12;
+    const float maxValue = packed ? 2047.0f : 32767.0f;
+    complex16_t converted[2][samples12InPkt];
+    const complex16_t* src[2] = {converted[0], converted[1]};
+    for (int ch = 0; ch < packet.channels; ++ch)
+    {
+        int16_t* dst = (int16_t*)converted[ch];
+        if (samples[ch] == nullptr)
+            memset(dst, 0, count*sizeof(complex16_t));
+        else if (config.format == StreamConfig::FMT_FLOAT32)
+        {
+            const float* samplesFloat = (const float*)samples[ch];
+            for (size_t i = 0; i < 2*count; ++i)
+                dst[i] = samplesFloat[i]*maxValue;
+        }
+        else if (config.format == config.linkFormat)
+            src[ch] = (const complex16_t*)samples[ch];
+        else
+        {
+            const int16_t* samplesShort = (const int16_t*)samples[ch];
+            if (config.format == StreamConfig::FMT_INT16)
+                for (size_t i = 0; i < 2*count; ++i)
+                    dst[i] = samplesShort[i] >> 4;
+            else
+                for (size_t i = 0; i < 2*count; ++i)
+                    dst[i] = samplesShort[i] << 4;
+        }
+    }
+    FPGA::Samples2FPGAPacketPayload(src, count, packet.channels == 2, packed, (uint8_t*)packet.payload);
+    return CommitTxPacket(count, meta);
+}
+
 int StreamChannel::Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
 {
     int popped = 0;
-    if(config.format == StreamConfig::FMT_FLOAT32 && !config.isTx)
+    //triggered windows end with END_BURST, reads stop there
+    uint32_t burstFlags = 0;
+    uint32_t* pBurstFlags = trigger ? &burstFlags : nullptr;
+    if (resampler)
+        popped = ReadResampled(samples, count, meta, timeout_ms);
+    else if(config.format == StreamConfig::FMT_FLOAT32 && !config.isTx)
     {
         //in place conversion
         complex16_t* ptr = (complex16_t*)samples;
         int16_t* samplesShort = (int16_t*)samples;
         float* samplesFloat = (float*)samples;
         const float maxValue = config.linkFormat == StreamConfig::FMT_INT12 ? 2047.0f : 32767.0f;
-        popped = fifo->pop_samples(ptr, count, meta ? &meta->timestamp : nullptr, timeout_ms);
+        popped = fifo->pop_samples(ptr, count, meta ? &meta->timestamp : nullptr, timeout_ms, pBurstFlags);
         for(int i=2*popped-1; i>=0; --i)
             samplesFloat[i] = (float)samplesShort[i]/maxValue;
     }
@@ -106,7 +479,7 @@ int StreamChannel::Read(void* samples, const uint32_t count, Metadata* meta, con
         complex16_t* ptr = (complex16_t*)samples;
         int16_t* samplesShort = (int16_t*)samples;
         int16_t* samplesConverted = (int16_t*)samples;
-        popped = fifo->pop_samples(ptr, count, meta ? &meta->timestamp : nullptr, timeout_ms);
+        popped = fifo->pop_samples(ptr, count, meta ? &meta->timestamp : nullptr, timeout_ms, pBurstFlags);
         if(config.format == StreamConfig::FMT_INT16)
             for(int i=2*popped-1; i>=0; --i)
                 samplesConverted[i] = samplesShort[i] << 4;
@@ -117,11 +490,29 @@ int StreamChannel::Read(void* samples, const uint32_t count, Metadata* meta, con
     else
     {
         complex16_t* ptr = (complex16_t*)samples;
-        popped = fifo->pop_samples(ptr, count, meta ? &meta->timestamp : nullptr, timeout_ms);
+        popped = fifo->pop_samples(ptr, count, meta ? &meta->timestamp : nullptr, timeout_ms, pBurstFlags);
     }
     if(meta)
-        meta->flags |= RingFIFO::SYNC_TIMESTAMP;
-
+    {
+        meta->flags &= ~(RingFIFO::CONFIG_CHANGED | RingFIFO::END_BURST);
+        meta->flags |= RingFIFO::SYNC_TIMESTAMP | burstFlags;
+        CommandQueue* queue = mStreamer->GetCommandQueueIfCreated();
+        if (queue && popped > 0)
+        {
+            uint64_t first = meta->timestamp;
+            uint64_t last = meta->timestamp + popped - 1;
+            if (resampler)
+            {
+                //device samples under the resampling filter
+                const uint64_t half = resampler->GetTapsPerOutput()/2;
+                first = resampler->ToInputTime(first);
+                first = first > half ? first - half : 0;
+                last = resampler->ToInputTime(last) + half;
+            }
+            if (queue->ChangedWithin(first, last))
+                meta->flags |= RingFIFO::CONFIG_CHANGED;
+        }
+    }
     return popped;
 }
 
@@ -136,6 +527,7 @@ StreamChannel::Info StreamChannel::GetInfo()
     stats.droppedPackets = pktLost;
     stats.overrun = info.overflow;
     stats.underrun = info.underflow;
+    stats.memoryUsed = info.memory + resampleOut.capacity()*sizeof(float) + resampleIn.capacity()*sizeof(complex16_t);
     pktLost = 0;
     if(config.isTx)
     {
@@ -147,9 +539,21 @@ StreamChannel::Info StreamChannel::GetInfo()
         stats.timestamp = mStreamer->rxLastTimestamp.load(std::memory_order_relaxed);
         stats.linkRate = mStreamer->rxDataRate_Bps.load(std::memory_order_relaxed);
     }
+    if (resampler)
+    {
+        stats.timestamp = config.isTx ? resampler->ToInputTime(stats.timestamp) : resampler->ToOutputTime(stats.timestamp);
+        stats.resampleCost = resampler->GetCostPerSample();
+    }
     return stats;
 }
 
+bool StreamChannel::WaitEvent(StreamEvent &event, const int32_t timeout_ms, uint8_t channels)
+{
+    if (channels == 0)
+        channels = 1 << (config.channelID&1);
+    return mStreamer->GetEvents(config.isTx).Wait(event, channels, timeout_ms);
+}
+
 int StreamChannel::GetStreamSize()
 {
     return mStreamer->GetStreamSize(config.isTx);
@@ -162,16 +566,33 @@ bool StreamChannel::IsActive() const
 
 int StreamChannel::Start()
 {
+    if (trigger)
+        trigger->Reset();
     mActive = true;
     fifo->Clear();
     pktLost = 0;
-    return mStreamer->UpdateThreads();
+    if (resampler)
+        resampler->Reset();
+    resampleOutPos = resampleOutLen = 0;
+    int status = mStreamer->UpdateThreads();
+    if (status == 0 && !config.isTx && config.dcIqTracking)
+        status = mStreamer->EnableRxTracking(config.channelID&1, true);
+    return status;
+}
+
+int StreamChannel::Arm()
+{
+    return mStreamer->Arm();
 }
 
 int StreamChannel::Stop()
 {
     mActive = false;
-    return mStreamer->UpdateThreads();
+    if (!config.isTx)
+        mStreamer->EnableRxTracking(config.channelID&1, false);
+    const int status = mStreamer->UpdateThreads();
+    mStreamer->GetEvents(config.isTx).Interrupt();
+    return status;
 }
 
 Streamer::Streamer(FPGA* f, LMS7002M* chip, int id) : mRxStreams(2, this), mTxStreams(2, this)
@@ -189,18 +610,212 @@ Streamer::Streamer(FPGA* f, LMS7002M* chip, int id) : mRxStreams(2, this), mTxSt
     txBatchSize = 1;
     rxBatchSize = 1;
     streamSize = 1;
+    for (auto &tracker : rxTracker)
+        tracker.store(nullptr);
+    for (auto &channelizer : rxChannelizer)
+        channelizer.store(nullptr);
+    commandQueue.store(nullptr);
+    rxRun = false;
+    txRun = false;
+    workersExit = false;
+    armed = false;
+    startAlign = false;
+    txDirectMemory = nullptr;
+    txDirectSize = 0;
+    txDirectHugePages = false;
+    txDirectRunning = false;
+    txPacketsPerBuffer = 0;
+    txPacketCapacity = 0;
+    alignBuffer.resize(sizeof(FPGA_DataPacket));
+    txPacketChannels = 1;
+    txFillIndex = 0;
+    txAcquired = false;
+    txNextTimestamp = 0;
 }
 
 Streamer::~Streamer()
 {
+    //pending commands are dropped before chip goes away
+    delete commandQueue.exchange(nullptr);
     terminateRx.store(true, std::memory_order_relaxed);
     terminateTx.store(true, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(workerLock);
+        workersExit = true;
+        workerCond.notify_all();
+    }
     if (txThread.joinable())
         txThread.join();
     if (rxThread.joinable())
         rxThread.join();
+    for (auto &tracker : rxTracker)
+        delete tracker.load();
+    for (auto &channelizer : rxChannelizer)
+        delete channelizer.load();
+    if (txDirectMemory)
+        FreeBuffer(txDirectMemory, txDirectSize, txDirectHugePages);
+}
+
+/** @brief Starts or stops background DC/IQ tracking of RX channel
+    @param ch channel index within this chip
+*/
+int Streamer::EnableRxTracking(int ch, bool enable)
+{
+    DCIQTracker* tracker = rxTracker[ch].load();
+    if (!enable)
+        return tracker ? tracker->Stop() : 0;
+    if (tracker == nullptr)
+    {
+        //kept until destruction, RX thread may hold the pointer
+        tracker = new DCIQTracker();
+        rxTracker[ch].store(tracker);
+    }
+    if (tracker->IsRunning())
+        return 0;
+    return tracker->Start(lms, ch, DCIQTracker::Config());
+}
+
+DCIQTracker* Streamer::GetRxTracker(int ch) const
+{
+    return rxTracker[ch&1].load();
+}
+
+/** @brief Returns channelizer of RX channel, created on first use
+    @param ch channel index within this chip
+*/
+Channelizer* Streamer::GetRxChannelizer(int ch)
+{
+    Channelizer* channelizer = rxChannelizer[ch&1].load();
+    if (channelizer)
+        return channelizer;
+    //kept until destruction, RX thread may hold the pointer
+    Channelizer* created = new Channelizer();
+    if (rxChannelizer[ch&1].compare_exchange_strong(channelizer, created))
+        return created;
+    delete created;
+    return channelizer;
+}
+
+CommandQueue* Streamer::GetCommandQueue()
+{
+    CommandQueue* queue = commandQueue.load();
+    if (queue)
+        return queue;
+    CommandQueue* created = new CommandQueue(this, lms);
+    if (commandQueue.compare_exchange_strong(queue, created))
+        return created;
+    delete created;
+    return queue;
+}
+
+CommandQueue* Streamer::GetCommandQueueIfCreated() const
+{
+    return commandQueue.load(std::memory_order_acquire);
+}
+
+StreamEventQueue &Streamer::GetEvents(bool tx)
+{
+    return tx ? txEvents : rxEvents;
+}
+
+const ClockModel &Streamer::GetClockModel() const
+{
+    return clockModel;
+}
+
+//! Mask of channels whose streams of direction are active
+uint8_t Streamer::ActiveChannels(bool tx) const
+{
+    const std::vector<StreamChannel> &streams = tx ? mTxStreams : mRxStreams;
+    uint8_t mask = 0;
+    for (size_t ch = 0; ch < streams.size(); ++ch)
+        if (streams[ch].used && streams[ch].mActive)
+            mask |= 1 << ch;
+    return mask;
+}
+
+bool Streamer::IsTxDirect() const
+{
+    for (auto &i : mTxStreams)
+        if (i.used && i.config.directBuffers)
+            return true;
+    return false;
+}
+
+/** @brief Lends payload of the next packet in TX transfer buffer ring
+    Buffers are filled in the same order TX thread sends them, acquiring
+    again before commit returns the same packet.
+    @return samples per channel that fit packet, 0 on timeout
+*/
+int Streamer::AcquireTxPacket(StreamChannel::TxPacket &packet, const int32_t timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(txDirectLock);
+    auto available = [this]{
+        return txDirectRunning && (txAcquired || txBuffers[txFillIndex].state == TX_FREE || txBuffers[txFillIndex].state == TX_FILLING);
+    };
+    if (!txDirectCond.wait_for(lock, std::chrono::milliseconds(timeout_ms), available))
+        return 0;
+    TxBuffer &buffer = txBuffers[txFillIndex];
+    if (buffer.state == TX_FREE)
+    {
+        buffer.state = TX_FILLING;
+        buffer.packets = 0;
+        buffer.bytes = 0;
+    }
+    txAcquired = true;
+    FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(txDirectMemory) + txFillIndex*txPacketsPerBuffer + buffer.packets;
+    packet.payload = pkt->data;
+    packet.capacity = txPacketCapacity;
+    packet.channels = txPacketChannels;
+    packet.linkFormat = dataLinkFormat;
+    return txPacketCapacity;
 }
 
+/** @brief Fills header of acquired packet and queues it
+    Packets are sent at fixed offsets of transfer buffer, so packet that is
+    not full ends the transfer, like END_BURST does.
+*/
+int Streamer::CommitTxPacket(const uint32_t count, const StreamChannel::Metadata* meta)
+{
+    std::lock_guard<std::mutex> lock(txDirectLock);
+    if (!txAcquired || !txDirectRunning)
+        return ReportError(-1, "CommitTxPacket: no packet acquired");
+    if (count > txPacketCapacity)
+        return ReportError(-1, "CommitTxPacket: %u samples do not fit packet", count);
+    const uint32_t flags = meta ? meta->flags : 0;
+    txAcquired = false;
+    if (count == 0 && !(flags & RingFIFO::END_BURST))
+        return 0;
+
+    TxBuffer &buffer = txBuffers[txFillIndex];
+    FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(txDirectMemory) + txFillIndex*txPacketsPerBuffer + buffer.packets;
+    const bool packed = dataLinkFormat == StreamConfig::FMT_INT12;
+    int payloadSize = sizeof(FPGA_DataPacket::data);
+    if (count < txPacketCapacity)
+    {
+        const int used = count * (packed ? 3 : 4) * txPacketChannels;
+        const int q = packed ? 48 : 16;
+        payloadSize = (1 + (used - 1) / q) * q;
+        memset(&pkt->data[used], 0, payloadSize - used);
+    }
+    pkt->counter = (flags & RingFIFO::SYNC_TIMESTAMP) ? meta->timestamp : txNextTimestamp;
+    txNextTimestamp = pkt->counter + count;
+    //by default ignore timestamps
+    const int ignoreTimestamp = !(flags & RingFIFO::SYNC_TIMESTAMP);
+    pkt->reserved[0] = ((int)ignoreTimestamp << 4);
+    pkt->reserved[1] = payloadSize & 0xFF;
+    pkt->reserved[2] = (payloadSize >> 8) & 0xFF;
+    buffer.bytes += 16+payloadSize;
+    buffer.endBurst = flags & RingFIFO::END_BURST;
+    buffer.lastTimestamp = pkt->counter + (count ? count - 1 : 0);
+    if (++buffer.packets == txPacketsPerBuffer || count < txPacketCapacity || (flags & RingFIFO::END_BURST))
+    {
+        buffer.state = TX_READY;
+        txFillIndex = (txFillIndex + 1) % txBuffers.size();
+        txDirectCond.notify_all();
+    }
+    return count;
+}
 
 StreamChannel* Streamer::SetupStream(const StreamConfig& config)
 {
@@ -212,7 +827,8 @@ StreamChannel* Streamer::SetupStream(const StreamConfig& config)
         return nullptr;
     }
 
-    if (txThread.joinable() || rxThread.joinable())
+    armed = false;
+    if (IsRunning(true) || IsRunning(false))
     {
         if ((!mTxStreams[ch].used) && (!mRxStreams[ch].used))
         {
@@ -227,10 +843,31 @@ StreamChannel* Streamer::SetupStream(const StreamConfig& config)
         }
     }
 
-    if(config.isTx)
-        mTxStreams[ch].Setup(config);
-    else
-        mRxStreams[ch].Setup(config);
+    if (config.isTx && config.directBuffers)
+    {
+        if (config.resampleUp != config.resampleDown)
+        {
+            lime::error("Stream setup failed: direct TX buffers do not support resampling");
+            return nullptr;
+        }
+        if (IsRunning(true))
+        {
+            lime::error("Stream setup failed: direct TX buffers cannot be added while transmitting");
+            return nullptr;
+        }
+    }
+    //TX channels share packets, both have to be written the same way
+    if (config.isTx && mTxStreams[ch^1].used && mTxStreams[ch^1].config.directBuffers != config.directBuffers)
+    {
+        lime::error("Stream setup failed: both TX channels have to use direct buffers or none");
+        return nullptr;
+    }
+
+    if((config.isTx ? mTxStreams[ch] : mRxStreams[ch]).Setup(config) != 0)
+    {
+        lime::error("Stream setup failed: %s", GetLastErrorMessage());
+        return nullptr;
+    }
 
     double rate = lms->GetSampleRate(config.isTx,LMS7002M::ChA)/1e6;
     streamSize = (mTxStreams[0].used||mRxStreams[0].used) + (mTxStreams[1].used||mRxStreams[1].used);
@@ -245,7 +882,7 @@ StreamChannel* Streamer::SetupStream(const StreamConfig& config)
     return config.isTx ? &mTxStreams[ch] : &mRxStreams[ch]; //success
 }
 
-void Streamer::ResizeChannelBuffers()
+int Streamer::ResizeChannelBuffers()
 {
     int pktSize = samples12InPkt/streamSize;
     for(auto& i : mRxStreams)
@@ -255,12 +892,69 @@ void Streamer::ResizeChannelBuffers()
         if(i.used && i.config.linkFormat != StreamConfig::FMT_INT12)
             pktSize = samples16InPkt/streamSize;
 
+    //slabs are reused, so restarts only re-point packets
     for(auto& i : mRxStreams)
         if(i.used && i.fifo)
-            i.fifo->Resize(pktSize);
+        {
+            if (i.fifo->Resize(pktSize, i.FifoLength(pktSize)/pktSize) != 0)
+                return -1;
+            i.PlaceBuffers();
+        }
     for(auto& i : mTxStreams)
         if(i.used && i.fifo)
-            i.fifo->Resize(pktSize);
+        {
+            if (i.fifo->Resize(pktSize, i.FifoLength(pktSize)/pktSize) != 0)
+                return -1;
+            i.PlaceBuffers();
+        }
+    return 0;
+}
+
+/** @brief Returns config of the first used stream requesting thread placement
+    @param tx stream direction
+    @return stream config or nullptr if default thread settings should be used
+*/
+const StreamConfig* Streamer::GetThreadConfig(bool tx) const
+{
+    const std::vector<StreamChannel> &streams = tx ? mTxStreams : mRxStreams;
+    for (auto &i : streams)
+        if (i.used && (!i.config.cpuAffinity.empty() || i.config.threadPriority > 0 || i.config.numaNode >= 0 || i.config.hugePages))
+            return &i.config;
+    return nullptr;
+}
+
+//placement applied to calling stream thread by earlier run, parked threads keep it
+static thread_local bool threadPinned = false;
+static thread_local bool threadNodeBound = false;
+
+/** @brief Applies CPU affinity, priority and memory node to the calling stream thread
+    Called at start of every run, so placement of a parked thread follows current config
+    @param config stream config from GetThreadConfig()
+    @return NUMA node for thread buffers, -1 for default placement
+*/
+int Streamer::ConfigureCurrentThread(const StreamConfig* config)
+{
+    if (config && config->threadPriority > 0)
+        SetOSCurrentThreadRealtimePriority(config->threadPriority);
+    else
+        SetOSCurrentThreadPriority(ThreadPriority::NORMAL, ThreadPolicy::REALTIME);
+
+    if (config && !config->cpuAffinity.empty())
+    {
+        SetOSCurrentThreadAffinity(config->cpuAffinity);
+        threadPinned = true;
+    }
+    else if (threadPinned)
+    {
+        SetOSCurrentThreadAffinity(std::vector<int>());
+        threadPinned = false;
+    }
+
+    const int node = config ? GetStreamNumaNode(*config) : -1;
+    if (node >= 0 || threadNodeBound)
+        SetOSCurrentThreadMemoryNode(node);
+    threadNodeBound = node >= 0;
+    return node;
 }
 
 int Streamer::GetStreamSize(bool tx)
@@ -279,7 +973,7 @@ int Streamer::GetStreamSize(bool tx)
 
 uint64_t Streamer::GetHardwareTimestamp(void)
 {
-    if(!(rxThread.joinable() || txThread.joinable()))
+    if(!(IsRunning(false) || IsRunning(true)))
     {
         //stop streaming just in case the board has not been configured
         fpga->WriteRegister(0xFFFF, 1 << chipId);
@@ -290,13 +984,28 @@ uint64_t Streamer::GetHardwareTimestamp(void)
     }
     else
     {
-        return rxLastTimestamp.load(std::memory_order_relaxed)+mTimestampOffset;
+        return CurrentTimestamp()+mTimestampOffset;
     }
 }
 
+double Streamer::GetSampleRate(bool tx)
+{
+    return lms->GetSampleRate(tx, LMS7002M::ChA);
+}
+
 void Streamer::SetHardwareTimestamp(const uint64_t now)
 {
-    mTimestampOffset = now - rxLastTimestamp.load(std::memory_order_relaxed);
+    mTimestampOffset = now - CurrentTimestamp();
+}
+
+uint64_t Streamer::CurrentTimestamp() const
+{
+    //last received timestamp lags by transfer size, estimate counter from host clock
+    const uint64_t received = rxLastTimestamp.load(std::memory_order_relaxed);
+    uint64_t estimate;
+    if (IsRunning(false) && clockModel.Now(estimate) == 0 && estimate > received)
+        return estimate;
+    return received;
 }
 
 void Streamer::RstRxIQGen()
@@ -350,32 +1059,30 @@ void Streamer::AlignRxTSP()
         dataWr[1] = (1 << 31) | (uint32_t(0x0400) << 16) | 0x8085;
         dataWr[2] = (1 << 31) | (uint32_t(0x040C) << 16) | 0x01FF;
         dataPort->WriteLMS7002MSPI(dataWr, 3, chipId);
-        uint32_t* buf = new uint32_t[sizeof(FPGA_DataPacket) / sizeof(uint32_t)];
 
         fpga->StopStreaming();
-        fpga->WriteRegister(0xFFFF, 1 << chipId);
-        fpga->WriteRegister(0x0008, 0x0100);
-        fpga->WriteRegister(0x0007, 3);
+        {
+            FPGA::WriteBatch batch(fpga);
+            fpga->WriteRegister(0xFFFF, 1 << chipId);
+            fpga->WriteRegister(0x0008, 0x0100);
+            fpga->WriteRegister(0x0007, 3);
+        }
 
         dataWr[0] = (1 << 31) | (uint32_t(0x0020) << 16) | 0x55FE;
         dataWr[1] = (1 << 31) | (uint32_t(0x0020) << 16) | 0xFFFD;
 
+        const uint32_t* buf = (const uint32_t*)alignBuffer.data();
         for (int i = 0; i < 100; i++)
         {
             dataPort->WriteLMS7002MSPI(&dataWr[0], 2, chipId);
-            dataPort->ResetStreamBuffers();
-            fpga->StartStreaming();
-            if (dataPort->ReceiveData((char*)buf, sizeof(FPGA_DataPacket), chipId, 50) != sizeof(FPGA_DataPacket))
+            if (CaptureAlignPacket() != 0)
             {
                 lime::warning("Channel alignment failed");
                 break;
             }
-            fpga->StopStreaming();
-            dataPort->AbortReading(chipId);
             if (buf[4] == buf[5])
                 break;
         }
-        delete[] buf;
     }
 
     //restore values
@@ -392,41 +1099,34 @@ void Streamer::AlignRxTSP()
     }
 }
 
-double Streamer::GetPhaseOffset(int bin)
+/** @brief Receives single packet into alignment buffer, FPGA must be configured
+    @return 0 on success
+*/
+int Streamer::CaptureAlignPacket()
 {
-    int16_t* buf = new int16_t[sizeof(FPGA_DataPacket)/sizeof(int16_t)];
-
     dataPort->ResetStreamBuffers();
     fpga->StartStreaming();
-    if (dataPort->ReceiveData((char*)buf, sizeof(FPGA_DataPacket), chipId, 50)!=sizeof(FPGA_DataPacket))
+    const int received = dataPort->ReceiveData(alignBuffer.data(), sizeof(FPGA_DataPacket), chipId, 50);
+    fpga->StopStreaming();
+    dataPort->AbortReading(chipId);
+    return received == sizeof(FPGA_DataPacket) ? 0 : -1;
+}
+
+/** @brief Captures one packet and measures channel phase difference at estimator bins
+    @param offsets channel B - A phase in degrees for each bin
+    @param magnitudes channel A magnitude for each bin
+    @return 0 on success
+*/
+int Streamer::GetPhaseOffsets(const PhaseEstimator &estimator, double* offsets, double* magnitudes)
+{
+    if (CaptureAlignPacket() != 0)
     {
         lime::warning("Channel alignment failed");
-        delete [] buf;
-        return -1000;
+        return -1;
     }
-    fpga->StopStreaming();
-    dataPort->AbortReading(chipId);
-    //calculate DFT bin of interest and check channel phase difference
-    const std::complex<double> iunit(0, 1);
-    const double pi = std::acos(-1);
-    const int N = 512;
-    std::complex<double> xA(0,0);
-    std::complex<double> xB(0, 0);
-    for (int n = 0; n < N; n++)
-    {
-        const std::complex<double> xAn(buf[8+4*n], buf[9+4*n]);
-        const std::complex<double> xBn(buf[10+4*n],buf[11+4*n]);
-        const std::complex<double> mult = std::exp(-2.0*iunit*pi* double(bin)* double(n)/double(N));
-        xA += xAn * mult;
-        xB += xBn * mult;
-    }
-    double phaseA = std::arg(xA) * 180.0 / pi;
-    double phaseB = std::arg(xB) * 180.0 / pi;
-    double phasediff = phaseB - phaseA;
-    if (phasediff < -180.0) phasediff +=360.0;
-    if (phasediff > 180.0) phasediff -=360.0;
-    delete [] buf;
-    return phasediff;
+    const FPGA_DataPacket* pkt = (const FPGA_DataPacket*)alignBuffer.data();
+    estimator.Estimate((const int16_t*)pkt->data, offsets, magnitudes);
+    return 0;
 }
 
 void Streamer::AlignRxRF(bool restoreValues)
@@ -464,28 +1164,52 @@ void Streamer::AlignRxRF(bool restoreValues)
     std::vector<uint32_t>  dataWr;
     dataWr.resize(16);
 
-    fpga->WriteRegister(0xFFFF, 1 << chipId);
-    fpga->StopStreaming();
-    fpga->WriteRegister(0x0008, 0x0100);
-    fpga->WriteRegister(0x0007, 3);
+    {
+        FPGA::WriteBatch batch(fpga);
+        fpga->WriteRegister(0xFFFF, 1 << chipId);
+        fpga->StopStreaming();
+        fpga->WriteRegister(0x0008, 0x0100);
+        fpga->WriteRegister(0x0007, 3);
+    }
+    //both bins are evaluated from every capture, tone bin must dominate
+    const PhaseEstimator estimator(512, {32, 64});
+    const double toneFreq[] = {450e6+srate/16.0, 450e6+srate/8.0};
+    int tone = 0;
+    lms->SetFrequencySX(true, toneFreq[tone]);
     bool found = false;
-    for (int i = 0; i < 200; i++){
+    bool failed = false;
+    for (int i = 0; i < 200 && !failed && !found; i++){
         lms->Modify_SPI_Reg_bits(LMS7_PD_FDIV_O_CGEN, 1);
         lms->Modify_SPI_Reg_bits(LMS7_PD_FDIV_O_CGEN, 0);
         AlignRxTSP();
 
-        lms->SetFrequencySX(true, 450e6+srate/16.0);
-        double offset1 = GetPhaseOffset(32);
-        if (offset1 < -360)
-            break;
-        lms->SetFrequencySX(true, 450e6+srate/8.0);
-        double offset2 = GetPhaseOffset(64);
-        if (offset2 < -360)
-            break;
-        double diff = offset1-offset2;
-        if (abs(diff-offset) < tolerance[dec])
+        //rejected capture says nothing about clock phase, so only measurement is repeated
+        for (int attempt = 0; attempt < 4 && !failed; ++attempt)
         {
-            found = true;
+            //measure tone left from previous measurement first, one retune per measurement
+            double phase[2];
+            bool valid = true;
+            for (int k = 0; k < 2; ++k)
+            {
+                if (k != 0)
+                {
+                    tone ^= 1;
+                    lms->SetFrequencySX(true, toneFreq[tone]);
+                }
+                double offsets[2];
+                double magnitudes[2];
+                if (GetPhaseOffsets(estimator, offsets, magnitudes) != 0)
+                {
+                    failed = true;
+                    break;
+                }
+                valid &= magnitudes[tone] > magnitudes[tone^1];
+                phase[tone] = offsets[tone];
+            }
+            if (failed || !valid)
+                continue;
+            //valid estimate decides this clock phase, out of tolerance needs CGEN reset
+            found = abs(phase[0]-phase[1]-offset) < tolerance[dec];
             break;
         }
     }
@@ -535,16 +1259,21 @@ void Streamer::AlignQuadrature(bool restoreValues)
     double srate = lms->GetSampleRate(false, LMS7002M::ChA);
     double freq = lms->GetFrequencySX(false);
 
-    fpga->WriteRegister(0xFFFF, 1 << chipId);
-    fpga->StopStreaming();
-    fpga->WriteRegister(0x0008, 0x0100);
-    fpga->WriteRegister(0x0007, 3);
+    {
+        FPGA::WriteBatch batch(fpga);
+        fpga->WriteRegister(0xFFFF, 1 << chipId);
+        fpga->StopStreaming();
+        fpga->WriteRegister(0x0008, 0x0100);
+        fpga->WriteRegister(0x0007, 3);
+    }
     lms->SetFrequencySX(true, freq+srate/16.0);
+    const PhaseEstimator estimator(512, {32});
     bool found = false;
     for (int i = 0; i < 100; i++){
 
-        double offset = GetPhaseOffset(32);
-        if (offset < -360)
+        double offset;
+        double magnitude;
+        if (GetPhaseOffsets(estimator, &offset, &magnitude) != 0)
             break;
         if (fabs(offset) <= 90.0)
         {
@@ -560,6 +1289,175 @@ void Streamer::AlignQuadrature(bool restoreValues)
         lime::warning("Channel alignment failed");
 }
 
+/** @brief Configures FPGA for streaming of used channels up to the start itself
+    FPGA streaming is stopped, timestamp and device stream buffers are reset,
+    registers that start streaming are collected to startAddrs/startData.
+*/
+int Streamer::PrepareStart()
+{
+    if (ResizeChannelBuffers() != 0)
+        return -1;
+    fpga->WriteRegister(0xFFFF, 1 << chipId);
+    startAlign = (mRxStreams[0].used && mRxStreams[1].used && (mRxStreams[0].config.align | mRxStreams[1].config.align));
+    if (startAlign)
+        AlignRxRF(true);
+    //read interface control once, stop streaming and reset timestamp in one transfer
+    const uint32_t ctrlAddr[] = {0x000A, 0x0009};
+    uint32_t ctrl[2];
+    if (fpga->ReadRegisters(ctrlAddr, ctrl, 2) != 0)
+        return -1;
+    const uint32_t reg10 = ctrl[0] & ~0x3; //RX_EN, TX_EN
+    const uint32_t reg9 = ctrl[1] & ~0x3; //SMPL_NR_CLR, TXPCT_LOSS_CLR
+    {
+        const uint32_t addr[] = {0x000A, 0x0009, 0x0009, 0x0009};
+        const uint32_t data[] = {reg10, reg9, reg9 | 0x3, reg9};
+        fpga->WriteRegisters(addr, data, 4);
+    }
+    rxLastTimestamp.store(0, std::memory_order_relaxed);
+    clockModel.Reset();
+    rxEvents.Clear();
+    txEvents.Clear();
+    //Clear device stream buffers
+    dataPort->ResetStreamBuffers();
+
+    //enable MIMO mode, 12 bit compressed values
+    dataLinkFormat = StreamConfig::FMT_INT12;
+    //by default use 12 bit compressed, adjust link format for stream
+
+    for(auto &i : mRxStreams)
+        if(i.used && i.config.linkFormat != StreamConfig::FMT_INT12)
+        {
+            dataLinkFormat = StreamConfig::FMT_INT16;
+            break;
+        }
+
+    for(auto &i : mTxStreams)
+        if(i.used && i.config.linkFormat != StreamConfig::FMT_INT12)
+        {
+            dataLinkFormat = StreamConfig::FMT_INT16;
+            break;
+        }
+
+    const uint16_t smpl_width = dataLinkFormat == StreamConfig::FMT_INT12 ? 2 : 0;
+    uint16_t mode = 0x0100;
+
+    if (lms->Get_SPI_Reg_bits(LMS7param(LML1_SISODDR)))
+        mode = 0x0040;
+    else if (lms->Get_SPI_Reg_bits(LMS7param(LML1_TRXIQPULSE)))
+        mode = 0x0180;
+
+    const uint16_t channelEnables = (mRxStreams[0].used||mTxStreams[0].used) + 2 * (mRxStreams[1].used||mTxStreams[1].used);
+
+    //link format, channels, start streaming and pulse 0x0009 bits 1,3
+    startAddrs = {0xFFFF, 0x0008, 0x0007, 0x000A, 0x0009, 0x0009};
+    startData = {uint32_t(1 << chipId), uint32_t(mode | smpl_width), channelEnables,
+                 reg10 | 0x1, reg9 | (5 << 1), reg9 & ~(5 << 1)}; //RX_EN
+    return 0;
+}
+
+/** @brief Prepares start of used streams ahead of time
+    FPGA configuration, buffer reset and LMS logic reset are done here and
+    stream threads are created parked, so the next stream Start() only sends
+    one register transfer and wakes the threads. Changing streams disarms.
+*/
+int Streamer::Arm()
+{
+    if (IsRunning(false) || IsRunning(true))
+        return ReportError(EBUSY, "Streamer: cannot arm while streaming");
+    bool needRx = false;
+    bool needTx = false;
+    for (auto &i : mRxStreams)
+        needRx |= i.used;
+    for (auto &i : mTxStreams)
+        needTx |= i.used;
+    if (!needRx && !needTx)
+        return ReportError(EINVAL, "Streamer: no streams to arm");
+    armed = false;
+    if (PrepareStart() != 0)
+        return -1;
+    if (!startAlign)
+        lms->ResetLogicregisters();
+    if (needRx)
+        SpawnWorker(false);
+    if (needTx)
+        SpawnWorker(true);
+    armed = true;
+    return 0;
+}
+
+void Streamer::Disarm()
+{
+    armed = false;
+}
+
+bool Streamer::IsArmed() const
+{
+    return armed;
+}
+
+/** @brief Creates parked stream thread of direction if it does not exist yet
+*/
+void Streamer::SpawnWorker(bool tx)
+{
+    std::thread &thread = tx ? txThread : rxThread;
+    if (thread.joinable())
+        return;
+    thread = std::thread(&Streamer::WorkerLoop, this, tx);
+}
+
+/** @brief Stream thread body, runs stream loop whenever started and parks between runs
+*/
+void Streamer::WorkerLoop(bool tx)
+{
+    bool &run = tx ? txRun : rxRun;
+    std::unique_lock<std::mutex> lock(workerLock);
+    while (true)
+    {
+        workerCond.wait(lock, [&]{ return workersExit || run; });
+        if (workersExit)
+            return;
+        lock.unlock();
+        if (tx)
+            TransmitPacketsLoop();
+        else
+            ReceivePacketsLoop();
+        lock.lock();
+        run = false;
+        workerCond.notify_all();
+    }
+}
+
+void Streamer::StartWorker(bool tx)
+{
+    SpawnWorker(tx);
+    (tx ? terminateTx : terminateRx).store(false, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(workerLock);
+    (tx ? txRun : rxRun) = true;
+    workerCond.notify_all();
+}
+
+/** @brief Ends stream loop of direction and waits until its thread is parked
+*/
+void Streamer::StopWorker(bool tx)
+{
+    (tx ? terminateTx : terminateRx).store(true, std::memory_order_relaxed);
+    const bool &run = tx ? txRun : rxRun;
+    std::unique_lock<std::mutex> lock(workerLock);
+    workerCond.wait(lock, [&]{ return !run; });
+}
+
+bool Streamer::IsRunning(bool tx) const
+{
+    std::lock_guard<std::mutex> lock(workerLock);
+    return tx ? txRun : rxRun;
+}
+
+bool Streamer::IsStreaming() const
+{
+    std::lock_guard<std::mutex> lock(workerLock);
+    return txRun || rxRun;
+}
+
 int Streamer::UpdateThreads(bool stopAll)
 {
     bool needTx = false;
@@ -582,70 +1480,23 @@ int Streamer::UpdateThreads(bool stopAll)
             }
     }
 
-    //stop threads if not needed
-    if((!needTx) && txThread.joinable())
-    {
-        terminateTx.store(true, std::memory_order_relaxed);
-        txThread.join();
-    }
-    if((!needRx) && rxThread.joinable())
-    {
-        terminateRx.store(true, std::memory_order_relaxed);
-        rxThread.join();
-    }
+    //stop threads if not needed, they stay parked for next start
+    if((!needTx) && IsRunning(true))
+        StopWorker(true);
+    if((!needRx) && IsRunning(false))
+        StopWorker(false);
 
+    bool rxRunning = IsRunning(false);
+    bool txRunning = IsRunning(true);
     //configure FPGA on first start, or disable FPGA when not streaming
-    if((needTx || needRx) && (!txThread.joinable()) && (!rxThread.joinable()))
+    if((needTx || needRx) && (!txRunning) && (!rxRunning))
     {
-        ResizeChannelBuffers();
-        fpga->WriteRegister(0xFFFF, 1 << chipId);
-        bool align = (mRxStreams[0].used && mRxStreams[1].used && (mRxStreams[0].config.align | mRxStreams[1].config.align));
-        if (align)
-            AlignRxRF(true);
-        //enable FPGA streaming
-        fpga->StopStreaming();
-        fpga->ResetTimestamp();
-        rxLastTimestamp.store(0, std::memory_order_relaxed);
-        //Clear device stream buffers
-        dataPort->ResetStreamBuffers();
-
-        //enable MIMO mode, 12 bit compressed values
-        dataLinkFormat = StreamConfig::FMT_INT12;
-        //by default use 12 bit compressed, adjust link format for stream
-
-        for(auto &i : mRxStreams)
-            if(i.used && i.config.linkFormat != StreamConfig::FMT_INT12)
-            {
-                dataLinkFormat = StreamConfig::FMT_INT16;
-                break;
-            }
-
-        for(auto &i : mTxStreams)
-            if(i.used && i.config.linkFormat != StreamConfig::FMT_INT12)
-            {
-                dataLinkFormat = StreamConfig::FMT_INT16;
-                break;
-            }
-
-        const uint16_t smpl_width = dataLinkFormat == StreamConfig::FMT_INT12 ? 2 : 0;
-        uint16_t mode = 0x0100;
-
-        if (lms->Get_SPI_Reg_bits(LMS7param(LML1_SISODDR)))
-            mode = 0x0040;
-        else if (lms->Get_SPI_Reg_bits(LMS7param(LML1_TRXIQPULSE)))
-            mode = 0x0180;
-
-        fpga->WriteRegister(0x0008, mode | smpl_width);
-
-        const uint16_t channelEnables = (mRxStreams[0].used||mTxStreams[0].used) + 2 * (mRxStreams[1].used||mTxStreams[1].used);
-        fpga->WriteRegister(0x0007, channelEnables);
-
-        uint32_t reg9 = fpga->ReadRegister(0x0009);
-        const uint32_t addr[] = {0x0009, 0x0009};
-        const uint32_t data[] = {reg9 | (5 << 1), reg9 & ~(5 << 1)};
-        fpga->StartStreaming();
-        fpga->WriteRegisters(addr, data, 2);
-        if (!align)
+        const bool wasArmed = armed.exchange(false);
+        if (!wasArmed && PrepareStart() != 0)
+            return -1;
+        //single transfer starts streaming
+        fpga->WriteRegisters(startAddrs.data(), startData.data(), startAddrs.size());
+        if (!wasArmed && !startAlign)
             lms->ResetLogicregisters();
     }
     else if(not needTx and not needRx)
@@ -656,27 +1507,38 @@ int Streamer::UpdateThreads(bool stopAll)
     }
 
     //FPGA should be configured and activated, start needed threads
-    if(needRx && (!rxThread.joinable()))
+    if((needRx && !rxRunning) || (needTx && !txRunning))
     {
-        terminateRx.store(false, std::memory_order_relaxed);
-        auto RxLoopFunction = std::bind(&Streamer::ReceivePacketsLoop, this);
-        rxThread = std::thread(RxLoopFunction);
-        SetOSThreadPriority(ThreadPriority::NORMAL, ThreadPolicy::REALTIME, &rxThread);
+        //USB event thread serves both directions, first stream requesting placement decides
+        const StreamConfig* usbConfig = nullptr;
+        for (auto &i : mRxStreams)
+            if (!usbConfig && i.used && (!i.config.usbCpuAffinity.empty() || i.config.usbThreadPriority > 0))
+                usbConfig = &i.config;
+        for (auto &i : mTxStreams)
+            if (!usbConfig && i.used && (!i.config.usbCpuAffinity.empty() || i.config.usbThreadPriority > 0))
+                usbConfig = &i.config;
+        if (usbConfig)
+            dataPort->SetEventThreadParams(usbConfig->usbCpuAffinity, usbConfig->usbThreadPriority);
     }
-    if(needTx && (!txThread.joinable()))
+    if(needRx && !rxRunning)
+        StartWorker(false);
+    if(needTx && !txRunning)
     {
-        fpga->WriteRegister(0xFFFF, 1 << chipId);
-        fpga->WriteRegister(0xD, 0); //stop WFM
-        terminateTx.store(false, std::memory_order_relaxed);
-        auto TxLoopFunction = std::bind(&Streamer::TransmitPacketsLoop, this);
-        txThread = std::thread(TxLoopFunction);
-        SetOSThreadPriority(ThreadPriority::NORMAL, ThreadPolicy::REALTIME, &txThread);
+        const uint32_t addr[] = {0xFFFF, 0xD};
+        const uint32_t data[] = {uint32_t(1 << chipId), 0}; //stop WFM
+        fpga->WriteRegisters(addr, data, 2);
+        StartWorker(true);
     }
     return 0;
 }
 
 void Streamer::TransmitPacketsLoop()
 {
+    if (IsTxDirect())
+    {
+        TransmitDirectLoop();
+        return;
+    }
     //at this point FPGA has to be already configured to output samples
     const uint8_t maxChannelCount = 2;
     const uint8_t chCount = streamSize;
@@ -690,82 +1552,128 @@ void Streamer::TransmitPacketsLoop()
     std::vector<int> handles(buffersCount, 0);
     std::vector<bool> bufferUsed(buffersCount, 0);
     std::vector<uint32_t> bytesToSend(buffersCount, 0);
-    std::vector<char> buffers;
-    buffers.resize(buffersCount*bufferSize, 0);
-    std::vector<SamplesPacket> packets;
-    for (int i = 0; i<maxChannelCount; ++i)
-        packets.emplace_back(maxSamplesBatch);
+    std::vector<bool> burstAck(buffersCount, false); //buffer ends burst
+    std::vector<uint64_t> burstEnds(buffersCount, 0); //timestamp of last burst sample
+    uint64_t burstEnd = 0;
+    bool bursting[maxChannelCount] = {false, false};
+    const StreamConfig* threadConfig = GetThreadConfig(true);
+    const int numaNode = ConfigureCurrentThread(threadConfig);
+    const bool hugePages = threadConfig && threadConfig->hugePages;
+    char* buffers = (char*)AllocateBuffer(buffersCount*bufferSize, numaNode, hugePages);
+    if (buffers == nullptr)
+        return;
+    //inactive channels send zeros
+    std::vector<complex16_t> zeros(maxSamplesBatch);
+    RingFIFO::Packet silence[maxChannelCount];
+    for (auto &p : silence)
+    {
+        p.timestamp = 0;
+        p.last = 0;
+        p.flags = 0;
+        p.samples = zeros.data();
+    }
 
     long totalBytesSent = 0;
     auto t1 = std::chrono::high_resolution_clock::now();
     auto t2 = t1;
     bool end_burst = false;
     uint8_t bi = 0; //buffer index
+    //completes transfer of sent buffer, burst end is acknowledged when it reached hardware
+    auto finishSending = [&](uint8_t i, uint32_t timeout_ms) {
+        if (dataPort->WaitForSending(handles[i], timeout_ms) == false)
+            return false;
+        totalBytesSent += dataPort->FinishDataSending(&buffers[i*bufferSize], bytesToSend[i], handles[i]);
+        bufferUsed[i] = false;
+        if (burstAck[i])
+        {
+            burstAck[i] = false;
+            txEvents.Post(StreamEvent::EVENT_BURST_ACK, ActiveChannels(true), burstEnds[i]);
+        }
+        return true;
+    };
     while (terminateTx.load(std::memory_order_relaxed) != true)
     {
-        if (bufferUsed[bi])
+        if (bufferUsed[bi] && !finishSending(bi, 1000))
         {
-            if (dataPort->WaitForSending(handles[bi], 1000) == true)
-            {
-                unsigned bytesSent = dataPort->FinishDataSending(&buffers[bi*bufferSize], bytesToSend[bi], handles[bi]);
-                totalBytesSent += bytesSent;
-                bufferUsed[bi] = false;
-            }
-            else
-            {
-                txDataRate_Bps.store(totalBytesSent, std::memory_order_relaxed);
-                totalBytesSent = 0;
-                continue;
-            }
+            txDataRate_Bps.store(totalBytesSent, std::memory_order_relaxed);
+            totalBytesSent = 0;
+            continue;
         }
+        //stream pauses after burst, complete its buffers without waiting
+        for (uint8_t j = 0; j < buffersCount; ++j)
+            if (bufferUsed[j] && burstAck[j])
+                finishSending(j, 0);
         bytesToSend[bi] = 0;
         FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[bi*bufferSize]);
+        end_burst = false;
         int i=0;
         do
         {
             bool has_samples = false;
             int payloadSize = sizeof(FPGA_DataPacket::data);
+            //FIFO slots are packed in place and freed after packing
+            RingFIFO::Packet* held[maxChannelCount] = {nullptr, nullptr};
+            RingFIFO::Packet* src[maxChannelCount] = {&silence[0], &silence[1]};
+            RingFIFO::Packet* ref = nullptr; //first channel with samples gives timestamp and flags
             for(int ch=0; ch<maxChannelCount; ++ch)
             {
                 if (!mTxStreams[ch].used)
                     continue;
                 const int ind = chCount == maxChannelCount ? ch : 0;
                 if (mTxStreams[ch].mActive==false)
+                    continue;
+                RingFIFO::Packet* slot = mTxStreams[ch].fifo->acquire_pop(100);
+                if (slot == nullptr)
                 {
-                    memset(packets[ind].samples,0,maxSamplesBatch*sizeof(complex16_t));
+                    if (bursting[ch])
+                    {
+                        bursting[ch] = false;
+                        txEvents.Post(StreamEvent::EVENT_UNDERFLOW, 1 << ch, txLastTimestamp.load(std::memory_order_relaxed));
+                    }
                     continue;
                 }
-                mTxStreams[ch].fifo->pop_packet(packets[ind]);
-                int samplesPopped = packets[ind].last;
+                held[ch] = slot;
+                int samplesPopped = slot->last;
                 if (samplesPopped != maxSamplesBatch)
                 {
-                    if (!(packets[ind].flags & RingFIFO::END_BURST))
+                    if (!(slot->flags & RingFIFO::END_BURST))
                         continue;
                     payloadSize = samplesPopped * sizeof(FPGA_DataPacket::data) / maxSamplesBatch;
                     int q = packed ? 48 : 16;
                     payloadSize = (1 + (payloadSize - 1) / q) * q;
-                    memset(&packets[ind].samples[samplesPopped], 0, (maxSamplesBatch - samplesPopped)*sizeof(complex16_t));
+                    memset(&slot->samples[samplesPopped], 0, (maxSamplesBatch - samplesPopped)*sizeof(complex16_t));
                 }
+                bursting[ch] = !(slot->flags & RingFIFO::END_BURST);
+                src[ind] = slot;
+                if (!ref)
+                    ref = slot;
                 has_samples = true;
             }
 
+            if (has_samples)
+            {
+                end_burst = (ref->flags & RingFIFO::END_BURST);
+                if (end_burst)
+                    burstEnd = ref->timestamp + ref->last - 1;
+                pkt[i].counter = ref->timestamp;
+                pkt[i].reserved[0] = 0;
+                //by default ignore timestamps
+                const int ignoreTimestamp = !(ref->flags & RingFIFO::SYNC_TIMESTAMP);
+                pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
+                pkt[i].reserved[1] = payloadSize & 0xFF;
+                pkt[i].reserved[2] = (payloadSize >> 8) & 0xFF;
+                complex16_t* samples[maxChannelCount];
+                for(uint8_t c=0; c<chCount; ++c)
+                    samples[c] = src[c]->samples;
+                uint8_t* const dataStart = (uint8_t*)pkt[i].data;
+                FPGA::Samples2FPGAPacketPayload(samples, maxSamplesBatch, chCount==2, packed, dataStart);
+                bytesToSend[bi] += 16+payloadSize;
+            }
+            for(int ch=0; ch<maxChannelCount; ++ch)
+                if (held[ch])
+                    mTxStreams[ch].fifo->release_pop();
             if (!has_samples)
                 break;
-
-            end_burst = (packets[0].flags & RingFIFO::END_BURST);
-            pkt[i].counter = packets[0].timestamp;
-            pkt[i].reserved[0] = 0;
-            //by default ignore timestamps
-            const int ignoreTimestamp = !(packets[0].flags & RingFIFO::SYNC_TIMESTAMP);
-            pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
-            pkt[i].reserved[1] = payloadSize & 0xFF;
-            pkt[i].reserved[2] = (payloadSize >> 8) & 0xFF;
-            std::vector<complex16_t*> src(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                src[c] = (packets[c].samples);
-            uint8_t* const dataStart = (uint8_t*)pkt[i].data;
-            FPGA::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount==2, packed, dataStart);
-            bytesToSend[bi] += 16+payloadSize;
         }while(++i<packetsToBatch && end_burst == false);
 
         if(terminateTx.load(std::memory_order_relaxed) == true) //early termination
@@ -776,6 +1684,8 @@ void Streamer::TransmitPacketsLoop()
             handles[bi] = dataPort->BeginDataSending(&buffers[bi*bufferSize], bytesToSend[bi], epIndex);
             txLastTimestamp.store(pkt[i-1].counter+maxSamplesBatch-1, std::memory_order_relaxed); //timestamp of the last sample that was sent to HW
             bufferUsed[bi] = true;
+            burstAck[bi] = end_burst;
+            burstEnds[bi] = burstEnd;
             bi = (bi + 1) & (buffersCount-1);
         }
 
@@ -796,6 +1706,130 @@ void Streamer::TransmitPacketsLoop()
 
     // Wait for all the queued requests to be cancelled
     dataPort->AbortSending(epIndex);
+    FreeBuffer(buffers, buffersCount*bufferSize, hugePages);
+    txDataRate_Bps.store(0, std::memory_order_relaxed);
+}
+
+/** @brief TX loop of StreamConfig::directBuffers streams
+    Sends transfer buffers filled by AcquireTxPacket()/CommitTxPacket() callers,
+    buffer that caller left partially filled is sent when caller falls behind.
+*/
+void Streamer::TransmitDirectLoop()
+{
+    const uint8_t chCount = streamSize;
+    const bool packed = dataLinkFormat == StreamConfig::FMT_INT12;
+    const int epIndex = chipId;
+    const uint8_t buffersCount = dataPort->GetBuffersCount();
+    const uint8_t packetsToBatch = dataPort->CheckStreamSize(txBatchSize);
+    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
+    const uint32_t packetCapacity = (packed ? samples12InPkt:samples16InPkt)/chCount;
+    std::vector<int> handles(buffersCount, 0);
+    const StreamConfig* threadConfig = GetThreadConfig(true);
+    const int numaNode = ConfigureCurrentThread(threadConfig);
+    const bool hugePages = threadConfig && threadConfig->hugePages;
+    {
+        std::lock_guard<std::mutex> lock(txDirectLock);
+        //memory is kept between runs, so packet left acquired by caller stays valid
+        if (txDirectMemory == nullptr || txDirectSize != buffersCount*bufferSize || txDirectHugePages != hugePages)
+        {
+            if (txDirectMemory)
+                FreeBuffer(txDirectMemory, txDirectSize, txDirectHugePages);
+            txDirectMemory = (char*)AllocateBuffer(buffersCount*bufferSize, numaNode, hugePages);
+            txDirectSize = buffersCount*bufferSize;
+            txDirectHugePages = hugePages;
+        }
+        if (txDirectMemory == nullptr)
+            return;
+        txBuffers.assign(buffersCount, TxBuffer{TX_FREE, 0, 0, false, 0});
+        txPacketsPerBuffer = packetsToBatch;
+        txPacketCapacity = packetCapacity;
+        txPacketChannels = chCount;
+        txFillIndex = 0;
+        txAcquired = false;
+        txNextTimestamp = 0;
+        txDirectRunning = true;
+    }
+    txDirectCond.notify_all();
+
+    long totalBytesSent = 0;
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto t2 = t1;
+    uint8_t bi = 0; //buffer index
+    bool bursting = false;
+    uint64_t lastTimestamp = 0;
+    //completes transfer of sent buffer, lock is released meanwhile
+    auto finishSending = [&](std::unique_lock<std::mutex> &lock, uint8_t i, uint32_t timeout_ms) {
+        lock.unlock();
+        const bool done = dataPort->WaitForSending(handles[i], timeout_ms);
+        if (done)
+            totalBytesSent += dataPort->FinishDataSending(&txDirectMemory[i*bufferSize], txBuffers[i].bytes, handles[i]);
+        lock.lock();
+        if (!done)
+            return false;
+        txBuffers[i].state = TX_FREE;
+        txDirectCond.notify_all();
+        if (txBuffers[i].endBurst)
+            txEvents.Post(StreamEvent::EVENT_BURST_ACK, ActiveChannels(true), txBuffers[i].lastTimestamp);
+        return true;
+    };
+    while (terminateTx.load(std::memory_order_relaxed) != true)
+    {
+        t2 = std::chrono::high_resolution_clock::now();
+        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+        if (timePeriod >= 1000)
+        {
+            //total number of bytes sent per second
+            float dataRate = 1000.0*totalBytesSent / timePeriod;
+            txDataRate_Bps.store(dataRate, std::memory_order_relaxed);
+            totalBytesSent = 0;
+            t1 = t2;
+        }
+
+        std::unique_lock<std::mutex> lock(txDirectLock);
+        TxBuffer &buffer = txBuffers[bi];
+        if (buffer.state == TX_SENDING && !finishSending(lock, bi, 1000))
+            continue;
+        if (!txDirectCond.wait_for(lock, std::chrono::milliseconds(1), [&]{ return buffer.state == TX_READY; }))
+        {
+            //complete transfers while idle, burst end is acknowledged when it reached hardware
+            bool drained = true;
+            for (uint8_t k = 1; k < buffersCount && drained; ++k)
+            {
+                const uint8_t i = (bi + k) & (buffersCount-1);
+                if (txBuffers[i].state == TX_SENDING)
+                    drained = finishSending(lock, i, 0);
+            }
+            //inside burst hardware ran out of samples
+            if (drained && bursting && buffer.state == TX_FREE)
+            {
+                bursting = false;
+                txEvents.Post(StreamEvent::EVENT_UNDERFLOW, ActiveChannels(true), lastTimestamp);
+            }
+            //caller fell behind, send what it has committed
+            if (buffer.state != TX_FILLING || buffer.packets == 0 || txAcquired)
+                continue;
+            buffer.state = TX_READY;
+            txFillIndex = (bi + 1) % buffersCount;
+        }
+        buffer.state = TX_SENDING;
+        lastTimestamp = buffer.lastTimestamp;
+        bursting = !buffer.endBurst;
+        const uint32_t bytesToSend = buffer.bytes;
+        lock.unlock();
+
+        handles[bi] = dataPort->BeginDataSending(&txDirectMemory[bi*bufferSize], bytesToSend, epIndex);
+        txLastTimestamp.store(lastTimestamp, std::memory_order_relaxed); //timestamp of the last sample that was sent to HW
+        bi = (bi + 1) & (buffersCount-1);
+    }
+
+    // Wait for all the queued requests to be cancelled
+    dataPort->AbortSending(epIndex);
+    {
+        std::lock_guard<std::mutex> lock(txDirectLock);
+        txDirectRunning = false;
+        txAcquired = false;
+    }
+    txDirectCond.notify_all();
     txDataRate_Bps.store(0, std::memory_order_relaxed);
 }
 
@@ -815,14 +1849,22 @@ void Streamer::ReceivePacketsLoop()
     const uint8_t packetsToBatch = dataPort->CheckStreamSize(rxBatchSize);
     const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
     std::vector<int> handles(buffersCount, 0);
-    std::vector<char>buffers(buffersCount*bufferSize, 0);
+    const StreamConfig* threadConfig = GetThreadConfig(false);
+    const int numaNode = ConfigureCurrentThread(threadConfig);
+    const bool hugePages = threadConfig && threadConfig->hugePages;
+    char* buffers = (char*)AllocateBuffer(buffersCount*bufferSize, numaNode, hugePages);
+    if (buffers == nullptr)
+        return;
     std::vector<SamplesPacket> chFrames;
 
     for (int i = 0; i<maxChannelCount; ++i)
         chFrames.emplace_back(samplesInPacket);
 
-    for (int i = 0; i<buffersCount; ++i)
-        handles[i] = dataPort->BeginDataReading(&buffers[i*bufferSize], bufferSize, epIndex);
+    //connections keeping received packets in memory let them be converted in place
+    const bool inPlace = dataPort->AcquireReceivedData(nullptr, 0, epIndex, 0) >= 0;
+    if (!inPlace)
+        for (int i = 0; i<buffersCount; ++i)
+            handles[i] = dataPort->BeginDataReading(&buffers[i*bufferSize], bufferSize, epIndex);
 
     int bi = 0;
     unsigned long totalBytesReceived = 0; //for data rate calculation
@@ -835,10 +1877,25 @@ void Streamer::ReceivePacketsLoop()
     while (terminateRx.load(std::memory_order_relaxed) == false)
     {
         int32_t bytesReceived = 0;
-        if(handles[bi] >= 0)
+        int64_t completionTime = 0;
+        const char* rxData = &buffers[bi*bufferSize];
+        if (inPlace)
+        {
+            bytesReceived = dataPort->AcquireReceivedData(&rxData, bufferSize, epIndex, 1000);
+            if (bytesReceived <= 0)
+            {
+                rxDataRate_Bps.store(totalBytesReceived, std::memory_order_relaxed);
+                totalBytesReceived = 0;
+                continue;
+            }
+            completionTime = ClockModel::HostTimeNs();
+            totalBytesReceived += bytesReceived;
+        }
+        else if(handles[bi] >= 0)
         {
             if (dataPort->WaitForReading(handles[bi], 1000) == true)
             {
+                completionTime = ClockModel::HostTimeNs();
                 bytesReceived = dataPort->FinishDataReading(&buffers[bi*bufferSize], bufferSize, handles[bi]);
                 totalBytesReceived += bytesReceived;
             }
@@ -851,7 +1908,7 @@ void Streamer::ReceivePacketsLoop()
         }
         for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
         {
-            const FPGA_DataPacket* pkt = (FPGA_DataPacket*)&buffers[bi*bufferSize];
+            const FPGA_DataPacket* pkt = (const FPGA_DataPacket*)rxData;
             const uint8_t byte0 = pkt[pktIndex].reserved[0];
             if ((byte0 & (1 << 3)) != 0)
             {
@@ -861,40 +1918,90 @@ void Streamer::ReceivePacketsLoop()
                 {
                     lime::debug("L");
                     resetFlagsDelay = buffersCount*2;
+                    txEvents.Post(StreamEvent::EVENT_LATE_TX, ActiveChannels(true), pkt[pktIndex].counter);
                 }
                 for(auto &value: mTxStreams)
                     if (value.used && value.mActive)
                         value.pktLost++;
             }
-            uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
+            const uint8_t* pktStart = (const uint8_t*)pkt[pktIndex].data;
             if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
             {
                 int packetLoss = ((pkt[pktIndex].counter - prevTs)/samplesInPacket)-1;
                 for(auto &value: mRxStreams)
                     if (value.used && value.mActive)
                         value.pktLost += packetLoss;
+                if (packetLoss > 0)
+                    rxEvents.Post(StreamEvent::EVENT_DROPPED_PACKETS, ActiveChannels(false), pkt[pktIndex].counter, packetLoss);
             }
             prevTs = pkt[pktIndex].counter;
             rxLastTimestamp.store(prevTs, std::memory_order_relaxed);
-            //parse samples
-            std::vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            int samplesCount = FPGA::FPGAPacketPayload2Samples(pktStart, 4080, chCount==2, packed, dest.data());
+            //parse samples straight into FIFO slots, trigger capture filters a copy
+            complex16_t* dest[maxChannelCount] = {chFrames[0].samples, chFrames[1].samples};
+            bool inFifo[maxChannelCount] = {false, false};
+            for(int ch=0; ch<maxChannelCount; ++ch)
+            {
+                const int ind = chCount == maxChannelCount ? ch : 0;
+                if (mRxStreams[ch].used==false || mRxStreams[ch].mActive==false || mRxStreams[ch].trigger)
+                    continue;
+                complex16_t* slot = mRxStreams[ch].fifo->acquire_push(samplesInPacket);
+                if (slot)
+                {
+                    dest[ind] = slot;
+                    inFifo[ch] = true;
+                }
+            }
+            int samplesCount = FPGA::FPGAPacketPayload2Samples(pktStart, 4080, chCount==2, packed, dest);
 
             for(int ch=0; ch<maxChannelCount; ++ch)
             {
                 if (mRxStreams[ch].used==false || mRxStreams[ch].mActive==false)
                     continue;
                 const int ind = chCount == maxChannelCount ? ch : 0;
-                chFrames[ind].timestamp = pkt[pktIndex].counter;
-                chFrames[ind].last = samplesCount;
-                mRxStreams[ch].fifo->push_packet(chFrames[ind]);
+                const uint64_t timestamp = pkt[pktIndex].counter;
+                DCIQTracker* tracker = rxTracker[ch].load(std::memory_order_acquire);
+                if (tracker)
+                    tracker->Feed(dest[ind], samplesCount, !packed);
+                Channelizer* channelizer = rxChannelizer[ch].load(std::memory_order_acquire);
+                if (channelizer)
+                    channelizer->Feed(dest[ind], samplesCount, timestamp, !packed);
+                PowerTrigger* trigger = mRxStreams[ch].trigger;
+                bool overflow = false;
+                if (inFifo[ch])
+                    overflow = mRxStreams[ch].fifo->commit_push(timestamp, samplesCount, 0);
+                else
+                {
+                    chFrames[ind].timestamp = timestamp;
+                    chFrames[ind].last = samplesCount;
+                    if (trigger)
+                        trigger->Process(chFrames[ind], mRxStreams[ch].fifo);
+                    else
+                        overflow = mRxStreams[ch].fifo->push_packet(chFrames[ind]);
+                }
+                if (overflow)
+                    rxEvents.Post(StreamEvent::EVENT_OVERFLOW, 1 << ch, timestamp);
             }
         }
-        // Re-submit this request to keep the queue full
-        handles[bi] = dataPort->BeginDataReading(&buffers[bi*bufferSize], bufferSize, epIndex);
-        bi = (bi + 1) & (buffersCount-1);
+        if (bytesReceived >= int32_t(sizeof(FPGA_DataPacket)))
+            clockModel.AddObservation(completionTime, prevTs + samplesInPacket - 1);
+        if (inPlace)
+        {
+            //packets overwritten during conversion were delivered torn
+            const int lost = dataPort->ReleaseReceivedData(bytesReceived, epIndex) / sizeof(FPGA_DataPacket);
+            if (lost > 0)
+            {
+                for(auto &value: mRxStreams)
+                    if (value.used && value.mActive)
+                        value.pktLost += lost;
+                rxEvents.Post(StreamEvent::EVENT_DROPPED_PACKETS, ActiveChannels(false), prevTs, lost);
+            }
+        }
+        else
+        {
+            // Re-submit this request to keep the queue full
+            handles[bi] = dataPort->BeginDataReading(&buffers[bi*bufferSize], bufferSize, epIndex);
+            bi = (bi + 1) & (buffersCount-1);
+        }
 
         t2 = std::chrono::high_resolution_clock::now();
         auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
@@ -911,6 +2018,7 @@ void Streamer::ReceivePacketsLoop()
         }
     }
     dataPort->AbortReading(epIndex);
+    FreeBuffer(buffers, buffersCount*bufferSize, hugePages);
     rxDataRate_Bps.store(0, std::memory_order_relaxed);
 }
 
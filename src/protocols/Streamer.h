@@ -16,7 +16,12 @@
 
 #include "dataTypes.h"
 #include "fifo.h"
+#include "ClockModel.h"
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 namespace lime
 {
@@ -25,13 +30,36 @@ class IConnection;
 class FPGA;
 class Streamer;
 class LMS7002M;
+class DCIQTracker;
+class Channelizer;
+class CommandQueue;
+class PhaseEstimator;
+class Resampler;
+class PowerTrigger;
 
 /*!
  * The stream config structure is used with the SetupStream() API.
  */
 struct LIME_API StreamConfig
 {
-    StreamConfig(void){};
+    StreamConfig(void) :
+        threadPriority(0),
+        numaNode(-1),
+        hugePages(false),
+        usbThreadPriority(0),
+        dcIqTracking(false),
+        resampleUp(1),
+        resampleDown(1),
+        powerTrigger(false),
+        triggerLevel(-30.0f),
+        triggerHysteresis(3.0f),
+        triggerAverage(32),
+        preTrigger(1024),
+        postTrigger(1024),
+        directBuffers(false),
+        bufferLatency(0.25f),
+        lockMemory(false)
+    {};
 
     //! True for transmit stream, false for receive
     bool isTx;
@@ -51,7 +79,8 @@ struct LIME_API StreamConfig
     /*!
      * The buffer length is a size in samples
      * that used for allocating internal buffers.
-     * Default: 0, meaning automatic selection
+     * Default: 0, meaning automatic selection from
+     * sample rate and bufferLatency
      */
     size_t bufferLength;
 
@@ -66,6 +95,135 @@ struct LIME_API StreamConfig
      * Default: STREAM_12_BIT_IN_16
      */
     StreamDataFormat linkFormat;
+
+    /*!
+     * CPU cores the stream thread is allowed to run on.
+     * RX and TX threads are shared by both channels, so the
+     * first active stream of each direction decides.
+     * Default: empty, meaning no restriction
+     */
+    std::vector<int> cpuAffinity;
+
+    //! SCHED_FIFO priority 1-99 of the stream thread, 0 - library default
+    int threadPriority;
+
+    /*!
+     * NUMA node for FIFO and transfer buffers.
+     * Default: -1, node of the first core in cpuAffinity
+     */
+    int numaNode;
+
+    //! Back FIFO and transfer buffers with huge pages when available
+    bool hugePages;
+
+    //! CPU cores and SCHED_FIFO priority of the connection USB event thread
+    std::vector<int> usbCpuAffinity;
+    int usbThreadPriority;
+
+    /*!
+     * Track RX DC offset and IQ imbalance from stream samples
+     * in background and adjust chip correctors while streaming.
+     */
+    bool dcIqTracking;
+
+    /*!
+     * Host side rational resampling, stream rate is device
+     * sample rate * resampleUp / resampleDown. Stream timestamps
+     * count stream samples. See Resampler::FindPlan() for choosing
+     * device rate and ratio.
+     * Default: 1/1, no resampling
+     */
+    unsigned resampleUp;
+    unsigned resampleDown;
+
+    /*!
+     * RX power trigger, only windows around samples whose moving average
+     * power reaches triggerLevel (dBFS) are put into stream FIFO.
+     * Window ends postTrigger samples after power dropped
+     * triggerHysteresis dB under the level, reads stop at window end
+     * and return END_BURST. See PowerTrigger.
+     * Default: false
+     */
+    bool powerTrigger;
+    float triggerLevel;
+    float triggerHysteresis;
+    //! samples in power average
+    uint32_t triggerAverage;
+    //! samples delivered before and after the window
+    uint32_t preTrigger;
+    uint32_t postTrigger;
+
+    /*!
+     * TX samples are written by caller straight into outgoing transfer
+     * buffers with StreamChannel::AcquireTxPacket()/CommitTxPacket()
+     * instead of Write(). Applies to both TX channels of the chip, as
+     * they share packets. Not available with host resampling.
+     * Default: false
+     */
+    bool directBuffers;
+
+    /*!
+     * Seconds of samples at current sample rate held by FIFO when
+     * bufferLength is 0. FIFO is resized on each stream start.
+     * Default: 0.25
+     */
+    float bufferLatency;
+
+    //! Lock FIFO memory in RAM, see LockMemory()
+    bool lockMemory;
+};
+
+/*!
+ * Asynchronous stream event, see StreamChannel::WaitEvent()
+ */
+struct StreamEvent
+{
+    enum Type
+    {
+        //! RX FIFO was full, oldest samples were overwritten
+        EVENT_OVERFLOW,
+        //! TX FIFO ran empty inside burst
+        EVENT_UNDERFLOW,
+        //! TX packet reached hardware after its timestamp and was dropped
+        EVENT_LATE_TX,
+        //! last packet of TX burst was sent to hardware
+        EVENT_BURST_ACK,
+        //! RX packets were lost on link
+        EVENT_DROPPED_PACKETS,
+    };
+    Type type;
+    //! channels of chip the event applies to, bit 0 - A, bit 1 - B
+    uint8_t channels;
+    //! hardware timestamp of the event, first one when repeats were merged
+    uint64_t timestamp;
+    //! merged repeats of event, lost packets for EVENT_DROPPED_PACKETS
+    uint32_t count;
+};
+
+/*!
+ * Bounded queue of stream events, stream threads post and API callers wait.
+ * When full, the oldest event is discarded.
+ */
+class StreamEventQueue
+{
+public:
+    StreamEventQueue();
+    //! Queues event, repeat of the newest unread event is merged into it
+    void Post(StreamEvent::Type type, uint8_t channels, uint64_t timestamp, uint32_t count = 1);
+    /** @brief Takes oldest event of any of channels, waiting up to timeout
+        Event of several channels stays queued for channels not taken yet.
+        @return true if event was taken, false on timeout or Interrupt()
+    */
+    bool Wait(StreamEvent &event, uint8_t channels, int32_t timeout_ms);
+    //! Wakes waiting callers without event
+    void Interrupt();
+    void Clear();
+private:
+    static const size_t maxEvents = 256;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<StreamEvent> events;
+    unsigned interrupts;
 };
 
 class LIME_API StreamChannel
@@ -87,28 +245,91 @@ public:
         float linkRate;
         int droppedPackets;
         uint64_t timestamp;
+        //! host resampler CPU time per stream sample in ns, 0 without resampling
+        float resampleCost;
+        //! bytes of FIFO and host resampler buffers
+        size_t memoryUsed;
+    };
+
+    /*!
+     * Packet payload of outgoing transfer buffer lent to TX caller.
+     * Samples are in link format: complex16_t for FMT_INT16, 12 bit I and Q
+     * packed in 3 bytes for FMT_INT12. With two channels in packet samples
+     * are interleaved A0 B0 A1 B1...
+     */
+    struct TxPacket
+    {
+        void* payload;
+        //! samples per channel that fit payload
+        uint32_t capacity;
+        uint8_t channels;
+        StreamConfig::StreamDataFormat linkFormat;
     };
 
     StreamChannel(Streamer* streamer);
     ~StreamChannel();
 
-    void Setup(StreamConfig conf);
+    int Setup(StreamConfig conf);
     void Close();
     int Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100);
     int Write(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms = 100);
+    /** @brief Lends payload of the next TX packet, stream needs StreamConfig::directBuffers
+        @return samples per channel that fit packet, 0 on timeout, -1 on error
+    */
+    int AcquireTxPacket(TxPacket &packet, const int32_t timeout_ms = 100);
+    /** @brief Queues acquired packet for sending
+        @param count samples per channel written to payload
+        @param meta timestamp and flags of the first sample, END_BURST sends buffered packets
+        @return count or -1 on error
+    */
+    int CommitTxPacket(const uint32_t count, const Metadata* meta);
+    /** @brief Converts samples in stream format into acquired packet and commits it
+        @param samples buffer of each packet channel, nullptr for silence
+    */
+    int CommitTxPacket(const void* const* samples, const uint32_t count, const Metadata* meta);
     StreamChannel::Info GetInfo();
+    /** @brief Waits for overflow, underflow, late TX, burst end or packet loss
+        of stream direction. Stopping the stream wakes waiting callers.
+        @param channels chip channel mask, 0 - channel of this stream
+        @return true if event was taken, false on timeout
+    */
+    bool WaitEvent(StreamEvent &event, const int32_t timeout_ms, uint8_t channels = 0);
     int GetStreamSize();
 
     bool IsActive() const;
+    //! Prepares start of streams set up on this chip, see Streamer::Arm()
+    int Arm();
     int Start();
     int Stop();
+    void PlaceBuffers();
+    /** @brief Sets stream thread scheduling and buffer placement, refused while streaming
+        @param cpus CPU affinity, empty for any CPU
+    */
+    int SetThreadParams(const std::vector<int> &cpus, int priority, int numaNode, bool hugePages);
+    //! Sets USB event thread scheduling, refused while streaming
+    int SetUSBThreadParams(const std::vector<int> &cpus, int priority);
+    //! FIFO length in samples for config and current sample rate
+    size_t FifoLength(int pktSize);
     StreamConfig config;
     Streamer* mStreamer;
     unsigned pktLost;
     bool mActive;
     bool used;
     RingFIFO* fifo;
+    //! host side resampler, nullptr when stream runs at device rate
+    Resampler* resampler;
+    //! RX power trigger run by RX thread, nullptr when every sample is delivered
+    PowerTrigger* trigger;
 protected:
+    int ReadResampled(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms);
+    int WriteResampled(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms);
+    float LinkToStreamScale() const;
+    //resampled RX samples not yet read, interleaved IQ
+    std::vector<float> resampleOut;
+    size_t resampleOutPos;
+    size_t resampleOutLen;
+    uint64_t resampleOutTimestamp;
+    std::vector<complex16_t> resampleIn;
 
 };
 
@@ -123,7 +344,32 @@ public:
 
     uint64_t GetHardwareTimestamp(void);
     void SetHardwareTimestamp(const uint64_t now);
+    //! Device sample rate of chip in given direction
+    double GetSampleRate(bool tx);
     int UpdateThreads(bool stopAll = false);
+    //! Prepares start of used streams, next start sends one register transfer
+    int Arm();
+    void Disarm();
+    bool IsArmed() const;
+    //! True while stream thread of either direction runs
+    bool IsStreaming() const;
+    int EnableRxTracking(int ch, bool enable);
+    //! Background DC/IQ tracker of RX channel, nullptr if never enabled
+    DCIQTracker* GetRxTracker(int ch) const;
+    //! Host side channelizer fed by RX channel while its stream is active
+    Channelizer* GetRxChannelizer(int ch);
+    //! Timed control commands of the chip, released by RX stream time
+    CommandQueue* GetCommandQueue();
+    //! Command queue if it was ever created
+    CommandQueue* GetCommandQueueIfCreated() const;
+    //! True if TX samples go through lent transfer buffers instead of FIFO
+    bool IsTxDirect() const;
+    int AcquireTxPacket(StreamChannel::TxPacket &packet, const int32_t timeout_ms);
+    //! Events of stream direction
+    StreamEventQueue &GetEvents(bool tx);
+    //! Host clock correlation of RX timestamps, fed while RX runs
+    const ClockModel &GetClockModel() const;
+    int CommitTxPacket(const uint32_t count, const StreamChannel::Metadata* meta);
 
     std::atomic<uint32_t> rxDataRate_Bps;
     std::atomic<uint32_t> txDataRate_Bps;
@@ -145,15 +391,70 @@ public:
     void ReceivePacketsLoop();
     void TransmitPacketsLoop();
 private:
-    void ResizeChannelBuffers();
+    void TransmitDirectLoop();
+    int ResizeChannelBuffers();
+    int PrepareStart();
+    void SpawnWorker(bool tx);
+    void WorkerLoop(bool tx);
+    void StartWorker(bool tx);
+    void StopWorker(bool tx);
+    bool IsRunning(bool tx) const;
+    const StreamConfig* GetThreadConfig(bool tx) const;
+    int ConfigureCurrentThread(const StreamConfig* config);
     void AlignRxTSP();
     void AlignRxRF(bool restoreValues);
     void AlignQuadrature(bool restoreValues);
     void RstRxIQGen();
-    double GetPhaseOffset(int bin);
+    int CaptureAlignPacket();
+    int GetPhaseOffsets(const PhaseEstimator &estimator, double* offsets, double* magnitudes);
+    uint8_t ActiveChannels(bool tx) const;
+    //! Hardware time without user offset
+    uint64_t CurrentTimestamp() const;
+    std::vector<char> alignBuffer; //single packet capture reused during alignment
     FPGA* fpga;
     LMS7002M* lms;
     int chipId;
+    std::atomic<DCIQTracker*> rxTracker[2];
+    std::atomic<Channelizer*> rxChannelizer[2];
+    std::atomic<CommandQueue*> commandQueue;
+    StreamEventQueue rxEvents;
+    StreamEventQueue txEvents;
+    ClockModel clockModel;
+    //stream threads are parked between runs
+    mutable std::mutex workerLock;
+    std::condition_variable workerCond;
+    bool rxRun;
+    bool txRun;
+    bool workersExit;
+    //FPGA registers starting prepared streams
+    std::vector<uint32_t> startAddrs;
+    std::vector<uint32_t> startData;
+    bool startAlign;
+    std::atomic<bool> armed;
+    //transfer buffers lent to TX caller, filled and sent in ring order
+    enum TxBufferState { TX_FREE, TX_FILLING, TX_READY, TX_SENDING };
+    struct TxBuffer
+    {
+        TxBufferState state;
+        uint32_t packets;
+        uint32_t bytes;
+        bool endBurst;
+        //! timestamp of the last committed sample
+        uint64_t lastTimestamp;
+    };
+    std::mutex txDirectLock;
+    std::condition_variable txDirectCond;
+    std::vector<TxBuffer> txBuffers;
+    char* txDirectMemory;
+    size_t txDirectSize;
+    bool txDirectHugePages;
+    bool txDirectRunning;
+    uint32_t txPacketsPerBuffer;
+    uint32_t txPacketCapacity;
+    uint8_t txPacketChannels;
+    unsigned txFillIndex;
+    bool txAcquired;
+    uint64_t txNextTimestamp;
 };
 }
 
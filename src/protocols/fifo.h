@@ -7,9 +7,13 @@
 #include <vector>
 #include <thread>
 #include <queue>
+#include <algorithm>
 #include "dataTypes.h"
+#include "threadHelper.h"
+#include "Logger.h"
 #include <cmath>
 #include <assert.h>
+#include <errno.h>
 
 namespace lime{
 
@@ -17,18 +21,31 @@ class RingFIFO
 {
 public:
 
+    //! packet slot, samples point into slab
+    struct Packet
+    {
+        uint64_t timestamp;
+        uint32_t last;
+        uint32_t flags;
+        complex16_t* samples;
+    };
+
     struct BufferInfo
     {
         uint32_t size;
         uint32_t itemsFilled;
         uint32_t overflow;
         uint32_t underflow;
+        //! bytes of sample storage
+        size_t memory;
     };
 
     enum StreamFlags
     {
         SYNC_TIMESTAMP = 1,
         END_BURST = 2,
+        //! RX metadata only: timed command was executed while samples were taken
+        CONFIG_CHANGED = 4,
     };
 
     //! @brief Returns information about FIFO size and fullness
@@ -40,41 +57,84 @@ public:
         stats.itemsFilled = mElementsFilled*mPktSize;
         stats.overflow = mOverflow;
         stats.underflow = mUnderflow;
+        stats.memory = mSlabSize;
         mOverflow = 0;
         mUnderflow = 0;
         return stats;
     }
 
     //!    @brief Initializes FIFO memory
-    RingFIFO() :  mBuffer(nullptr), mPktSize(0), mBufferSize(0)
+    RingFIFO() :  mPktSize(0), mBufferSize(0), mSlab(nullptr), mSlabSize(0), mLocked(false)
     {
         Clear();
     }
 
     ~RingFIFO()
     {
-        if (mBuffer)
-            delete [] mBuffer;
+        FreeBuffer(mSlab, mSlabSize, false);
     };
 
-    void push_packet(SamplesPacket &packet)
+    /** @brief Copies packet samples into FIFO, packets longer than FIFO
+        packet size are split across consecutive slots
+        @return true if FIFO was full and the oldest packet was overwritten
+    */
+    bool push_packet(const SamplesPacket &packet)
     {
         std::unique_lock<std::mutex> lck(lock);
 
-        if (mElementsFilled >= mBufferSize) //buffer might be full, wait for free slots
+        bool overflow = false;
+        uint32_t offset = 0;
+        do
         {
-                mHead = (mHead + 1) % mBufferSize;//advance to next one
-                mElementsFilled--;
-                mFirst = 0;
-                mOverflow++;
-        }
+            overflow |= DropOldestIfFull();
+            Packet &slot = mBuffer[mTail];
+            const uint32_t cnt = std::min<uint32_t>(packet.last - offset, mPktSize);
+            slot.timestamp = packet.timestamp + offset;
+            slot.last = cnt;
+            //burst end belongs to the final part only
+            slot.flags = offset + cnt < packet.last ? packet.flags & SYNC_TIMESTAMP : packet.flags;
+            memcpy(slot.samples, packet.samples + offset, cnt*sizeof(complex16_t));
+            mTail  = (mTail + 1) % mBufferSize;//advance to next one
+            ++mElementsFilled;
+            offset += cnt;
+        } while (offset < packet.last);
 
-        mBuffer[mTail] = std::move(packet);
-        mTail  = (mTail + 1) % mBufferSize;//advance to next one
-        ++mElementsFilled;
+        lck.unlock();
+        hasItems.notify_one();
+        return overflow;
+    }
 
+    /** @brief Returns storage of next free slot, producer fills it without holding FIFO lock
+        and hands it over with commit_push(). When FIFO is full the oldest packet is dropped.
+        @param samplesCount number of samples that will be written
+        @return slot samples, nullptr if samplesCount does not fit in one slot
+    */
+    complex16_t* acquire_push(const uint32_t samplesCount)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        if (samplesCount > uint32_t(mPktSize) || mBufferSize == 0)
+            return nullptr;
+        mPushOverflow = DropOldestIfFull();
+        return mBuffer[mTail].samples;
+    }
+
+    /** @brief Makes slot filled after acquire_push() available to consumer
+        @return true if the oldest packet was dropped to make room
+    */
+    bool commit_push(const uint64_t timestamp, const uint32_t samplesCount, const uint32_t flags)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        Packet &slot = mBuffer[mTail];
+        slot.timestamp = timestamp;
+        slot.last = samplesCount;
+        slot.flags = flags;
+        mTail = (mTail + 1) % mBufferSize;//advance to next one
+        ++mElementsFilled;
+        const bool overflow = mPushOverflow;
+        mPushOverflow = false;
         lck.unlock();
         hasItems.notify_one();
+        return overflow;
     }
 
     /** @brief inserts samples to FIFO, operation is thread-safe
@@ -132,12 +192,15 @@ public:
         @param samplesCount number of samples to pop
         @param timestamp returns timestamp of the first sample in buffer
         @param timeout_ms timeout duration for operation
+        @param flags when not null, popping stops after packet ending a burst and END_BURST is returned here
         @return number of samples popped
     */
-    uint32_t pop_samples(complex16_t* buffer, const uint32_t samplesCount, uint64_t *timestamp, const uint32_t timeout_ms)
+    uint32_t pop_samples(complex16_t* buffer, const uint32_t samplesCount, uint64_t *timestamp, const uint32_t timeout_ms, uint32_t *flags = nullptr)
     {
         assert(buffer != nullptr);
         uint32_t samplesFilled = 0;
+        if (flags)
+            *flags = 0;
         std::unique_lock<std::mutex> lck(lock);
         while (samplesFilled < samplesCount)
         {
@@ -163,9 +226,17 @@ public:
 
                 if (cntbuf == cnt) //packet depleated
                 {
+                    const bool burstEnd = mBuffer[mHead].flags & END_BURST;
                     mHead = (mHead + 1) % mBufferSize;//advance to next one
                     mFirst = 0;
                     --mElementsFilled;
+                    if (flags && burstEnd)
+                    {
+                        *flags = END_BURST;
+                        lck.unlock();
+                        hasItems.notify_one();
+                        return samplesFilled;
+                    }
                 }
                 else
                     mFirst += cnt;
@@ -176,43 +247,95 @@ public:
         return samplesFilled;
     }
 
-    void pop_packet(SamplesPacket &packet)
+    /** @brief Returns oldest packet, consumer reads it without holding FIFO lock
+        and frees slot with release_pop(). Only for FIFOs whose producer waits for
+        free slots (push_samples), those never overwrite the held packet.
+        @param timeout_ms time to wait for packet
+        @return oldest packet, nullptr on timeout
+    */
+    Packet* acquire_pop(const uint32_t timeout_ms)
     {
         std::unique_lock<std::mutex> lck(lock);
-
         while (mElementsFilled == 0) //buffer might be empty, wait for packets
-            if (hasItems.wait_for(lck, std::chrono::milliseconds(100)) == std::cv_status::timeout)
+            if (hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout)
             {
                 mUnderflow++;
-                packet.last = 0;
-                packet.flags = 0;
-                return;
+                return nullptr;
             }
+        mPopHeld = true;
+        return &mBuffer[mHead];
+    }
 
-        packet = std::move(mBuffer[mHead]);
+    //! @brief Frees slot returned by acquire_pop()
+    void release_pop()
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        mPopHeld = false;
         mHead = (mHead + 1) % mBufferSize;//advance to next one
+        mFirst = 0;
         --mElementsFilled;
         lck.unlock();
         hasItems.notify_one();
     }
 
-    void Resize(int pktSize, int bufSize = -1)
+    /** @brief Sets packet size and count, FIFO is cleared
+        @return 0 on success, -1 if memory could not be allocated, previous size is kept then
+    */
+    int Resize(int pktSize, int bufSize = -1)
     {
         Clear();
         std::unique_lock<std::mutex> lck(lock);
         if (bufSize < 0)
            bufSize =  mPktSize*mBufferSize/pktSize;
+        if (pktSize <= 0 || bufSize <= 0)
+            return ReportError(EINVAL, "FIFO: invalid size %d x %d samples", bufSize, pktSize);
 
         if ((unsigned)bufSize == mBufferSize && pktSize == mPktSize)
-            return;
+            return 0;
+
+        //packets share one slab, kept unless it is too small or twice too big
+        const size_t needed = size_t(pktSize)*bufSize*sizeof(complex16_t);
+        if (needed > mSlabSize || needed < mSlabSize/2)
+        {
+            complex16_t* slab = (complex16_t*)AllocateBuffer(needed, -1, false);
+            if (slab == nullptr)
+                return ReportError(ENOMEM, "FIFO: failed to allocate %lu bytes", (unsigned long)needed);
+            FreeBuffer(mSlab, mSlabSize, false);
+            mSlab = slab;
+            mSlabSize = needed;
+            if (mLocked)
+                LockSlab(true);
+        }
         mBufferSize = bufSize;
         mPktSize = pktSize;
-        if (mBuffer)
-            delete [] mBuffer;
-
-        mBuffer = bufSize == 0 ? nullptr : new SamplesPacket[mBufferSize];
+        mBuffer.resize(mBufferSize);
         for (unsigned i = 0; i < mBufferSize; i++)
-            mBuffer[i] = SamplesPacket(mPktSize);
+        {
+            mBuffer[i].samples = mSlab + size_t(i)*mPktSize;
+            mBuffer[i].last = 0;
+            mBuffer[i].flags = 0;
+        }
+        return 0;
+    }
+
+    //! @brief Calls func(pointer, bytes) for sample storage, used for memory placement
+    template<class Func>
+    void ForEachBuffer(Func func)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        if (mSlab)
+            func((void*)mSlab, mSlabSize);
+    }
+
+    //! @brief Keeps sample storage in RAM (mlock), also after reallocation
+    void LockMemory(bool enable)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        if (enable == mLocked)
+            return;
+        mLocked = enable;
+        if (mSlab)
+            LockSlab(enable);
     }
 
     void Clear()
@@ -225,10 +348,31 @@ public:
         mElementsFilled = 0;
         mOverflow = 0;
         mUnderflow = 0;
+        mPushOverflow = false;
+        mPopHeld = false;
     }
 
 protected:
-    SamplesPacket* mBuffer;
+    //! @brief Frees oldest slot when FIFO is full, called with lock held
+    bool DropOldestIfFull()
+    {
+        if (mElementsFilled < mBufferSize)
+            return false;
+        assert(!mPopHeld); //held packet would be overwritten
+        mHead = (mHead + 1) % mBufferSize;//advance to next one
+        mElementsFilled--;
+        mFirst = 0;
+        mOverflow++;
+        return true;
+    }
+
+    void LockSlab(bool enable)
+    {
+        if (lime::LockMemory(mSlab, mSlabSize, enable) != 0 && enable)
+            lime::warning("FIFO: failed to lock %lu bytes in memory", (unsigned long)mSlabSize);
+    }
+
+    std::vector<Packet> mBuffer;
     int32_t mPktSize;
     uint32_t mBufferSize;
     uint32_t mHead;
@@ -238,6 +382,11 @@ protected:
     uint32_t mElementsFilled;
     uint32_t mOverflow;
     uint32_t mUnderflow;
+    complex16_t* mSlab;
+    size_t mSlabSize;
+    bool mLocked;
+    bool mPushOverflow; //slot acquired by acquire_push() dropped oldest packet
+    bool mPopHeld; //slot returned by acquire_pop() is being read
     std::mutex lock;
     std::condition_variable hasItems;
 };
@@ -2,9 +2,21 @@
 
 #ifdef __unix__
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #else
 #include <windows.h>
 #endif
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sstream>
 #include "Logger.h"
 
 using namespace lime;
@@ -189,3 +201,369 @@ int lime::SetOSCurrentThreadPriority(ThreadPriority priority, ThreadPolicy polic
     return 0;
 }
 #endif
+
+int lime::ParseCPUList(const std::string &list, std::vector<int> &cpus)
+{
+    cpus.clear();
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty())
+            continue;
+        char* end = nullptr;
+        const long first = strtol(range.c_str(), &end, 10);
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        if (*end != '\0' || first < 0 || last < first)
+        {
+            lime::error("Invalid CPU list: %s", list.c_str());
+            cpus.clear();
+            return -1;
+        }
+        for (long i = first; i <= last; ++i)
+            cpus.push_back(i);
+    }
+    return 0;
+}
+
+#ifdef __unix__
+#ifdef __linux__
+static int SetAffinity(pthread_t thread, const std::vector<int> &cpus)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    //no restriction means cores allowed to process, e.g. by taskset
+    if (cpus.empty() && sched_getaffinity(getpid(), sizeof(cpuset), &cpuset) != 0)
+    {
+        const long count = sysconf(_SC_NPROCESSORS_CONF);
+        for (long i = 0; i < count && i < CPU_SETSIZE; ++i)
+            CPU_SET(i, &cpuset);
+    }
+    for (auto cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpuset);
+    if (int ret = pthread_setaffinity_np(thread, sizeof(cpuset), &cpuset))
+    {
+        lime::warning("Failed to set thread CPU affinity: %s", strerror(ret));
+        return -1;
+    }
+    return 0;
+}
+
+//memory policy values from linux/mempolicy.h, numaif.h needs libnuma
+static const int MPOL_DEFAULT_ = 0;
+static const int MPOL_PREFERRED_ = 1;
+static const unsigned MPOL_MF_MOVE_ = 1 << 1;
+#endif
+
+int lime::SetOSThreadAffinity(const std::vector<int> &cpus, std::thread *thread)
+{
+    if (!thread)
+    {
+        lime::debug("SetOSThreadAffinity: null thread pointer");
+        return -1;
+    }
+#ifdef __linux__
+    return SetAffinity(thread->native_handle(), cpus);
+#else
+    return -1;
+#endif
+}
+
+int lime::SetOSCurrentThreadAffinity(const std::vector<int> &cpus)
+{
+#ifdef __linux__
+    return SetAffinity(pthread_self(), cpus);
+#else
+    return -1;
+#endif
+}
+
+static int SetRealtimePriority(pthread_t thread, int priority)
+{
+    sched_param sch;
+    const int prio_min = sched_get_priority_min(SCHED_FIFO);
+    const int prio_max = sched_get_priority_max(SCHED_FIFO);
+    sch.sched_priority = priority < prio_min ? prio_min : (priority > prio_max ? prio_max : priority);
+    if (int ret = pthread_setschedparam(thread, SCHED_FIFO, &sch))
+    {
+        lime::warning("Failed to set SCHED_FIFO priority %d: %s", sch.sched_priority, strerror(ret));
+        return -1;
+    }
+    return 0;
+}
+
+int lime::SetOSThreadRealtimePriority(int priority, std::thread *thread)
+{
+    if (!thread)
+    {
+        lime::debug("SetOSThreadRealtimePriority: null thread pointer");
+        return -1;
+    }
+    return SetRealtimePriority(thread->native_handle(), priority);
+}
+
+int lime::SetOSCurrentThreadRealtimePriority(int priority)
+{
+    return SetRealtimePriority(pthread_self(), priority);
+}
+
+int lime::GetCPUNumaNode(int cpu)
+{
+    const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return -1;
+    int node = -1;
+    while (struct dirent* entry = readdir(dir))
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+        {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    closedir(dir);
+    return node;
+}
+
+int lime::SetOSCurrentThreadMemoryNode(int node)
+{
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    unsigned long mask[16] = {0};
+    if (node >= int(sizeof(mask) * 8))
+        return -1;
+    if (node >= 0)
+        mask[node / (8 * sizeof(long))] |= 1UL << (node % (8 * sizeof(long)));
+    if (syscall(SYS_set_mempolicy, node >= 0 ? MPOL_PREFERRED_ : MPOL_DEFAULT_, node >= 0 ? mask : nullptr, node >= 0 ? sizeof(mask) * 8 : 0) != 0)
+    {
+        lime::debug("SetOSCurrentThreadMemoryNode: set_mempolicy failed (%s)", strerror(errno));
+        return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int lime::BindMemoryToNode(void *ptr, size_t size, int node, bool hugePages)
+{
+    if (!ptr || size == 0)
+        return 0;
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    const uintptr_t start = uintptr_t(ptr) & ~(page - 1);
+    const size_t len = (uintptr_t(ptr) + size - start + page - 1) & ~(page - 1);
+    int status = 0;
+#ifdef MADV_HUGEPAGE
+    if (hugePages)
+        madvise((void*)start, len, MADV_HUGEPAGE);
+#endif
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node >= 0)
+    {
+        unsigned long mask[16] = {0};
+        if (node >= int(sizeof(mask) * 8))
+            return -1;
+        mask[node / (8 * sizeof(long))] |= 1UL << (node % (8 * sizeof(long)));
+        if (syscall(SYS_mbind, start, len, MPOL_PREFERRED_, mask, sizeof(mask) * 8, MPOL_MF_MOVE_) != 0)
+        {
+            lime::debug("BindMemoryToNode: mbind failed (%s)", strerror(errno));
+            status = -1;
+        }
+    }
+#else
+    if (node >= 0)
+        status = -1;
+#endif
+    return status;
+}
+
+static size_t MappingSize(size_t size, bool hugePages)
+{
+    const size_t hugePageSize = 2 << 20;
+    return hugePages ? (size + hugePageSize - 1) & ~(hugePageSize - 1) : size;
+}
+
+void* lime::AllocateBuffer(size_t size, int node, bool hugePages)
+{
+    if (size == 0)
+        return nullptr;
+    const size_t length = MappingSize(size, hugePages);
+    void* ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (hugePages) //reserved huge pages
+        ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED)
+    {
+        BindMemoryToNode(ptr, length, node, false);
+        return ptr;
+    }
+#endif
+    ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+    {
+        lime::error("AllocateBuffer: failed to allocate %lu bytes", (unsigned long)length);
+        return nullptr;
+    }
+    //pages are not touched yet, so placement applies on first use
+    BindMemoryToNode(ptr, length, node, hugePages);
+    return ptr;
+}
+
+void lime::FreeBuffer(void *ptr, size_t size, bool hugePages)
+{
+    if (ptr)
+        munmap(ptr, MappingSize(size, hugePages));
+}
+
+int lime::LockMemory(void *ptr, size_t size, bool lock)
+{
+    if (ptr == nullptr || size == 0)
+        return 0;
+    return (lock ? mlock(ptr, size) : munlock(ptr, size)) == 0 ? 0 : -1;
+}
+
+#elif _WIN32
+
+int lime::SetOSThreadAffinity(const std::vector<int> &cpus, std::thread *thread)
+{
+    if (!thread)
+    {
+        lime::debug("SetOSThreadAffinity: null thread pointer");
+        return -1;
+    }
+    DWORD_PTR mask = 0;
+    for (auto cpu : cpus)
+        if (cpu < int(sizeof(mask) * 8))
+            mask |= DWORD_PTR(1) << cpu;
+    if (cpus.empty())
+    {
+        DWORD_PTR systemMask;
+        GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask);
+    }
+    return SetThreadAffinityMask(thread->native_handle(), mask) ? 0 : -1;
+}
+
+int lime::SetOSCurrentThreadAffinity(const std::vector<int> &cpus)
+{
+    DWORD_PTR mask = 0;
+    for (auto cpu : cpus)
+        if (cpu < int(sizeof(mask) * 8))
+            mask |= DWORD_PTR(1) << cpu;
+    if (cpus.empty())
+    {
+        DWORD_PTR systemMask;
+        GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask);
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) ? 0 : -1;
+}
+
+int lime::SetOSThreadRealtimePriority(int priority, std::thread *thread)
+{
+    if (!thread)
+    {
+        lime::debug("SetOSThreadRealtimePriority: null thread pointer");
+        return -1;
+    }
+    const int win_priority = priority > 50 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+    return SetThreadPriority(thread->native_handle(), win_priority) ? 0 : -1;
+}
+
+int lime::SetOSCurrentThreadRealtimePriority(int priority)
+{
+    const int win_priority = priority > 50 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+    return SetThreadPriority(GetCurrentThread(), win_priority) ? 0 : -1;
+}
+
+int lime::GetCPUNumaNode(int cpu)
+{
+    UCHAR node;
+    if (cpu > 255 || !GetNumaProcessorNode(UCHAR(cpu), &node))
+        return -1;
+    return node;
+}
+
+int lime::SetOSCurrentThreadMemoryNode(int node)
+{
+    return -1;
+}
+
+int lime::BindMemoryToNode(void *ptr, size_t size, int node, bool hugePages)
+{
+    return node >= 0 ? -1 : 0;
+}
+
+void* lime::AllocateBuffer(size_t size, int node, bool hugePages)
+{
+    if (size == 0)
+        return nullptr;
+    if (node >= 0)
+        return VirtualAllocExNuma(GetCurrentProcess(), NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void lime::FreeBuffer(void *ptr, size_t size, bool hugePages)
+{
+    if (ptr)
+        VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+int lime::LockMemory(void *ptr, size_t size, bool lock)
+{
+    if (ptr == nullptr || size == 0)
+        return 0;
+    return (lock ? VirtualLock(ptr, size) : VirtualUnlock(ptr, size)) ? 0 : -1;
+}
+
+#else
+
+int lime::SetOSThreadAffinity(const std::vector<int> &cpus, std::thread *thread)
+{
+    return -1;
+}
+
+int lime::SetOSCurrentThreadAffinity(const std::vector<int> &cpus)
+{
+    return -1;
+}
+
+int lime::SetOSThreadRealtimePriority(int priority, std::thread *thread)
+{
+    return -1;
+}
+
+int lime::SetOSCurrentThreadRealtimePriority(int priority)
+{
+    return -1;
+}
+
+int lime::GetCPUNumaNode(int cpu)
+{
+    return -1;
+}
+
+int lime::SetOSCurrentThreadMemoryNode(int node)
+{
+    return -1;
+}
+
+int lime::BindMemoryToNode(void *ptr, size_t size, int node, bool hugePages)
+{
+    return node >= 0 ? -1 : 0;
+}
+
+void* lime::AllocateBuffer(size_t size, int node, bool hugePages)
+{
+    return size ? calloc(1, size) : nullptr;
+}
+
+void lime::FreeBuffer(void *ptr, size_t size, bool hugePages)
+{
+    free(ptr);
+}
+
+int lime::LockMemory(void *ptr, size_t size, bool lock)
+{
+    return lock ? -1 : 0;
+}
+#endif
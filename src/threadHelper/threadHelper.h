@@ -1,7 +1,11 @@
 #ifndef LIMESUITE_THREAD_H
 #define LIMESUITE_THREAD_H
 
+#include "LimeSuiteConfig.h"
 #include <thread>
+#include <vector>
+#include <string>
+#include <stddef.h>
 
 namespace lime{
 
@@ -41,6 +45,108 @@ int SetOSThreadPriority(ThreadPriority priority, ThreadPolicy policy, std::threa
  * @return          0 on success, (-1) on failure
  */
 int SetOSCurrentThreadPriority(ThreadPriority priority, ThreadPolicy policy);
+
+/**
+ * Set explicit SCHED_FIFO priority level of current thread
+ * @note On Windows systems priority above 50 maps to TIME_CRITICAL, otherwise HIGHEST
+ *
+ * @param priority  SCHED_FIFO priority, 1-99
+ *
+ * @return          0 on success, (-1) on failure
+ */
+int SetOSCurrentThreadRealtimePriority(int priority);
+
+/**
+ * Set explicit SCHED_FIFO priority level of specified thread
+ *
+ * @param priority  SCHED_FIFO priority, 1-99
+ * @param thread    Thread to which set the priority to
+ *
+ * @return          0 on success, (-1) on failure
+ */
+int SetOSThreadRealtimePriority(int priority, std::thread *thread);
+
+/**
+ * Restrict specified thread to run only on given CPU cores
+ *
+ * @param cpus      CPU core indexes, empty list restores cores of the process
+ * @param thread    Thread to pin
+ *
+ * @return          0 on success, (-1) on failure
+ */
+int SetOSThreadAffinity(const std::vector<int> &cpus, std::thread *thread);
+
+/**
+ * Restrict current thread to run only on given CPU cores
+ *
+ * @param cpus      CPU core indexes, empty list restores cores of the process
+ *
+ * @return          0 on success, (-1) on failure
+ */
+int SetOSCurrentThreadAffinity(const std::vector<int> &cpus);
+
+/**
+ * Parse CPU list in the same notation as isolcpus and taskset, e.g. "2,4-7"
+ *
+ * @param list      CPU list string
+ * @param cpus      Parsed CPU indexes
+ *
+ * @return          0 on success, (-1) on malformed list
+ */
+LIME_API int ParseCPUList(const std::string &list, std::vector<int> &cpus);
+
+/**
+ * @param cpu   CPU core index
+ * @return      NUMA node the CPU belongs to, (-1) if unknown
+ */
+int GetCPUNumaNode(int cpu);
+
+/**
+ * Make memory allocated by current thread prefer given NUMA node
+ *
+ * @param node  NUMA node, (-1) restores default policy
+ *
+ * @return      0 on success, (-1) on failure or when NUMA is not supported
+ */
+int SetOSCurrentThreadMemoryNode(int node);
+
+/**
+ * Move already allocated memory to given NUMA node and optionally
+ * request transparent huge pages for it
+ *
+ * @param ptr       Start of memory region
+ * @param size      Size of memory region in bytes
+ * @param node      NUMA node, (-1) to leave placement unchanged
+ * @param hugePages Request huge pages for region
+ *
+ * @return          0 on success, (-1) on failure
+ */
+int BindMemoryToNode(void *ptr, size_t size, int node, bool hugePages);
+
+/**
+ * Allocate zeroed, page aligned buffer on given NUMA node
+ * Huge pages are tried first when requested, falling back to normal pages
+ *
+ * @param size      Size in bytes
+ * @param node      NUMA node, (-1) for default placement
+ * @param hugePages Back buffer with huge pages
+ *
+ * @return          Buffer pointer, must be released with FreeBuffer()
+ *                  using the same size and hugePages, nullptr on failure
+ */
+void* AllocateBuffer(size_t size, int node, bool hugePages);
+void FreeBuffer(void *ptr, size_t size, bool hugePages);
+
+/**
+ * Keep memory region resident in RAM, so it is never paged out
+ *
+ * @param ptr       Start of memory region
+ * @param size      Size of memory region in bytes
+ * @param lock      true - lock region, false - unlock
+ *
+ * @return          0 on success, (-1) on failure (e.g. RLIMIT_MEMLOCK)
+ */
+int LockMemory(void *ptr, size_t size, bool lock);
 }
 
 #endif
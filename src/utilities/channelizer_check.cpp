@@ -0,0 +1,159 @@
+/**
+    @file channelizer_check.cpp
+    @author Lime Microsystems
+    @brief Checks Channelizer outputs and timestamps with synthetic tones, measures throughput
+*/
+
+#include "Channelizer.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+using namespace std;
+using namespace lime;
+
+static const double pi = acos(-1);
+static const uint32_t packetSamples = 1360;
+
+//12 bit samples of two tones, frequencies normalized to sample rate
+static vector<complex16_t> MakeTones(uint32_t count, uint64_t timestamp, double f1, double f2)
+{
+    vector<complex16_t> samples(count);
+    for (uint32_t n = 0; n < count; ++n)
+    {
+        const double t = double(timestamp + n);
+        const complex<double> x = 600.0 * polar(1.0, 2 * pi * f1 * t) + 600.0 * polar(1.0, 2 * pi * f2 * t);
+        samples[n].i = lrint(x.real());
+        samples[n].q = lrint(x.imag());
+    }
+    return samples;
+}
+
+//reads count samples, checks every read continues timestamps of previous one
+static bool ReadChannel(Channelizer::SubChannel* channel, vector<complex<float> > &out, uint32_t count)
+{
+    out.resize(count);
+    const uint32_t chunk = 250;
+    uint64_t expected = 0;
+    bool ok = true;
+    for (uint32_t pos = 0; pos < count; pos += chunk)
+    {
+        StreamChannel::Metadata meta;
+        meta.flags = 0;
+        const uint32_t n = min(chunk, count - pos);
+        if (channel->Read(&out[pos], n, &meta, 1000) != int(n))
+            return false;
+        if (pos > 0 && meta.timestamp != expected)
+            ok = false;
+        expected = meta.timestamp + n;
+    }
+    return ok;
+}
+
+static double Power(const vector<complex<float> > &x, size_t from)
+{
+    double sum = 0;
+    for (size_t i = from; i < x.size(); ++i)
+        sum += norm(x[i]);
+    return sum / (x.size() - from);
+}
+
+int main()
+{
+    const unsigned bankChannels = 16;
+    const unsigned bin = 3;
+    const double ddcOffset = 0.01;
+    Channelizer::Config config;
+    config.bankChannels = bankChannels;
+    config.bankTaps = 8;
+    config.ddc.push_back(Channelizer::DDC{-0.2, 10});
+    config.format = StreamConfig::FMT_FLOAT32;
+
+    Channelizer channelizer;
+    if (channelizer.Start(config) != 0)
+        return -1;
+
+    //feed packets whenever input ring has space
+    const uint64_t timestamp0 = 5001;
+    const uint32_t total = 160 * packetSamples;
+    vector<complex16_t> input = MakeTones(total, timestamp0, double(bin) / bankChannels, -0.2 + ddcOffset);
+    for (uint32_t pos = 0; pos < total; pos += packetSamples)
+    {
+        while (channelizer.GetQueuedBlocks() >= Channelizer::GetRingBlocks() - 1)
+            this_thread::yield();
+        channelizer.Feed(&input[pos], packetSamples, timestamp0 + pos, false);
+    }
+
+    bool ok = channelizer.GetDroppedSamples() == 0;
+    cout << "dropped input samples: " << channelizer.GetDroppedSamples() << endl;
+
+    //filter bank: tone only in its own bin, second tone is in bin M-3
+    const uint32_t bankCount = total / bankChannels - 64;
+    vector<vector<complex<float> > > bankOut(bankChannels);
+    for (unsigned c = 0; c < bankChannels; ++c)
+        if (!ReadChannel(channelizer.GetChannel(c), bankOut[c], bankCount))
+        {
+            cout << "bank channel " << c << " read or timestamp error" << endl;
+            ok = false;
+        }
+    const double tonePower = Power(bankOut[bin], 16);
+    double worstRejection = 1e9;
+    for (unsigned c = 0; c < bankChannels; ++c)
+    {
+        if (c + 1 >= bin && c <= bin + 1)
+            continue;
+        if (c + 1 >= bankChannels - bin && c <= bankChannels - bin + 1)
+            continue;
+        worstRejection = min(worstRejection, 10 * log10(tonePower / (Power(bankOut[c], 16) + 1e-20)));
+    }
+    cout << fixed << setprecision(1) << "bank bin " << bin << " amplitude " << sqrt(tonePower) * 32767
+         << " (expected " << 600 * 16 << "), worst rejection " << worstRejection << " dB" << endl;
+    ok = ok && worstRejection > 60 && fabs(sqrt(tonePower) * 32767 / (600 * 16) - 1.0) < 0.02;
+
+    //down converter: tone appears at offset times decimation
+    Channelizer::SubChannel* ddc = channelizer.GetChannel(bankChannels);
+    vector<complex<float> > ddcOut;
+    if (!ReadChannel(ddc, ddcOut, total / 10 - 64))
+    {
+        cout << "down converter read or timestamp error" << endl;
+        ok = false;
+    }
+    complex<double> rotation = 0;
+    for (size_t i = 20; i + 1 < ddcOut.size(); ++i)
+        rotation += complex<double>(ddcOut[i + 1] * conj(ddcOut[i]));
+    const double measured = arg(rotation) / (2 * pi);
+    cout << setprecision(4) << "down converter tone " << measured << " (expected " << ddcOffset * 10 << ")" << endl;
+    ok = ok && fabs(measured - ddcOffset * 10) < 1e-3;
+    channelizer.Stop();
+
+    //throughput: feed as above, wait until input ring is drained
+    config.format = StreamConfig::FMT_INT16;
+    config.fifoSamples = total;
+    const unsigned subChannels = bankChannels + config.ddc.size();
+    for (unsigned threads = 1; threads <= max(1u, thread::hardware_concurrency()) && ok; threads *= 2)
+    {
+        config.threads = threads;
+        channelizer.Start(config);
+        const int repeats = 8;
+        auto t0 = chrono::high_resolution_clock::now();
+        for (int rep = 0; rep < repeats; ++rep)
+            for (uint32_t pos = 0; pos < total; pos += packetSamples)
+            {
+                while (channelizer.GetQueuedBlocks() >= Channelizer::GetRingBlocks() - 1)
+                    this_thread::yield();
+                channelizer.Feed(&input[pos], packetSamples, timestamp0 + uint64_t(rep) * total + pos, false);
+            }
+        while (channelizer.GetQueuedBlocks() > 0)
+            this_thread::yield();
+        auto t1 = chrono::high_resolution_clock::now();
+        channelizer.Stop();
+        cout << threads << " threads: " << setprecision(1) << repeats * total / chrono::duration<double>(t1 - t0).count() / 1e6
+             << " MS/s input, " << subChannels << " sub-channels, dropped " << channelizer.GetDroppedSamples() << endl;
+    }
+
+    cout << (ok ? "PASS" : "FAIL") << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/**
+    @file gfir_benchmark.cpp
+    @author Lime Microsystems
+    @brief Compares GFIR design against original solver bit by bit, measures design and cache timing
+*/
+
+#include "GFIRCache.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+extern "C" void GenerateFilterReference(int n, double w1, double w2, double a1, double a2, double *coefs);
+
+using namespace std;
+using namespace lime;
+
+//packs reference design like GFIRCache::Design()
+static void DesignReference(const GFIRCache::Key &key, GFIRCache::Entry &entry)
+{
+    const int L = key.taps/15;
+    double coef[120];
+    double coef2[40];
+    GenerateFilterReference(L*15, key.w1, key.w2, 1.0, 0, coef);
+    GenerateFilterReference(L*5, key.w1, key.w2, 1.0, 0, coef2);
+    int sample = 0;
+    for (int i = 0; i < 15; i++)
+        for (int j = 0; j < 8; j++)
+            entry.gfir1[i*8+j] = (j < L && sample < L*15) ? int16_t(coef[sample++]*32767.0) : 0;
+    sample = 0;
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < 8; j++)
+            entry.gfir2[i*8+j] = (j < L && sample < L*5) ? int16_t(coef2[sample++]*32767.0) : 0;
+}
+
+int main()
+{
+    const vector<double> interfaces = {30.72, 61.44, 122.88, 40.0, 80.0, 160.0};
+    const vector<int> ratios = {7, 0, 1, 2, 3, 4};
+    vector<double> bandwidths;
+    for (double bw = 0.5; bw <= 60.0; bw *= 1.1)
+        bandwidths.push_back(bw);
+
+    vector<GFIRCache::Key> keys;
+    for (auto clk : interfaces)
+        for (auto ratio : ratios)
+            for (auto bw : bandwidths)
+            {
+                GFIRCache::Key key;
+                if (GFIRCache::MakeKey(bw, clk, ratio, key))
+                    keys.push_back(key);
+            }
+
+    //bit exactness and design time
+    int mismatches = 0;
+    double referenceTime = 0;
+    double designTime = 0;
+    for (auto &key : keys)
+    {
+        GFIRCache::Entry reference, entry;
+        auto t0 = chrono::high_resolution_clock::now();
+        DesignReference(key, reference);
+        auto t1 = chrono::high_resolution_clock::now();
+        GFIRCache::Design(key, entry);
+        auto t2 = chrono::high_resolution_clock::now();
+        referenceTime += chrono::duration<double>(t1 - t0).count();
+        designTime += chrono::duration<double>(t2 - t1).count();
+        if (memcmp(&reference, &entry, sizeof(entry)) != 0)
+        {
+            ++mismatches;
+            cout << "mismatch: taps " << key.taps << " ratio " << key.ratio << " w1 " << key.w1 << endl;
+        }
+    }
+    cout << keys.size() << " designs, " << mismatches << " differ from original solver" << endl;
+    cout << fixed << setprecision(3) << "original solver: " << 1e3 * referenceTime / keys.size() << " ms/design" << endl;
+    cout << "current solver:  " << 1e3 * designTime / keys.size() << " ms/design" << endl;
+
+    //cache prebuild, hits and file round trip
+    GFIRCache &cache = GFIRCache::Instance();
+    cache.Clear();
+    auto t0 = chrono::high_resolution_clock::now();
+    const int added = cache.Prebuild(interfaces, ratios, bandwidths);
+    auto t1 = chrono::high_resolution_clock::now();
+    for (auto &key : keys)
+        cache.Get(key);
+    auto t2 = chrono::high_resolution_clock::now();
+    cout << "prebuild of " << added << " entries: " << 1e3 * chrono::duration<double>(t1 - t0).count() << " ms" << endl;
+    cout << "cached lookup:   " << 1e6 * chrono::duration<double>(t2 - t1).count() / keys.size() << " us/design" << endl;
+
+    const string filename = "gfir_cache_test.txt";
+    bool fileOk = cache.Save(filename) == 0;
+    cache.Clear();
+    fileOk = fileOk && cache.Load(filename) == 0 && cache.Size() == size_t(added);
+    for (auto &key : keys)
+    {
+        GFIRCache::Entry entry, expected;
+        entry = cache.Get(key);
+        GFIRCache::Design(key, expected);
+        fileOk = fileOk && memcmp(&entry, &expected, sizeof(entry)) == 0;
+    }
+    fileOk = fileOk && cache.GetMisses() == 0;
+    remove(filename.c_str());
+    cout << "save/load round trip: " << (fileOk ? "exact" : "FAILED") << endl;
+
+    const bool ok = mismatches == 0 && fileOk;
+    cout << (ok ? "PASS" : "FAIL") << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+/**
+    @file gfir_reference.c
+    @author Lime Microsystems
+    @brief Original GFIR least squares design (per element normal equations,
+    LU decomposition), kept as bit exactness reference for gfir_benchmark
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define LMS_POINTS 4000
+#define CPREC 16
+#define TINY 1.0e-20
+
+static double Case1F(double w, int i)
+{
+    return cos(2.0*M_PI*w*((double)(i)-1.0));
+}
+
+static double Case2F(double w, int i)
+{
+    return cos(2.0*M_PI*w*((double)(i)-0.5));
+}
+
+/* Numerical Recipes LU decomposition, a[1:n][1:n] */
+static void ludcmp(double **a, int n, int *indx)
+{
+    int i, imax = 0, j, k;
+    double big, dum, sum, temp;
+    double *vv = (double *) malloc((n+1)*sizeof(double));
+
+    for (i = 1; i <= n; i++) {
+        big = 0.0;
+        for (j = 1; j <= n; j++)
+            if ((temp = fabs(a[i][j])) > big) big = temp;
+        vv[i] = 1.0/big;
+    }
+    for (j = 1; j <= n; j++) {
+        for (i = 1; i < j; i++) {
+            sum = a[i][j];
+            for (k = 1; k < i; k++) sum -= a[i][k]*a[k][j];
+            a[i][j] = sum;
+        }
+        big = 0.0;
+        for (i = j; i <= n; i++) {
+            sum = a[i][j];
+            for (k = 1; k < j; k++)
+                sum -= a[i][k]*a[k][j];
+            a[i][j] = sum;
+            if ((dum = vv[i]*fabs(sum)) >= big) {
+                big = dum;
+                imax = i;
+            }
+        }
+        if (j != imax) {
+            for (k = 1; k <= n; k++) {
+                dum = a[imax][k];
+                a[imax][k] = a[j][k];
+                a[j][k] = dum;
+            }
+            vv[imax] = vv[j];
+        }
+        indx[j] = imax;
+        if (fpclassify(a[j][j]) == FP_ZERO) a[j][j] = TINY;
+        if (j != n) {
+            dum = 1.0/(a[j][j]);
+            for (i = j+1; i <= n; i++) a[i][j] *= dum;
+        }
+    }
+    free(vv);
+}
+
+static void lubksb(double **a, int n, int *indx, double *b)
+{
+    int i, ii = 0, ip, j;
+    double sum;
+
+    for (i = 1; i <= n; i++) {
+        ip = indx[i];
+        sum = b[ip];
+        b[ip] = b[i];
+        if (ii) {
+            for (j = ii; j <= i-1; j++) sum -= a[i][j]*b[j];
+        } else if (sum) {
+            ii = i;
+        }
+        b[i] = sum;
+    }
+    for (i = n; i >= 1; i--) {
+        sum = b[i];
+        for (j = i+1; j <= n; j++) sum -= a[i][j]*b[j];
+        b[i] = sum/a[i][i];
+    }
+}
+
+/* Symmetric low pass design with the grid of gfir_lms(), coefficients rounded to CPREC bits */
+void GenerateFilterReference(int n, double w1, double w2, double a1, double a2, double *coefs)
+{
+    const int points = LMS_POINTS/2;
+    const int p = 2*points;
+    const int p1 = points/4;
+    const int p2 = p - p1;
+    double *w = (double *) calloc(p, sizeof(double));
+    double *des = (double *) calloc(p, sizeof(double));
+    double *weight = (double *) calloc(p, sizeof(double));
+    double *hr = (double *) calloc(n, sizeof(double));
+    double (*f)(double, int) = (n % 2) ? Case1F : Case2F;
+    int L = n/2 + (n % 2);
+    double **A, *a;
+    int *index;
+    int i, j, k;
+    double deltaw, fwki, fwkj;
+
+    deltaw = w1/(double)(p1-1);
+    for (i = 0; i < p1; i++) {
+        w[i] = (double)(i)*deltaw;
+        des[i] = a1;
+        weight[i] = 1.0;
+    }
+    deltaw = (0.5-w2)/(double)(p2-1);
+    for (i = 0; i < p2; i++) {
+        w[i+p1] = w2 + (double)(i)*deltaw;
+        des[i+p1] = a2;
+        weight[i+p1] = 0.0001;
+    }
+
+    a = (double *) calloc(L+1, sizeof(double));
+    index = (int *) calloc(L+1, sizeof(int));
+    A = (double **) calloc(L+1, sizeof(double *));
+    for (i = 1; i <= L; i++) A[i] = (double *) calloc(L+1, sizeof(double));
+
+    for (k = 0; k < p; k++) {
+        for (j = 1; j <= L; j++) {
+            fwkj = f(w[k], j);
+            A[j][j] += weight[k]*fwkj*fwkj;
+            a[j] += weight[k]*des[k]*fwkj;
+            for (i = j+1; i <= L; i++) {
+                fwki = f(w[k], i);
+                A[i][j] += weight[k]*fwki*fwkj;
+                A[j][i] += weight[k]*fwkj*fwki;
+            }
+        }
+    }
+    ludcmp(A, L, index);
+    lubksb(A, L, index, a);
+
+    for (i = 0; i < L; i++) hr[i] = 0.5*a[L-i];
+    if (n % 2) hr[L-1] = a[1];
+    for (i = 0; i < n/2; i++) hr[n-i-1] = hr[i];
+
+    for (i = 0; i < n; i++) {
+        k = hr[i] > 0.0 ? 1 : -1;
+        coefs[i] = (int)(hr[i]*(1<<CPREC) + k*0.5);
+        coefs[i] /= (double)(1<<CPREC);
+    }
+
+    for (i = 1; i <= L; i++) free(A[i]);
+    free(A);
+    free(a);
+    free(index);
+    free(w);
+    free(des);
+    free(weight);
+    free(hr);
+}
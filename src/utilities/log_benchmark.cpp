@@ -0,0 +1,146 @@
+/**
+    @file log_benchmark.cpp
+    @author Lime Microsystems
+    @brief Checks deferred log formatting and measures logging cost of streaming threads with slow log handler
+*/
+
+#include "Logger.h"
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+
+using namespace std;
+using namespace lime;
+
+static atomic<uint64_t> delivered(0);
+static atomic<int> handlerDelayUs(0);
+static mutex lastLock;
+static string lastMessage;
+
+//stands for terminal output or GUI event posting
+static void SlowHandler(const LogLevel level, const char *message)
+{
+    {
+        lock_guard<mutex> lck(lastLock);
+        lastMessage = message;
+    }
+    delivered.fetch_add(1);
+    const int delay = handlerDelayUs.load();
+    if (delay > 0)
+        this_thread::sleep_for(chrono::microseconds(delay));
+}
+
+/** @brief Logs message and compares delivered text with vsnprintf output
+*/
+static bool Expect(const char* format, ...)
+{
+    char expected[4096];
+    va_list args;
+    va_start(args, format);
+    va_list logArgs;
+    va_copy(logArgs, args);
+    vsnprintf(expected, sizeof(expected), format, args);
+    lime::log(LOG_LEVEL_WARNING, format, logArgs);
+    va_end(logArgs);
+    va_end(args);
+    flushLog();
+    lock_guard<mutex> lck(lastLock);
+    if (lastMessage == expected)
+        return true;
+    cerr << "Format mismatch: \"" << lastMessage << "\" expected \"" << expected << "\"" << endl;
+    return false;
+}
+
+static bool CheckFormatting()
+{
+    const string longText(1000, 'x');
+    char text[] = "transient";
+    bool ok = true;
+    ok &= Expect("plain message");
+    ok &= Expect("100%% done");
+    ok &= Expect("int %d %i %+5d %-4d| %05d", -12, 34, 56, 7, -8);
+    ok &= Expect("unsigned %u %x %X %#o %08x", 1u, 0xbeefu, 0xCAFEu, 8u, 0x1234u);
+    ok &= Expect("lengths %hhd %hu %ld %lld %zu %llx", 300, 70000, -5L, -1234567890123LL, size_t(42), 0xFFFFFFFFFFULL);
+    ok &= Expect("float %f %.3f %e %g %10.2f %Lf", 1.5, 3.14159, 1e-9, 2.5e10, -7.125, (long double)0.25);
+    ok &= Expect("star %*d|%-*.*f|", 6, 42, 9, 2, 3.14159);
+    ok &= Expect("string %s %10s %-6s| %.3s %s", "abc", "right", "left", "truncate", (const char*)nullptr);
+    ok &= Expect("char %c%c pointer %p", 'o', 'k', (void*)&ok);
+    ok &= Expect(text);
+    ok &= Expect("long %s", longText.c_str());
+    ok &= Expect("many %d %d %d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+    return ok;
+}
+
+/** @brief Logs from streaming like threads during link trouble
+*/
+static void LoadTest(const char* name, LogLevel level, bool async, unsigned burst)
+{
+    const int threadCount = 4;
+    const int messages = 5000;
+    setAsyncLogging(async);
+    setLogRateLimit(burst, 1.0);
+    const LogStats before = getLogStats();
+    delivered.store(0);
+    vector<double> maxLatency(threadCount, 0);
+    vector<double> totalTime(threadCount, 0);
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+        threads.push_back(thread([&, t]()
+        {
+            for (int i = 0; i < messages; ++i)
+            {
+                auto t0 = chrono::high_resolution_clock::now();
+                lime::log(level, "%s Rx%d: packet %d lost, timestamp %llu", name, t, i, (unsigned long long)i * 1360);
+                auto t1 = chrono::high_resolution_clock::now();
+                const double duration = chrono::duration<double>(t1 - t0).count();
+                totalTime[t] += duration;
+                maxLatency[t] = max(maxLatency[t], duration);
+            }
+        }));
+    for (auto &thread : threads)
+        thread.join();
+    flushLog();
+    const LogStats after = getLogStats();
+
+    double total = 0;
+    for (double time : totalTime)
+        total += time;
+    cout << setw(22) << left << name << right << fixed
+         << setprecision(0) << setw(10) << total / (threadCount * messages) / 1e-9
+         << setprecision(1) << setw(10) << *max_element(maxLatency.begin(), maxLatency.end()) / 1e-6
+         << setw(11) << delivered.load()
+         << setw(9) << after.dropped - before.dropped
+         << setw(12) << after.suppressed - before.suppressed << endl;
+}
+
+int main(int argc, char** argv)
+{
+    registerLogHandler(SlowHandler);
+    setAsyncLogging(true);
+    setLogRateLimit(0, 1.0);
+    if (!CheckFormatting())
+    {
+        cerr << "Deferred formatting check failed" << endl;
+        return 1;
+    }
+    cout << "Deferred formatting matches vsnprintf" << endl;
+
+    handlerDelayUs.store(20);
+    cout << "4 threads x 5000 messages, handler takes 20 us" << endl;
+    cout << "mode                     ns/call    max us  delivered  dropped  suppressed" << endl;
+    LoadTest("sync warning", LOG_LEVEL_WARNING, false, 0);
+    LoadTest("async warning", LOG_LEVEL_WARNING, true, 50);
+    LoadTest("sync info, limited", LOG_LEVEL_INFO, false, 50);
+    LoadTest("async info", LOG_LEVEL_INFO, true, 0);
+    LoadTest("async info, limited", LOG_LEVEL_INFO, true, 50);
+    registerLogHandler(nullptr);
+    return 0;
+}
@@ -0,0 +1,118 @@
+/**
+    @file phase_estimator_check.cpp
+    @author Lime Microsystems
+    @brief Checks MIMO alignment phase estimator against synthetic captures
+*/
+
+#include "PhaseEstimator.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <complex>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+using namespace lime;
+
+static const int N = 512;
+static const double pi = acos(-1);
+
+//reference single bin DFT, as previously used by alignment
+static double ReferencePhaseDiff(const int16_t* buf, int bin)
+{
+    const complex<double> iunit(0, 1);
+    complex<double> xA(0, 0);
+    complex<double> xB(0, 0);
+    for (int n = 0; n < N; n++)
+    {
+        const complex<double> mult = exp(-2.0*iunit*pi*double(bin)*double(n)/double(N));
+        xA += complex<double>(buf[4*n], buf[4*n+1]) * mult;
+        xB += complex<double>(buf[4*n+2], buf[4*n+3]) * mult;
+    }
+    double diff = (arg(xB) - arg(xA)) * 180.0 / pi;
+    if (diff <= -180.0) diff += 360.0;
+    if (diff > 180.0) diff -= 360.0;
+    return diff;
+}
+
+//two channel capture of tone at bin, channel B shifted by phase degrees, deterministic noise
+static void MakeCapture(vector<int16_t> &buf, int bin, double phase, unsigned seed)
+{
+    buf.resize(4*N);
+    const double amplitude = 1500;
+    for (int n = 0; n < N; n++)
+    {
+        const double w = 2*pi*bin*n/N + 0.3;
+        const double wB = w + phase*pi/180.0;
+        int16_t noise[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            seed = seed*1103515245 + 12345;
+            noise[c] = int((seed >> 16) & 0x3F) - 32;
+        }
+        buf[4*n] = lrint(amplitude*cos(w)) + noise[0];
+        buf[4*n+1] = lrint(amplitude*sin(w)) + noise[1];
+        buf[4*n+2] = lrint(amplitude*cos(wB)) + noise[2];
+        buf[4*n+3] = lrint(amplitude*sin(wB)) + noise[3];
+    }
+}
+
+static double PhaseError(double a, double b)
+{
+    double d = a - b;
+    while (d > 180.0) d -= 360.0;
+    while (d <= -180.0) d += 360.0;
+    return fabs(d);
+}
+
+int main(int argc, char** argv)
+{
+    const int bins[] = {32, 64};
+    const double phases[] = {0.0, 1.0, -2.5, 45.0, -90.0, 135.0, 179.0, -179.0};
+    const PhaseEstimator estimator(N, {32, 64});
+    vector<int16_t> buf;
+    double maxError = 0;
+    cout << fixed << setprecision(3);
+    unsigned seed = 1;
+    for (int bin : bins)
+        for (double phase : phases)
+        {
+            MakeCapture(buf, bin, phase, seed++);
+            double offsets[2];
+            double magnitudes[2];
+            estimator.Estimate(buf.data(), offsets, magnitudes);
+            const int tone = bin == 32 ? 0 : 1;
+            const double error = PhaseError(offsets[tone], phase);
+            const double refError = PhaseError(offsets[tone], ReferencePhaseDiff(buf.data(), bin));
+            maxError = max(maxError, max(error, refError));
+            if (magnitudes[tone] <= magnitudes[tone^1])
+            {
+                cout << "bin " << bin << ": tone not dominant" << endl;
+                return EXIT_FAILURE;
+            }
+            cout << "bin " << setw(2) << bin << " phase " << setw(7) << phase
+                 << " estimated " << setw(9) << offsets[tone]
+                 << " reference " << setw(9) << ReferencePhaseDiff(buf.data(), bin) << endl;
+        }
+
+    const int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    MakeCapture(buf, 32, 10.0, 1);
+    volatile double sink = 0;
+    auto t0 = chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        sink += ReferencePhaseDiff(buf.data(), 32) + ReferencePhaseDiff(buf.data(), 64);
+    auto t1 = chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        double offsets[2];
+        estimator.Estimate(buf.data(), offsets);
+        sink += offsets[0] + offsets[1];
+    }
+    auto t2 = chrono::high_resolution_clock::now();
+    cout << "reference DFT, 2 bins: " << chrono::duration<double>(t1-t0).count()/iterations*1e6 << " us" << endl;
+    cout << "Goertzel, 2 bins:      " << chrono::duration<double>(t2-t1).count()/iterations*1e6 << " us" << endl;
+    cout << "max phase error " << maxError << " deg" << endl;
+    return maxError < 0.5 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,91 @@
+/**
+    @file resampler_benchmark.cpp
+    @author Lime Microsystems
+    @brief Prints device rate plans of common stream rates, checks resampled tone and measures CPU cost
+*/
+
+#include "Resampler.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+using namespace std;
+using namespace lime;
+
+static const double pi = acos(-1);
+
+/** @brief Resamples tone in packet sized blocks
+    @return tone power relative to residual in dB, -1 if output timestamps were not contiguous
+*/
+static double CheckTone(Resampler &resampler, double toneRate, uint32_t inputCount)
+{
+    const uint32_t block = 1360;
+    vector<float> in(2 * block);
+    vector<complex<float> > out;
+    vector<float> part(2 * resampler.MaxOutput(block));
+    uint64_t expected = 0;
+    uint64_t firstTimestamp = 0;
+    for (uint32_t pos = 0; pos < inputCount; pos += block)
+    {
+        for (uint32_t n = 0; n < block; ++n)
+        {
+            const complex<double> x = 0.5 * polar(1.0, 2 * pi * toneRate * (pos + n));
+            in[2 * n] = x.real();
+            in[2 * n + 1] = x.imag();
+        }
+        uint64_t timestamp;
+        const uint32_t produced = resampler.Process(in.data(), block, pos, part.data(), timestamp);
+        if (pos == 0)
+            firstTimestamp = timestamp;
+        else if (timestamp != expected)
+            return -1;
+        expected = timestamp + produced;
+        for (uint32_t n = 0; n < produced; ++n)
+            out.push_back(complex<float>(part[2 * n], part[2 * n + 1]));
+    }
+
+    //compare with ideal tone at output timestamps, skip filter start
+    const double outRate = toneRate * resampler.GetDown() / resampler.GetUp();
+    double signal = 0;
+    double residual = 0;
+    for (size_t n = out.size() / 4; n < out.size(); ++n)
+    {
+        const complex<double> ideal = 0.5 * polar(1.0, 2 * pi * outRate * double(firstTimestamp + n));
+        signal += norm(ideal);
+        residual += norm(complex<double>(out[n]) - ideal);
+    }
+    return 10 * log10(signal / residual);
+}
+
+int main(int argc, char** argv)
+{
+    const double refClk = 30.72e6;
+    const double rates[] = {30.72e6, 25e6, 23.04e6, 16.368e6, 10.23e6, 5.115e6, 4.092e6, 2.046e6, 1.023e6};
+    cout << "Reference clock " << refClk / 1e6 << " MHz" << endl;
+    cout << "    stream MS/s   device MS/s  ovs  up/down  taps/sample   error Hz  tone dB  ns/sample" << endl;
+    for (double rate : rates)
+    {
+        const Resampler::Plan plan = Resampler::FindPlan(rate, refClk);
+        cout << fixed << setprecision(6) << setw(14) << rate / 1e6 << setw(14) << plan.hardwareRate / 1e6
+             << setw(5) << plan.oversample << setw(5) << plan.up << "/" << left << setw(4) << plan.down << right
+             << setw(12) << plan.cost << setprecision(3) << setw(12) << plan.error;
+        if (plan.up == plan.down)
+        {
+            cout << endl;
+            continue;
+        }
+        Resampler resampler(plan.up, plan.down);
+        //tone at 20% of stream rate, well inside passband
+        const double tone = 0.2 * rate / plan.hardwareRate;
+        const double snr = CheckTone(resampler, tone, 2000000);
+        cout << setprecision(1) << setw(9) << snr << setprecision(2) << setw(11) << resampler.GetCostPerSample() << endl;
+        if (snr < 60)
+        {
+            cerr << "Resampled tone check failed" << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,360 @@
+/**
+    @file rfe_i2c_benchmark.cpp
+    @author Lime Microsystems
+    @brief Checks limeRFE I2C over GPIO against simulated slave and compares transaction cost with per edge bit-banging
+*/
+
+#include "RFE_I2CBus.h"
+#include "IConnection.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+using namespace std;
+using namespace lime;
+
+static const uint8_t slaveAddress = 0x51;
+static const int sclBit = 6;
+static const int sdaBit = 7;
+
+/*!
+ * I2C slave storing written bytes and returning them on read
+ */
+class EchoSlave
+{
+public:
+    EchoSlave() : drive(false), phase(IDLE), prevScl(true), prevSda(true), bitCount(0), shift(0), reading(false), readIndex(0), masterAck(false) {}
+
+    //! Follows line levels, true if slave pulls SDA low
+    void Update(bool scl, bool sda)
+    {
+        if (scl && prevScl && sda != prevSda)
+        {
+            if (!sda) //start
+            {
+                phase = ADDRESS;
+                bitCount = -1; //SCL falls after start before first bit
+                shift = 0;
+            }
+            else //stop
+                phase = IDLE;
+            drive = false;
+        }
+        else if (scl && !prevScl) //rising edge, sample
+        {
+            if ((phase == ADDRESS || phase == WRITE) && bitCount < 8)
+                shift = (shift << 1) | sda;
+            else if (phase == READ && bitCount == 8)
+                masterAck = !sda;
+        }
+        else if (!scl && prevScl) //falling edge, next bit
+            Falling();
+        prevScl = scl;
+        prevSda = sda;
+    }
+
+    bool drive;
+    vector<uint8_t> data;
+
+private:
+    void Falling()
+    {
+        ++bitCount;
+        if (phase == ADDRESS || phase == WRITE)
+        {
+            if (bitCount == 8)
+            {
+                if (phase == ADDRESS)
+                {
+                    drive = (shift >> 1) == slaveAddress;
+                    reading = shift & 1;
+                    if (!drive)
+                        phase = IDLE;
+                    else if (!reading)
+                        data.clear();
+                }
+                else
+                {
+                    data.push_back(shift);
+                    drive = true;
+                }
+            }
+            else if (bitCount == 9)
+            {
+                drive = false;
+                bitCount = 0;
+                shift = 0;
+                if (phase == ADDRESS && reading)
+                {
+                    phase = READ;
+                    readIndex = 0;
+                    drive = !(Out() & 0x80);
+                }
+                else
+                    phase = WRITE;
+            }
+        }
+        else if (phase == READ)
+        {
+            if (bitCount < 8)
+                drive = !((Out() >> (7 - bitCount)) & 1);
+            else if (bitCount == 8)
+                drive = false;
+            else
+            {
+                bitCount = 0;
+                ++readIndex;
+                drive = masterAck && !(Out() & 0x80);
+                if (!masterAck)
+                    phase = IDLE;
+            }
+        }
+    }
+    uint8_t Out() const
+    {
+        return readIndex < data.size() ? data[readIndex] : 0xFF;
+    }
+
+    enum {IDLE, ADDRESS, WRITE, READ} phase;
+    bool prevScl;
+    bool prevSda;
+    int bitCount;
+    uint8_t shift;
+    bool reading;
+    size_t readIndex;
+    bool masterAck;
+};
+
+/*!
+ * SDR GPIO stand-in, every register access costs one transfer latency
+ */
+class GPIOStandIn : public IConnection
+{
+public:
+    GPIOStandIn(int latency_us, bool queuedWrites) : transfers(0), latency(latency_us), queued(queuedWrites), dir(0), val(0) {}
+
+    int WriteLMS7002MSPI(const uint32_t *writeData, size_t size, unsigned periphID) override
+    {
+        return -1;
+    }
+    int ReadLMS7002MSPI(const uint32_t *writeData, uint32_t *readData, size_t size, unsigned periphID) override
+    {
+        return -1;
+    }
+
+    int GPIOWrite(const uint8_t *buffer, const size_t bufLength) override
+    {
+        Transfer();
+        val = buffer[0];
+        Apply();
+        return 0;
+    }
+    int GPIORead(uint8_t *buffer, const size_t bufLength) override
+    {
+        Transfer();
+        buffer[0] = Levels();
+        return 0;
+    }
+    int GPIODirWrite(const uint8_t *buffer, const size_t bufLength) override
+    {
+        Transfer();
+        dir = buffer[0];
+        Apply();
+        return 0;
+    }
+    int GPIODirRead(uint8_t *buffer, const size_t bufLength) override
+    {
+        Transfer();
+        buffer[0] = dir;
+        return 0;
+    }
+    int GPIODirWriteSequence(const uint8_t *states, const size_t count) override
+    {
+        if (!queued)
+            return IConnection::GPIODirWriteSequence(states, count);
+        Transfer();
+        for (size_t i = 0; i < count; ++i)
+        {
+            dir = states[i];
+            Apply();
+        }
+        return 0;
+    }
+
+    unsigned transfers;
+    EchoSlave slave;
+
+private:
+    void Transfer()
+    {
+        ++transfers;
+        if (latency > 0)
+            this_thread::sleep_for(chrono::microseconds(latency));
+    }
+    uint8_t Levels() const
+    {
+        //outputs drive their values, inputs are pulled up
+        uint8_t levels = (dir & val) | ~dir;
+        if (slave.drive)
+            levels &= ~(1 << sdaBit);
+        return levels;
+    }
+    void Apply()
+    {
+        const uint8_t levels = Levels();
+        slave.Update((levels >> sclBit) & 1, (levels >> sdaBit) & 1);
+    }
+    int latency;
+    bool queued;
+    uint8_t dir;
+    uint8_t val;
+};
+
+/*!
+ * Former limeRFE bit-banging, four GPIO transfers and half SCL period delay per line change
+ */
+class EdgeI2C
+{
+public:
+    explicit EdgeI2C(IConnection* c) : conn(c) {}
+
+    int Write(const unsigned char* data, int size)
+    {
+        Start();
+        Tx(slaveAddress << 1);
+        for (int i = 0; i < size; ++i)
+            Tx(data[i]);
+        Stop();
+        return 0;
+    }
+    int Read(unsigned char* data, int size)
+    {
+        Start();
+        Tx((slaveAddress << 1) | 1);
+        for (int i = 0; i < size; ++i)
+            data[i] = Rx(i != size - 1);
+        Stop();
+        return size;
+    }
+
+private:
+    void SetVal(int bit, int value)
+    {
+        uint8_t gpioDir = 0;
+        conn->GPIODirRead(&gpioDir, 1);
+        gpioDir = value ? gpioDir & ~(1 << bit) : gpioDir | (1 << bit);
+        conn->GPIODirWrite(&gpioDir, 1);
+        uint8_t gpioVal = 0;
+        conn->GPIORead(&gpioVal, 1);
+        gpioVal = value ? gpioVal | (1 << bit) : gpioVal & ~(1 << bit);
+        conn->GPIOWrite(&gpioVal, 1);
+        this_thread::sleep_for(chrono::microseconds(5));
+    }
+    int GetVal(int bit)
+    {
+        uint8_t gpioVal = 0;
+        conn->GPIORead(&gpioVal, 1);
+        return gpioVal & (1 << bit);
+    }
+    void Start()
+    {
+        SetVal(sdaBit, 1);
+        SetVal(sclBit, 1);
+        SetVal(sdaBit, 0);
+        SetVal(sclBit, 0);
+    }
+    void Stop()
+    {
+        SetVal(sdaBit, 0);
+        SetVal(sclBit, 1);
+        SetVal(sdaBit, 1);
+    }
+    void Tx(unsigned char d)
+    {
+        for (int x = 0; x < 8; ++x)
+        {
+            SetVal(sdaBit, (d & 0x80) != 0);
+            SetVal(sclBit, 1);
+            d <<= 1;
+            SetVal(sclBit, 0);
+        }
+        SetVal(sdaBit, 1);
+        SetVal(sclBit, 1);
+        GetVal(sdaBit);
+        SetVal(sclBit, 0);
+    }
+    unsigned char Rx(bool ack)
+    {
+        unsigned char d = 0;
+        SetVal(sdaBit, 1);
+        for (int x = 0; x < 8; ++x)
+        {
+            d <<= 1;
+            do
+                SetVal(sclBit, 1);
+            while (GetVal(sclBit) == 0);
+            if (GetVal(sdaBit))
+                d |= 1;
+            SetVal(sclBit, 0);
+        }
+        SetVal(sdaBit, !ack);
+        SetVal(sclBit, 1);
+        SetVal(sclBit, 0);
+        SetVal(sdaBit, 1);
+        return d;
+    }
+    IConnection* conn;
+};
+
+/** @brief Writes command buffer and reads it back like limeRFE command exchange
+*/
+template<class Master>
+static void Exchange(const char* name, Master &master, GPIOStandIn &conn)
+{
+    const int size = 16;
+    unsigned char command[size];
+    for (int i = 0; i < size; ++i)
+        command[i] = 0xA5 ^ (i * 37);
+    unsigned char reply[size] = {0};
+
+    conn.transfers = 0;
+    auto t0 = chrono::high_resolution_clock::now();
+    master.Write(command, size);
+    const unsigned writeTransfers = conn.transfers;
+    master.Read(reply, size);
+    auto t1 = chrono::high_resolution_clock::now();
+
+    bool ok = conn.slave.data.size() == size_t(size);
+    for (int i = 0; ok && i < size; ++i)
+        ok = conn.slave.data[i] == command[i] && reply[i] == command[i];
+    cout << setw(28) << left << name << right
+         << setw(10) << writeTransfers
+         << setw(10) << conn.transfers - writeTransfers
+         << fixed << setprecision(2) << setw(12) << chrono::duration<double>(t1 - t0).count() * 1e3
+         << setw(8) << (ok ? "ok" : "FAIL") << endl;
+}
+
+int main(int argc, char** argv)
+{
+    const int latency_us = 100;
+    cout << "16 byte write and read, GPIO transfer latency " << latency_us << " us" << endl;
+    cout << "method                      write xfers read xfers  total ms  check" << endl;
+    {
+        GPIOStandIn conn(latency_us, false);
+        EdgeI2C master(&conn);
+        Exchange("per edge read-modify-write", master, conn);
+    }
+    {
+        GPIOStandIn conn(latency_us, false);
+        RFE_I2CBus master(&conn, slaveAddress, sclBit, sdaBit);
+        Exchange("shadowed, unqueued writes", master, conn);
+    }
+    {
+        GPIOStandIn conn(latency_us, true);
+        RFE_I2CBus master(&conn, slaveAddress, sclBit, sdaBit);
+        Exchange("shadowed, queued writes", master, conn);
+    }
+    return 0;
+}
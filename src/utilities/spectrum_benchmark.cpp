@@ -0,0 +1,88 @@
+/**
+    @file spectrum_benchmark.cpp
+    @author Lime Microsystems
+    @brief Measures SpectrumEngine throughput for different FFT sizes
+*/
+
+#include "SpectrumEngine.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+using namespace lime;
+
+//runs engine over samples, returns processed mega samples per second per channel
+static double Measure(const SpectrumEngine::Config &config, const vector<vector<complex16_t> > &data, vector<float> &spectrum)
+{
+    SpectrumEngine engine;
+    if (engine.Configure(config, data.size()) != 0)
+        return 0;
+    vector<const complex16_t*> buffers;
+    for (auto &ch : data)
+        buffers.push_back(ch.data());
+    const uint32_t chunk = 16384;
+    const uint32_t total = data[0].size();
+    auto t0 = chrono::high_resolution_clock::now();
+    for (uint32_t pos = 0; pos + chunk <= total; pos += chunk)
+    {
+        vector<const complex16_t*> chunkPtrs;
+        for (auto ptr : buffers)
+            chunkPtrs.push_back(ptr + pos);
+        engine.Process(chunkPtrs.data(), chunk);
+    }
+    auto t1 = chrono::high_resolution_clock::now();
+    spectrum.resize(config.fftSize);
+    engine.GetSpectrum(0, spectrum.data());
+    return total / chrono::duration<double>(t1 - t0).count() / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    const unsigned channels = 2;
+    const uint32_t samples = argc > 1 ? atoi(argv[1]) : 1 << 22;
+    const double toneFraction = 0.125; //tone at fs/8
+
+    vector<vector<complex16_t> > data(channels, vector<complex16_t>(samples));
+    unsigned seed = 1;
+    for (auto &ch : data)
+        for (uint32_t n = 0; n < samples; ++n)
+        {
+            seed = seed * 1103515245 + 12345;
+            const int noise = int((seed >> 16) & 0x1F) - 16;
+            ch[n].i = lrint(1000 * cos(2 * M_PI * toneFraction * n)) + noise;
+            ch[n].q = lrint(1000 * sin(2 * M_PI * toneFraction * n)) - noise;
+        }
+
+    cout << "SpectrumEngine, " << channels << " channels, Blackman-Harris, 50% overlap, "
+         << std::thread::hardware_concurrency() << " hardware threads" << endl;
+    cout << setw(8) << "FFT" << setw(14) << "1 thread" << setw(14) << "all threads" << setw(10) << "peak" << endl;
+    bool ok = true;
+    for (unsigned fftSize = 1024; fftSize <= 65536; fftSize *= 2)
+    {
+        SpectrumEngine::Config config;
+        config.fftSize = fftSize;
+        config.windowFunction = 1;
+        config.overlap = 0.5;
+        vector<float> single, multi;
+        config.threads = 1;
+        const double rateSingle = Measure(config, data, single);
+        config.threads = 0;
+        const double rateMulti = Measure(config, data, multi);
+
+        //output starts at bin N/2+1, tone should land at N/2-1 + N/8
+        unsigned peak = 0;
+        for (unsigned i = 0; i < fftSize; ++i)
+            if (multi[i] > multi[peak])
+                peak = i;
+        const unsigned expected = fftSize / 2 - 1 + unsigned(fftSize * toneFraction);
+        const bool match = peak == expected && fabs(single[peak] - multi[peak]) <= 1e-3 * single[peak];
+        ok &= match;
+        cout << setw(8) << fftSize << setw(10) << fixed << setprecision(1) << rateSingle << " MS/s"
+             << setw(10) << rateMulti << " MS/s" << setw(10) << (match ? "ok" : "FAIL") << endl;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}